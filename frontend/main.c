@@ -770,6 +770,7 @@ usage(int error_code)
 		"  --use-gl\t\tUse the GL renderer (deprecated alias for --renderer=gl)\n"
 		"  --use-vulkan\t\tUse the Vulkan renderer (deprecated alias for --renderer=vulkan)\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
+		"  --output-count=COUNT\tCreate multiple outputs\n"
 		"  --refresh-rate=RATE\tThe output refresh rate (in mHz)\n"
 		"  --fake-seat\t\tUse a fake seat for compatibility\n"
 		"\n");
@@ -1174,6 +1175,22 @@ weston_parse_require_outputs(const char *name, enum require_outputs *mode)
 	return -1;
 }
 
+/* $XDG_CACHE_HOME/weston, or ~/.cache/weston without it */
+static char *
+get_renderer_cache_dir(void)
+{
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *dir = NULL;
+
+	if (cache_home && cache_home[0] == '/')
+		str_printf(&dir, "%s/weston", cache_home);
+	else if (home && home[0] == '/')
+		str_printf(&dir, "%s/.cache/weston", home);
+
+	return dir;
+}
+
 static int
 weston_compositor_init_config(struct weston_compositor *ec,
 			      struct weston_config *config)
@@ -1182,6 +1199,9 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
 	int repaint_msec;
+	int repaint_threads;
+	bool renderer_cache;
+	bool renderer_cache_prewarm;
 	bool color_management;
 	bool cal;
 	bool disable_input = false;
@@ -1223,6 +1243,41 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	weston_log("Output repaint window is %d ms maximum.\n",
 		   ec->repaint_msec);
 
+	weston_config_section_get_bool(s, "adaptive-repaint-window",
+				       &ec->adaptive_repaint_window, false);
+	if (ec->adaptive_repaint_window)
+		weston_log("Output repaint window adapts to repaint durations.\n");
+
+	weston_config_section_get_int(s, "repaint-threads", &repaint_threads, 1);
+	if (repaint_threads < 1 || repaint_threads > 32) {
+		weston_log("Invalid repaint-threads value in config: %d\n",
+			   repaint_threads);
+	} else if (repaint_threads > 1) {
+		if (weston_compositor_set_repaint_threads(ec, repaint_threads) < 0)
+			return -1;
+		weston_log("Using %d threads for output repaint.\n",
+			   repaint_threads);
+	}
+
+	weston_config_section_get_uint(s, "occluded-frame-interval",
+				       &ec->occluded_frame_interval_msec, 0);
+	if (ec->occluded_frame_interval_msec > 0)
+		weston_log("Frame callbacks of occluded surfaces are sent every "
+			   "%u ms.\n", ec->occluded_frame_interval_msec);
+
+	weston_config_section_get_bool(s, "renderer-cache",
+				       &renderer_cache, true);
+	weston_config_section_get_bool(s, "renderer-cache-prewarm",
+				       &renderer_cache_prewarm, false);
+	if (renderer_cache) {
+		char *dir = get_renderer_cache_dir();
+
+		if (dir)
+			weston_compositor_set_renderer_cache(ec, dir,
+							     renderer_cache_prewarm);
+		free(dir);
+	}
+
 	weston_config_section_get_uint(s, "placeholder-color",
 				       &ec->placeholder_color, 0x660000);
 
@@ -4307,7 +4362,9 @@ load_headless_backend(struct weston_compositor *c,
 	bool force_gl;
 	bool force_vulkan;
 	bool no_outputs = false;
+	int output_count = 1;
 	char *transform = NULL;
+	int i;
 
 	struct wet_output_config *parsed_options = wet_init_parsed_options(c);
 	if (!parsed_options)
@@ -4332,6 +4389,7 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_BOOLEAN, "use-vulkan", 0, &force_vulkan },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
+		{ WESTON_OPTION_INTEGER, "output-count", 0, &output_count },
 		{ WESTON_OPTION_INTEGER, "refresh-rate", 0, &config.refresh },
 		{ WESTON_OPTION_BOOLEAN, "fake-seat", 0, &config.fake_seat },
 	};
@@ -4384,6 +4442,19 @@ load_headless_backend(struct weston_compositor *c,
 
 		if (api->create_head(wb->backend, "headless") < 0)
 			return -1;
+
+		for (i = 1; i < output_count; i++) {
+			char *name;
+
+			if (asprintf(&name, "headless-%d", i) < 0)
+				return -1;
+
+			if (api->create_head(wb->backend, name) < 0) {
+				free(name);
+				return -1;
+			}
+			free(name);
+		}
 	}
 
 	return 0;
@@ -5529,6 +5600,12 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	if (weston_compositor_init_config(wet.compositor, config) < 0)
 		goto out;
 
+	/* Tests must neither depend on nor fill the user's cache */
+	if (test_data)
+		weston_compositor_set_renderer_cache(wet.compositor,
+						     test_data->test_quirks.renderer_cache_dir,
+						     wet.compositor->renderer_cache_prewarm);
+
 	weston_config_section_get_bool(section, "require-input",
 				       &wet.compositor->require_input, true);
 
@@ -80,6 +80,29 @@ struct weston_commit_timing_target {
 	struct timespec time;
 };
 
+/** Cumulative performance counters of a surface or an output
+ *
+ * For a surface, \c commits counts content updates bringing new content,
+ * \c painted those that made it into a repaint, and \c dropped those
+ * replaced before they could. The latency is from a content update being
+ * applied to the repaint showing it being submitted.
+ *
+ * For an output, \c commits counts submitted repaints, \c painted those
+ * that got presented, and \c dropped those presented late. The latency is
+ * from the start of a repaint to its presentation.
+ *
+ * Counters only ever grow, rates are taken from the difference between two
+ * snapshots.
+ */
+struct weston_perf_counters {
+	uint64_t commits;
+	uint64_t painted;
+	uint64_t dropped;
+	uint64_t latency_count;
+	uint64_t latency_total_nsec;
+	uint64_t latency_max_nsec;
+};
+
 struct weston_client;
 struct weston_compositor;
 struct weston_surface;
@@ -97,6 +120,8 @@ struct pixel_format_info;
 struct weston_output_capture_info;
 struct weston_output_color_outcome;
 struct weston_tearing_control;
+struct weston_repaint_window;
+struct weston_repaint_profile;
 struct di_info;
 
 enum weston_keyboard_modifier {
@@ -226,6 +251,8 @@ struct weston_testsuite_quirks {
 	bool gl_force_import_yuv_fallback;
 	/** Required enum weston_capability bit mask, otherwise skip run. */
 	uint32_t required_capabilities;
+	/** Renderer cache directory, the renderer cache is off if NULL. */
+	const char *renderer_cache_dir;
 };
 
 /** Weston test suite data that is given to compositor
@@ -409,6 +436,7 @@ struct weston_output {
 	int32_t width, height;
 
 	uint64_t gpu_track_id;
+	uint64_t gpu_pass_track_id;
 	uint64_t paint_track_id;
 	uint64_t presentation_track_id;
 
@@ -503,6 +531,26 @@ struct weston_output {
 	struct weston_log_pacer repaint_delay_pacer;
 	struct weston_log_pacer pixman_overdraw_pacer;
 
+	/** Recent repaint durations, see repaint-window.c */
+	struct weston_repaint_window *repaint_window;
+	/** Target presentation time of the frame being repainted, to
+	 *  detect misses. Valid only while awaiting completion. */
+	struct timespec repaint_target;
+	bool repaint_target_valid;
+	/** When the repaint of this output, rather than of all the outputs
+	 *  repainting with it, started */
+	struct timespec repaint_start;
+	/** Time spent in each repaint phase */
+	struct weston_repaint_profile *repaint_profile;
+	/** Occluded surfaces on this output wait for their throttled
+	 *  frame callbacks, see occluded_frame_interval_msec */
+	bool occluded_frame_callbacks_pending;
+
+	struct weston_perf_counters perf;
+	/** When the repaint awaiting presentation started */
+	struct timespec perf_repaint_start;
+	bool perf_repaint_pending;
+
 	int (*start_repaint_loop)(struct weston_output *output);
 	void (*prepare_repaint)(struct weston_output *output);
 	int (*repaint)(struct weston_output *output);
@@ -1365,6 +1413,10 @@ struct weston_dmabuf_feedback;
 struct weston_dmabuf_feedback_format_table;
 struct weston_renderer;
 struct weston_content_update;
+struct weston_transaction_queue;
+struct weston_pick_index;
+struct weston_worker_pool;
+struct weston_slab_pool;
 
 /** Main object, container-like structure which aggregates all other objects.
  *
@@ -1414,6 +1466,9 @@ struct weston_compositor {
 	struct wl_list seat_list;
 	struct wl_list layer_list;	/* struct weston_layer::link */
 	struct wl_list view_list;	/* struct weston_view::link */
+	struct weston_pick_index *pick_index;
+	struct weston_slab_pool *view_pool;
+	struct weston_slab_pool *paint_node_pool;
 	struct wl_list plane_list;
 	struct wl_list key_binding_list;
 	struct wl_list modifier_binding_list;
@@ -1470,7 +1525,25 @@ struct weston_compositor {
 
 	clockid_t presentation_clock;
 	int32_t repaint_msec;
+	/** Choose the repaint window of each output from its measured
+	 *  repaint durations, using repaint_msec only until enough have
+	 *  been measured. */
+	bool adaptive_repaint_window;
 	struct timespec last_repaint_start;
+	struct weston_worker_pool *repaint_pool;
+	/** Send the frame callbacks of surfaces fully occluded on their
+	 *  output at most once per this many milliseconds. 0 withholds them
+	 *  until the surface becomes visible again. */
+	uint32_t occluded_frame_interval_msec;
+	struct wl_event_source *occluded_frame_timer;
+	bool occluded_frame_timer_armed;
+	struct timespec occluded_frame_deadline; /* valid while armed */
+	/** Directory where renderers keep data across sessions, such as
+	 *  compiled shader programs. NULL disables it. */
+	char *renderer_cache_dir;
+	/** Let renderers prepare at startup what the previous session used
+	 *  from their cache. */
+	bool renderer_cache_prewarm;
 
 	unsigned int activate_serial;
 
@@ -1513,6 +1586,10 @@ struct weston_compositor {
 	struct weston_log_scope *debug_scene;
 	struct weston_log_scope *timeline;
 	struct weston_log_scope *libseat_debug;
+	struct weston_log_scope *repaint_window_debug;
+	struct weston_log_scope *repaint_profile_debug;
+	struct weston_log_scope *perf_counters_debug;
+	struct weston_log_scope *slab_pools_debug;
 	struct weston_log_filtered *advertised_log_scopes;
 
 	struct content_protection *content_protection;
@@ -1785,6 +1862,20 @@ struct weston_view {
 
 	bool is_mapped;
 	struct weston_log_pacer subsurface_parent_log_pacer;
+
+	/* Spatial index state for weston_compositor_pick_view(),
+	 * managed by pick-index.c.
+	 */
+	struct {
+		struct wl_list link;       /* weston_pick_index::view_list */
+		struct wl_list wide_link;  /* weston_pick_index::wide_list */
+		struct wl_list dirty_link; /* weston_pick_index::dirty_list */
+		bool indexed;
+		bool filed;
+		pixman_box32_t cells;      /* inclusive, valid when filed */
+		uint32_t order;            /* position in the view list */
+		uint32_t generation;
+	} pick;
 };
 
 enum weston_surface_status {
@@ -1946,6 +2037,8 @@ struct weston_surface {
 
 	struct wl_list frame_callback_list;
 	struct wl_list feedback_list;
+	/** Output frame time at which frame callbacks were last sent */
+	struct timespec frame_callback_time;
 
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_viewport buffer_viewport;
@@ -2049,6 +2142,11 @@ struct weston_surface {
 	float frame_commit_fps_counter;
 	float painted_frame_fps_counter;
 
+	struct weston_perf_counters perf;
+	/** When the content update not yet painted was applied */
+	struct timespec perf_update_time;
+	bool perf_update_pending;
+
 	/** Visibility won't be calculated until repaint, but we use this to
 	 * track whether we can safely use the last repaint's visibility
 	 * calculations when considering this surface's visibility.
@@ -2062,6 +2160,11 @@ struct weston_surface {
 
 	/** commit_timing_v1 */
 	struct weston_commit_timer *commit_timer;
+
+	/** Deferred content updates: the transaction queue holding all of
+	 * this surface's pending content updates, or NULL if it has none */
+	struct weston_transaction_queue *transaction_queue;
+	unsigned int pending_content_update_count;
 };
 
 struct weston_subsurface {
@@ -2299,6 +2402,14 @@ void
 weston_compositor_set_default_pointer_grab(struct weston_compositor *compositor,
 			const struct weston_pointer_grab_interface *interface);
 
+int
+weston_compositor_set_repaint_threads(struct weston_compositor *compositor,
+				      unsigned int n_threads);
+
+void
+weston_compositor_set_renderer_cache(struct weston_compositor *compositor,
+				     const char *dir, bool prewarm);
+
 struct weston_surface *
 weston_surface_create(struct weston_compositor *compositor,
 		      struct weston_client *client);
@@ -310,6 +310,7 @@ pipewire_output_enable_pixman(struct pipewire_output *output)
 	struct weston_renderer *renderer = output->base.compositor->renderer;
 	const struct pixman_renderer_output_options options = {
 		.use_shadow = true,
+		.skip_shadow_if_possible = true,
 		.fb_size = {
 			.width = output->base.current_mode->width,
 			.height = output->base.current_mode->height,
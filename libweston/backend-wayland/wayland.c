@@ -854,6 +854,7 @@ wayland_output_init_pixman_renderer(struct wayland_output *output)
 	struct weston_renderer *renderer = output->base.compositor->renderer;
 	const struct pixman_renderer_output_options options = {
 		.use_shadow = true,
+		.skip_shadow_if_possible = true,
 		.fb_size = {
 			.width = output->base.current_mode->width,
 			.height = output->base.current_mode->height
@@ -1105,6 +1105,7 @@ x11_output_enable(struct weston_output *base)
 	case WESTON_RENDERER_PIXMAN: {
 		const struct pixman_renderer_output_options options = {
 			.use_shadow = true,
+			.skip_shadow_if_possible = true,
 			.fb_size = {
 				.width = mode->width,
 				.height = mode->height
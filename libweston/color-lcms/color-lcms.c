@@ -398,7 +398,7 @@ cmlcms_init(struct weston_color_manager *cm_base)
 	struct weston_compositor *compositor = cm->base.compositor;
 
 	if (!(compositor->capabilities & WESTON_CAP_COLOR_OPS)) {
-		weston_log("color-lcms: error: color operations capability missing. Is GL-renderer not in use?\n");
+		weston_log("color-lcms: error: color operations capability missing. Is neither GL-renderer nor Pixman-renderer in use?\n");
 		return false;
 	}
 
@@ -87,9 +87,13 @@
 #include "color-representation.h"
 #include "id-number-allocator.h"
 #include "output-capture.h"
+#include "pick-index.h"
+#include "repaint-window.h"
+#include "slab-pool.h"
 #include "pixman-renderer.h"
 #include "renderer-gl/gl-renderer.h"
 #include "weston-trace.h"
+#include "worker-pool.h"
 #include "renderer-vulkan/vulkan-renderer.h"
 
 #include <libweston/commit-timing.h>
@@ -270,6 +274,10 @@ paint_node_update_early(struct weston_paint_node *pnode)
 	if (buffer_dirty)
 		surface->compositor->renderer->attach(pnode);
 
+	if (view_dirty || output_dirty ||
+	    (pnode->status & WESTON_PAINT_NODE_BUFFER_PARAMS_DIRTY))
+		pnode->visibility_stale = true;
+
 	pnode->output->paint_node_changes |= pnode->status;
 	pnode->status &= ~(WESTON_PAINT_NODE_VIEW_DIRTY | \
 			   WESTON_PAINT_NODE_OUTPUT_DIRTY |
@@ -390,9 +398,7 @@ weston_paint_node_create(struct weston_surface *surface,
 
 	assert(view->surface == surface);
 
-	pnode = zalloc(sizeof *pnode);
-	if (!pnode)
-		return NULL;
+	pnode = weston_slab_pool_alloc(surface->compositor->paint_node_pool);
 
 	/*
 	 * Invariant: all paint nodes with the same surface+output have the
@@ -420,13 +426,16 @@ weston_paint_node_create(struct weston_surface *surface,
 
 	str_printf(&pnode->internal_name, "%u:%s", output->id, view->internal_name);
 
+	wl_signal_init(&pnode->destroy_signal);
 	wl_list_init(&pnode->z_order_link);
 
 	pixman_region32_init(&pnode->damage);
 	pixman_region32_init(&pnode->visible);
 	pixman_region32_init(&pnode->visible_previous);
 	pixman_region32_init(&pnode->clipped_view);
+	pixman_region32_init(&pnode->opaque_above);
 	pixman_region32_copy(&pnode->visible, &view->transform.boundingbox);
+	pnode->visibility_stale = true;
 
 	pnode->plane = &pnode->output->primary_plane;
 	pnode->plane_next = NULL;
@@ -441,12 +450,22 @@ weston_paint_node_create(struct weston_surface *surface,
 static void
 weston_paint_node_remove_z_order_link(struct weston_paint_node *pnode)
 {
+	struct wl_list *below = pnode->z_order_link.next;
+
 	/* We don't need to rebuild the z order list on removal, because a
 	 * removal still leaves a nicely z sorted list.
+	 *
+	 * The visibility of everything below changes though, so start the
+	 * next incremental visibility update at the node below.
 	 */
-	if (!wl_list_empty(&pnode->z_order_link))
+	if (!wl_list_empty(&pnode->z_order_link)) {
 		paint_node_damage_below(pnode, &pnode->visible);
 
+		if (below != &pnode->output->paint_node_z_order_list)
+			container_of(below, struct weston_paint_node,
+				     z_order_link)->visibility_stale = true;
+	}
+
 	/* Once we unlink this paint node, it will no longer be seen by
 	 * the paint node update functions that accumulate paint node
 	 * changes for the output. Those changes might be used by the
@@ -463,6 +482,8 @@ weston_paint_node_remove_z_order_link(struct weston_paint_node *pnode)
 	pixman_region32_clear(&pnode->visible);
 	pixman_region32_clear(&pnode->clipped_view);
 	pixman_region32_clear(&pnode->damage);
+	pixman_region32_clear(&pnode->opaque_above);
+	pnode->visibility_stale = true;
 	pnode->status = WESTON_PAINT_NODE_CLEAN;
 	wl_list_remove(&pnode->z_order_link);
 	wl_list_init(&pnode->z_order_link);
@@ -473,6 +494,8 @@ weston_paint_node_destroy(struct weston_paint_node *pnode)
 {
 	assert(pnode->view->surface == pnode->surface);
 
+	wl_signal_emit(&pnode->destroy_signal, pnode);
+
 	weston_paint_node_remove_z_order_link(pnode);
 
 	pnode->view->output_visibility_mask &= ~(1u << pnode->output->id);
@@ -486,8 +509,10 @@ weston_paint_node_destroy(struct weston_paint_node *pnode)
 	pixman_region32_fini(&pnode->visible);
 	pixman_region32_fini(&pnode->visible_previous);
 	pixman_region32_fini(&pnode->clipped_view);
+	pixman_region32_fini(&pnode->opaque_above);
 	free(pnode->internal_name);
-	free(pnode);
+	weston_slab_pool_free(pnode->surface->compositor->paint_node_pool,
+			      pnode);
 }
 
 /** Send wl_output events for mode and scale changes
@@ -745,10 +770,7 @@ weston_view_create_internal(struct weston_surface *surface)
 {
 	struct weston_view *view;
 
-	view = zalloc(sizeof *view);
-	if (view == NULL)
-		return NULL;
-
+	view = weston_slab_pool_alloc(surface->compositor->view_pool);
 	view->surface = surface;
 
 	/* Assign to surface */
@@ -760,6 +782,9 @@ weston_view_create_internal(struct weston_surface *surface)
 	wl_list_init(&view->link);
 	wl_list_init(&view->layer_link.link);
 	wl_list_init(&view->paint_node_list);
+	wl_list_init(&view->pick.link);
+	wl_list_init(&view->pick.wide_link);
+	wl_list_init(&view->pick.dirty_link);
 
 	view->internal_id = ++surface->view_id_counter;
 	str_printf(&view->internal_name, "%s-%" PRIu64,
@@ -1980,6 +2005,9 @@ weston_view_update_transform_internal(struct weston_view *view)
 
 	weston_view_assign_output(view);
 
+	weston_pick_index_update_view(view->surface->compositor->pick_index,
+				      view);
+
 	wl_signal_emit(&view->surface->compositor->transform_signal,
 		       view->surface);
 
@@ -2014,6 +2042,8 @@ weston_view_geometry_dirty_internal(struct weston_view *view)
 		return;
 
 	view->transform.dirty = 1;
+	weston_pick_index_dirty_view(view->surface->compositor->pick_index,
+				     view);
 
 	wl_list_for_each(child, &view->geometry.child_list,
 			 geometry.parent_link)
@@ -2529,25 +2559,10 @@ weston_compositor_pick_view(struct weston_compositor *compositor,
 			    struct weston_coord_global pos)
 {
 	WESTON_TRACE_FUNC();
-	struct weston_view *view;
-
-	/* Can't use paint node list: occlusion by input regions, not opaque. */
-	wl_list_for_each(view, &compositor->view_list, link) {
-		struct weston_coord_surface surf_pos;
-
-		weston_view_update_transform(view);
-
-		if (!pixman_region32_contains_point(
-				&view->transform.boundingbox, pos.c.x, pos.c.y, NULL))
-			continue;
-
-		surf_pos = weston_coord_global_to_surface(view, pos);
-		if (!weston_view_takes_input_at_point(view, surf_pos))
-			continue;
 
-		return view;
-	}
-	return NULL;
+	/* Can't use paint node list: occlusion by input regions, not opaque.
+	 * The pick index follows the view list order instead. */
+	return weston_pick_index_pick_view(compositor->pick_index, pos);
 }
 
 static void
@@ -2596,6 +2611,8 @@ weston_view_unmap(struct weston_view *view)
 	view->layer_link.layer = NULL;
 	wl_list_remove(&view->link);
 	wl_list_init(&view->link);
+	weston_pick_index_remove_view(view->surface->compositor->pick_index,
+				      view);
 	weston_view_set_output_mask(view, 0x0);
 	view->output_visibility_mask = 0;
 	weston_surface_assign_output(view->surface);
@@ -2676,6 +2693,8 @@ weston_view_destroy(struct weston_view *view)
 	if (!wl_list_empty(&view->link))
 		view->surface->compositor->view_list_needs_rebuild = true;
 	wl_list_remove(&view->link);
+	weston_pick_index_remove_view(view->surface->compositor->pick_index,
+				      view);
 
 	wl_list_remove(&view->layer_link.link);
 	wl_list_init(&view->layer_link.link);
@@ -2691,7 +2710,7 @@ weston_view_destroy(struct weston_view *view)
 	wl_list_remove(&view->surface_link);
 
 	free(view->internal_name);
-	free(view);
+	weston_slab_pool_free(view->surface->compositor->view_pool, view);
 }
 
 WL_EXPORT struct weston_surface *
@@ -3306,15 +3325,82 @@ out:
 	surface->flow_id = 0;
 }
 
+WESTON_EXPORT_FOR_TESTS const char *
+weston_repaint_phase_to_str(enum weston_repaint_phase phase)
+{
+	switch (phase) {
+	case WESTON_REPAINT_PHASE_PREPARE:
+		return "prepare";
+	case WESTON_REPAINT_PHASE_VISIBILITY:
+		return "visibility";
+	case WESTON_REPAINT_PHASE_ASSIGN_PLANES:
+		return "assign_planes";
+	case WESTON_REPAINT_PHASE_DAMAGE:
+		return "damage";
+	case WESTON_REPAINT_PHASE_RENDER:
+		return "render";
+	case WESTON_REPAINT_PHASE_COUNT:
+		break;
+	}
+
+	return "???";
+}
+
+static uint64_t
+repaint_profile_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return timespec_to_nsec(&now);
+}
+
+/* Charge the time since *start to a repaint phase, and restart the clock.
+ * Phases may be entered more than once per repaint.
+ */
+static void
+repaint_profile_mark(struct weston_output *output,
+		     enum weston_repaint_phase phase, uint64_t *start)
+{
+	uint64_t now = repaint_profile_now();
+
+	output->repaint_profile->last_nsec[phase] += now - *start;
+	*start = now;
+}
+
+static void
+paint_node_add_opaque(struct weston_paint_node *pnode,
+		      pixman_region32_t *opaque)
+{
+	if (pnode->is_fully_opaque)
+		pixman_region32_union(opaque, opaque, &pnode->visible);
+	else if (pnode->view->alpha == 1.0)
+		pixman_region32_union(opaque, opaque,
+				      &pnode->view->transform.opaque);
+}
+
+/* Whether anything this paint node's own visibility depends on, other
+ * than the opaque region above it, may have changed since it was last
+ * computed.
+ */
+static bool
+paint_node_visibility_changed(struct weston_paint_node *pnode)
+{
+	return pnode->visibility_stale ||
+	       (pnode->status & WESTON_PAINT_NODE_VISIBILITY_DIRTY) ||
+	       pnode->visible_fully_opaque != pnode->is_fully_opaque;
+}
+
 static void
 paint_node_update_visible(struct weston_paint_node *pnode,
 			  pixman_region32_t *opaque)
 {
 	struct weston_view *view = pnode->view;
-	struct weston_surface *surface = view->surface;
 
 	assert(!view->transform.dirty);
 
+	pixman_region32_copy(&pnode->opaque_above, opaque);
 	pixman_region32_copy(&pnode->visible_previous, &pnode->visible);
 
 	pixman_region32_intersect(&pnode->clipped_view,
@@ -3324,35 +3410,95 @@ paint_node_update_visible(struct weston_paint_node *pnode,
 	pixman_region32_subtract(&pnode->visible, &pnode->clipped_view,
 				 opaque);
 
-	if (pnode->is_fully_opaque)
-		pixman_region32_union(opaque, opaque, &pnode->visible);
-	else if (view->alpha == 1.0)
-		pixman_region32_union(opaque, opaque, &view->transform.opaque);
-
-	/* This might not be the only paint node that contributes to this
-	 * surface's visibility on this output, but since we can only end up
-	 * here when doing a full walk of this output's paint nodes, we know
-	 * that all paint nodes that contribute to this dirty bit will be
-	 * considered before the walk is finished.
-	 */
-	surface->output_visibility_dirty_mask &= ~(1u << pnode->output->id);
+	paint_node_add_opaque(pnode, opaque);
+
+	pnode->visibility_stale = false;
+	pnode->visible_previous_stale = true;
+	pnode->visible_fully_opaque = pnode->is_fully_opaque;
 }
 
+/* The visibility of this paint node is known to be the same as on the
+ * previous update, so it only needs its bookkeeping brought up to date.
+ */
+static void
+paint_node_keep_visible(struct weston_paint_node *pnode)
+{
+	if (pnode->visible_previous_stale) {
+		pixman_region32_copy(&pnode->visible_previous, &pnode->visible);
+		pnode->visible_previous_stale = false;
+	}
+}
 
+/* Only the paint nodes at or below the topmost changed paint node can have
+ * a different visibility than on the previous update. Every paint node keeps
+ * the opaque region of all the nodes above it, so the walk can start there
+ * without looking at the nodes above. Once the recomputed opaque region
+ * matches the one cached on an unchanged node again, the nodes below are
+ * unaffected until the next changed node.
+ */
 static void
 output_update_visibility(struct weston_output *output)
 {
 	WESTON_TRACE_FUNC();
 	struct weston_paint_node *pnode;
+	struct weston_paint_node *above = NULL;
+	bool recompute = false;
 	pixman_region32_t opaque;
+	uint64_t start = repaint_profile_now();
 
 	pixman_region32_init(&opaque);
 
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
-			 z_order_link)
+			 z_order_link) {
+		bool changed = paint_node_visibility_changed(pnode);
+
+		if (!recompute && !changed) {
+			paint_node_keep_visible(pnode);
+			above = pnode;
+			continue;
+		}
+
+		if (!recompute) {
+			/* A changed node's own cache may be stale, e.g. when
+			 * it has just been inserted, so use the node above. */
+			if (above) {
+				pixman_region32_copy(&opaque,
+						     &above->opaque_above);
+				paint_node_add_opaque(above, &opaque);
+			}
+			recompute = true;
+		} else if (!changed &&
+			   pixman_region32_equal(&opaque,
+						 &pnode->opaque_above)) {
+			paint_node_keep_visible(pnode);
+			above = pnode;
+			recompute = false;
+			continue;
+		}
+
 		paint_node_update_visible(pnode, &opaque);
+		above = pnode;
+	}
 
 	pixman_region32_fini(&opaque);
+
+	repaint_profile_mark(output, WESTON_REPAINT_PHASE_VISIBILITY, &start);
+}
+
+/* A surface may have paint nodes on several outputs, whose visibility may
+ * be updated concurrently, so the surface's dirty mask is only touched here,
+ * on the main thread, once the walk is finished and all paint nodes of this
+ * output have been considered.
+ */
+static void
+output_clear_visibility_dirty(struct weston_output *output)
+{
+	struct weston_paint_node *pnode;
+	uint32_t output_bit = 1u << output->id;
+
+	wl_list_for_each(pnode, &output->paint_node_z_order_list,
+			 z_order_link)
+		pnode->surface->output_visibility_dirty_mask &= ~output_bit;
 }
 
 static void
@@ -3412,22 +3558,59 @@ view_ensure_paint_node(struct weston_view *view, struct weston_output *output)
 	return weston_paint_node_create(view->surface, view, output);
 }
 
+/* Move a paint node, new or already listed, right after \c pos in the
+ * z-order list of its output.
+ *
+ * Only the paint node itself, and the one that was below it, get their
+ * visibility recomputed from scratch. Everything else below either of them
+ * is caught up by the incremental visibility update.
+ */
 static void
-add_to_z_order_list(struct weston_output *output,
-		    struct weston_paint_node *pnode)
+paint_node_restack(struct weston_paint_node *pnode, struct wl_list *pos)
 {
-	if (!pnode)
-		return;
+	struct wl_list *below = pnode->z_order_link.next;
+
+	if (!wl_list_empty(&pnode->z_order_link) &&
+	    below != &pnode->output->paint_node_z_order_list)
+		container_of(below, struct weston_paint_node,
+			     z_order_link)->visibility_stale = true;
 
 	wl_list_remove(&pnode->z_order_link);
-	wl_list_insert(output->paint_node_z_order_list.prev,
-		       &pnode->z_order_link);
+	wl_list_insert(pos, &pnode->z_order_link);
+	pnode->visibility_stale = true;
+}
 
-	/*
-	 * Building weston_output::paint_node_z_order_list ensures all
-	 * necessary color transform objects are installed.
-	 */
-	weston_paint_node_ensure_color_transform(pnode);
+/* Whether the paint node stays on its output after the z-order list is
+ * brought in line with the view list
+ */
+static bool
+paint_node_is_listed(struct weston_paint_node *pnode)
+{
+	struct weston_view *view = pnode->view;
+
+	return !wl_list_empty(&view->link) &&
+	       weston_surface_is_mapped(view->surface) &&
+	       weston_view_is_mapped(view) &&
+	       weston_surface_has_content(view->surface) &&
+	       (view->output_mask & (1u << pnode->output->id));
+}
+
+/* Take a lowered paint node out of the z-order list. It is put back like a
+ * new one once its view is reached, so only the paint node itself, and the
+ * one that was below it, get their visibility recomputed from scratch.
+ */
+static void
+paint_node_unlink_lowered(struct weston_paint_node *pnode)
+{
+	struct wl_list *below = pnode->z_order_link.next;
+
+	if (below != &pnode->output->paint_node_z_order_list)
+		container_of(below, struct weston_paint_node,
+			     z_order_link)->visibility_stale = true;
+
+	wl_list_remove(&pnode->z_order_link);
+	wl_list_init(&pnode->z_order_link);
+	pnode->visibility_stale = true;
 }
 
 static void
@@ -3495,15 +3678,28 @@ view_list_add(struct weston_compositor *compositor,
 	}
 }
 
+/* Bring the z-order list of an output in line with the view list
+ *
+ * Rather than rebuilding the list from scratch, walk the view list and the
+ * current z-order list side by side. Paint nodes already in place are kept
+ * as they are; new and raised ones are spliced in where they belong, and
+ * those no longer on this output are unlinked.
+ *
+ * A lowered paint node is found right above the paint node of the view
+ * that follows it in the view list. It is taken out there, and put back
+ * once its own view is reached, instead of raising every paint node it
+ * used to cover. Either way, only the paint nodes that moved, and the ones
+ * they used to cover, need their visibility recomputed.
+ */
 static void
 weston_output_build_z_order_list(struct weston_compositor *compositor,
 				 struct weston_output *output)
 {
+	struct wl_list *list = &output->paint_node_z_order_list;
+	struct wl_list *pos = list;
 	struct weston_paint_node *pnode;
 	struct weston_view *view;
-
-	wl_list_remove(&output->paint_node_z_order_list);
-	wl_list_init(&output->paint_node_z_order_list);
+	bool changed = false;
 
 	wl_list_for_each(view, &compositor->view_list, link) {
 		/* It is possible for a view to appear in the layer list even though
@@ -3518,8 +3714,10 @@ weston_output_build_z_order_list(struct weston_compositor *compositor,
 					 "the layer list, which should not occur.\n");
 
 			pnode = weston_view_find_paint_node(view, output);
-			if (pnode)
+			if (pnode) {
 				weston_paint_node_destroy(pnode);
+				changed = true;
+			}
 
 			continue;
 		}
@@ -3528,10 +3726,52 @@ weston_output_build_z_order_list(struct weston_compositor *compositor,
 			continue;
 
 		pnode = view_ensure_paint_node(view, output);
-		add_to_z_order_list(output, pnode);
+		if (!pnode)
+			continue;
+
+		/*
+		 * Building weston_output::paint_node_z_order_list ensures all
+		 * necessary color transform objects are installed.
+		 */
+		weston_paint_node_ensure_color_transform(pnode);
+
+		/* The paint node in the way, right above this one, was
+		 * lowered or is gone */
+		if (pos->next != &pnode->z_order_link && pos->next != list &&
+		    pos->next->next == &pnode->z_order_link) {
+			struct weston_paint_node *above;
+
+			above = container_of(pos->next,
+					     struct weston_paint_node,
+					     z_order_link);
+			if (paint_node_is_listed(above))
+				paint_node_unlink_lowered(above);
+			else
+				weston_paint_node_remove_z_order_link(above);
+			changed = true;
+		}
+
+		if (pos->next != &pnode->z_order_link) {
+			paint_node_restack(pnode, pos);
+			changed = true;
+		}
+
+		pos = &pnode->z_order_link;
+	}
+
+	/* Anything left below the last listed paint node is gone from this
+	 * output. */
+	while (pos->next != list) {
+		pnode = container_of(pos->next, struct weston_paint_node,
+				     z_order_link);
+		weston_paint_node_remove_z_order_link(pnode);
+		changed = true;
 	}
 
-	output->paint_node_changes = WESTON_PAINT_NODE_ALL_DIRTY;
+	/* Tell the backends the stacking changed */
+	if (changed)
+		output->paint_node_changes = WESTON_PAINT_NODE_ALL_DIRTY;
+
 	output->paint_node_list_needs_rebuild = false;
 }
 
@@ -3553,6 +3793,8 @@ weston_compositor_build_view_list(struct weston_compositor *compositor)
 		}
 	}
 
+	weston_pick_index_sync_view_list(compositor->pick_index);
+
 	/* while rebuilding the view list would implicitly need a paint node
 	 * rebuild list as well, the other way around is not true.
 	 * Separating these two allows other call sites to just issue a paint
@@ -3697,6 +3939,180 @@ output_assign_planes(struct weston_output *output)
 	}
 }
 
+static int
+weston_output_repaint_msec(const struct weston_output *output);
+
+/* Like weston_output_repaint_msec(), but with the adaptive repaint window
+ * taken into account, and in nanoseconds.
+ */
+static int64_t
+weston_output_repaint_nsec(const struct weston_output *output)
+{
+	const struct weston_repaint_window *rw = output->repaint_window;
+	int64_t refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+	int64_t repaint_nsec;
+
+	if (!output->compositor->adaptive_repaint_window ||
+	    !weston_repaint_window_is_ready(rw))
+		return (int64_t)weston_output_repaint_msec(output) * 1000000;
+
+	/* Same bounds as for the static repaint window */
+	repaint_nsec = weston_repaint_window_get_nsec(rw);
+	repaint_nsec = MIN(repaint_nsec, refresh_nsec - 1000000);
+	repaint_nsec = MAX(repaint_nsec, 1000000);
+
+	return repaint_nsec;
+}
+
+static void
+weston_output_repaint_window_format(struct weston_output *output,
+				    char *buf, size_t len)
+{
+	const struct weston_repaint_window *rw = output->repaint_window;
+	bool adaptive = output->compositor->adaptive_repaint_window &&
+			weston_repaint_window_is_ready(rw);
+
+	snprintf(buf, len,
+		 "output '%s': window %.1f ms%s, p98 repaint %.1f ms over %u "
+		 "repaints, %" PRIu64 " missed of %" PRIu64,
+		 output->name, weston_output_repaint_nsec(output) / 1e6,
+		 adaptive ? " (adaptive)" : "",
+		 weston_repaint_window_get_percentile_nsec(rw) / 1e6,
+		 rw->n_samples, rw->misses, rw->frames);
+}
+
+static void
+weston_output_repaint_window_report(struct weston_output *output,
+				    const char *reason)
+{
+	struct weston_compositor *compositor = output->compositor;
+	char timestr[128];
+	char str[256];
+
+	if (!weston_log_scope_is_enabled(compositor->repaint_window_debug))
+		return;
+
+	weston_log_scope_timestamp(compositor->repaint_window_debug,
+				   timestr, sizeof timestr);
+	weston_output_repaint_window_format(output, str, sizeof str);
+	weston_log_scope_printf(compositor->repaint_window_debug,
+				"%s %s: %s\n", timestr, reason, str);
+}
+
+/* Record how long this repaint took, from the start of this output's
+ * repaint until the backend has committed the frame. Outputs repainted
+ * before it in the same timer tick are not accounted.
+ */
+static void
+weston_output_repaint_window_sample(struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct weston_repaint_window *rw = output->repaint_window;
+	struct timespec now;
+	int64_t window_nsec;
+
+	weston_compositor_read_presentation_clock(compositor, &now);
+	weston_repaint_window_add_sample(rw,
+		timespec_sub_to_nsec(&now, &output->repaint_start));
+
+	/* Repaints scheduled to present as soon as possible have no
+	 * target to miss. */
+	output->repaint_target = output->next_present;
+	output->repaint_target_valid =
+		timespec_sub_to_nsec(&output->next_present,
+				     &output->next_repaint) > 0;
+
+	window_nsec = weston_output_repaint_nsec(output);
+	if (window_nsec != rw->reported_nsec) {
+		rw->reported_nsec = window_nsec;
+		TL_POINT(compositor, TLP_CORE_REPAINT_WINDOW,
+			 TLP_OUTPUT(output), TLP_END);
+		weston_output_repaint_window_report(output, "window changed");
+	}
+}
+
+/* A frame is late if it was presented noticeably after the time it was
+ * repainted for. Timer driven outputs report their current time when late,
+ * so only a small tolerance is possible.
+ */
+static void
+weston_output_repaint_window_check_miss(struct weston_output *output,
+					const struct timespec *stamp,
+					uint32_t presented_flags)
+{
+	int64_t refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+	int64_t late_nsec;
+
+	if (!output->repaint_target_valid)
+		return;
+
+	output->repaint_target_valid = false;
+
+	if (presented_flags & (WP_PRESENTATION_FEEDBACK_INVALID |
+			       WESTON_FINISH_FRAME_TEARING) ||
+	    output->vrr_mode == WESTON_VRR_MODE_GAME)
+		return;
+
+	late_nsec = timespec_sub_to_nsec(stamp, &output->repaint_target);
+	if (late_nsec <= 1000000)
+		return;
+
+	weston_repaint_window_add_miss(output->repaint_window, refresh_nsec);
+	output->perf.dropped++;
+	TL_POINT(output->compositor, TLP_CORE_REPAINT_MISSED,
+		 TLP_OUTPUT(output), TLP_VBLANK(stamp), TLP_END);
+	weston_output_repaint_window_report(output, "missed");
+}
+
+static void
+weston_perf_counters_add_latency(struct weston_perf_counters *perf,
+				 int64_t nsec)
+{
+	nsec = MAX(nsec, 0);
+
+	perf->latency_count++;
+	perf->latency_total_nsec += nsec;
+	perf->latency_max_nsec = MAX(perf->latency_max_nsec, (uint64_t)nsec);
+}
+
+/* The pending content update of a surface made it into a repaint */
+static void
+weston_surface_perf_painted(struct weston_surface *surface,
+			    const struct timespec *submit_time)
+{
+	surface->perf.painted++;
+	surface->perf_update_pending = false;
+	weston_perf_counters_add_latency(&surface->perf,
+		timespec_sub_to_nsec(submit_time, &surface->perf_update_time));
+}
+
+/* Account the phases of a successful repaint, and log them as one JSON
+ * object per line.
+ */
+static void
+weston_output_repaint_profile_commit(struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct weston_repaint_profile *prof = output->repaint_profile;
+	struct weston_log_scope *scope = compositor->repaint_profile_debug;
+	unsigned int i;
+
+	prof->frames++;
+	for (i = 0; i < WESTON_REPAINT_PHASE_COUNT; i++)
+		prof->total_nsec[i] += prof->last_nsec[i];
+
+	if (!weston_log_scope_is_enabled(scope))
+		return;
+
+	weston_log_scope_printf(scope, "{\"output\":\"%s\",\"frame\":%" PRIu64,
+				output->name, prof->frames);
+	for (i = 0; i < WESTON_REPAINT_PHASE_COUNT; i++)
+		weston_log_scope_printf(scope, ",\"%s_ns\":%" PRIu64,
+					weston_repaint_phase_to_str(i),
+					prof->last_nsec[i]);
+	weston_log_scope_printf(scope, "}\n");
+}
+
 /* The "latch" point is the last possible instant before a repaint. After
  * the latch, no more content updates can be applied by the compositor
  * until after the scheduled repaint completes.
@@ -3707,20 +4123,24 @@ output_assign_planes(struct weston_output *output)
  * and repaint.
  */
 static void
-weston_output_latch(struct weston_output *output)
+weston_compositor_latch(struct weston_compositor *compositor)
 {
-	struct weston_compositor *compositor = output->compositor;
-
 	assert(!compositor->latched);
 	/* Since this is the last moment when transactions can be applied
-	 * before we repaint this output, let's test them all now.
+	 * before we repaint, let's test them all now.
 	 *
 	 * This can theoretically catch transactions that are ready now, but
 	 * otherwise wouldn't have their readiness noticed until a later pass
 	 * through the event loop.
 	 */
-	weston_compositor_apply_transactions(output->compositor);
+	weston_compositor_apply_transactions(compositor);
 	compositor->latched = true;
+}
+
+static void
+weston_output_latch(struct weston_output *output)
+{
+	assert(output->compositor->latched);
 
 	wl_signal_emit(&output->post_latch_signal, output);
 
@@ -3732,20 +4152,24 @@ weston_output_latch(struct weston_output *output)
 	weston_fifo_output_clear_barriers(output);
 }
 
-static int
-weston_output_repaint(struct weston_output *output)
+/* Everything up to the visibility update. This walks the scene graph
+ * shared by all outputs, so it must run on the main thread.
+ *
+ * Nothing visible outside of the output happens here, so an output that
+ * ends up not being repainted can be rolled back with
+ * weston_output_repaint_abort().
+ */
+static void
+weston_output_repaint_prepare(struct weston_output *output)
 {
-	WESTON_TRACE_FUNC();
 	struct weston_compositor *ec = output->compositor;
 	struct weston_paint_node *pnode;
-	struct weston_animation *animation, *next;
-	struct wl_resource *cb, *cnext;
-	struct wl_list frame_callback_list;
-	int r;
-	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
+	uint64_t start = repaint_profile_now();
 
-	weston_output_latch(output);
+	weston_compositor_read_presentation_clock(ec, &output->repaint_start);
+	memset(output->repaint_profile->last_nsec, 0,
+	       sizeof output->repaint_profile->last_nsec);
 
 	TL_POINT(ec, TLP_CORE_REPAINT_BEGIN, TLP_OUTPUT(output), TLP_END);
 
@@ -3808,9 +4232,159 @@ weston_output_repaint(struct weston_output *output)
 		paint_node_update_early(pnode);
 	}
 
-	output_update_visibility(output);
+	repaint_profile_mark(output, WESTON_REPAINT_PHASE_PREPARE, &start);
+}
+
+/* Undo the early update and the visibility update of an output that was
+ * prepared for repaint but is not repainted, or must be prepared again, so
+ * the next attempt sees the same changes as if it had never been prepared.
+ *
+ * The renderer has already attached the new buffers, which it is fine to
+ * do again, so the buffers are not flagged dirty again and their frames
+ * are not counted twice. The output's paint_node_changes are only cleared
+ * by a successful repaint and keep the buffer changes.
+ */
+static void
+weston_output_repaint_abort(struct weston_output *output)
+{
+	struct weston_paint_node *pnode;
+
+	wl_list_for_each(pnode, &output->paint_node_z_order_list,
+			 z_order_link) {
+		/* Damage must still cover what was last repainted */
+		pixman_region32_copy(&pnode->visible,
+				     &pnode->visible_previous);
+		pnode->status |= WESTON_PAINT_NODE_ALL_DIRTY &
+				 ~WESTON_PAINT_NODE_BUFFER_DIRTY;
+		pnode->visibility_stale = true;
+	}
+}
+
+/* Whether anything this output was prepared with changed since, which
+ * finishing the repaint of another output can do: its frame callbacks,
+ * animations and repick may move views shown on this one as well.
+ */
+static bool
+weston_output_repaint_prepare_is_stale(struct weston_output *output)
+{
+	struct weston_compositor *ec = output->compositor;
+	struct weston_paint_node *pnode;
+
+	if (ec->view_list_needs_rebuild ||
+	    output->paint_node_list_needs_rebuild)
+		return true;
+
+	/* The bits the early update clears */
+	wl_list_for_each(pnode, &output->paint_node_z_order_list,
+			 z_order_link) {
+		if (pnode->status & (WESTON_PAINT_NODE_VIEW_DIRTY |
+				     WESTON_PAINT_NODE_OUTPUT_DIRTY |
+				     WESTON_PAINT_NODE_BUFFER_DIRTY |
+				     WESTON_PAINT_NODE_BUFFER_PARAMS_DIRTY))
+			return true;
+	}
+
+	return false;
+}
+
+/* Whether the frame callbacks of a surface fully occluded on this output
+ * are due with this repaint. If they are not, *wait_msec is lowered to when
+ * they will be.
+ */
+static bool
+weston_output_occluded_frame_due(struct weston_output *output,
+				 struct weston_surface *surface,
+				 int64_t *wait_msec)
+{
+	uint32_t interval = output->compositor->occluded_frame_interval_msec;
+	int64_t elapsed;
+
+	if (interval == 0 || wl_list_empty(&surface->frame_callback_list))
+		return false;
+
+	elapsed = timespec_sub_to_msec(&output->frame_time,
+				       &surface->frame_callback_time);
+	if (elapsed >= interval)
+		return true;
+
+	*wait_msec = MIN(*wait_msec, interval - elapsed);
+
+	return false;
+}
+
+/* Nothing may repaint the output by the time withheld frame callbacks are
+ * due, so make sure something does.
+ */
+static void
+weston_output_arm_occluded_frame_timer(struct weston_output *output,
+				       int64_t wait_msec)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct timespec now, deadline;
+
+	output->occluded_frame_callbacks_pending = true;
+
+	wait_msec = MAX(wait_msec, 1);
+	weston_compositor_read_presentation_clock(compositor, &now);
+	timespec_add_msec(&deadline, &now, wait_msec);
+
+	/* Another output may already want it to fire earlier */
+	if (compositor->occluded_frame_timer_armed &&
+	    timespec_sub_to_nsec(&deadline,
+				 &compositor->occluded_frame_deadline) >= 0)
+		return;
+
+	compositor->occluded_frame_timer_armed = true;
+	compositor->occluded_frame_deadline = deadline;
+	wl_event_source_timer_update(compositor->occluded_frame_timer,
+				     wait_msec);
+}
+
+static int
+occluded_frame_timer_handler(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_output *output;
+
+	compositor->occluded_frame_timer_armed = false;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (!output->occluded_frame_callbacks_pending)
+			continue;
+
+		output->occluded_frame_callbacks_pending = false;
+		weston_output_schedule_repaint(output);
+	}
+
+	return 0;
+}
+
+/* Everything from plane assignment on: backend and renderer work, and
+ * protocol events. Main thread only.
+ */
+static int
+weston_output_repaint_finish(struct weston_output *output)
+{
+	struct weston_compositor *ec = output->compositor;
+	struct weston_paint_node *pnode;
+	struct weston_animation *animation, *next;
+	struct wl_resource *cb, *cnext;
+	struct wl_list frame_callback_list;
+	int r;
+	uint32_t frame_time_msec;
+	int64_t occluded_wait_msec = INT64_MAX;
+	uint64_t start = repaint_profile_now();
+	struct timespec submit_time = { 0 };
+
+	/* Only latch outputs that do get repainted, see
+	 * weston_output_repaint_abort(). */
+	weston_output_latch(output);
+
+	output_clear_visibility_dirty(output);
+	repaint_profile_mark(output, WESTON_REPAINT_PHASE_VISIBILITY, &start);
 
 	output_assign_planes(output);
+	repaint_profile_mark(output, WESTON_REPAINT_PHASE_ASSIGN_PLANES, &start);
 
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
 			 z_order_link) {
@@ -3818,14 +4392,23 @@ weston_output_repaint(struct weston_output *output)
 	}
 
 	output_accumulate_damage(output);
+	repaint_profile_mark(output, WESTON_REPAINT_PHASE_DAMAGE, &start);
 
 	r = output->repaint(output);
+	repaint_profile_mark(output, WESTON_REPAINT_PHASE_RENDER, &start);
 	ec->latched = false;
 
 	output->repaint_needed = false;
 	if (r == 0) {
 		output->repaint_status = REPAINT_AWAITING_COMPLETION;
 		output->repainted = true;
+		weston_output_repaint_window_sample(output);
+		weston_output_repaint_profile_commit(output);
+
+		output->perf.commits++;
+		output->perf_repaint_start = ec->last_repaint_start;
+		output->perf_repaint_pending = true;
+		weston_compositor_read_presentation_clock(ec, &submit_time);
 	}
 
 	weston_compositor_repick(ec);
@@ -3841,21 +4424,34 @@ weston_output_repaint(struct weston_output *output)
 		if (pnode->surface->output != output)
 			continue;
 
+		if (r == 0 && pnode->surface->perf_update_pending &&
+		    pixman_region32_not_empty(&pnode->visible))
+			weston_surface_perf_painted(pnode->surface, &submit_time);
+
 		/*
 		 * avoid adding pnode's frame callbacks/presented
 		 * feedback to the respective lists if pnode/surface is
-		 * occluded
+		 * occluded, unless its throttled frame callbacks are due
 		 */
-		if (!pixman_region32_not_empty(&pnode->visible))
+		if (!pixman_region32_not_empty(&pnode->visible) &&
+		    !weston_output_occluded_frame_due(output, pnode->surface,
+						      &occluded_wait_msec))
 			continue;
 
 		wl_list_insert_list(&frame_callback_list,
 				    &pnode->surface->frame_callback_list);
 		wl_list_init(&pnode->surface->frame_callback_list);
+		pnode->surface->frame_callback_time = output->frame_time;
 
-		weston_output_take_feedback_list(output, pnode->surface);
+		/* nothing of an occluded surface was presented */
+		if (pixman_region32_not_empty(&pnode->visible))
+			weston_output_take_feedback_list(output, pnode->surface);
 	}
 
+	if (occluded_wait_msec != INT64_MAX)
+		weston_output_arm_occluded_frame_timer(output,
+						       occluded_wait_msec);
+
 
 	wl_resource_for_each_safe(cb, cnext, &frame_callback_list) {
 		wl_callback_send_done(cb, frame_time_msec);
@@ -3882,6 +4478,140 @@ weston_output_repaint(struct weston_output *output)
 	return r;
 }
 
+static int
+weston_output_repaint(struct weston_output *output)
+{
+	WESTON_TRACE_FUNC();
+
+	weston_compositor_latch(output->compositor);
+	weston_output_repaint_prepare(output);
+	output_update_visibility(output);
+
+	return weston_output_repaint_finish(output);
+}
+
+static void
+output_update_visibility_job(void *data, unsigned int index)
+{
+	struct weston_output **outputs = data;
+
+	output_update_visibility(outputs[index]);
+}
+
+/* Repaint all outputs of a backend that will repaint, updating their
+ * visibility concurrently on the repaint thread pool.
+ *
+ * The outputs are latched together, and everything touching the scene
+ * graph, the backend or clients still happens on the main thread. That
+ * includes damage accumulation, which flushes the damage and drops the
+ * buffer references of surfaces shared between outputs. Compositing is
+ * spread over the pool by the renderer itself, see the Pixman renderer's
+ * repaint bands.
+ *
+ * Repainting an output runs frame callbacks, animations and repick, which
+ * can change the views of the outputs after it. Those are prepared again on
+ * the main thread before being repainted.
+ */
+static int
+weston_backend_repaint_outputs_parallel(struct weston_compositor *compositor,
+					struct weston_backend *backend,
+					unsigned int count)
+{
+	WESTON_TRACE_FUNC();
+	struct weston_output **outputs;
+	struct weston_output *output;
+	struct timespec finish_start, finish_end;
+	int64_t finished_nsec = 0;
+	unsigned int i = 0;
+	int ret = 0;
+
+	outputs = xcalloc(count, sizeof *outputs);
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (output->backend == backend && output->will_repaint)
+			outputs[i++] = output;
+	}
+	assert(i == count);
+
+	weston_compositor_latch(compositor);
+	for (i = 0; i < count; i++)
+		weston_output_repaint_prepare(outputs[i]);
+
+	weston_worker_pool_run(compositor->repaint_pool,
+			       output_update_visibility_job, outputs, count);
+
+	for (i = 0; i < count; i++) {
+		if (ret) {
+			weston_output_repaint_abort(outputs[i]);
+			continue;
+		}
+
+		/* Content was latched for all of them at once, and must
+		 * stay latched until each one has been repainted. */
+		compositor->latched = true;
+
+		if (weston_output_repaint_prepare_is_stale(outputs[i])) {
+			/* Prepare it again like the serial path does, right
+			 * before repainting it. */
+			weston_output_repaint_abort(outputs[i]);
+			weston_output_repaint_prepare(outputs[i]);
+			output_update_visibility(outputs[i]);
+		} else {
+			/* The time spent repainting the previous outputs is
+			 * not part of this one's repaint. */
+			timespec_add_nsec(&outputs[i]->repaint_start,
+					  &outputs[i]->repaint_start,
+					  finished_nsec);
+		}
+
+		weston_compositor_read_presentation_clock(compositor,
+							  &finish_start);
+		ret = weston_output_repaint_finish(outputs[i]);
+		weston_compositor_read_presentation_clock(compositor,
+							  &finish_end);
+		finished_nsec += timespec_sub_to_nsec(&finish_end,
+						      &finish_start);
+	}
+
+	free(outputs);
+
+	return ret;
+}
+
+static int
+weston_backend_repaint_outputs(struct weston_compositor *compositor,
+			       struct weston_backend *backend)
+{
+	struct weston_output *output;
+	unsigned int count = 0;
+	int ret = 0;
+
+	if (compositor->repaint_pool) {
+		wl_list_for_each(output, &compositor->output_list, link) {
+			if (output->backend == backend && output->will_repaint)
+				count++;
+		}
+
+		if (count > 1)
+			return weston_backend_repaint_outputs_parallel(compositor,
+								       backend,
+								       count);
+	}
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (output->backend != backend)
+			continue;
+
+		if (!output->will_repaint)
+			continue;
+
+		ret = weston_output_repaint(output);
+		if (ret)
+			break;
+	}
+
+	return ret;
+}
+
 static bool
 weston_output_check_repaint(struct weston_output *output, struct timespec *now)
 {
@@ -4022,7 +4752,7 @@ weston_output_repaint_from_present(const struct weston_output *output,
 
 out:
 	/* Subtract the "repaint window" time to get the deadline for the presentation time */
-	timespec_add_msec(&repaint_time, &actual_present_time, -weston_output_repaint_msec(output));
+	timespec_add_nsec(&repaint_time, &actual_present_time, -weston_output_repaint_nsec(output));
 
 	return repaint_time;
 }
@@ -4126,7 +4856,13 @@ surface_frame_rate_stats(void *data)
 	uint32_t frame_counter_interval =
 		compositor->perf_surface_stats.frame_counter_interval;
 
-	if (surf->resource) {
+	surf->frame_commit_fps_counter =
+		(float) (surf->frame_commit_counter / frame_counter_interval);
+	surf->painted_frame_fps_counter =
+		(float) (surf->painted_frame_counter / frame_counter_interval);
+
+	/* Only label the counters for someone actually tracing */
+	if (surf->resource && WESTON_TRACE_ENABLED()) {
 		char surface_desc[512];
 		char p_counter_fc_counter[1024];
 		char p_counter_painted_counter[1024];
@@ -4141,18 +4877,12 @@ surface_frame_rate_stats(void *data)
 				 "unlabelled surface %d", res_id);
 		}
 
-		surf->frame_commit_fps_counter =
-			(float) (surf->frame_commit_counter / frame_counter_interval);
-
 		snprintf(p_counter_fc_counter, sizeof(p_counter_fc_counter),
 			 "%s #%d", (char *) surface_desc, surf->s_id);
 
 		WESTON_TRACE_SET_COUNTER(p_counter_fc_counter,
 					 surf->frame_commit_fps_counter);
 
-		surf->painted_frame_fps_counter =
-			(float) (surf->painted_frame_counter / frame_counter_interval);
-
 		snprintf(p_counter_painted_counter, sizeof(p_counter_painted_counter),
 			 "%s #%d (painted)", (char *) surface_desc, surf->s_id);
 
@@ -4267,17 +4997,7 @@ output_repaint_timer_handler(int fd, uint32_t mask, void *data)
 		if (backend->repaint_begin)
 			backend->repaint_begin(backend);
 
-		wl_list_for_each(output, &compositor->output_list, link) {
-			if (output->backend != backend)
-				continue;
-
-			if (!output->will_repaint)
-				continue;
-
-			ret = weston_output_repaint(output);
-			if (ret)
-				break;
-		}
+		ret = weston_backend_repaint_outputs(compositor, backend);
 		if (ret == 0) {
 			if (backend->repaint_flush)
 				backend->repaint_flush(backend);
@@ -4397,6 +5117,15 @@ weston_output_finish_frame(struct weston_output *output,
 	TL_POINT(compositor, TLP_CORE_REPAINT_FINISHED, TLP_OUTPUT(output),
 		 TLP_VBLANK(&vblank_monotonic), TLP_END);
 
+	weston_output_repaint_window_check_miss(output, stamp, presented_flags);
+
+	if (output->perf_repaint_pending) {
+		output->perf_repaint_pending = false;
+		output->perf.painted++;
+		weston_perf_counters_add_latency(&output->perf,
+			timespec_sub_to_nsec(stamp, &output->perf_repaint_start));
+	}
+
 	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
 	if (!(presented_flags & WP_PRESENTATION_FEEDBACK_INVALID)) {
 		weston_presentation_feedback_present_list(&output->feedback_list,
@@ -4461,7 +5190,7 @@ weston_output_finish_frame(struct weston_output *output,
 	while (!output->forced_present.valid &&
 	       presented_flags == WP_PRESENTATION_FEEDBACK_INVALID &&
 	       output->vrr_mode != WESTON_VRR_MODE_GAME &&
-	       timespec_sub_to_msec(&output->next_present, &now) < weston_output_repaint_msec(output))
+	       timespec_sub_to_nsec(&output->next_present, &now) < weston_output_repaint_nsec(output))
 		timespec_add_nsec(&output->next_present,
 				  &output->next_present,
 				  refresh_nsec);
@@ -8339,6 +9068,10 @@ weston_output_init(struct weston_output *output,
 	output->vrr_mode = WESTON_VRR_MODE_NONE;
 
 	wl_list_init(&output->fifo_barrier_surfaces);
+
+	output->repaint_window = xzalloc(sizeof *output->repaint_window);
+	weston_repaint_window_init(output->repaint_window);
+	output->repaint_profile = xzalloc(sizeof *output->repaint_profile);
 }
 
 /** Adds weston_output object to pending output list.
@@ -8681,6 +9414,11 @@ weston_output_release(struct weston_output *output)
 	wl_list_for_each_safe(head, tmp, &output->head_list, output_link)
 		weston_head_detach(head);
 
+	free(output->repaint_window);
+	output->repaint_window = NULL;
+	free(output->repaint_profile);
+	output->repaint_profile = NULL;
+
 	free(output->name);
 }
 
@@ -9896,6 +10634,100 @@ debug_scene_graph_cb(struct weston_log_subscription *sub, void *data)
 	weston_log_subscription_complete(sub);
 }
 
+static void
+debug_repaint_window_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+	struct weston_output *output;
+	char str[256];
+
+	wl_list_for_each(output, &ec->output_list, link) {
+		weston_output_repaint_window_format(output, str, sizeof str);
+		weston_log_subscription_printf(sub, "%s\n", str);
+	}
+}
+
+static void
+debug_perf_counters_print(struct weston_log_subscription *sub,
+			  const char *type, const char *name, uint32_t id,
+			  const struct weston_perf_counters *perf)
+{
+	weston_log_subscription_printf(sub,
+		"{\"type\":\"%s\",\"name\":\"%s\",\"id\":%u,"
+		"\"commits\":%" PRIu64 ",\"painted\":%" PRIu64 ","
+		"\"dropped\":%" PRIu64 ",\"latency_count\":%" PRIu64 ","
+		"\"latency_total_ns\":%" PRIu64 ",\"latency_max_ns\":%" PRIu64 "}\n",
+		type, name, id, perf->commits, perf->painted, perf->dropped,
+		perf->latency_count, perf->latency_total_nsec,
+		perf->latency_max_nsec);
+}
+
+/* One JSON object per output and per mapped surface, preceded by one with
+ * the time of the snapshot. Labels are only made up here, when asked for.
+ */
+static void
+debug_perf_counters_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+	struct weston_output *output;
+	struct weston_view *view;
+	struct timespec now;
+
+	weston_compositor_read_presentation_clock(ec, &now);
+	weston_log_subscription_printf(sub, "{\"type\":\"snapshot\","
+				       "\"time_ns\":%" PRId64 "}\n",
+				       timespec_to_nsec(&now));
+
+	wl_list_for_each(output, &ec->output_list, link)
+		debug_perf_counters_print(sub, "output", output->name,
+					  output->id, &output->perf);
+
+	wl_list_for_each(view, &ec->view_list, link) {
+		struct weston_surface *surface = view->surface;
+		char label[128] = "";
+		char *c;
+
+		/* Once per surface */
+		if (surface->views.next != &view->surface_link)
+			continue;
+
+		if (surface->get_label)
+			surface->get_label(surface, label, sizeof label);
+
+		/* Keep the JSON valid whatever the label */
+		for (c = label; *c; c++) {
+			if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20)
+				*c = '_';
+		}
+
+		debug_perf_counters_print(sub, "surface", label, surface->s_id,
+					  &surface->perf);
+	}
+
+	weston_log_subscription_complete(sub);
+}
+
+static void
+debug_slab_pools_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+	FILE *fp;
+	char *str;
+	size_t len;
+
+	fp = open_memstream(&str, &len);
+	assert(fp);
+
+	weston_slab_pool_print(ec->view_pool, fp);
+	weston_slab_pool_print(ec->paint_node_pool, fp);
+
+	if (fclose(fp) == 0) {
+		weston_log_subscription_printf(sub, "%s", str);
+		free(str);
+	}
+	weston_log_subscription_complete(sub);
+}
+
 /** Retrieve testsuite data from compositor
  *
  * The testsuite data can be defined by the test suite of projects that uses
@@ -10170,6 +11002,13 @@ weston_compositor_create(struct wl_display *display,
 	ec->color_transform_id_generator = weston_idalloc_create(ec);
 
 	wl_list_init(&ec->view_list);
+	ec->pick_index = weston_pick_index_create(ec);
+
+	ec->view_pool = weston_slab_pool_create("views",
+						sizeof(struct weston_view), 32);
+	ec->paint_node_pool =
+		weston_slab_pool_create("paint nodes",
+					sizeof(struct weston_paint_node), 64);
 	wl_list_init(&ec->plane_list);
 	wl_list_init(&ec->layer_list);
 	wl_list_init(&ec->seat_list);
@@ -10195,6 +11034,8 @@ weston_compositor_create(struct wl_display *display,
 
 	loop = wl_display_get_event_loop(ec->wl_display);
 	ec->idle_source = wl_event_loop_add_timer(loop, idle_handler, ec);
+	ec->occluded_frame_timer =
+		wl_event_loop_add_timer(loop, occluded_frame_timer_handler, ec);
 
 	ec->repaint_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
 	if (ec->repaint_timer_fd < 0)
@@ -10232,6 +11073,29 @@ weston_compositor_create(struct wl_display *display,
 		weston_compositor_add_log_scope(ec, "libseat-debug",
 						"libseat debug messages\n",
 						NULL, NULL, NULL);
+
+	ec->repaint_window_debug =
+		weston_compositor_add_log_scope(ec, "repaint-window",
+						"Output repaint window and missed frames\n",
+						debug_repaint_window_cb, NULL,
+						ec);
+
+	ec->repaint_profile_debug =
+		weston_compositor_add_log_scope(ec, "repaint-profile",
+						"Time spent in each repaint phase, as JSON lines\n",
+						NULL, NULL, NULL);
+
+	ec->perf_counters_debug =
+		weston_compositor_add_log_scope(ec, "perf-counters",
+						"Surface and output performance counters, as JSON lines\n",
+						debug_perf_counters_cb, NULL,
+						ec);
+
+	ec->slab_pools_debug =
+		weston_compositor_add_log_scope(ec, "slab-pools",
+						"Occupancy of the view and paint node pools\n",
+						debug_slab_pools_cb, NULL,
+						ec);
 	return ec;
 
 fail:
@@ -10250,6 +11114,7 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	ec->shutting_down = true;
 
 	wl_event_source_remove(ec->idle_source);
+	wl_event_source_remove(ec->occluded_frame_timer);
 	wl_event_source_remove(ec->repaint_timer_source);
 	close(ec->repaint_timer_fd);
 
@@ -10321,6 +11186,63 @@ weston_compositor_set_default_pointer_grab(struct weston_compositor *ec,
 	}
 }
 
+/** Set the number of threads used for repainting outputs
+ *
+ * \param compositor The compositor.
+ * \param n_threads Number of threads, including the main thread. 0 or 1
+ * repaints all outputs on the main thread, which is the default.
+ * \return 0 on success, -1 if the threads could not be started.
+ *
+ * With more than one thread, outputs of the same backend that repaint at the
+ * same time have their visibility updated concurrently. They are latched
+ * together, before any of them is repainted.
+ * The Pixman renderer also composites the damage of an output in bands, one
+ * per thread.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT int
+weston_compositor_set_repaint_threads(struct weston_compositor *compositor,
+				      unsigned int n_threads)
+{
+	struct weston_worker_pool *pool = NULL;
+
+	if (n_threads > 1) {
+		pool = weston_worker_pool_create(n_threads);
+		if (!pool)
+			return -1;
+	}
+
+	if (compositor->repaint_pool)
+		weston_worker_pool_destroy(compositor->repaint_pool);
+	compositor->repaint_pool = pool;
+
+	return 0;
+}
+
+/** Set where renderers keep their cache across sessions
+ *
+ * \param compositor The compositor.
+ * \param dir The cache directory, created as needed, or NULL to disable
+ * the cache, which is the default.
+ * \param prewarm Prepare at startup what the previous session used.
+ *
+ * The GL renderer keeps the binaries of its shader programs there, the
+ * Vulkan renderer its pipeline cache. Entries are tied to the driver that
+ * made them, so changing drivers only makes the cache miss. This must be
+ * called before the renderer is created.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_renderer_cache(struct weston_compositor *compositor,
+				     const char *dir, bool prewarm)
+{
+	free(compositor->renderer_cache_dir);
+	compositor->renderer_cache_dir = dir ? xstrdup(dir) : NULL;
+	compositor->renderer_cache_prewarm = prewarm;
+}
+
 static int
 weston_compositor_set_presentation_clock(struct weston_compositor *compositor,
 					 uint32_t supported_clocks)
@@ -10714,9 +11636,35 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 	weston_log_scope_destroy(compositor->libseat_debug);
 	compositor->libseat_debug = NULL;
 
+	weston_log_scope_destroy(compositor->repaint_window_debug);
+	compositor->repaint_window_debug = NULL;
+
+	weston_log_scope_destroy(compositor->repaint_profile_debug);
+	compositor->repaint_profile_debug = NULL;
+
+	weston_log_scope_destroy(compositor->perf_counters_debug);
+	compositor->perf_counters_debug = NULL;
+
+	weston_log_scope_destroy(compositor->slab_pools_debug);
+	compositor->slab_pools_debug = NULL;
+
 	weston_idalloc_destroy(compositor->color_transform_id_generator);
 	weston_idalloc_destroy(compositor->color_profile_id_generator);
 
+	weston_pick_index_destroy(compositor->pick_index);
+	compositor->pick_index = NULL;
+
+	if (compositor->repaint_pool)
+		weston_worker_pool_destroy(compositor->repaint_pool);
+	compositor->repaint_pool = NULL;
+
+	free(compositor->renderer_cache_dir);
+
+	weston_slab_pool_destroy(compositor->paint_node_pool);
+	compositor->paint_node_pool = NULL;
+	weston_slab_pool_destroy(compositor->view_pool);
+	compositor->view_pool = NULL;
+
 	if (compositor->default_dmabuf_feedback) {
 		weston_dmabuf_feedback_destroy(compositor->default_dmabuf_feedback);
 		weston_dmabuf_feedback_format_table_destroy(compositor->dmabuf_feedback_format_table);
@@ -407,6 +407,35 @@ void
 weston_output_set_single_mode(struct weston_output *output,
 			      struct weston_mode *target);
 
+/** Phases of an output repaint, as timed by the core */
+enum weston_repaint_phase {
+	/** Latching, view and z-order list rebuild, early paint node update */
+	WESTON_REPAINT_PHASE_PREPARE = 0,
+	/** Visible region computation */
+	WESTON_REPAINT_PHASE_VISIBILITY,
+	/** Backend plane assignment */
+	WESTON_REPAINT_PHASE_ASSIGN_PLANES,
+	/** Late paint node update and damage accumulation */
+	WESTON_REPAINT_PHASE_DAMAGE,
+	/** The backend repaint hook, including rendering */
+	WESTON_REPAINT_PHASE_RENDER,
+	WESTON_REPAINT_PHASE_COUNT
+};
+
+/** Time spent in each phase of an output's repaints
+ *
+ * Updated on every successful repaint. Users interested in an interval
+ * may clear it at any time between repaints.
+ */
+struct weston_repaint_profile {
+	uint64_t frames;
+	uint64_t last_nsec[WESTON_REPAINT_PHASE_COUNT];
+	uint64_t total_nsec[WESTON_REPAINT_PHASE_COUNT];
+};
+
+const char *
+weston_repaint_phase_to_str(enum weston_repaint_phase phase);
+
 /* weston_plane */
 
 void
@@ -703,6 +732,9 @@ struct weston_paint_node {
 
 	char *internal_name;
 
+	/* Emitted with the paint node, for renderer state attached to it */
+	struct wl_signal destroy_signal;
+
 	/* Mutable members: */
 
 	enum weston_paint_node_status status;
@@ -720,6 +752,15 @@ struct weston_paint_node {
 	pixman_region32_t visible;
 	pixman_region32_t clipped_view;
 	pixman_region32_t damage; /* In global coordinates */
+
+	/* Incremental visibility, see output_update_visibility().
+	 * opaque_above is the union of the opaque regions of all the paint
+	 * nodes above this one when visible was last computed.
+	 */
+	pixman_region32_t opaque_above;
+	bool visibility_stale;
+	bool visible_previous_stale;
+	bool visible_fully_opaque;
 	struct weston_plane *plane;
 	struct weston_plane *plane_next;
 
@@ -0,0 +1,359 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Spatial index for weston_compositor_pick_view()
+ *
+ * Every view on weston_compositor::view_list is filed into the cells of a
+ * uniform grid that its transformed bounding box covers. The grid is
+ * unbounded: cells are hashed into a fixed number of buckets, so a bucket
+ * may hold views from several cells and a hit is always confirmed against
+ * the real bounding box and input region.
+ *
+ * Views are refiled when their transform is updated, and the stacking order
+ * is captured when the view list is rebuilt. A pick only tests the views
+ * filed under the cell of the pick position, plus the few views too large to
+ * be worth filing per cell, and returns the topmost hit. That is exactly the
+ * view a linear walk of the view list would return.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "libweston-internal.h"
+#include "pick-index.h"
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+
+/* 256x256 cells in the global coordinate space */
+#define PICK_INDEX_CELL_SHIFT 8
+
+#define PICK_INDEX_BUCKET_BITS 10
+#define PICK_INDEX_BUCKET_COUNT (1u << PICK_INDEX_BUCKET_BITS)
+
+/* Views covering more cells than this (backgrounds, fullscreen windows,
+ * heavily zoomed views) are put on the wide list instead, which is checked
+ * on every pick. */
+#define PICK_INDEX_MAX_CELLS 64
+
+struct weston_pick_index {
+	struct weston_compositor *compositor;
+
+	/* struct weston_view *, once for every covered cell hashing here */
+	struct wl_array buckets[PICK_INDEX_BUCKET_COUNT];
+
+	struct wl_list view_list;  /* weston_view::pick.link */
+	struct wl_list wide_list;  /* weston_view::pick.wide_link */
+	struct wl_list dirty_list; /* weston_view::pick.dirty_link */
+
+	uint32_t generation;
+};
+
+static inline int32_t
+pick_cell(int32_t v)
+{
+	/* Arithmetic shift, rounds towards negative infinity */
+	return v >> PICK_INDEX_CELL_SHIFT;
+}
+
+static struct wl_array *
+pick_index_bucket(struct weston_pick_index *index, int32_t cx, int32_t cy)
+{
+	uint32_t h;
+
+	h = (uint32_t)cx * 0x9e3779b1u ^ (uint32_t)cy * 0x85ebca77u;
+
+	return &index->buckets[h >> (32 - PICK_INDEX_BUCKET_BITS)];
+}
+
+static void
+bucket_add(struct wl_array *bucket, struct weston_view *view)
+{
+	struct weston_view **entry;
+
+	entry = wl_array_add(bucket, sizeof *entry);
+	abort_oom_if_null(entry);
+	*entry = view;
+}
+
+static void
+bucket_remove(struct wl_array *bucket, struct weston_view *view)
+{
+	struct weston_view **entries = bucket->data;
+	size_t count = bucket->size / sizeof *entries;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (entries[i] != view)
+			continue;
+
+		entries[i] = entries[count - 1];
+		bucket->size -= sizeof *entries;
+		return;
+	}
+
+	assert(!"view missing from its pick index bucket");
+}
+
+static void
+pick_index_unfile_view(struct weston_pick_index *index,
+		       struct weston_view *view)
+{
+	int32_t cx, cy;
+
+	wl_list_remove(&view->pick.wide_link);
+	wl_list_init(&view->pick.wide_link);
+
+	if (!view->pick.filed)
+		return;
+
+	for (cy = view->pick.cells.y1; cy <= view->pick.cells.y2; cy++)
+		for (cx = view->pick.cells.x1; cx <= view->pick.cells.x2; cx++)
+			bucket_remove(pick_index_bucket(index, cx, cy), view);
+
+	view->pick.filed = false;
+}
+
+static void
+pick_index_file_view(struct weston_pick_index *index,
+		     struct weston_view *view)
+{
+	const pixman_box32_t *box;
+	pixman_box32_t cells;
+	int64_t count;
+	int32_t cx, cy;
+
+	assert(!view->pick.filed);
+	assert(wl_list_empty(&view->pick.wide_link));
+	assert(!view->transform.dirty);
+
+	box = pixman_region32_extents(&view->transform.boundingbox);
+	if (box->x1 >= box->x2 || box->y1 >= box->y2)
+		return;
+
+	cells.x1 = pick_cell(box->x1);
+	cells.y1 = pick_cell(box->y1);
+	cells.x2 = pick_cell(box->x2 - 1);
+	cells.y2 = pick_cell(box->y2 - 1);
+
+	count = ((int64_t)cells.x2 - cells.x1 + 1) *
+		((int64_t)cells.y2 - cells.y1 + 1);
+	if (count > PICK_INDEX_MAX_CELLS) {
+		wl_list_insert(&index->wide_list, &view->pick.wide_link);
+		return;
+	}
+
+	for (cy = cells.y1; cy <= cells.y2; cy++)
+		for (cx = cells.x1; cx <= cells.x2; cx++)
+			bucket_add(pick_index_bucket(index, cx, cy), view);
+
+	view->pick.cells = cells;
+	view->pick.filed = true;
+}
+
+struct weston_pick_index *
+weston_pick_index_create(struct weston_compositor *compositor)
+{
+	struct weston_pick_index *index;
+	unsigned int i;
+
+	index = xzalloc(sizeof *index);
+	index->compositor = compositor;
+
+	for (i = 0; i < ARRAY_LENGTH(index->buckets); i++)
+		wl_array_init(&index->buckets[i]);
+
+	wl_list_init(&index->view_list);
+	wl_list_init(&index->wide_list);
+	wl_list_init(&index->dirty_list);
+
+	return index;
+}
+
+void
+weston_pick_index_destroy(struct weston_pick_index *index)
+{
+	struct weston_view *view, *tmp;
+	unsigned int i;
+
+	wl_list_for_each_safe(view, tmp, &index->view_list, pick.link)
+		weston_pick_index_remove_view(index, view);
+
+	for (i = 0; i < ARRAY_LENGTH(index->buckets); i++)
+		wl_array_release(&index->buckets[i]);
+
+	free(index);
+}
+
+/** Capture the stacking order of weston_compositor::view_list
+ *
+ * Views newly on the view list are added to the index, views no longer on
+ * it are removed. Must be called whenever the view list has been rebuilt.
+ */
+void
+weston_pick_index_sync_view_list(struct weston_pick_index *index)
+{
+	struct weston_view *view, *tmp;
+	uint32_t order = 0;
+
+	index->generation++;
+
+	wl_list_for_each(view, &index->compositor->view_list, link) {
+		view->pick.order = order++;
+		view->pick.generation = index->generation;
+
+		if (view->pick.indexed)
+			continue;
+
+		view->pick.indexed = true;
+		wl_list_insert(index->view_list.prev, &view->pick.link);
+
+		if (view->transform.dirty)
+			weston_pick_index_dirty_view(index, view);
+		else
+			pick_index_file_view(index, view);
+	}
+
+	wl_list_for_each_safe(view, tmp, &index->view_list, pick.link) {
+		if (view->pick.generation != index->generation)
+			weston_pick_index_remove_view(index, view);
+	}
+}
+
+/** Refile a view after its transform has been updated */
+void
+weston_pick_index_update_view(struct weston_pick_index *index,
+			      struct weston_view *view)
+{
+	if (!view->pick.indexed)
+		return;
+
+	wl_list_remove(&view->pick.dirty_link);
+	wl_list_init(&view->pick.dirty_link);
+
+	pick_index_unfile_view(index, view);
+	pick_index_file_view(index, view);
+}
+
+/** Note that a view's filed bounding box may be stale
+ *
+ * The view will have its transform updated before the next pick.
+ */
+void
+weston_pick_index_dirty_view(struct weston_pick_index *index,
+			     struct weston_view *view)
+{
+	if (!view->pick.indexed)
+		return;
+
+	wl_list_remove(&view->pick.dirty_link);
+	wl_list_insert(&index->dirty_list, &view->pick.dirty_link);
+}
+
+void
+weston_pick_index_remove_view(struct weston_pick_index *index,
+			      struct weston_view *view)
+{
+	if (!view->pick.indexed)
+		return;
+
+	pick_index_unfile_view(index, view);
+
+	wl_list_remove(&view->pick.dirty_link);
+	wl_list_init(&view->pick.dirty_link);
+	wl_list_remove(&view->pick.link);
+	wl_list_init(&view->pick.link);
+
+	view->pick.indexed = false;
+}
+
+static bool
+view_takes_input_at_global(struct weston_view *view,
+			   struct weston_coord_global pos)
+{
+	struct weston_coord_surface surf_pos;
+
+	if (!pixman_region32_contains_point(&view->transform.boundingbox,
+					    pos.c.x, pos.c.y, NULL))
+		return false;
+
+	surf_pos = weston_coord_global_to_surface(view, pos);
+
+	return weston_view_takes_input_at_point(view, surf_pos);
+}
+
+static struct weston_view *
+pick_candidate(struct weston_view *best, struct weston_view *view,
+	       struct weston_coord_global pos)
+{
+	/* Anything stacked below the current best cannot win */
+	if (best && view->pick.order >= best->pick.order)
+		return best;
+
+	if (!view_takes_input_at_global(view, pos))
+		return best;
+
+	return view;
+}
+
+/** Find the topmost view taking input at a global position
+ *
+ * Gives the same result as walking weston_compositor::view_list from the top
+ * and returning the first view taking input at \c pos.
+ */
+struct weston_view *
+weston_pick_index_pick_view(struct weston_pick_index *index,
+			    struct weston_coord_global pos)
+{
+	struct weston_view *best = NULL;
+	struct weston_view **entry;
+	struct weston_view *view;
+	struct wl_array *bucket;
+	int32_t x = pos.c.x;
+	int32_t y = pos.c.y;
+
+	/* Bring stale views up to date, which refiles them. Updating a
+	 * transform emits signals that may dirty further views, so take
+	 * them one at a time. */
+	while (!wl_list_empty(&index->dirty_list)) {
+		view = container_of(index->dirty_list.next,
+				    struct weston_view, pick.dirty_link);
+		wl_list_remove(&view->pick.dirty_link);
+		wl_list_init(&view->pick.dirty_link);
+		weston_view_update_transform(view);
+	}
+
+	bucket = pick_index_bucket(index, pick_cell(x), pick_cell(y));
+	wl_array_for_each(entry, bucket)
+		best = pick_candidate(best, *entry, pos);
+
+	wl_list_for_each(view, &index->wide_list, pick.wide_link)
+		best = pick_candidate(best, view, pos);
+
+	return best;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <libweston/libweston.h>
+
+struct weston_pick_index;
+
+struct weston_pick_index *
+weston_pick_index_create(struct weston_compositor *compositor);
+
+void
+weston_pick_index_destroy(struct weston_pick_index *index);
+
+void
+weston_pick_index_sync_view_list(struct weston_pick_index *index);
+
+void
+weston_pick_index_update_view(struct weston_pick_index *index,
+			      struct weston_view *view);
+
+void
+weston_pick_index_dirty_view(struct weston_pick_index *index,
+			     struct weston_view *view);
+
+void
+weston_pick_index_remove_view(struct weston_pick_index *index,
+			      struct weston_view *view);
+
+struct weston_view *
+weston_pick_index_pick_view(struct weston_pick_index *index,
+			    struct weston_coord_global pos);
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Color transformations for the Pixman renderer
+ *
+ * Every weston_color_transform is decomposed into a shaper (3x1D LUT) and a
+ * 3D LUT, which is what the GL renderer does too when the individual steps
+ * are not available, and evaluated on the CPU. Pixels are premultiplied
+ * PIXMAN_rgba_float, transformed in place.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include "color.h"
+#include "pixman-color-transform.h"
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+
+/* Same sizes as the GL renderer: good precision, moderate memory */
+#define SHAPER_LEN 1024
+#define LUT3D_LEN 33
+
+struct pixman_color_transform {
+	struct weston_color_transform *owner;
+	struct wl_listener destroy_listener;
+
+	/* R, G and B curves, one after the other */
+	float shaper[3 * SHAPER_LEN];
+	/* lut3d[B][G][R] of RGB triplets */
+	float lut3d[3 * LUT3D_LEN * LUT3D_LEN * LUT3D_LEN];
+};
+
+static void
+pixman_color_transform_destroy(struct pixman_color_transform *pxform)
+{
+	wl_list_remove(&pxform->destroy_listener.link);
+	free(pxform);
+}
+
+static void
+color_transform_destroy_handler(struct wl_listener *l, void *data)
+{
+	struct pixman_color_transform *pxform;
+
+	pxform = wl_container_of(l, pxform, destroy_listener);
+	assert(pxform->owner == data);
+
+	pixman_color_transform_destroy(pxform);
+}
+
+/** Get the Pixman renderer's version of a color transformation
+ *
+ * \param xform The color transformation, must not be NULL.
+ * \return The transformation, cached for as long as \c xform lives, or NULL
+ * if it could not be decomposed.
+ */
+const struct pixman_color_transform *
+pixman_color_transform_from(struct weston_color_transform *xform)
+{
+	struct pixman_color_transform *pxform;
+	struct wl_listener *l;
+
+	l = wl_signal_get(&xform->destroy_signal,
+			  color_transform_destroy_handler);
+	if (l)
+		return container_of(l, struct pixman_color_transform,
+				    destroy_listener);
+
+	pxform = xzalloc(sizeof *pxform);
+
+	if (!xform->to_shaper_plus_3dlut(xform, SHAPER_LEN, pxform->shaper,
+					 LUT3D_LEN, pxform->lut3d)) {
+		free(pxform);
+		return NULL;
+	}
+
+	pxform->owner = xform;
+	pxform->destroy_listener.notify = color_transform_destroy_handler;
+	wl_signal_add(&xform->destroy_signal, &pxform->destroy_listener);
+
+	return pxform;
+}
+
+/* Position of a value in a LUT of len taps, clamped like a GL sampler */
+static inline float
+lut_position(float v, unsigned int len)
+{
+	if (!(v > 0.0f))
+		return 0.0f;
+	if (v >= 1.0f)
+		return len - 1;
+
+	return v * (len - 1);
+}
+
+static inline float
+shaper_eval(const float *curve, float v)
+{
+	float pos = lut_position(v, SHAPER_LEN);
+	unsigned int i = MIN((unsigned int) pos, SHAPER_LEN - 2);
+	float t = pos - i;
+
+	return curve[i] + t * (curve[i + 1] - curve[i]);
+}
+
+/* Trilinear interpolation of the 3D LUT */
+static inline void
+lut3d_eval(const float *lut3d, const float in[3], float out[3])
+{
+	const unsigned int stride[3] = {
+		3, 3 * LUT3D_LEN, 3 * LUT3D_LEN * LUT3D_LEN
+	};
+	unsigned int base = 0;
+	float t[3];
+	unsigned int ch, c;
+
+	for (ch = 0; ch < 3; ch++) {
+		float pos = lut_position(in[ch], LUT3D_LEN);
+		unsigned int i = MIN((unsigned int) pos, LUT3D_LEN - 2);
+
+		t[ch] = pos - i;
+		base += i * stride[ch];
+	}
+
+	for (c = 0; c < 3; c++) {
+		const float *p = &lut3d[base + c];
+		float c00, c01, c10, c11, c0, c1;
+
+		c00 = p[0] + t[0] * (p[stride[0]] - p[0]);
+		c10 = p[stride[1]] + t[0] *
+		      (p[stride[1] + stride[0]] - p[stride[1]]);
+		c01 = p[stride[2]] + t[0] *
+		      (p[stride[2] + stride[0]] - p[stride[2]]);
+		c11 = p[stride[2] + stride[1]] + t[0] *
+		      (p[stride[2] + stride[1] + stride[0]] -
+		       p[stride[2] + stride[1]]);
+
+		c0 = c00 + t[1] * (c10 - c00);
+		c1 = c01 + t[1] * (c11 - c01);
+
+		out[c] = c0 + t[2] * (c1 - c0);
+	}
+}
+
+/** Transform pixels in place
+ *
+ * \param pxform The transformation.
+ * \param rgba Premultiplied pixels, 4 floats each in R, G, B, A order, as
+ * stored by PIXMAN_rgba_float.
+ * \param n_pixels Number of pixels.
+ *
+ * Fully transparent pixels are left alone. This may be called from several
+ * threads at once.
+ */
+void
+pixman_color_transform_apply(const struct pixman_color_transform *pxform,
+			     float *rgba, unsigned int n_pixels)
+{
+	unsigned int i, ch;
+
+	for (i = 0; i < n_pixels; i++, rgba += 4) {
+		float a = rgba[3];
+		float shaped[3];
+		float out[3];
+
+		if (!(a > 0.0f))
+			continue;
+
+		for (ch = 0; ch < 3; ch++)
+			shaped[ch] = shaper_eval(&pxform->shaper[ch * SHAPER_LEN],
+						 rgba[ch] / a);
+
+		lut3d_eval(pxform->lut3d, shaped, out);
+
+		for (ch = 0; ch < 3; ch++)
+			rgba[ch] = out[ch] * a;
+	}
+}
@@ -30,12 +30,17 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "pixman-renderer.h"
 #include "color.h"
+#include "color-representation.h"
 #include "pixel-formats.h"
 #include "output-capture.h"
+#include "pixman-color-transform.h"
+#include "pixman-yuv.h"
+#include "worker-pool.h"
 #include "shared/helpers.h"
 #include "shared/weston-drm-fourcc.h"
 #include "shared/xalloc.h"
@@ -47,14 +52,58 @@ struct pixman_output_state {
 	const struct pixel_format_info *shadow_format;
 	pixman_image_t *hw_buffer;
 	const struct pixel_format_info *hw_format;
+	/* Blend into a PIXMAN_rgba_float shadow, converted to the output
+	 * color space when copied to the hardware buffer */
+	bool blend_to_output;
+	/* Composite straight into the hardware buffer when it has the
+	 * shadow's pixel format, leaving the shadow stale */
+	bool skip_shadow_if_possible;
+	bool shadow_stale;
 	struct weston_size fb_size;
 	struct wl_list renderbuffer_list;
+	struct wl_array draw_list; /* struct weston_paint_node * */
+};
+
+/* A surface shown on outputs with different color transformations keeps
+ * one converted image per transformation, up to this many.
+ */
+#define PIXMAN_XFORM_IMAGE_COUNT 4
+
+struct pixman_xform_image {
+	struct weston_color_transform *xform; /* NULL if unused */
+	/* The image in blending space, PIXMAN_rgba_float or a solid fill */
+	pixman_image_t *image;
+	pixman_color_t color;
+	pixman_region32_t damage; /* buffer coordinates */
+	uint32_t last_use;
 };
 
 struct pixman_surface_state {
 	struct weston_surface *surface;
 
 	pixman_image_t *image;
+	pixman_color_t color; /* of a solid fill image */
+
+	struct pixman_xform_image xform_images[PIXMAN_XFORM_IMAGE_COUNT];
+	uint32_t xform_use_counter;
+	/* The wl_shm buffer format and size the xform images were converted
+	 * from, they are kept across buffers that match. */
+	const struct pixel_format_info *xform_source_format;
+	struct weston_size xform_source_size;
+
+	/* The RGB conversion of a YUV wl_shm buffer, which image refers to.
+	 * Kept across buffers of the same size and format, like the GL
+	 * renderer keeps its textures. */
+	pixman_image_t *yuv_image;
+	const struct pixel_format_info *yuv_format; /* NULL if not YUV */
+	/* The format last converted into yuv_image */
+	const struct pixel_format_info *yuv_image_format;
+	struct weston_color_representation yuv_color_rep;
+	pixman_region32_t yuv_damage; /* buffer coordinates */
+
+	/* Bumped whenever the content of image or an xform image changes */
+	uint32_t content_serial;
+
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_release_reference buffer_release_ref;
 
@@ -63,6 +112,32 @@ struct pixman_surface_state {
 	struct wl_listener renderer_destroy_listener;
 };
 
+/* A transformed paint node already composited in output space, so that
+ * repaints only need a plain blit while nothing changes. The image is only
+ * made once the same key is seen on two repaints in a row, so animating
+ * content or transformations never pay for it.
+ */
+struct pixman_paint_node_cache {
+	struct wl_listener pnode_destroy_listener;
+
+	/* PIXMAN_a8r8g8b8, or PIXMAN_rgba_float when blending to output */
+	pixman_image_t *image;
+	/* Output position of the image */
+	int32_t x, y;
+
+	/* The key */
+	pixman_image_t *source;
+	uint32_t content_serial;
+	struct weston_color_transform *xform;
+	struct weston_matrix output_to_buffer_matrix;
+	bool needs_filtering;
+	int32_t surface_width, surface_height;
+	bool scissor_enabled;
+	pixman_region32_t scissor;
+	pixman_format_code_t format;
+	struct weston_size fb_size;
+};
+
 struct pixman_renderbuffer {
 #if !defined(NDEBUG)
 	struct weston_output *output;
@@ -85,6 +160,29 @@ struct pixman_renderer {
 	struct wl_signal destroy_signal;
 };
 
+/* Rows of the output composited on their own, possibly on a worker thread */
+struct pixman_tile {
+	struct weston_output *output;
+	/* In global coordinates, shared by all tiles */
+	pixman_region32_t *damage;
+	/* The output image, or a handle of this tile's own on its pixels */
+	pixman_image_t *target;
+	pixman_image_t *debug_color;
+	/* Framebuffer rows y1 to y2 - 1 */
+	int32_t y1, y2;
+	/* Source images need a handle of the tile's own */
+	bool private_sources;
+	/* Worst overdraw of a source clip */
+	int overdraw;
+};
+
+/* Tiles thinner than this are not worth a thread */
+#define PIXMAN_TILE_MIN_ROWS 64
+
+static const pixman_color_t debug_red = {
+	0x3fff, 0x0000, 0x0000, 0x3fff
+};
+
 static inline struct pixman_output_state *
 get_output_state(struct weston_output *output)
 {
@@ -175,26 +273,6 @@ view_transformation_is_translation(struct weston_view *view)
 	return false;
 }
 
-static void
-region_intersect_only_translation(pixman_region32_t *result_global,
-				  pixman_region32_t *global,
-				  pixman_region32_t *surf,
-				  struct weston_view *view)
-{
-	struct weston_coord_surface cs;
-	struct weston_coord_global cg;
-
-	cs = weston_coord_surface(0, 0, view->surface);
-	assert(view_transformation_is_translation(view));
-
-	/* Convert from surface to global coordinates */
-	pixman_region32_copy(result_global, surf);
-	cg = weston_coord_surface_to_global(view, cs);
-	pixman_region32_translate(result_global, cg.c.x, cg.c.y);
-
-	pixman_region32_intersect(result_global, result_global, global);
-}
-
 static void
 composite_whole(pixman_op_t op,
 		pixman_image_t *src,
@@ -225,8 +303,9 @@ composite_whole(pixman_op_t op,
 				 dest_width, dest_height);
 }
 
-static void
-composite_clipped(struct weston_output *output,
+/* Returns the number of times the destination got composited */
+static int
+composite_clipped(pixman_op_t op,
 		  pixman_image_t *src,
 		  pixman_image_t *mask,
 		  pixman_image_t *dest,
@@ -245,9 +324,10 @@ composite_clipped(struct weston_output *output,
 	int i;
 
 	/*
-	 * Hardcoded to use PIXMAN_OP_OVER, because sampling outside of
-	 * a Pixman image produces (0,0,0,0) instead of discarding the
-	 * fragment.
+	 * PIXMAN_OP_OVER is needed, because sampling outside of a Pixman
+	 * image produces (0,0,0,0) instead of discarding the fragment.
+	 * PIXMAN_OP_SRC only works for callers that know every destination
+	 * pixel in the clip samples inside a single box.
 	 *
 	 * Also repeat mode must be PIXMAN_REPEAT_NONE (the default) to
 	 * actually sample (0,0,0,0). This may cause issues for clients that
@@ -265,6 +345,8 @@ composite_clipped(struct weston_output *output,
 	src_data = pixman_image_get_data(src);
 
 	assert(src_format);
+	assert(op == PIXMAN_OP_OVER ||
+	       pixman_region32_n_rects(src_clip) == 1);
 
 	/* This would be massive overdraw, except when n_box is 1. */
 	boxes = pixman_region32_rectangles(src_clip, &n_box);
@@ -286,7 +368,7 @@ composite_clipped(struct weston_output *output,
 		pixman_image_set_transform(boximg, &adj);
 
 		pixman_image_set_filter(boximg, filter, NULL, 0);
-		pixman_image_composite32(PIXMAN_OP_OVER, boximg, mask, dest,
+		pixman_image_composite32(op, boximg, mask, dest,
 					 0, 0, /* src_x, src_y */
 					 0, 0, /* mask_x, mask_y */
 					 0, 0, /* dest_x, dest_y */
@@ -295,56 +377,360 @@ composite_clipped(struct weston_output *output,
 		pixman_image_unref(boximg);
 	}
 
-	if (n_box > 1) {
-		weston_log_paced(&output->pixman_overdraw_pacer, 1, 0,
-				 "Pixman-renderer warning: %dx overdraw\n",
-				 n_box);
+	return n_box;
+}
+
+/* A handle of its own on the pixels of an image, for a worker thread */
+static pixman_image_t *
+image_create_handle(pixman_image_t *image)
+{
+	pixman_image_t *handle;
+
+	handle = pixman_image_create_bits_no_clear(pixman_image_get_format(image),
+						   pixman_image_get_width(image),
+						   pixman_image_get_height(image),
+						   pixman_image_get_data(image),
+						   pixman_image_get_stride(image));
+	abort_oom_if_null(handle);
+
+	return handle;
+}
+
+static struct pixman_xform_image *
+surface_state_find_xform_image(struct pixman_surface_state *ps,
+			       struct weston_color_transform *xform)
+{
+	unsigned int i;
+
+	assert(xform);
+
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++) {
+		if (ps->xform_images[i].xform == xform)
+			return &ps->xform_images[i];
+	}
+
+	return NULL;
+}
+
+/* The image a paint node is drawn from, in the blending space of its
+ * output. The converted images are up to date after
+ * paint_node_is_drawable().
+ */
+static pixman_image_t *
+paint_node_source_image(struct weston_paint_node *pnode,
+			const pixman_color_t **color)
+{
+	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
+	struct pixman_xform_image *xi;
+
+	if (!pnode->surf_xform.transform) {
+		*color = &ps->color;
+		return ps->image;
 	}
+
+	xi = surface_state_find_xform_image(ps, pnode->surf_xform.transform);
+	assert(xi);
+	*color = &xi->color;
+	return xi->image;
+}
+
+/* Pixman images carry state that compositing changes, e.g. transform,
+ * filter and cached flags, so a tile on a worker thread gets a handle of its
+ * own on the same pixels.
+ */
+static pixman_image_t *
+tile_source_image(struct pixman_tile *tile, pixman_image_t *image,
+		  const pixman_color_t *color)
+{
+	if (!tile->private_sources)
+		return pixman_image_ref(image);
+
+	if (!pixman_image_get_data(image))
+		return pixman_image_create_solid_fill(color);
+
+	return image_create_handle(image);
+}
+
+static void
+paint_node_cache_handle_pnode_destroy(struct wl_listener *listener,
+				      void *data)
+{
+	struct pixman_paint_node_cache *cache =
+		container_of(listener, struct pixman_paint_node_cache,
+			     pnode_destroy_listener);
+
+	wl_list_remove(&cache->pnode_destroy_listener.link);
+	if (cache->image)
+		pixman_image_unref(cache->image);
+	pixman_region32_fini(&cache->scissor);
+	free(cache);
+}
+
+static struct pixman_paint_node_cache *
+get_paint_node_cache(struct weston_paint_node *pnode)
+{
+	struct wl_listener *listener;
+
+	listener = wl_signal_get(&pnode->destroy_signal,
+				 paint_node_cache_handle_pnode_destroy);
+	if (!listener)
+		return NULL;
+
+	return container_of(listener, struct pixman_paint_node_cache,
+			    pnode_destroy_listener);
+}
+
+/* Whether pixman would have to resample the surface image for this paint
+ * node, rather than blit it.
+ */
+static bool
+paint_node_is_transformed(struct weston_paint_node *pnode)
+{
+	return pnode->buffer_to_output_matrix.type &
+	       ~WESTON_MATRIX_TRANSFORM_TRANSLATE;
+}
+
+/* Store the current key, returning whether it was the same as before */
+static bool
+paint_node_cache_update_key(struct pixman_paint_node_cache *cache,
+			    struct weston_paint_node *pnode,
+			    pixman_image_t *source,
+			    pixman_format_code_t format)
+{
+	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
+	struct pixman_output_state *po = get_output_state(pnode->output);
+	struct weston_view *view = pnode->view;
+	bool same;
+
+	same = cache->source == source &&
+	       cache->content_serial == ps->content_serial &&
+	       cache->xform == pnode->surf_xform.transform &&
+	       memcmp(cache->output_to_buffer_matrix.d,
+		      pnode->output_to_buffer_matrix.d,
+		      sizeof cache->output_to_buffer_matrix.d) == 0 &&
+	       cache->needs_filtering == pnode->needs_filtering &&
+	       cache->surface_width == pnode->surface->width &&
+	       cache->surface_height == pnode->surface->height &&
+	       cache->scissor_enabled == view->geometry.scissor_enabled &&
+	       (!cache->scissor_enabled ||
+		pixman_region32_equal(&cache->scissor,
+				      &view->geometry.scissor)) &&
+	       cache->format == format &&
+	       cache->fb_size.width == po->fb_size.width &&
+	       cache->fb_size.height == po->fb_size.height;
+	if (same)
+		return true;
+
+	cache->source = source;
+	cache->content_serial = ps->content_serial;
+	cache->xform = pnode->surf_xform.transform;
+	cache->output_to_buffer_matrix = pnode->output_to_buffer_matrix;
+	cache->needs_filtering = pnode->needs_filtering;
+	cache->surface_width = pnode->surface->width;
+	cache->surface_height = pnode->surface->height;
+	cache->scissor_enabled = view->geometry.scissor_enabled;
+	pixman_region32_copy(&cache->scissor, &view->geometry.scissor);
+	cache->format = format;
+	cache->fb_size = po->fb_size;
+
+	return false;
+}
+
+/* Composite the whole paint node into the cache image, the way
+ * draw_paint_node() would into the output.
+ */
+static bool
+paint_node_cache_fill(struct pixman_paint_node_cache *cache,
+		      struct weston_paint_node *pnode,
+		      pixman_image_t *source)
+{
+	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
+	struct pixman_output_state *po = get_output_state(pnode->output);
+	struct weston_surface *surface = pnode->surface;
+	struct weston_view *view = pnode->view;
+	pixman_region32_t box_output;
+	pixman_box32_t *extents;
+	pixman_transform_t transform;
+	pixman_filter_t filter;
+	int32_t width, height;
+
+	pixman_region32_init(&box_output);
+	weston_region_global_to_output(&box_output, pnode->output,
+				       &view->transform.boundingbox);
+	pixman_region32_intersect_rect(&box_output, &box_output, 0, 0,
+				       po->fb_size.width, po->fb_size.height);
+	extents = pixman_region32_extents(&box_output);
+	cache->x = extents->x1;
+	cache->y = extents->y1;
+	width = extents->x2 - extents->x1;
+	height = extents->y2 - extents->y1;
+	pixman_region32_fini(&box_output);
+
+	if (width <= 0 || height <= 0)
+		return false;
+
+	/* Zero-filled: whatever the source does not cover stays transparent */
+	cache->image = pixman_image_create_bits(cache->format, width, height,
+						NULL, 0);
+	if (!cache->image)
+		return false;
+
+	/* Cache image coordinates to buffer coordinates */
+	weston_matrix_to_pixman_transform(&transform,
+					  &pnode->output_to_buffer_matrix);
+	pixman_transform_translate(NULL, &transform,
+				   pixman_int_to_fixed(-cache->x),
+				   pixman_int_to_fixed(-cache->y));
+
+	if (pnode->needs_filtering)
+		filter = PIXMAN_FILTER_BILINEAR;
+	else
+		filter = PIXMAN_FILTER_NEAREST;
+
+	if (ps->buffer_ref.buffer)
+		wl_shm_buffer_begin_access(ps->buffer_ref.buffer->shm_buffer);
+
+	if (view_transformation_is_translation(view)) {
+		composite_whole(PIXMAN_OP_SRC, source, NULL, cache->image,
+				&transform, filter);
+	} else {
+		pixman_region32_t surf_region;
+		pixman_region32_t buffer_region;
+
+		pixman_region32_init_rect(&surf_region, 0, 0,
+					  surface->width, surface->height);
+		if (view->geometry.scissor_enabled)
+			pixman_region32_intersect(&surf_region, &surf_region,
+						  &view->geometry.scissor);
+
+		pixman_region32_init(&buffer_region);
+		weston_surface_to_buffer_region(surface, &surf_region,
+						&buffer_region);
+
+		composite_clipped(PIXMAN_OP_OVER, source, NULL, cache->image,
+				  &transform, filter, &buffer_region);
+
+		pixman_region32_fini(&buffer_region);
+		pixman_region32_fini(&surf_region);
+	}
+
+	if (ps->buffer_ref.buffer)
+		wl_shm_buffer_end_access(ps->buffer_ref.buffer->shm_buffer);
+
+	return true;
+}
+
+/* Keep the output space image of a transformed paint node up to date. Only
+ * called from the main thread, before drawing.
+ */
+static void
+paint_node_update_cache(struct weston_paint_node *pnode)
+{
+	struct pixman_output_state *po = get_output_state(pnode->output);
+	struct pixman_paint_node_cache *cache = get_paint_node_cache(pnode);
+	const pixman_color_t *color;
+	pixman_image_t *source;
+	pixman_format_code_t format;
+
+	source = paint_node_source_image(pnode, &color);
+
+	/* Solid fills are as cheap to draw as a blit */
+	if (!paint_node_is_transformed(pnode) ||
+	    !pixman_image_get_data(source)) {
+		if (cache)
+			paint_node_cache_handle_pnode_destroy(&cache->pnode_destroy_listener,
+							      pnode);
+		return;
+	}
+
+	if (!cache) {
+		cache = xzalloc(sizeof *cache);
+		pixman_region32_init(&cache->scissor);
+		cache->pnode_destroy_listener.notify =
+			paint_node_cache_handle_pnode_destroy;
+		wl_signal_add(&pnode->destroy_signal,
+			      &cache->pnode_destroy_listener);
+	}
+
+	format = po->blend_to_output ? PIXMAN_rgba_float : PIXMAN_a8r8g8b8;
+
+	if (!paint_node_cache_update_key(cache, pnode, source, format)) {
+		if (cache->image) {
+			pixman_image_unref(cache->image);
+			cache->image = NULL;
+		}
+		return;
+	}
+
+	if (!cache->image)
+		paint_node_cache_fill(cache, pnode, source);
 }
 
 /** Paint an intersected region
  *
+ * \param tile The tile to paint into.
  * \param pnode The paint node to be painted.
- * \param repaint_output The region to be painted in output coordinates.
+ * \param repaint_output The region to be painted in output coordinates,
+ *                       clipped to the tile here.
  * \param source_clip The region of the source image to use, in source image
  *                    coordinates. If NULL, use the whole source image.
  * \param pixman_op Compositing operator, either SRC or OVER.
  */
 static void
-repaint_region(struct weston_paint_node *pnode,
+repaint_region(struct pixman_tile *tile,
+	       struct weston_paint_node *pnode,
 	       pixman_region32_t *repaint_output,
 	       pixman_region32_t *source_clip,
 	       pixman_op_t pixman_op)
 {
 	struct weston_output *output = pnode->output;
 	struct weston_view *ev = pnode->view;
-	struct pixman_renderer *pr =
-		(struct pixman_renderer *) output->compositor->renderer;
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
 	struct pixman_output_state *po = get_output_state(output);
-	pixman_image_t *target_image;
+	struct pixman_paint_node_cache *cache = get_paint_node_cache(pnode);
+	pixman_image_t *target_image = tile->target;
+	const pixman_color_t *color;
+	pixman_image_t *source;
+	pixman_image_t *src_image;
 	pixman_transform_t transform;
 	pixman_filter_t filter;
 	pixman_image_t *mask_image;
 	pixman_color_t mask = { 0, };
+	bool access_buffer;
 
-	if (po->shadow_image)
-		target_image = po->shadow_image;
-	else
-		target_image = po->hw_buffer;
+	pixman_region32_intersect_rect(repaint_output, repaint_output,
+				       0, tile->y1,
+				       po->fb_size.width, tile->y2 - tile->y1);
+	if (!pixman_region32_not_empty(repaint_output))
+		return;
 
  	/* Clip rendering to the damaged output region */
 	pixman_image_set_clip_region32(target_image, repaint_output);
 
-	weston_matrix_to_pixman_transform(&transform,
-					  &pnode->output_to_buffer_matrix);
-
-	if (pnode->needs_filtering)
-		filter = PIXMAN_FILTER_BILINEAR;
-	else
+	if (cache && cache->image) {
+		/* Already clipped to the source and transformed */
+		pixman_transform_init_translate(&transform,
+						pixman_int_to_fixed(-cache->x),
+						pixman_int_to_fixed(-cache->y));
 		filter = PIXMAN_FILTER_NEAREST;
+		source_clip = NULL;
+		src_image = tile_source_image(tile, cache->image, NULL);
+		access_buffer = false;
+	} else {
+		weston_matrix_to_pixman_transform(&transform,
+						  &pnode->output_to_buffer_matrix);
 
-	if (ps->buffer_ref.buffer)
+		if (pnode->needs_filtering)
+			filter = PIXMAN_FILTER_BILINEAR;
+		else
+			filter = PIXMAN_FILTER_NEAREST;
+
+		source = paint_node_source_image(pnode, &color);
+		src_image = tile_source_image(tile, source, color);
+		access_buffer = ps->buffer_ref.buffer != NULL;
+	}
+
+	if (access_buffer)
 		wl_shm_buffer_begin_access(ps->buffer_ref.buffer->shm_buffer);
 
 	if (ev->alpha < 1.0) {
@@ -354,22 +740,28 @@ repaint_region(struct weston_paint_node *pnode,
 		mask_image = NULL;
 	}
 
-	if (source_clip)
-		composite_clipped(output, ps->image, mask_image, target_image,
-				  &transform, filter, source_clip);
-	else
-		composite_whole(pixman_op, ps->image, mask_image,
+	if (source_clip) {
+		int n = composite_clipped(pixman_op, src_image, mask_image,
+					  target_image, &transform, filter,
+					  source_clip);
+
+		tile->overdraw = MAX(tile->overdraw, n);
+	} else {
+		composite_whole(pixman_op, src_image, mask_image,
 				target_image, &transform, filter);
+	}
 
 	if (mask_image)
 		pixman_image_unref(mask_image);
 
-	if (ps->buffer_ref.buffer)
+	if (access_buffer)
 		wl_shm_buffer_end_access(ps->buffer_ref.buffer->shm_buffer);
 
-	if (pr->repaint_debug)
+	pixman_image_unref(src_image);
+
+	if (tile->debug_color)
 		pixman_image_composite32(PIXMAN_OP_OVER,
-					 pr->debug_color, /* src */
+					 tile->debug_color, /* src */
 					 NULL /* mask */,
 					 target_image, /* dest */
 					 0, 0, /* src_x, src_y */
@@ -381,75 +773,74 @@ repaint_region(struct weston_paint_node *pnode,
 	pixman_image_set_clip_region32(target_image, NULL);
 }
 
+/* Split the repaint region into the part where the paint node is known to
+ * be opaque, which can be painted with PIXMAN_OP_SRC, and the rest, which
+ * needs PIXMAN_OP_OVER. Both are returned in output coordinates.
+ */
 static void
-draw_node_translated(struct weston_paint_node *pnode,
-		     pixman_region32_t *repaint_global)
+split_opaque(struct weston_paint_node *pnode,
+	     pixman_region32_t *repaint_global,
+	     pixman_region32_t *opaque_output,
+	     pixman_region32_t *blend_output)
 {
-	struct weston_output *output = pnode->output;
-	struct weston_surface *surface = pnode->surface;
-	struct weston_view *view = pnode->view;
+	pixman_region32_intersect(opaque_output, repaint_global,
+				  weston_paint_node_get_opaque_region(pnode));
+	pixman_region32_subtract(blend_output, repaint_global,
+				 opaque_output);
+
+	weston_region_global_to_output(opaque_output, pnode->output,
+				       opaque_output);
+	weston_region_global_to_output(blend_output, pnode->output,
+				       blend_output);
+}
 
-	/* non-opaque region in surface coordinates: */
-	pixman_region32_t surface_blend;
-	/* region to be painted in output coordinates: */
-	pixman_region32_t repaint_output;
+static void
+draw_node_translated(struct pixman_tile *tile,
+		     struct weston_paint_node *pnode,
+		     pixman_region32_t *repaint_global)
+{
+	pixman_region32_t opaque_output;
+	pixman_region32_t blend_output;
 
-	pixman_region32_init(&repaint_output);
+	pixman_region32_init(&opaque_output);
+	pixman_region32_init(&blend_output);
 
-	/* Blended region is whole surface minus opaque region,
-	 * unless surface alpha forces us to blend all.
+	/* A buffer scaled with filtering blends its edges with the
+	 * transparent samples around it, so an opaque surface does not make
+	 * for opaque pixels there. Keep PIXMAN_OP_OVER for all of it.
 	 */
-	pixman_region32_init_rect(&surface_blend, 0, 0,
-				  surface->width, surface->height);
-
-	if (!(view->alpha < 1.0)) {
-		pixman_region32_subtract(&surface_blend, &surface_blend,
-					 &surface->opaque);
-
-		if (pixman_region32_not_empty(&surface->opaque)) {
-			region_intersect_only_translation(&repaint_output,
-							  repaint_global,
-							  &surface->opaque,
-							  view);
-			weston_region_global_to_output(&repaint_output,
-						       output,
-						       &repaint_output);
-
-			repaint_region(pnode, &repaint_output, NULL,
-				       PIXMAN_OP_SRC);
-		}
+	if (!pnode->needs_filtering) {
+		split_opaque(pnode, repaint_global, &opaque_output,
+			     &blend_output);
+	} else {
+		pixman_region32_copy(&blend_output, repaint_global);
+		weston_region_global_to_output(&blend_output, pnode->output,
+					       &blend_output);
 	}
 
-	if (pixman_region32_not_empty(&surface_blend)) {
-		region_intersect_only_translation(&repaint_output,
-						  repaint_global,
-						  &surface_blend, view);
-		weston_region_global_to_output(&repaint_output,
-					       output,
-					       &repaint_output);
+	if (pixman_region32_not_empty(&opaque_output))
+		repaint_region(tile, pnode, &opaque_output, NULL,
+			       PIXMAN_OP_SRC);
 
-		repaint_region(pnode, &repaint_output, NULL, PIXMAN_OP_OVER);
-	}
+	if (pixman_region32_not_empty(&blend_output))
+		repaint_region(tile, pnode, &blend_output, NULL,
+			       PIXMAN_OP_OVER);
 
-	pixman_region32_fini(&surface_blend);
-	pixman_region32_fini(&repaint_output);
+	pixman_region32_fini(&blend_output);
+	pixman_region32_fini(&opaque_output);
 }
 
 static void
-draw_node_source_clipped(struct weston_paint_node *pnode,
+draw_node_source_clipped(struct pixman_tile *tile,
+			 struct weston_paint_node *pnode,
 			 pixman_region32_t *repaint_global)
 {
 	struct weston_surface *surface = pnode->surface;
-	struct weston_output *output = pnode->output;
 	struct weston_view *view = pnode->view;
 	pixman_region32_t surf_region;
 	pixman_region32_t buffer_region;
-	pixman_region32_t repaint_output;
-
-	/* Do not bother separating the opaque region from non-opaque.
-	 * Source clipping requires PIXMAN_OP_OVER in all cases, so painting
-	 * opaque separately has no benefit.
-	 */
+	pixman_region32_t opaque_output;
+	pixman_region32_t blend_output;
 
 	pixman_region32_init_rect(&surf_region, 0, 0,
 				  surface->width, surface->height);
@@ -460,34 +851,270 @@ draw_node_source_clipped(struct weston_paint_node *pnode,
 	pixman_region32_init(&buffer_region);
 	weston_surface_to_buffer_region(surface, &surf_region, &buffer_region);
 
-	pixman_region32_init(&repaint_output);
-	pixman_region32_copy(&repaint_output, repaint_global);
-	weston_region_global_to_output(&repaint_output, output,
-				       &repaint_output);
+	pixman_region32_init(&opaque_output);
+	pixman_region32_init(&blend_output);
+
+	/* Source clipping needs PIXMAN_OP_OVER, as samples from outside the
+	 * source clip are transparent rather than discarded. The opaque
+	 * region of a transformed view is only ever the bounding box of a
+	 * scaled one though, so without filtering all of its pixels sample
+	 * inside the surface and PIXMAN_OP_SRC gives the same result.
+	 */
+	if (!pnode->needs_filtering &&
+	    pixman_region32_n_rects(&buffer_region) == 1) {
+		split_opaque(pnode, repaint_global, &opaque_output,
+			     &blend_output);
+	} else {
+		pixman_region32_copy(&blend_output, repaint_global);
+		weston_region_global_to_output(&blend_output, pnode->output,
+					       &blend_output);
+	}
+
+	if (pixman_region32_not_empty(&opaque_output))
+		repaint_region(tile, pnode, &opaque_output, &buffer_region,
+			       PIXMAN_OP_SRC);
 
-	repaint_region(pnode, &repaint_output, &buffer_region, PIXMAN_OP_OVER);
+	if (pixman_region32_not_empty(&blend_output))
+		repaint_region(tile, pnode, &blend_output, &buffer_region,
+			       PIXMAN_OP_OVER);
 
-	pixman_region32_fini(&repaint_output);
+	pixman_region32_fini(&blend_output);
+	pixman_region32_fini(&opaque_output);
 	pixman_region32_fini(&buffer_region);
 	pixman_region32_fini(&surf_region);
 }
 
 static void
-draw_paint_node(struct weston_paint_node *pnode,
-		pixman_region32_t *damage /* in global coordinates */)
+xform_image_update_color(struct pixman_xform_image *xi,
+			 const pixman_color_t *color,
+			 const struct pixman_color_transform *pxform)
 {
-	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
-	/* repaint bounding region in global coordinates: */
-	pixman_region32_t repaint;
+	float rgba[4] = {
+		color->red / 65535.0f,
+		color->green / 65535.0f,
+		color->blue / 65535.0f,
+		color->alpha / 65535.0f,
+	};
 
-	if (!pnode->surf_xform_valid)
+	pixman_color_transform_apply(pxform, rgba, 1);
+
+	xi->color.red = CLIP(rgba[0], 0.0f, 1.0f) * 0xffff;
+	xi->color.green = CLIP(rgba[1], 0.0f, 1.0f) * 0xffff;
+	xi->color.blue = CLIP(rgba[2], 0.0f, 1.0f) * 0xffff;
+	xi->color.alpha = color->alpha;
+
+	if (xi->image)
+		pixman_image_unref(xi->image);
+	xi->image = pixman_image_create_solid_fill(&xi->color);
+}
+
+/* Find the converted image for a color transformation, or reuse an unused
+ * or the least recently used one for it.
+ */
+static struct pixman_xform_image *
+surface_state_get_xform_image(struct pixman_surface_state *ps,
+			      struct weston_color_transform *xform,
+			      const struct pixman_color_transform *pxform)
+{
+	struct pixman_xform_image *xi;
+	unsigned int i;
+
+	xi = surface_state_find_xform_image(ps, xform);
+	if (xi)
+		goto out;
+
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++) {
+		struct pixman_xform_image *candidate = &ps->xform_images[i];
+
+		if (!candidate->xform) {
+			xi = candidate;
+			break;
+		}
+		if (!xi || candidate->last_use < xi->last_use)
+			xi = candidate;
+	}
+
+	weston_color_transform_unref(xi->xform);
+	xi->xform = weston_color_transform_ref(xform);
+	ps->content_serial++;
+	pixman_region32_union_rect(&xi->damage, &xi->damage, 0, 0,
+				   pixman_image_get_width(ps->image),
+				   pixman_image_get_height(ps->image));
+	if (!pixman_image_get_data(ps->image))
+		xform_image_update_color(xi, &ps->color, pxform);
+
+out:
+	xi->last_use = ++ps->xform_use_counter;
+	return xi;
+}
+
+/* Bring the blending space copy of the surface image up to date, converting
+ * only what got damaged since the last time.
+ */
+static bool
+surface_state_update_xform_image(struct pixman_surface_state *ps,
+				 struct weston_color_transform *xform)
+{
+	const struct pixman_color_transform *pxform;
+	struct pixman_xform_image *xi;
+	int width = pixman_image_get_width(ps->image);
+	int height = pixman_image_get_height(ps->image);
+	uint8_t *data;
+	int stride;
+	pixman_box32_t *boxes;
+	int n_boxes, i, y;
+
+	pxform = pixman_color_transform_from(xform);
+	if (!pxform)
+		return false;
+
+	xi = surface_state_get_xform_image(ps, xform, pxform);
+
+	/* Solid fills only have their color converted, above */
+	if (!pixman_image_get_data(ps->image))
+		return true;
+
+	if (!xi->image || !pixman_image_get_data(xi->image) ||
+	    pixman_image_get_width(xi->image) != width ||
+	    pixman_image_get_height(xi->image) != height) {
+		if (xi->image)
+			pixman_image_unref(xi->image);
+		xi->image =
+			pixman_image_create_bits_no_clear(PIXMAN_rgba_float,
+							  width, height,
+							  NULL, 0);
+		if (!xi->image)
+			return false;
+		pixman_region32_union_rect(&xi->damage, &xi->damage,
+					   0, 0, width, height);
+	}
+
+	pixman_region32_intersect_rect(&xi->damage, &xi->damage,
+				       0, 0, width, height);
+	if (!pixman_region32_not_empty(&xi->damage))
+		return true;
+
+	if (ps->buffer_ref.buffer)
+		wl_shm_buffer_begin_access(ps->buffer_ref.buffer->shm_buffer);
+
+	/* Drawing leaves its transform and filter behind */
+	pixman_image_set_transform(ps->image, NULL);
+	pixman_image_set_filter(ps->image, PIXMAN_FILTER_NEAREST, NULL, 0);
+	pixman_image_set_repeat(ps->image, PIXMAN_REPEAT_NONE);
+
+	pixman_image_set_clip_region32(xi->image, &xi->damage);
+	pixman_image_composite32(PIXMAN_OP_SRC, ps->image, NULL,
+				 xi->image,
+				 0, 0, 0, 0, 0, 0, width, height);
+	pixman_image_set_clip_region32(xi->image, NULL);
+
+	if (ps->buffer_ref.buffer)
+		wl_shm_buffer_end_access(ps->buffer_ref.buffer->shm_buffer);
+
+	data = (uint8_t *) pixman_image_get_data(xi->image);
+	stride = pixman_image_get_stride(xi->image);
+	boxes = pixman_region32_rectangles(&xi->damage, &n_boxes);
+	for (i = 0; i < n_boxes; i++) {
+		for (y = boxes[i].y1; y < boxes[i].y2; y++) {
+			float *row = (float *) (data + y * stride);
+
+			pixman_color_transform_apply(pxform,
+						     row + boxes[i].x1 * 4,
+						     boxes[i].x2 - boxes[i].x1);
+		}
+	}
+
+	pixman_region32_clear(&xi->damage);
+
+	return true;
+}
+
+static bool
+surface_state_has_xform_images(struct pixman_surface_state *ps)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++) {
+		if (ps->xform_images[i].xform)
+			return true;
+	}
+
+	return false;
+}
+
+/* Add damage in buffer coordinates to all the converted images in use */
+static void
+surface_state_damage_xform_images(struct pixman_surface_state *ps,
+				  int32_t x, int32_t y,
+				  int32_t width, int32_t height)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++) {
+		struct pixman_xform_image *xi = &ps->xform_images[i];
+
+		if (xi->xform)
+			pixman_region32_union_rect(&xi->damage, &xi->damage,
+						   x, y, width, height);
+	}
+}
+
+/* Convert what got damaged of a YUV buffer since the last time, all of it
+ * if the color representation changed.
+ */
+static void
+surface_state_update_yuv_image(struct pixman_surface_state *ps)
+{
+	struct weston_surface *surface = ps->surface;
+	struct weston_buffer *buffer = ps->buffer_ref.buffer;
+	struct weston_color_representation color_rep;
+	struct weston_color_representation_matrix cr_matrix;
+
+	color_rep = weston_fill_color_representation(&surface->color_representation,
+						     ps->yuv_format);
+	if (!weston_color_representation_equal(&color_rep, &ps->yuv_color_rep,
+					       WESTON_CR_COMPARISON_FLAG_IGNORE_ALPHA |
+					       WESTON_CR_COMPARISON_FLAG_IGNORE_CHROMA_LOCATION)) {
+		ps->yuv_color_rep = color_rep;
+		pixman_region32_union_rect(&ps->yuv_damage, &ps->yuv_damage,
+					   0, 0, buffer->width, buffer->height);
+		surface_state_damage_xform_images(ps, 0, 0,
+						  buffer->width, buffer->height);
+		ps->content_serial++;
+	}
+
+	if (!pixman_region32_not_empty(&ps->yuv_damage))
 		return;
 
-	assert(pnode->surf_xform.transform == NULL);
+	weston_get_color_representation_matrix(surface->compositor,
+					       color_rep.matrix_coefficients,
+					       color_rep.quant_range,
+					       &cr_matrix);
+
+	wl_shm_buffer_begin_access(buffer->shm_buffer);
+	pixman_yuv_convert(ps->yuv_format, &cr_matrix,
+			   wl_shm_buffer_get_data(buffer->shm_buffer),
+			   buffer->stride, buffer->width, buffer->height,
+			   ps->yuv_image, &ps->yuv_damage);
+	wl_shm_buffer_end_access(buffer->shm_buffer);
+
+	pixman_region32_clear(&ps->yuv_damage);
+}
+
+/* Whether there is anything to draw for a paint node. Only called from the
+ * main thread, before drawing.
+ */
+static bool
+paint_node_is_drawable(struct weston_paint_node *pnode)
+{
+	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
+
+	if (!pnode->surf_xform_valid)
+		return false;
 
 	/* No buffer attached */
 	if (!ps->image)
-		return;
+		return false;
 
 	/* if we still have a reference, but the underlying buffer is no longer
 	 * available signal that we should unref image_t as well. This happens
@@ -499,12 +1126,32 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (ps->buffer_ref.buffer && !ps->buffer_ref.buffer->shm_buffer) {
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
-		return;
+		return false;
 	}
 
+	if (ps->yuv_format)
+		surface_state_update_yuv_image(ps);
+
+	if (pnode->surf_xform.transform &&
+	    !surface_state_update_xform_image(ps, pnode->surf_xform.transform)) {
+		weston_log("Pixman-renderer: failed to generate a color transformation.\n");
+		return false;
+	}
+
+	paint_node_update_cache(pnode);
+
+	return true;
+}
+
+static void
+draw_paint_node(struct pixman_tile *tile, struct weston_paint_node *pnode)
+{
+	/* repaint bounding region in global coordinates: */
+	pixman_region32_t repaint;
+
 	pixman_region32_init(&repaint);
 	pixman_region32_intersect(&repaint,
-				  &pnode->visible, damage);
+				  &pnode->visible, tile->damage);
 
 	if (!pixman_region32_not_empty(&repaint))
 		goto out;
@@ -517,7 +1164,7 @@ draw_paint_node(struct weston_paint_node *pnode,
 		 * Also the boundingbox is accurate rather than an
 		 * approximation.
 		 */
-		draw_node_translated(pnode, &repaint);
+		draw_node_translated(tile, pnode, &repaint);
 	} else {
 		/* The complex case: the view transformation does not allow
 		 * converting opaque etc. regions into global coordinate space.
@@ -526,49 +1173,298 @@ draw_paint_node(struct weston_paint_node *pnode,
 		 * to be used whole. Source clipping does not work with
 		 * PIXMAN_OP_SRC.
 		 */
-		draw_node_source_clipped(pnode, &repaint);
+		draw_node_source_clipped(tile, pnode, &repaint);
 	}
 
 out:
 	pixman_region32_fini(&repaint);
 }
+
 static void
-repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
+draw_tile(struct pixman_tile *tile)
 {
+	struct pixman_output_state *po = get_output_state(tile->output);
+	struct weston_paint_node **pnode;
+
+	wl_array_for_each(pnode, &po->draw_list)
+		draw_paint_node(tile, *pnode);
+}
+
+static void
+draw_tile_job(void *data, unsigned int index)
+{
+	struct pixman_tile *tiles = data;
+
+	draw_tile(&tiles[index]);
+}
+
+/* Split the damaged rows into bands, one per thread of the pool, unless they
+ * are too few to bother.
+ */
+static unsigned int
+output_count_tiles(struct weston_output *output, pixman_region32_t *damage,
+		   int32_t *y1, int32_t *y2)
+{
+	struct weston_worker_pool *pool = output->compositor->repaint_pool;
+	pixman_region32_t damage_output;
+	pixman_box32_t *extents;
+	unsigned int n_tiles;
+
+	if (!pool)
+		return 1;
+
+	pixman_region32_init(&damage_output);
+	weston_region_global_to_output(&damage_output, output, damage);
+	extents = pixman_region32_extents(&damage_output);
+	*y1 = extents->y1;
+	*y2 = extents->y2;
+	pixman_region32_fini(&damage_output);
+
+	n_tiles = MIN(weston_worker_pool_get_size(pool),
+		      (unsigned int) MAX(*y2 - *y1, 0) / PIXMAN_TILE_MIN_ROWS);
+
+	return MAX(n_tiles, 1u);
+}
+
+static void
+repaint_surfaces(struct weston_output *output, pixman_region32_t *damage,
+		 pixman_image_t *target)
+{
+	struct pixman_renderer *pr = get_renderer(output->compositor);
+	struct pixman_output_state *po = get_output_state(output);
 	struct weston_paint_node *pnode;
+	struct pixman_tile *tiles;
+	unsigned int n_tiles;
+	int32_t y1, y2;
+	int overdraw = 0;
+	unsigned int i;
 
+	po->draw_list.size = 0;
 	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
-		if (pnode->plane == &output->primary_plane)
-			draw_paint_node(pnode, damage);
+		struct weston_paint_node **entry;
+
+		if (pnode->plane != &output->primary_plane ||
+		    !paint_node_is_drawable(pnode))
+			continue;
+
+		entry = wl_array_add(&po->draw_list, sizeof *entry);
+		abort_oom_if_null(entry);
+		*entry = pnode;
+	}
+
+	n_tiles = output_count_tiles(output, damage, &y1, &y2);
+
+	if (n_tiles == 1) {
+		struct pixman_tile tile = {
+			.output = output,
+			.damage = damage,
+			.target = target,
+			.debug_color = pr->repaint_debug ? pr->debug_color : NULL,
+			.y1 = 0,
+			.y2 = po->fb_size.height,
+		};
+
+		draw_tile(&tile);
+		overdraw = tile.overdraw;
+	} else {
+		tiles = xcalloc(n_tiles, sizeof *tiles);
+
+		for (i = 0; i < n_tiles; i++) {
+			struct pixman_tile *tile = &tiles[i];
+
+			tile->output = output;
+			tile->damage = damage;
+			tile->target = image_create_handle(target);
+			if (pr->repaint_debug)
+				tile->debug_color =
+					pixman_image_create_solid_fill(&debug_red);
+			tile->y1 = y1 + (int64_t) (y2 - y1) * i / n_tiles;
+			tile->y2 = y1 + (int64_t) (y2 - y1) * (i + 1) / n_tiles;
+			tile->private_sources = true;
+		}
+
+		weston_worker_pool_run(output->compositor->repaint_pool,
+				       draw_tile_job, tiles, n_tiles);
+
+		for (i = 0; i < n_tiles; i++) {
+			overdraw = MAX(overdraw, tiles[i].overdraw);
+			if (tiles[i].debug_color)
+				pixman_image_unref(tiles[i].debug_color);
+			pixman_image_unref(tiles[i].target);
+		}
+		free(tiles);
+	}
+
+	if (overdraw > 1) {
+		weston_log_paced(&output->pixman_overdraw_pacer, 1, 0,
+				 "Pixman-renderer warning: %dx overdraw\n",
+				 overdraw);
 	}
 }
 
+/* Rows of the shadow image copied into the hardware buffer */
+struct pixman_band {
+	/* Converting from blending to output color space, or NULL */
+	const struct pixman_color_transform *pxform;
+	/* The band's own handles on the images */
+	pixman_image_t *shadow_image;
+	pixman_image_t *hw_buffer;
+	/* In output coordinates */
+	pixman_region32_t region;
+};
+
+/* Rows converted at a time */
+#define PIXMAN_BAND_CHUNK_ROWS 16
+
 static void
-copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
+blend_to_output_band(struct pixman_band *band)
 {
-	struct pixman_output_state *po = get_output_state(output);
-	pixman_region32_t output_region;
+	uint8_t *shadow_data =
+		(uint8_t *) pixman_image_get_data(band->shadow_image);
+	int shadow_stride = pixman_image_get_stride(band->shadow_image);
+	int width = pixman_image_get_width(band->shadow_image);
+	pixman_box32_t *boxes;
+	float *chunk;
+	int n_boxes, i;
 
-	pixman_region32_init(&output_region);
-	pixman_region32_copy(&output_region, region);
+	boxes = pixman_region32_rectangles(&band->region, &n_boxes);
+	if (n_boxes == 0)
+		return;
 
-	weston_region_global_to_output(&output_region, output, &output_region);
+	chunk = xmalloc(width * PIXMAN_BAND_CHUNK_ROWS * 4 * sizeof *chunk);
+
+	for (i = 0; i < n_boxes; i++) {
+		int box_width = boxes[i].x2 - boxes[i].x1;
+		int y;
+
+		for (y = boxes[i].y1; y < boxes[i].y2;
+		     y += PIXMAN_BAND_CHUNK_ROWS) {
+			int rows = MIN(boxes[i].y2 - y, PIXMAN_BAND_CHUNK_ROWS);
+			pixman_image_t *chunk_image;
+			int r;
+
+			for (r = 0; r < rows; r++) {
+				const uint8_t *src = shadow_data +
+					(y + r) * shadow_stride +
+					boxes[i].x1 * 4 * sizeof *chunk;
+
+				memcpy(&chunk[r * box_width * 4], src,
+				       box_width * 4 * sizeof *chunk);
+			}
+
+			pixman_color_transform_apply(band->pxform, chunk,
+						     box_width * rows);
+
+			chunk_image = pixman_image_create_bits_no_clear(
+					PIXMAN_rgba_float, box_width, rows,
+					(uint32_t *) chunk,
+					box_width * 4 * sizeof *chunk);
+			abort_oom_if_null(chunk_image);
+			pixman_image_composite32(PIXMAN_OP_SRC,
+						 chunk_image, NULL,
+						 band->hw_buffer,
+						 0, 0, /* src_x, src_y */
+						 0, 0, /* mask_x, mask_y */
+						 boxes[i].x1, y, /* dest_x, dest_y */
+						 box_width, rows);
+			pixman_image_unref(chunk_image);
+		}
+	}
 
-	pixman_image_set_clip_region32 (po->hw_buffer, &output_region);
-	pixman_region32_fini(&output_region);
+	free(chunk);
+}
 
+static void
+copy_band_job(void *data, unsigned int index)
+{
+	struct pixman_band *band = &((struct pixman_band *) data)[index];
+
+	if (band->pxform) {
+		blend_to_output_band(band);
+		return;
+	}
+
+	pixman_image_set_clip_region32(band->hw_buffer, &band->region);
 	pixman_image_composite32(PIXMAN_OP_SRC,
-				 po->shadow_image, /* src */
+				 band->shadow_image, /* src */
 				 NULL /* mask */,
-				 po->hw_buffer, /* dest */
+				 band->hw_buffer, /* dest */
 				 0, 0, /* src_x, src_y */
 				 0, 0, /* mask_x, mask_y */
 				 0, 0, /* dest_x, dest_y */
-				 po->fb_size.width, /* width */
-				 po->fb_size.height /* height */);
+				 pixman_image_get_width(band->hw_buffer),
+				 pixman_image_get_height(band->hw_buffer));
+}
 
-	pixman_image_set_clip_region32 (po->hw_buffer, NULL);
+/* Copy the shadow image to the hardware buffer, converting from blending to
+ * output color space if needed, in bands like repaint_surfaces().
+ */
+static void
+copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	const struct pixman_color_transform *pxform = NULL;
+	pixman_region32_t output_region;
+	struct pixman_band *bands;
+	unsigned int n_bands, i;
+	int32_t y1 = 0, y2 = 0;
+
+	if (po->blend_to_output) {
+		pxform = pixman_color_transform_from(output->color_outcome->from_blend_to_output);
+		if (!pxform) {
+			weston_log("Pixman-renderer: %s failed to generate a color transformation.\n",
+				   __func__);
+			return;
+		}
+	}
+
+	pixman_region32_init(&output_region);
+	weston_region_global_to_output(&output_region, output, region);
+	pixman_region32_intersect_rect(&output_region, &output_region, 0, 0,
+				       po->fb_size.width, po->fb_size.height);
+
+	n_bands = output_count_tiles(output, region, &y1, &y2);
+	bands = xcalloc(n_bands, sizeof *bands);
+
+	for (i = 0; i < n_bands; i++) {
+		struct pixman_band *band = &bands[i];
+		int32_t band_y1 = y1 + (int64_t) (y2 - y1) * i / n_bands;
+		int32_t band_y2 = y1 + (int64_t) (y2 - y1) * (i + 1) / n_bands;
+
+		band->pxform = pxform;
+		pixman_region32_init(&band->region);
+
+		if (n_bands == 1) {
+			band->shadow_image = pixman_image_ref(po->shadow_image);
+			band->hw_buffer = pixman_image_ref(po->hw_buffer);
+			pixman_region32_copy(&band->region, &output_region);
+		} else {
+			band->shadow_image = image_create_handle(po->shadow_image);
+			band->hw_buffer = image_create_handle(po->hw_buffer);
+			pixman_region32_intersect_rect(&band->region,
+						       &output_region,
+						       0, band_y1,
+						       po->fb_size.width,
+						       band_y2 - band_y1);
+		}
+	}
+
+	if (n_bands > 1)
+		weston_worker_pool_run(output->compositor->repaint_pool,
+				       copy_band_job, bands, n_bands);
+	else
+		copy_band_job(bands, 0);
+
+	pixman_image_set_clip_region32(po->hw_buffer, NULL);
+
+	for (i = 0; i < n_bands; i++) {
+		pixman_region32_fini(&bands[i].region);
+		pixman_image_unref(bands[i].shadow_image);
+		pixman_image_unref(bands[i].hw_buffer);
+	}
+	free(bands);
+	pixman_region32_fini(&output_region);
 }
 
 static void
@@ -634,6 +1530,94 @@ static void
 pixman_renderer_output_set_buffer(struct weston_output *output,
 				  pixman_image_t *buffer);
 
+/* Whether the shadow copy can be skipped for the current hardware buffer.
+ * The shadow has the framebuffer geometry, so only the pixel format and the
+ * blending space decide. */
+static bool
+output_skips_shadow(struct pixman_output_state *po)
+{
+	return po->shadow_image && po->skip_shadow_if_possible &&
+	       !po->blend_to_output &&
+	       po->hw_format->pixman_format == po->shadow_format->pixman_format;
+}
+
+/* (Re)create the shadow for the framebuffer size and blending space */
+static bool
+pixman_renderer_output_create_shadow(struct weston_output *output)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	const struct weston_size *fb_size = &po->fb_size;
+
+	if (po->shadow_image) {
+		pixman_image_unref(po->shadow_image);
+		po->shadow_image = NULL;
+	}
+
+	if (!po->shadow_format && !po->blend_to_output)
+		return true;
+
+	/* There is no pixel format to capture a float shadow into */
+	if (po->blend_to_output) {
+		if (po->shadow_format)
+			weston_output_update_capture_info(output,
+							  WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
+							  0, 0,
+							  po->shadow_format,
+							  NULL);
+		po->shadow_image =
+			pixman_image_create_bits_no_clear(PIXMAN_rgba_float,
+							  fb_size->width,
+							  fb_size->height,
+							  NULL, 0);
+		return !!po->shadow_image;
+	}
+
+	po->shadow_image =
+		pixman_image_create_bits_no_clear(po->shadow_format->pixman_format,
+						  fb_size->width, fb_size->height,
+						  NULL, 0);
+
+	weston_output_update_capture_info(output,
+					  WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
+					  po->fb_size.width,
+					  po->fb_size.height,
+					  po->shadow_format,
+					  NULL);
+
+	return !!po->shadow_image;
+}
+
+/* Blending space may be linear, which needs more than 8 bits */
+static bool
+output_needs_blend_to_output(struct weston_output *output)
+{
+	return output->color_outcome->from_blend_to_output &&
+	       !output->from_blend_to_output_by_backend;
+}
+
+/* The color outcome of an output may change after it was created, e.g.
+ * when it gets a color profile. Switch the shadow to the blending space
+ * it now needs, and composite everything again.
+ */
+static bool
+pixman_renderer_output_update_blend_to_output(struct weston_output *output)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_renderbuffer *rb;
+	bool blend_to_output = output_needs_blend_to_output(output);
+
+	if (po->blend_to_output == blend_to_output)
+		return true;
+
+	po->blend_to_output = blend_to_output;
+	po->shadow_stale = true;
+
+	wl_list_for_each(rb, &po->renderbuffer_list, link)
+		pixman_region32_copy(&rb->damage, &output->region);
+
+	return pixman_renderer_output_create_shadow(output);
+}
+
 static void
 pixman_renderer_repaint_output(struct weston_output *output,
 			       pixman_region32_t *output_damage,
@@ -650,24 +1634,48 @@ pixman_renderer_repaint_output(struct weston_output *output,
 		pixman_region32_union(&rb->damage, &rb->damage, output_damage);
 	}
 
+	if (!pixman_renderer_output_update_blend_to_output(output)) {
+		weston_log("Pixman-renderer: failed to reallocate the shadow "
+			   "of output %s.\n", output->name);
+		return;
+	}
+
 	rb = (struct pixman_renderbuffer *) renderbuffer;
 
 	pixman_renderer_output_set_buffer(output, rb->image);
 
 	assert(output->from_blend_to_output_by_backend ||
-	       output->color_outcome->from_blend_to_output == NULL);
+	       output->color_outcome->from_blend_to_output == NULL ||
+	       po->blend_to_output);
 
 	if (!po->hw_buffer)
  		return;
 
-	if (po->shadow_image) {
-		repaint_surfaces(output, output_damage);
+	if (output_skips_shadow(po)) {
+		repaint_surfaces(output, &rb->damage, po->hw_buffer);
 		pixman_renderer_do_capture_tasks(output,
 						 WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
-						 po->shadow_image, po->shadow_format);
+						 po->hw_buffer,
+						 po->shadow_format);
+		po->shadow_stale = true;
+	} else if (po->shadow_image) {
+		if (po->shadow_stale) {
+			pixman_region32_copy(&rb->damage, &output->region);
+			repaint_surfaces(output, &output->region,
+					 po->shadow_image);
+			po->shadow_stale = false;
+		} else {
+			repaint_surfaces(output, output_damage,
+					 po->shadow_image);
+		}
+		if (!po->blend_to_output)
+			pixman_renderer_do_capture_tasks(output,
+							 WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
+							 po->shadow_image,
+							 po->shadow_format);
 		copy_to_hw_buffer(output, &rb->damage);
 	} else {
-		repaint_surfaces(output, &rb->damage);
+		repaint_surfaces(output, &rb->damage, po->hw_buffer);
 	}
 	pixman_renderer_do_capture_tasks(output,
 					 WESTON_OUTPUT_CAPTURE_SOURCE_FRAMEBUFFER,
@@ -682,7 +1690,31 @@ pixman_renderer_repaint_output(struct weston_output *output,
 static void
 pixman_renderer_flush_damage(struct weston_paint_node *pnode)
 {
-	/* No-op for pixman renderer */
+	struct weston_surface *surface = pnode->surface;
+	struct pixman_surface_state *ps = get_surface_state(surface);
+	pixman_box32_t *rects;
+	int i, n;
+
+	if (pixman_region32_not_empty(&surface->damage))
+		ps->content_serial++;
+
+	/* Only the converted copies of the image need to catch up */
+	if (!surface_state_has_xform_images(ps) && !ps->yuv_format)
+		return;
+
+	rects = pixman_region32_rectangles(&surface->damage, &n);
+	for (i = 0; i < n; i++) {
+		pixman_box32_t r = weston_surface_to_buffer_rect(surface,
+								 rects[i]);
+
+		surface_state_damage_xform_images(ps, r.x1, r.y1,
+						  r.x2 - r.x1, r.y2 - r.y1);
+		if (ps->yuv_format)
+			pixman_region32_union_rect(&ps->yuv_damage,
+						   &ps->yuv_damage,
+						   r.x1, r.y1,
+						   r.x2 - r.x1, r.y2 - r.y1);
+	}
 }
 
 static void
@@ -712,6 +1744,7 @@ pixman_renderer_surface_set_color(struct weston_surface *es,
 	color.green = green * 0xffff;
 	color.blue = blue * 0xffff;
 	color.alpha = alpha * 0xffff;
+	ps->color = color;
 
 	if (ps->image) {
 		pixman_image_unref(ps->image);
@@ -721,6 +1754,84 @@ pixman_renderer_surface_set_color(struct weston_surface *es,
 	ps->image = pixman_image_create_solid_fill(&color);
 }
 
+static void
+surface_state_drop_yuv(struct pixman_surface_state *ps)
+{
+	if (ps->yuv_image) {
+		pixman_image_unref(ps->yuv_image);
+		ps->yuv_image = NULL;
+	}
+	ps->yuv_image_format = NULL;
+	pixman_region32_clear(&ps->yuv_damage);
+}
+
+/* The buffer gets converted before drawing, see
+ * surface_state_update_yuv_image(). Only the damage needs converting if
+ * the previous buffer had the same size and format.
+ */
+static void
+surface_state_attach_yuv(struct pixman_surface_state *ps,
+			 struct weston_buffer *buffer,
+			 const struct pixel_format_info *pixel_info)
+{
+	if (!ps->yuv_image ||
+	    pixman_image_get_width(ps->yuv_image) != buffer->width ||
+	    pixman_image_get_height(ps->yuv_image) != buffer->height) {
+		surface_state_drop_yuv(ps);
+		ps->yuv_image = pixman_image_create_bits_no_clear(PIXMAN_x8r8g8b8,
+								  buffer->width,
+								  buffer->height,
+								  NULL, 0);
+		abort_oom_if_null(ps->yuv_image);
+	}
+
+	if (ps->yuv_image_format != pixel_info)
+		pixman_region32_union_rect(&ps->yuv_damage, &ps->yuv_damage,
+					   0, 0, buffer->width, buffer->height);
+
+	ps->yuv_format = pixel_info;
+	ps->yuv_image_format = pixel_info;
+	ps->image = pixman_image_ref(ps->yuv_image);
+
+	ps->buffer_destroy_listener.notify =
+		buffer_state_handle_buffer_destroy;
+	wl_signal_add(&buffer->destroy_signal,
+		      &ps->buffer_destroy_listener);
+}
+
+/* The converted images stay bound to their color transformations if the new
+ * buffer has the same size and format as the previous one, like the YUV
+ * conversion in surface_state_attach_yuv(). The surface damage then says
+ * what to convert again, see pixman_renderer_flush_damage(). Otherwise all
+ * of the new image gets converted, reusing the old ones' storage.
+ */
+static void
+surface_state_attach_xform_images(struct pixman_surface_state *ps,
+				  struct weston_buffer *buffer)
+{
+	const struct pixel_format_info *format = NULL;
+	unsigned int i;
+
+	if (buffer && buffer->type == WESTON_BUFFER_SHM && buffer->shm_buffer)
+		format = pixel_format_get_info_shm(wl_shm_buffer_get_format(buffer->shm_buffer));
+
+	if (format && format == ps->xform_source_format &&
+	    buffer->width == ps->xform_source_size.width &&
+	    buffer->height == ps->xform_source_size.height)
+		return;
+
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++) {
+		weston_color_transform_unref(ps->xform_images[i].xform);
+		ps->xform_images[i].xform = NULL;
+	}
+
+	ps->xform_source_format = format;
+	if (format) {
+		ps->xform_source_size.width = buffer->width;
+		ps->xform_source_size.height = buffer->height;
+	}
+}
+
 static void
 pixman_renderer_attach(struct weston_paint_node *pnode)
 {
@@ -746,6 +1857,11 @@ pixman_renderer_attach(struct weston_paint_node *pnode)
 		ps->image = NULL;
 	}
 
+	surface_state_attach_xform_images(ps, buffer);
+
+	ps->content_serial++;
+	ps->yuv_format = NULL;
+
 	if (!buffer)
 		return;
 
@@ -777,6 +1893,13 @@ pixman_renderer_attach(struct weston_paint_node *pnode)
 		return;
 
 	pixel_info = pixel_format_get_info_shm(wl_shm_buffer_get_format(shm_buffer));
+	if (pixel_info && pixman_yuv_format_supported(pixel_info)) {
+		surface_state_attach_yuv(ps, buffer, pixel_info);
+		return;
+	}
+
+	surface_state_drop_yuv(ps);
+
 	if (!pixel_info || !pixman_format_supported_source(pixel_info->pixman_format)) {
 		weston_log("Unsupported SHM buffer format 0x%x\n",
 			wl_shm_buffer_get_format(shm_buffer));
@@ -802,6 +1925,8 @@ pixman_renderer_attach(struct weston_paint_node *pnode)
 static void
 pixman_renderer_surface_state_destroy(struct pixman_surface_state *ps)
 {
+	unsigned int i;
+
 	wl_list_remove(&ps->surface_destroy_listener.link);
 	wl_list_remove(&ps->renderer_destroy_listener.link);
 	if (ps->buffer_destroy_listener.notify) {
@@ -815,6 +1940,17 @@ pixman_renderer_surface_state_destroy(struct pixman_surface_state *ps)
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
 	}
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++) {
+		struct pixman_xform_image *xi = &ps->xform_images[i];
+
+		if (xi->image)
+			pixman_image_unref(xi->image);
+		weston_color_transform_unref(xi->xform);
+		pixman_region32_fini(&xi->damage);
+	}
+	if (ps->yuv_image)
+		pixman_image_unref(ps->yuv_image);
+	pixman_region32_fini(&ps->yuv_damage);
 	weston_buffer_reference(&ps->buffer_ref, NULL,
 				BUFFER_WILL_NOT_BE_ACCESSED);
 	weston_buffer_release_reference(&ps->buffer_release_ref, NULL);
@@ -848,6 +1984,7 @@ pixman_renderer_create_surface(struct weston_surface *surface)
 {
 	struct pixman_surface_state *ps;
 	struct pixman_renderer *pr = get_renderer(surface->compositor);
+	unsigned int i;
 
 	ps = zalloc(sizeof *ps);
 	if (ps == NULL)
@@ -856,6 +1993,9 @@ pixman_renderer_create_surface(struct weston_surface *surface)
 	surface->renderer_state = ps;
 
 	ps->surface = surface;
+	for (i = 0; i < ARRAY_LENGTH(ps->xform_images); i++)
+		pixman_region32_init(&ps->xform_images[i].damage);
+	pixman_region32_init(&ps->yuv_damage);
 
 	ps->surface_destroy_listener.notify =
 		surface_state_handle_surface_destroy;
@@ -1047,25 +2187,7 @@ pixman_renderer_resize_output(struct weston_output *output,
 	if (!pixman_renderer_discard_renderbuffers(po, false))
 		return false;
 
-	if (!po->shadow_format)
-		return true;
-
-	if (po->shadow_image)
-		pixman_image_unref(po->shadow_image);
-
-	po->shadow_image =
-		pixman_image_create_bits_no_clear(po->shadow_format->pixman_format,
-						  fb_size->width, fb_size->height,
-						  NULL, 0);
-
-	weston_output_update_capture_info(output,
-					  WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
-					  po->fb_size.width,
-					  po->fb_size.height,
-					  po->shadow_format,
-					  NULL);
-
-	return !!po->shadow_image;
+	return pixman_renderer_output_create_shadow(output);
 }
 
 static void
@@ -1078,11 +2200,7 @@ debug_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 	pr->repaint_debug ^= 1;
 
 	if (pr->repaint_debug) {
-		pixman_color_t red = {
-			0x3fff, 0x0000, 0x0000, 0x3fff
-		};
-
-		pr->debug_color = pixman_image_create_solid_fill(&red);
+		pr->debug_color = pixman_image_create_solid_fill(&debug_red);
 	} else {
 		pixman_image_unref(pr->debug_color);
 		weston_compositor_damage_all(ec);
@@ -1122,6 +2240,8 @@ pixman_renderer_init(struct weston_compositor *ec)
 	ec->renderer = &renderer->base;
 	ec->capabilities |= WESTON_CAP_ROTATION_ANY;
 	ec->capabilities |= WESTON_CAP_VIEW_CLIP_MASK;
+	ec->capabilities |= WESTON_CAP_COLOR_OPS;
+	ec->capabilities |= WESTON_CAP_COLOR_REP;
 
 	renderer->debug_binding =
 		weston_compositor_add_debug_binding(ec, KEY_R,
@@ -1133,7 +2253,8 @@ pixman_renderer_init(struct weston_compositor *ec)
 	num_formats = pixel_format_get_info_count();
 	for (i = 0; i < num_formats; i++) {
 		pixel_info = pixel_format_get_info_by_index(i);
-		if (!pixman_format_supported_source(pixel_info->pixman_format))
+		if (!pixman_format_supported_source(pixel_info->pixman_format) &&
+		    !pixman_yuv_format_supported(pixel_info))
 			continue;
 
 		/* skip formats which libwayland registers by default */
@@ -1205,10 +2326,15 @@ pixman_renderer_output_create(struct weston_output *output,
 
 	output->renderer_state = po;
 
-	if (options->use_shadow)
+	if (options->use_shadow) {
 		po->shadow_format = pixel_format_get_info(DRM_FORMAT_XRGB8888);
+		po->skip_shadow_if_possible = options->skip_shadow_if_possible;
+	}
+
+	po->blend_to_output = output_needs_blend_to_output(output);
 
 	wl_list_init(&po->renderbuffer_list);
+	wl_array_init(&po->draw_list);
 
 	if (!pixman_renderer_resize_output(output, &options->fb_size, &area)) {
 		output->renderer_state = NULL;
@@ -1242,6 +2368,7 @@ pixman_renderer_output_destroy(struct weston_output *output)
 	po->hw_buffer = NULL;
 
 	pixman_renderer_discard_renderbuffers(po, true);
+	wl_array_release(&po->draw_list);
 
 	free(po);
 	output->renderer_state = NULL;
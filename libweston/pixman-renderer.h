@@ -36,6 +36,10 @@ pixman_renderer_init(struct weston_compositor *ec);
 struct pixman_renderer_output_options {
 	/** Composite into a shadow buffer, copying to the hardware buffer */
 	bool use_shadow;
+	/** Composite straight into the hardware buffer instead when it has
+	 * the shadow's pixel format. Only for hardware buffers that are as
+	 * fast to read back as system memory. */
+	bool skip_shadow_if_possible;
 	/** Initial framebuffer size */
 	struct weston_size fb_size;
 	/** Initial pixel format */
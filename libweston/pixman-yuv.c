@@ -0,0 +1,294 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * YUV to RGB conversion for the Pixman renderer
+ *
+ * Pixman cannot sample YUV, so wl_shm YUV buffers are converted into an
+ * x8r8g8b8 image, only where damaged. Each row is first unpacked into
+ * separate Y, U and V arrays with the chroma upsampled by repetition, which
+ * is where the formats differ. The conversion itself is then a single
+ * fixed-point loop without branches or gathers, that compilers turn into
+ * SIMD code.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include "pixel-formats.h"
+#include "pixman-yuv.h"
+#include "shared/helpers.h"
+#include "shared/weston-drm-fourcc.h"
+#include "shared/xalloc.h"
+
+/* Fractional bits of the conversion coefficients */
+#define YUV_SHIFT 13
+
+struct yuv_coefficients {
+	int32_t m[3][3]; /* [RGB][YUV] */
+	int32_t y_offset;
+};
+
+/* Where the samples of a row are, in bytes */
+struct yuv_row_layout {
+	const uint8_t *y;
+	const uint8_t *u;
+	const uint8_t *v;
+	int y_step;
+	int c_step;
+	int hsub;
+	int c_width;
+};
+
+/** Whether wl_shm buffers of a format can be converted
+ *
+ * Only formats with 8-bit samples are supported.
+ */
+bool
+pixman_yuv_format_supported(const struct pixel_format_info *info)
+{
+	switch (info->format) {
+	case DRM_FORMAT_YUYV:
+	case DRM_FORMAT_YVYU:
+	case DRM_FORMAT_UYVY:
+	case DRM_FORMAT_VYUY:
+	case DRM_FORMAT_NV12:
+	case DRM_FORMAT_NV21:
+	case DRM_FORMAT_NV16:
+	case DRM_FORMAT_NV61:
+	case DRM_FORMAT_NV24:
+	case DRM_FORMAT_NV42:
+	case DRM_FORMAT_YUV420:
+	case DRM_FORMAT_YVU420:
+	case DRM_FORMAT_YUV422:
+	case DRM_FORMAT_YVU422:
+	case DRM_FORMAT_YUV444:
+	case DRM_FORMAT_YVU444:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void
+yuv_coefficients_init(struct yuv_coefficients *coeffs,
+		      const struct weston_color_representation_matrix *cr_matrix)
+{
+	int r, c;
+
+	for (r = 0; r < 3; r++) {
+		for (c = 0; c < 3; c++) {
+			float m = cr_matrix->matrix.col[c].el[r];
+
+			coeffs->m[r][c] = m * (1 << YUV_SHIFT) +
+					  (m < 0.0f ? -0.5f : 0.5f);
+		}
+	}
+
+	/* Chroma offsets are always 128 */
+	coeffs->y_offset = cr_matrix->offset.x * 255.0f + 0.5f;
+}
+
+/* Locate the samples of row y, following the wl_shm plane layout also used
+ * by the GL renderer: planes one after the other, with the stride of
+ * plane 0 divided by the horizontal subsampling.
+ */
+static void
+yuv_row_layout_init(struct yuv_row_layout *row,
+		    const struct pixel_format_info *info,
+		    const uint8_t *data, int stride, int width, int height,
+		    int y)
+{
+	int hsub = pixel_format_hsub(info, 1);
+	int vsub = pixel_format_vsub(info, 1);
+	int c_height = MAX(height / vsub, 1);
+	int cy = MIN(y / vsub, c_height - 1);
+	bool vu = info->chroma_order == ORDER_VU;
+	const uint8_t *chroma;
+	int c_stride;
+
+	row->hsub = hsub;
+	row->c_width = MAX(width / hsub, 1);
+
+	switch (info->num_planes) {
+	case 1:
+		/* Packed 4:2:2, two pixels in four bytes */
+		row->y = data + y * stride;
+		row->y_step = 2;
+		row->c_step = 4;
+		if (info->luma_chroma_order == ORDER_CHROMA_LUMA) {
+			chroma = row->y;
+			row->y += 1;
+		} else {
+			chroma = row->y + 1;
+		}
+		row->u = chroma + (vu ? 2 : 0);
+		row->v = chroma + (vu ? 0 : 2);
+		break;
+	case 2:
+		/* Y plane, then interleaved chroma */
+		row->y = data + y * stride;
+		row->y_step = 1;
+		c_stride = stride / hsub * 2;
+		chroma = data + stride * height + cy * c_stride;
+		row->c_step = 2;
+		row->u = chroma + (vu ? 1 : 0);
+		row->v = chroma + (vu ? 0 : 1);
+		break;
+	case 3:
+	default:
+		row->y = data + y * stride;
+		row->y_step = 1;
+		c_stride = stride / hsub;
+		chroma = data + stride * height;
+		row->c_step = 1;
+		row->u = chroma + cy * c_stride;
+		row->v = chroma + c_stride * (height / vsub) + cy * c_stride;
+		if (vu) {
+			const uint8_t *tmp = row->u;
+
+			row->u = row->v;
+			row->v = tmp;
+		}
+		break;
+	}
+}
+
+static void
+yuv_row_unpack(const struct yuv_row_layout *row, int x1, int x2,
+	       int32_t *ys, int32_t *us, int32_t *vs)
+{
+	int x, i;
+
+	for (x = x1, i = 0; x < x2; x++, i++) {
+		int cx = MIN(x / row->hsub, row->c_width - 1);
+
+		ys[i] = row->y[x * row->y_step];
+		us[i] = row->u[cx * row->c_step];
+		vs[i] = row->v[cx * row->c_step];
+	}
+}
+
+static inline uint32_t
+yuv_clamp_channel(int32_t c)
+{
+	c >>= YUV_SHIFT;
+
+	return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+static void
+yuv_row_convert(const struct yuv_coefficients *coeffs,
+		const int32_t *restrict ys, const int32_t *restrict us,
+		const int32_t *restrict vs, uint32_t *restrict out, int n)
+{
+	const int32_t round = 1 << (YUV_SHIFT - 1);
+	int i;
+
+	for (i = 0; i < n; i++) {
+		int32_t y = ys[i] - coeffs->y_offset;
+		int32_t u = us[i] - 128;
+		int32_t v = vs[i] - 128;
+		int32_t r, g, b;
+
+		r = coeffs->m[0][0] * y + coeffs->m[0][1] * u +
+		    coeffs->m[0][2] * v + round;
+		g = coeffs->m[1][0] * y + coeffs->m[1][1] * u +
+		    coeffs->m[1][2] * v + round;
+		b = coeffs->m[2][0] * y + coeffs->m[2][1] * u +
+		    coeffs->m[2][2] * v + round;
+
+		out[i] = 0xff000000 |
+			 yuv_clamp_channel(r) << 16 |
+			 yuv_clamp_channel(g) << 8 |
+			 yuv_clamp_channel(b);
+	}
+}
+
+/** Convert the damaged part of a YUV buffer to RGB
+ *
+ * \param info The buffer format, see pixman_yuv_format_supported().
+ * \param cr_matrix The YUV to RGB matrix and offsets from the color
+ * representation of the surface.
+ * \param data The buffer contents.
+ * \param stride The stride of the first plane in bytes.
+ * \param width The buffer width.
+ * \param height The buffer height.
+ * \param dest A PIXMAN_x8r8g8b8 or PIXMAN_a8r8g8b8 image the size of the
+ * buffer.
+ * \param region What to convert, in buffer coordinates.
+ */
+void
+pixman_yuv_convert(const struct pixel_format_info *info,
+		   const struct weston_color_representation_matrix *cr_matrix,
+		   const void *data, int stride, int width, int height,
+		   pixman_image_t *dest, pixman_region32_t *region)
+{
+	uint8_t *dest_data = (uint8_t *) pixman_image_get_data(dest);
+	int dest_stride = pixman_image_get_stride(dest);
+	struct yuv_coefficients coeffs;
+	pixman_box32_t *boxes;
+	int32_t *samples;
+	int n_boxes, i, y;
+
+	assert(pixman_yuv_format_supported(info));
+	assert(PIXMAN_FORMAT_BPP(pixman_image_get_format(dest)) == 32);
+	assert(pixman_image_get_width(dest) == width);
+	assert(pixman_image_get_height(dest) == height);
+
+	yuv_coefficients_init(&coeffs, cr_matrix);
+
+	samples = xcalloc(3 * width, sizeof *samples);
+
+	boxes = pixman_region32_rectangles(region, &n_boxes);
+	for (i = 0; i < n_boxes; i++) {
+		int x1 = MAX(boxes[i].x1, 0);
+		int x2 = MIN(boxes[i].x2, width);
+
+		if (x1 >= x2)
+			continue;
+
+		for (y = MAX(boxes[i].y1, 0); y < MIN(boxes[i].y2, height); y++) {
+			struct yuv_row_layout row;
+			uint32_t *out;
+
+			yuv_row_layout_init(&row, info, data, stride,
+					    width, height, y);
+			yuv_row_unpack(&row, x1, x2, samples, samples + width,
+				       samples + 2 * width);
+
+			out = (uint32_t *) (dest_data + y * dest_stride) + x1;
+			yuv_row_convert(&coeffs, samples, samples + width,
+					samples + 2 * width, out, x2 - x1);
+		}
+	}
+
+	free(samples);
+}
@@ -793,6 +793,7 @@ gl_renderer_setup_egl_extensions(struct weston_compositor *ec)
 	if (egl_display_has(gr, EXTENSION_KHR_FENCE_SYNC)) {
 		GET_PROC_ADDRESS(gr->create_sync, "eglCreateSyncKHR");
 		GET_PROC_ADDRESS(gr->destroy_sync, "eglDestroySyncKHR");
+		GET_PROC_ADDRESS(gr->client_wait_sync, "eglClientWaitSyncKHR");
 	}
 
 	if (egl_display_has(gr, EXTENSION_ANDROID_NATIVE_FENCE_SYNC))
@@ -88,6 +88,7 @@ compile_const int c_color_effect = DEF_COLOR_EFFECT;
 compile_const bool c_input_is_premult = DEF_INPUT_IS_PREMULT;
 compile_const bool c_tint = DEF_TINT;
 compile_const bool c_wireframe = DEF_WIREFRAME;
+compile_const bool c_batched = DEF_BATCHED;
 compile_const bool c_need_color_pipeline =
 	c_color_pre_curve != SHADER_COLOR_CURVE_IDENTITY ||
 	c_color_mapping != SHADER_COLOR_MAPPING_IDENTITY ||
@@ -120,10 +121,13 @@ uniform sampler2D tex;
 varying HIGHPRECISION vec2 v_texcoord;
 varying HIGHPRECISION vec4 v_color;
 varying HIGHPRECISION vec3 v_barycentric;
+varying HIGHPRECISION vec2 v_batch;
 
 uniform sampler2D tex1;
 uniform sampler2D tex2;
 uniform sampler2D tex_wireframe;
+/* #define MAX_BATCH_TEXTURES is runtime generated. */
+uniform sampler2D tex_batch[MAX_BATCH_TEXTURES];
 uniform float view_alpha;
 uniform vec4 unicolor;
 uniform vec4 tint;
@@ -192,6 +196,25 @@ texture2D_swizzle(samplerExternalOES sampler, int unit, vec2 coord)
 }
 #endif
 
+/*
+ * Batched draws merge several RGBA paint nodes, each vertex carrying the slot
+ * of its texture. GLSL ES 1.00 only allows indexing sampler arrays with
+ * constant or loop index expressions, hence the loop.
+ */
+vec4
+sample_batch_texture()
+{
+	int slot = int(v_batch.x + 0.5);
+
+	for (int i = 0; i < MAX_BATCH_TEXTURES; i++) {
+		if (i == slot)
+			return texture2D(tex_batch[i], v_texcoord);
+	}
+
+	/* Never reached, bad slot value. */
+	return vec4(1.0, 0.3, 1.0, 1.0);
+}
+
 vec4
 sample_input_texture()
 {
@@ -202,6 +225,9 @@ sample_input_texture()
 	if (c_variant == SHADER_VARIANT_SOLID)
 		return unicolor;
 
+	if (c_batched)
+		return sample_batch_texture();
+
 	if (c_variant == SHADER_VARIANT_EXTERNAL ||
 	    c_variant == SHADER_VARIANT_RGBA)
 		return texture2D_swizzle(tex, 0, v_texcoord);
@@ -511,7 +537,10 @@ main()
 	if (!c_input_is_premult || (c_input_is_premult && c_need_straight_alpha))
 		color.rgb *= color.a;
 
-	color *= view_alpha;
+	if (c_batched)
+		color *= v_batch.y;
+	else
+		color *= view_alpha;
 
 	if (c_tint)
 		color = color * vec4(1.0 - tint.a) + tint;
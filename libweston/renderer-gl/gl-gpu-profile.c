@@ -0,0 +1,370 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * GPU timestamps of the passes of output repaints
+ *
+ * While the gl-gpu-profile logging scope has a subscriber, every paint node
+ * draw, the shadow blit, the border draws and the capture copies of an output
+ * repaint are bracketed by a pair of GL_TIMESTAMP_EXT queries. Results are
+ * picked up without waiting at the following repaints of the output, once the
+ * GPU is done with them. They are summarised in the scope for each frame and,
+ * if the timeline is being profiled, reported as timeline points and Perfetto
+ * slices on a "GPU passes" track of the output.
+ *
+ * GPU timestamps are mapped to CLOCK_MONOTONIC with an offset sampled at the
+ * end of each frame. Frames during which the GPU timer went disjoint, e.g. on
+ * a frequency change, are dropped.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+
+#include "gl-renderer.h"
+#include "gl-renderer-internal.h"
+#include "timeline.h"
+#include "shared/string-helpers.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+
+struct gl_gpu_pass {
+	char *label;
+	GLuint begin_query;
+	GLuint end_query;
+};
+
+struct gl_gpu_frame {
+	struct wl_list link; /* gl_gpu_profile::frames */
+	struct wl_array passes; /* struct gl_gpu_pass */
+	int64_t gpu_to_monotonic; /* nanoseconds */
+};
+
+struct weston_log_scope *
+gl_gpu_profile_scope_create(struct gl_renderer *gr)
+{
+	return weston_compositor_add_log_scope(gr->compositor,
+		"gl-gpu-profile",
+		"GPU time of each pass of the GL output repaints, "
+		"down to single paint nodes. Subscribing turns the "
+		"measurements on.\n",
+		NULL, NULL, gr);
+}
+
+/** Whether repaints should be timestamped
+ *
+ * Batched draws can't be attributed to single paint nodes, so the caller is
+ * expected not to batch draws across paint nodes while this holds.
+ */
+bool
+gl_gpu_profile_is_enabled(struct gl_renderer *gr)
+{
+	return gl_features_has(gr, FEATURE_GPU_PASS_TIMESTAMPS) &&
+	       weston_log_scope_is_enabled(gr->gpu_profile_scope);
+}
+
+static GLuint
+get_query(struct gl_renderer *gr)
+{
+	GLuint query;
+
+	if (gr->free_queries.size > 0) {
+		gr->free_queries.size -= sizeof query;
+		memcpy(&query, (char *) gr->free_queries.data +
+		       gr->free_queries.size, sizeof query);
+		return query;
+	}
+
+	gr->gen_queries(1, &query);
+
+	return query;
+}
+
+static void
+put_query(struct gl_renderer *gr, GLuint query)
+{
+	GLuint *slot;
+
+	slot = wl_array_add(&gr->free_queries, sizeof *slot);
+	if (slot)
+		*slot = query;
+	else
+		gr->delete_queries(1, &query);
+}
+
+static void
+frame_destroy(struct gl_renderer *gr, struct gl_gpu_frame *frame)
+{
+	struct gl_gpu_pass *pass;
+
+	wl_array_for_each(pass, &frame->passes) {
+		put_query(gr, pass->begin_query);
+		put_query(gr, pass->end_query);
+		free(pass->label);
+	}
+	wl_array_release(&frame->passes);
+	free(frame);
+}
+
+static void
+to_monotonic(struct timespec *ts, const struct gl_gpu_frame *frame,
+	     GLuint64 gpu_time)
+{
+	timespec_from_nsec(ts, (int64_t) gpu_time + frame->gpu_to_monotonic);
+}
+
+static void
+frame_report(struct gl_renderer *gr, struct gl_gpu_profile *profile,
+	     struct gl_gpu_frame *frame)
+{
+	struct weston_compositor *compositor = gr->compositor;
+	struct weston_output *output = profile->output;
+	bool timeline = weston_timeline_profiling(compositor->timeline);
+	bool summary = weston_log_scope_is_enabled(gr->gpu_profile_scope);
+	GLuint64 first = UINT64_MAX, last = 0, total = 0;
+	GLuint64 begin, end;
+	struct gl_gpu_pass *pass;
+	struct timespec ts;
+
+	wl_array_for_each(pass, &frame->passes) {
+		gr->get_query_object_ui64v(pass->begin_query,
+					   GL_QUERY_RESULT_EXT, &begin);
+		gr->get_query_object_ui64v(pass->end_query,
+					   GL_QUERY_RESULT_EXT, &end);
+		end = MAX(begin, end);
+		first = MIN(first, begin);
+		last = MAX(last, end);
+		total += end - begin;
+
+		if (timeline) {
+			to_monotonic(&ts, frame, begin);
+			TL_POINT(compositor, TLP_RENDERER_GPU_PASS_BEGIN,
+				 TLP_GPU(&ts), TLP_OUTPUT(output),
+				 TLP_LABEL(pass->label), TLP_END);
+			to_monotonic(&ts, frame, end);
+			TL_POINT(compositor, TLP_RENDERER_GPU_PASS_END,
+				 TLP_GPU(&ts), TLP_OUTPUT(output),
+				 TLP_LABEL(pass->label), TLP_END);
+		}
+
+		if (summary)
+			weston_log_scope_printf(gr->gpu_profile_scope,
+						"  %9.3f us  %s\n",
+						(end - begin) / 1000.0,
+						pass->label);
+	}
+
+	if (summary)
+		weston_log_scope_printf(gr->gpu_profile_scope,
+					"output %s: %u passes, %.3f us busy "
+					"over %.3f us\n",
+					output->name,
+					(unsigned) (frame->passes.size /
+						    sizeof *pass),
+					total / 1000.0,
+					(last - first) / 1000.0);
+}
+
+/* Report the frames the GPU is done with, without waiting for others */
+static void
+collect_frames(struct gl_renderer *gr, struct gl_gpu_profile *profile)
+{
+	struct gl_gpu_frame *frame, *tmp;
+	struct gl_gpu_pass *pass;
+	GLint disjoint = 0;
+	GLint available;
+
+	if (wl_list_empty(&profile->frames))
+		return;
+
+	/* Reading the flag resets it. */
+	glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+	wl_list_for_each_safe(frame, tmp, &profile->frames, link) {
+		/* The last query of a frame is the last one to complete. */
+		pass = (struct gl_gpu_pass *) ((char *) frame->passes.data +
+					       frame->passes.size) - 1;
+		gr->get_query_object_iv(pass->end_query,
+					GL_QUERY_RESULT_AVAILABLE_EXT,
+					&available);
+		if (!available)
+			break;
+
+		if (!disjoint)
+			frame_report(gr, profile, frame);
+
+		wl_list_remove(&frame->link);
+		frame_destroy(gr, frame);
+	}
+}
+
+void
+gl_gpu_profile_init(struct gl_gpu_profile *profile,
+		    struct weston_output *output)
+{
+	profile->output = output;
+	wl_list_init(&profile->frames);
+	profile->current = NULL;
+}
+
+/** Drop the frames of an output, reported or not
+ *
+ * Must be called with the GL context current.
+ */
+void
+gl_gpu_profile_fini(struct gl_renderer *gr, struct gl_gpu_profile *profile)
+{
+	struct gl_gpu_frame *frame, *tmp;
+
+	wl_list_for_each_safe(frame, tmp, &profile->frames, link) {
+		wl_list_remove(&frame->link);
+		frame_destroy(gr, frame);
+	}
+
+	if (profile->current)
+		frame_destroy(gr, profile->current);
+	profile->current = NULL;
+}
+
+/** Report finished frames, and start recording a new one if enabled */
+void
+gl_gpu_profile_begin_frame(struct gl_renderer *gr,
+			   struct gl_gpu_profile *profile)
+{
+	if (!gl_features_has(gr, FEATURE_GPU_PASS_TIMESTAMPS))
+		return;
+
+	assert(!profile->current);
+
+	collect_frames(gr, profile);
+
+	if (!gl_gpu_profile_is_enabled(gr))
+		return;
+
+	profile->current = xzalloc(sizeof *profile->current);
+	wl_array_init(&profile->current->passes);
+}
+
+/** Queue the frame being recorded for collection */
+void
+gl_gpu_profile_end_frame(struct gl_renderer *gr,
+			 struct gl_gpu_profile *profile)
+{
+	struct gl_gpu_frame *frame = profile->current;
+	struct timespec now;
+	GLint64 gpu_now;
+
+	if (!frame)
+		return;
+
+	profile->current = NULL;
+
+	if (frame->passes.size == 0) {
+		frame_destroy(gr, frame);
+		return;
+	}
+
+	gr->get_integer64v(GL_TIMESTAMP_EXT, &gpu_now);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	frame->gpu_to_monotonic = timespec_to_nsec(&now) - gpu_now;
+
+	wl_list_insert(profile->frames.prev, &frame->link);
+}
+
+/** Start timing a pass of the frame being recorded
+ *
+ * \param name What the pass does.
+ * \param surface The surface drawn by the pass, or NULL.
+ *
+ * Passes don't nest, each one must be ended before the next one begins.
+ */
+void
+gl_gpu_profile_begin_pass(struct gl_renderer *gr,
+			  struct gl_gpu_profile *profile,
+			  const char *name,
+			  struct weston_surface *surface)
+{
+	struct gl_gpu_pass *pass;
+	char label[64];
+
+	if (!profile->current)
+		return;
+
+	pass = wl_array_add(&profile->current->passes, sizeof *pass);
+	if (!pass)
+		return;
+
+	if (!surface) {
+		pass->label = xstrdup(name);
+	} else {
+		if (!surface->get_label ||
+		    surface->get_label(surface, label, sizeof label) < 0)
+			snprintf(label, sizeof label, "unlabelled surface");
+		str_printf(&pass->label, "%s %s #%d", name, label,
+			   surface->s_id);
+		if (!pass->label)
+			pass->label = xstrdup(name);
+	}
+
+	pass->begin_query = get_query(gr);
+	pass->end_query = get_query(gr);
+	gr->query_counter(pass->begin_query, GL_TIMESTAMP_EXT);
+}
+
+void
+gl_gpu_profile_end_pass(struct gl_renderer *gr,
+			struct gl_gpu_profile *profile)
+{
+	struct gl_gpu_pass *pass;
+
+	if (!profile->current || profile->current->passes.size == 0)
+		return;
+
+	pass = (struct gl_gpu_pass *) ((char *) profile->current->passes.data +
+				       profile->current->passes.size) - 1;
+	gr->query_counter(pass->end_query, GL_TIMESTAMP_EXT);
+}
+
+/** Delete the query objects kept around for reuse
+ *
+ * Must be called with the GL context current, after all the profiles are
+ * finalized.
+ */
+void
+gl_gpu_profile_release_queries(struct gl_renderer *gr)
+{
+	GLuint *query;
+
+	wl_array_for_each(query, &gr->free_queries)
+		gr->delete_queries(1, query);
+	wl_array_release(&gr->free_queries);
+}
@@ -0,0 +1,448 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * On-disk cache of linked GL programs
+ *
+ * Every program is kept in a file of its own, named after a hash of the
+ * driver identification strings and after its shader requirement bits. The
+ * file header repeats both, along with a hash of the complete shader sources
+ * and one of the binary, so a stale or damaged entry only ever costs a
+ * regular compilation. A driver can also refuse a binary it made itself,
+ * e.g. after an update that kept its version strings: glProgramBinary() then
+ * fails to link, and the entry is dropped.
+ *
+ * The requirements of the programs drawn with in a session are listed in
+ * gl-<driver hash>.used when the renderer is destroyed. The next session can
+ * load them all before its first repaint.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+
+#include "gl-renderer.h"
+#include "gl-renderer-internal.h"
+#include "shared/file-util.h"
+#include "shared/string-helpers.h"
+#include "shared/xalloc.h"
+
+#define PROGRAM_CACHE_MAGIC 0x43505747 /* "WGPC" */
+/* Bump whenever struct gl_shader_requirements changes layout: it is part of
+ * the driver hash, so entries and used lists of older layouts are ignored. */
+#define PROGRAM_CACHE_VERSION 2
+
+/* Anything bigger is not a program binary */
+#define PROGRAM_CACHE_MAX_FILE_SIZE (64 * 1024 * 1024)
+
+/* Entries of other drivers are removed once unused for this long */
+#define PROGRAM_CACHE_STALE_SECONDS (30 * 24 * 60 * 60)
+
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t driver_hash;
+	uint64_t source_hash;
+	uint64_t binary_hash;
+	uint32_t requirements;
+	uint32_t binary_format;
+	uint32_t binary_length;
+	uint32_t reserved;
+};
+
+/** FNV-1a, extended with the bytes of a string
+ *
+ * \param hash The hash so far, GL_PROGRAM_CACHE_HASH_INIT to start.
+ * \param str The string, NULL is hashed like an empty string.
+ */
+uint64_t
+gl_program_cache_hash(uint64_t hash, const char *str)
+{
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) (str ? str : ""); *p; p++) {
+		hash ^= *p;
+		hash *= 0x100000001b3ull;
+	}
+
+	/* Keep "ab" + "c" apart from "a" + "bc" */
+	hash ^= 0xff;
+	hash *= 0x100000001b3ull;
+
+	return hash;
+}
+
+static uint64_t
+hash_bytes(const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	uint64_t hash = GL_PROGRAM_CACHE_HASH_INIT;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static uint32_t
+requirements_to_key(const struct gl_shader_requirements *requirements)
+{
+	uint32_t key;
+
+	static_assert(sizeof *requirements == sizeof key,
+		      "shader requirements must fit a cache key");
+	memcpy(&key, requirements, sizeof key);
+
+	return key;
+}
+
+static char *
+entry_path(struct gl_renderer *gr, uint32_t key)
+{
+	char *path = NULL;
+
+	str_printf(&path, "%s/gl-%016" PRIx64 "-%08" PRIx32 ".bin",
+		   gr->program_cache.dir, gr->program_cache.driver_hash, key);
+
+	return path;
+}
+
+static char *
+used_list_path(struct gl_renderer *gr)
+{
+	char *path = NULL;
+
+	str_printf(&path, "%s/gl-%016" PRIx64 ".used",
+		   gr->program_cache.dir, gr->program_cache.driver_hash);
+
+	return path;
+}
+
+/* Concurrent readers see either the old file or the complete new one. */
+static void
+replace_file(struct gl_renderer *gr, const char *path,
+	     const void *head, size_t head_size,
+	     const void *body, size_t body_size)
+{
+	char *tmp_template = NULL;
+
+	str_printf(&tmp_template, "%s/gl-tmp-XXXXXX", gr->program_cache.dir);
+	if (!tmp_template)
+		return;
+
+	file_replace(path, tmp_template, head, head_size, body, body_size);
+	free(tmp_template);
+}
+
+/** Record a program for prewarming the next session */
+void
+gl_program_cache_mark_used(struct gl_renderer *gr,
+			   const struct gl_shader_requirements *requirements)
+{
+	uint32_t key = requirements_to_key(requirements);
+	uint32_t *used;
+
+	if (!gr->program_cache.dir)
+		return;
+
+	wl_array_for_each(used, &gr->program_cache.used) {
+		if (*used == key)
+			return;
+	}
+
+	used = wl_array_add(&gr->program_cache.used, sizeof *used);
+	if (used)
+		*used = key;
+}
+
+static void
+read_used_list(struct gl_renderer *gr)
+{
+	char *path = used_list_path(gr);
+	char *data, *p, *end;
+	size_t size;
+	uint32_t *key;
+	unsigned long val;
+
+	data = path ? file_read_all(path, PROGRAM_CACHE_MAX_FILE_SIZE, &size) : NULL;
+	free(path);
+	if (!data)
+		return;
+
+	for (p = data; *p; p = end) {
+		errno = 0;
+		val = strtoul(p, &end, 16);
+		if (end == p || errno != 0 || val > UINT32_MAX)
+			break;
+
+		key = wl_array_add(&gr->program_cache.prev_used, sizeof *key);
+		if (!key)
+			break;
+		*key = val;
+	}
+
+	free(data);
+}
+
+static void
+write_used_list(struct gl_renderer *gr)
+{
+	char *path = used_list_path(gr);
+	char *list = NULL;
+	size_t size = 0;
+	uint32_t *key;
+	FILE *fp;
+
+	if (!path)
+		return;
+
+	fp = open_memstream(&list, &size);
+	if (fp) {
+		wl_array_for_each(key, &gr->program_cache.used)
+			fprintf(fp, "%08" PRIx32 "\n", *key);
+		if (fclose(fp) == 0)
+			replace_file(gr, path, list, size, NULL, 0);
+	}
+
+	free(list);
+	free(path);
+}
+
+/* Other drivers' entries would otherwise pile up with every update. */
+static void
+prune_stale_entries(struct gl_renderer *gr)
+{
+	char own_prefix[32];
+	struct dirent *de;
+	struct stat st;
+	time_t now = time(NULL);
+	DIR *dir;
+
+	snprintf(own_prefix, sizeof own_prefix, "gl-%016" PRIx64,
+		 gr->program_cache.driver_hash);
+
+	dir = opendir(gr->program_cache.dir);
+	if (!dir)
+		return;
+
+	while ((de = readdir(dir))) {
+		if (strncmp(de->d_name, "gl-", 3) != 0 ||
+		    strncmp(de->d_name, own_prefix, strlen(own_prefix)) == 0)
+			continue;
+
+		if (fstatat(dirfd(dir), de->d_name, &st,
+			    AT_SYMLINK_NOFOLLOW) < 0 ||
+		    !S_ISREG(st.st_mode) ||
+		    now - st.st_mtime < PROGRAM_CACHE_STALE_SECONDS)
+			continue;
+
+		unlinkat(dirfd(dir), de->d_name, 0);
+	}
+
+	closedir(dir);
+}
+
+/** Set up the program cache
+ *
+ * Must be called with the GL context current, after the renderer features
+ * are known. Leaves the cache disabled if the compositor has no cache
+ * directory, or if the driver cannot hand out program binaries.
+ */
+void
+gl_program_cache_init(struct gl_renderer *gr)
+{
+	const char *dir = gr->compositor->renderer_cache_dir;
+	uint64_t hash = GL_PROGRAM_CACHE_HASH_INIT;
+	char version[16];
+
+	wl_array_init(&gr->program_cache.prev_used);
+	wl_array_init(&gr->program_cache.used);
+
+	if (!dir || !gl_features_has(gr, FEATURE_PROGRAM_BINARY))
+		return;
+
+	if (file_make_directory(dir) < 0) {
+		weston_log("Failed to create renderer cache directory %s: %s\n",
+			   dir, strerror(errno));
+		return;
+	}
+
+	hash = gl_program_cache_hash(hash, (const char *) glGetString(GL_VENDOR));
+	hash = gl_program_cache_hash(hash, (const char *) glGetString(GL_RENDERER));
+	hash = gl_program_cache_hash(hash, (const char *) glGetString(GL_VERSION));
+	hash = gl_program_cache_hash(hash, (const char *)
+				     glGetString(GL_SHADING_LANGUAGE_VERSION));
+	snprintf(version, sizeof version, "%d", PROGRAM_CACHE_VERSION);
+	hash = gl_program_cache_hash(hash, version);
+
+	gr->program_cache.dir = xstrdup(dir);
+	gr->program_cache.driver_hash = hash;
+	gr->program_cache.prewarm_pending =
+		gr->compositor->renderer_cache_prewarm;
+
+	read_used_list(gr);
+	prune_stale_entries(gr);
+}
+
+/** Tear down the program cache, recording the programs used for prewarming
+ *
+ * Also safe to call if gl_program_cache_init() was never called on the
+ * zero-initialized renderer.
+ */
+void
+gl_program_cache_fini(struct gl_renderer *gr)
+{
+	if (gr->program_cache.dir && gr->program_cache.used.size > 0)
+		write_used_list(gr);
+
+	wl_array_release(&gr->program_cache.prev_used);
+	wl_array_release(&gr->program_cache.used);
+	free(gr->program_cache.dir);
+	gr->program_cache.dir = NULL;
+}
+
+/** Create a program from its cached binary
+ *
+ * \param gr The renderer.
+ * \param requirements The shader requirements of the program.
+ * \param source_hash The hash of all sources of the program.
+ * \return The linked program, or GL_NONE if it must be compiled.
+ */
+GLuint
+gl_program_cache_load(struct gl_renderer *gr,
+		      const struct gl_shader_requirements *requirements,
+		      uint64_t source_hash)
+{
+	uint32_t key = requirements_to_key(requirements);
+	struct program_cache_header header;
+	GLuint program = GL_NONE;
+	char *path, *data = NULL;
+	const char *binary;
+	size_t size;
+	GLint status;
+
+	if (!gr->program_cache.dir)
+		return GL_NONE;
+
+	path = entry_path(gr, key);
+	if (path)
+		data = file_read_all(path, PROGRAM_CACHE_MAX_FILE_SIZE, &size);
+	if (!data || size < sizeof header)
+		goto out;
+
+	memcpy(&header, data, sizeof header);
+	binary = data + sizeof header;
+	if (header.magic != PROGRAM_CACHE_MAGIC ||
+	    header.version != PROGRAM_CACHE_VERSION ||
+	    header.driver_hash != gr->program_cache.driver_hash ||
+	    header.source_hash != source_hash ||
+	    header.requirements != key ||
+	    header.binary_length != size - sizeof header ||
+	    header.binary_hash != hash_bytes(binary, header.binary_length))
+		goto out;
+
+	program = glCreateProgram();
+	gr->program_binary(program, header.binary_format, binary,
+			   header.binary_length);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		glDeleteProgram(program);
+		program = GL_NONE;
+		unlink(path);
+		goto out;
+	}
+
+out:
+	free(data);
+	free(path);
+	return program;
+}
+
+/** Save the binary of a freshly linked program in the cache
+ *
+ * \param gr The renderer.
+ * \param requirements The shader requirements of the program.
+ * \param source_hash The hash of all sources of the program.
+ * \param program The linked program.
+ */
+void
+gl_program_cache_store(struct gl_renderer *gr,
+		       const struct gl_shader_requirements *requirements,
+		       uint64_t source_hash, GLuint program)
+{
+	uint32_t key = requirements_to_key(requirements);
+	struct program_cache_header header;
+	GLint length = 0;
+	GLenum format;
+	char *path;
+	void *binary;
+
+	if (!gr->program_cache.dir)
+		return;
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0 || length > PROGRAM_CACHE_MAX_FILE_SIZE)
+		return;
+
+	binary = xmalloc(length);
+	gr->get_program_binary(program, length, &length, &format, binary);
+	if (length <= 0)
+		goto out;
+
+	header = (struct program_cache_header) {
+		.magic = PROGRAM_CACHE_MAGIC,
+		.version = PROGRAM_CACHE_VERSION,
+		.driver_hash = gr->program_cache.driver_hash,
+		.source_hash = source_hash,
+		.binary_hash = hash_bytes(binary, length),
+		.requirements = key,
+		.binary_format = format,
+		.binary_length = length,
+	};
+
+	path = entry_path(gr, key);
+	if (path)
+		replace_file(gr, path, &header, sizeof header, binary, length);
+	free(path);
+
+out:
+	free(binary);
+}
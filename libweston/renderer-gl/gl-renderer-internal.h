@@ -128,32 +128,34 @@ enum gl_extension_flag {
 	EXTENSION_ANGLE_PACK_REVERSE_ROW_ORDER    = 1ull << 1,
 	EXTENSION_APPLE_TEXTURE_PACKED_FLOAT      = 1ull << 3,
 	EXTENSION_ARM_RGBA8                       = 1ull << 4,
-	EXTENSION_EXT_COLOR_BUFFER_FLOAT          = 1ull << 5,
-	EXTENSION_EXT_COLOR_BUFFER_HALF_FLOAT     = 1ull << 6,
-	EXTENSION_EXT_DISJOINT_TIMER_QUERY        = 1ull << 7,
-	EXTENSION_EXT_EGL_IMAGE_STORAGE           = 1ull << 8,
-	EXTENSION_EXT_MAP_BUFFER_RANGE            = 1ull << 9,
-	EXTENSION_EXT_READ_FORMAT_BGRA            = 1ull << 10,
-	EXTENSION_EXT_TEXTURE_FORMAT_BGRA8888     = 1ull << 11,
-	EXTENSION_EXT_TEXTURE_NORM16              = 1ull << 12,
-	EXTENSION_EXT_TEXTURE_RG                  = 1ull << 13,
-	EXTENSION_EXT_TEXTURE_SRGB_R8             = 1ull << 14,
-	EXTENSION_EXT_TEXTURE_SRGB_RG8            = 1ull << 15,
-	EXTENSION_EXT_TEXTURE_STORAGE             = 1ull << 16,
-	EXTENSION_EXT_TEXTURE_TYPE_2_10_10_10_REV = 1ull << 17,
-	EXTENSION_EXT_UNPACK_SUBIMAGE             = 1ull << 18,
+	EXTENSION_EXT_BUFFER_STORAGE              = 1ull << 5,
+	EXTENSION_EXT_COLOR_BUFFER_FLOAT          = 1ull << 6,
+	EXTENSION_EXT_COLOR_BUFFER_HALF_FLOAT     = 1ull << 7,
+	EXTENSION_EXT_DISJOINT_TIMER_QUERY        = 1ull << 8,
+	EXTENSION_EXT_EGL_IMAGE_STORAGE           = 1ull << 9,
+	EXTENSION_EXT_MAP_BUFFER_RANGE            = 1ull << 10,
+	EXTENSION_EXT_READ_FORMAT_BGRA            = 1ull << 11,
+	EXTENSION_EXT_TEXTURE_FORMAT_BGRA8888     = 1ull << 12,
+	EXTENSION_EXT_TEXTURE_NORM16              = 1ull << 13,
+	EXTENSION_EXT_TEXTURE_RG                  = 1ull << 14,
+	EXTENSION_EXT_TEXTURE_SRGB_R8             = 1ull << 15,
+	EXTENSION_EXT_TEXTURE_SRGB_RG8            = 1ull << 16,
+	EXTENSION_EXT_TEXTURE_STORAGE             = 1ull << 17,
+	EXTENSION_EXT_TEXTURE_TYPE_2_10_10_10_REV = 1ull << 18,
+	EXTENSION_EXT_UNPACK_SUBIMAGE             = 1ull << 19,
 	EXTENSION_NV_PACKED_FLOAT                 = 1ull << 20,
 	EXTENSION_NV_PIXEL_BUFFER_OBJECT          = 1ull << 21,
 	EXTENSION_OES_EGL_IMAGE                   = 1ull << 22,
 	EXTENSION_OES_EGL_IMAGE_EXTERNAL          = 1ull << 23,
-	EXTENSION_OES_MAPBUFFER                   = 1ull << 24,
-	EXTENSION_OES_REQUIRED_INTERNALFORMAT     = 1ull << 25,
-	EXTENSION_OES_RGB8_RGBA8                  = 1ull << 26,
-	EXTENSION_OES_TEXTURE_3D                  = 1ull << 27,
-	EXTENSION_OES_TEXTURE_FLOAT               = 1ull << 28,
-	EXTENSION_OES_TEXTURE_FLOAT_LINEAR        = 1ull << 29,
-	EXTENSION_OES_TEXTURE_HALF_FLOAT          = 1ull << 30,
-	EXTENSION_QCOM_RENDER_SRGB_R8_RG8         = 1ull << 31,
+	EXTENSION_OES_GET_PROGRAM_BINARY          = 1ull << 24,
+	EXTENSION_OES_MAPBUFFER                   = 1ull << 25,
+	EXTENSION_OES_REQUIRED_INTERNALFORMAT     = 1ull << 26,
+	EXTENSION_OES_RGB8_RGBA8                  = 1ull << 27,
+	EXTENSION_OES_TEXTURE_3D                  = 1ull << 28,
+	EXTENSION_OES_TEXTURE_FLOAT               = 1ull << 29,
+	EXTENSION_OES_TEXTURE_FLOAT_LINEAR        = 1ull << 30,
+	EXTENSION_OES_TEXTURE_HALF_FLOAT          = 1ull << 31,
+	EXTENSION_QCOM_RENDER_SRGB_R8_RG8         = 1ull << 32,
 };
 
 enum gl_feature_flag {
@@ -203,6 +205,21 @@ enum gl_feature_flag {
 
 	/* GL renderer can create 3D textures. */
 	FEATURE_TEXTURE_3D = 1ull << 9,
+
+	/* GL renderer can retrieve linked programs as binaries and load them
+	 * back, in order to keep them in the on-disk program cache. */
+	FEATURE_PROGRAM_BINARY = 1ull << 10,
+
+	/* GL renderer can upload wl_shm damage through a ring of pixel unpack
+	 * buffers guarded by fence sync objects, instead of having the driver
+	 * copy it synchronously out of client memory. A persistently mapped
+	 * ring is used if buffer storage is supported as well. */
+	FEATURE_ASYNC_UPLOAD = 1ull << 11,
+
+	/* GL renderer can timestamp the passes of an output repaint, down to
+	 * single paint nodes, and report them through the timeline and
+	 * gl-gpu-profile logging scopes. */
+	FEATURE_GPU_PASS_TIMESTAMPS = 1ull << 12,
 };
 
 /* Keep the following in sync with vertex.glsl. */
@@ -250,6 +267,7 @@ enum gl_shader_attrib_loc {
 	SHADER_ATTRIB_LOC_POSITION = 0,
 	SHADER_ATTRIB_LOC_TEXCOORD,
 	SHADER_ATTRIB_LOC_BARYCENTRIC,
+	SHADER_ATTRIB_LOC_BATCH,
 };
 
 enum gl_tex_unit {
@@ -265,6 +283,11 @@ static_assert(TEX_UNIT_LAST < 8, "OpenGL ES 2.0 requires at least 8 texture "
 	      "GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS check at display creation "
 	      "to require more.");
 
+/* Max number of images per batched draw. Batched programs have no color
+ * pipeline and no wireframe, so they sample from the units those use
+ * otherwise. */
+#define SHADER_BATCH_TEX_MAX TEX_UNIT_WIREFRAME
+
 enum gl_bgra8_texture_support {
 	BGRA8_TEXTURE_SUPPORT_STORAGE = 0,
 	BGRA8_TEXTURE_SUPPORT_IMAGE_REVISED,
@@ -272,6 +295,13 @@ enum gl_bgra8_texture_support {
 	BGRA8_TEXTURE_SUPPORT_NONE,
 };
 
+/** GPU timestamps of an output's repaint passes, see gl-gpu-profile.c */
+struct gl_gpu_profile {
+	struct weston_output *output;
+	struct wl_list frames; /* struct gl_gpu_frame::link, oldest first */
+	struct gl_gpu_frame *current; /* being recorded, or NULL */
+};
+
 struct gl_extension_table {
 	const char *str;
 	size_t len;
@@ -295,6 +325,7 @@ struct gl_shader_requirements
 	bool input_is_premult:1;
 	bool tint:1;
 	bool wireframe:1;
+	bool batched:1;
 
 	unsigned color_effect:2; /* enum gl_shader_color_effect */
 
@@ -306,7 +337,7 @@ struct gl_shader_requirements
 	 * The total size of all bitfields plus pad_bits_ must fill up exactly
 	 * how many bytes the compiler allocates for them together.
 	 */
-	unsigned pad_bits_:14;
+	unsigned pad_bits_:13;
 };
 static_assert(sizeof(struct gl_shader_requirements) ==
 	      4 /* total bitfield size in bytes */,
@@ -462,6 +493,7 @@ struct gl_renderer {
 	/* EGL_KHR_fence_sync */
 	PFNEGLCREATESYNCKHRPROC create_sync;
 	PFNEGLDESTROYSYNCKHRPROC destroy_sync;
+	PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
 
 	/* EGL_ANDROID_native_fence_sync */
 	PFNEGLDUPNATIVEFENCEFDANDROIDPROC dup_native_fence_fd;
@@ -493,15 +525,22 @@ struct gl_renderer {
 	PFNGLDELETEQUERIESEXTPROC delete_queries;
 	PFNGLBEGINQUERYEXTPROC begin_query;
 	PFNGLENDQUERYEXTPROC end_query;
-#if !defined(NDEBUG)
 	PFNGLGETQUERYOBJECTIVEXTPROC get_query_object_iv;
-#endif
 	PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_object_ui64v;
+	PFNGLQUERYCOUNTEREXTPROC query_counter;
+	PFNGLGETINTEGER64VEXTPROC get_integer64v;
 
 	/* GL_EXT_texture_storage */
 	PFNGLTEXSTORAGE2DEXTPROC tex_storage_2d;
 	PFNGLTEXSTORAGE3DEXTPROC tex_storage_3d;
 
+	/* GL_OES_get_program_binary */
+	PFNGLGETPROGRAMBINARYOESPROC get_program_binary;
+	PFNGLPROGRAMBINARYOESPROC program_binary;
+
+	/* GL_EXT_buffer_storage */
+	PFNGLBUFFERSTORAGEEXTPROC buffer_storage;
+
 	uint64_t features;
 
 	GLenum pbo_usage;
@@ -524,6 +563,41 @@ struct gl_renderer {
 	 */
 	struct wl_list shader_list;
 	struct weston_log_scope *shader_scope;
+	struct weston_log_scope *gpu_profile_scope;
+	struct wl_array free_queries; /* GLuint, see gl-gpu-profile.c */
+
+	/** On-disk program binary cache, see gl-program-cache.c */
+	struct {
+		char *dir; /* NULL when disabled */
+		uint64_t driver_hash;
+		struct wl_array prev_used; /* uint32_t requirement keys */
+		struct wl_array used; /* uint32_t requirement keys */
+		bool prewarm_pending;
+	} program_cache;
+
+	/** Streaming wl_shm uploads, see gl-upload-ring.c */
+	struct {
+		GLuint pbo;
+		uint8_t *map; /* persistent mapping, or NULL */
+		size_t size;
+		size_t head; /* next free byte */
+		size_t tail; /* oldest byte the GPU may still read */
+		size_t pending; /* end of the range between begin() and end() */
+		struct wl_array fences; /* struct gl_upload_fence, oldest first */
+	} upload_ring;
+
+	/** Draws of consecutive paint nodes merged into one, see batch_mesh() */
+	struct {
+		struct gl_shader_config sconf;
+		bool opaque;
+		bool blend;
+		bool disabled; /* the batched program failed to build */
+		GLuint tex[SHADER_BATCH_TEX_MAX];
+		struct gl_texture_parameters param[SHADER_BATCH_TEX_MAX];
+		int ntex;
+		struct wl_array vertices; /* struct gl_batch_vertex */
+		struct wl_array indices; /* uint16_t */
+	} batch;
 
 	struct dmabuf_allocator *allocator;
 };
@@ -747,6 +821,81 @@ gl_renderer_use_program(struct gl_renderer *gr,
 struct weston_log_scope *
 gl_shader_scope_create(struct gl_renderer *gr);
 
+void
+gl_renderer_prewarm_programs(struct gl_renderer *gr);
+
+void
+gl_program_cache_init(struct gl_renderer *gr);
+
+void
+gl_program_cache_fini(struct gl_renderer *gr);
+
+/* Initial value for gl_program_cache_hash() */
+#define GL_PROGRAM_CACHE_HASH_INIT 0xcbf29ce484222325ull
+
+uint64_t
+gl_program_cache_hash(uint64_t hash, const char *str);
+
+GLuint
+gl_program_cache_load(struct gl_renderer *gr,
+		      const struct gl_shader_requirements *requirements,
+		      uint64_t source_hash);
+
+void
+gl_program_cache_store(struct gl_renderer *gr,
+		       const struct gl_shader_requirements *requirements,
+		       uint64_t source_hash, GLuint program);
+
+void
+gl_program_cache_mark_used(struct gl_renderer *gr,
+			   const struct gl_shader_requirements *requirements);
+
+void *
+gl_upload_ring_begin(struct gl_renderer *gr, size_t size, size_t *offset);
+
+void
+gl_upload_ring_unmap(struct gl_renderer *gr);
+
+void
+gl_upload_ring_end(struct gl_renderer *gr);
+
+void
+gl_upload_ring_fini(struct gl_renderer *gr);
+
+struct weston_log_scope *
+gl_gpu_profile_scope_create(struct gl_renderer *gr);
+
+bool
+gl_gpu_profile_is_enabled(struct gl_renderer *gr);
+
+void
+gl_gpu_profile_init(struct gl_gpu_profile *profile,
+		    struct weston_output *output);
+
+void
+gl_gpu_profile_fini(struct gl_renderer *gr, struct gl_gpu_profile *profile);
+
+void
+gl_gpu_profile_begin_frame(struct gl_renderer *gr,
+			   struct gl_gpu_profile *profile);
+
+void
+gl_gpu_profile_end_frame(struct gl_renderer *gr,
+			 struct gl_gpu_profile *profile);
+
+void
+gl_gpu_profile_begin_pass(struct gl_renderer *gr,
+			  struct gl_gpu_profile *profile,
+			  const char *name,
+			  struct weston_surface *surface);
+
+void
+gl_gpu_profile_end_pass(struct gl_renderer *gr,
+			struct gl_gpu_profile *profile);
+
+void
+gl_gpu_profile_release_queries(struct gl_renderer *gr);
+
 bool
 gl_shader_config_set_color_transform(struct gl_renderer *gr,
 				     struct gl_shader_config *sconf,
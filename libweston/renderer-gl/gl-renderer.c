@@ -177,6 +177,8 @@ struct gl_output_state {
 	/* struct timeline_render_point::link */
 	struct wl_list timeline_render_point_list;
 
+	struct gl_gpu_profile gpu_profile;
+
 	const struct pixel_format_info *shadow_format;
 	struct gl_texture_parameters shadow_param;
 	GLuint shadow_tex;
@@ -267,6 +269,7 @@ struct gl_buffer_state {
 	/* Only needed between attach() and flush_damage() */
 	int pitch; /* plane 0 pitch in pixels */
 	int offset[3]; /* per-plane pitch in bytes */
+	int cpp[3]; /* per-texture bytes per texel */
 
 	EGLImageKHR images[3];
 	int num_images;
@@ -325,6 +328,7 @@ static const struct gl_extension_table extension_table[] = {
 	EXT("GL_ANGLE_pack_reverse_row_order", EXTENSION_ANGLE_PACK_REVERSE_ROW_ORDER),
 	EXT("GL_APPLE_texture_packed_float", EXTENSION_APPLE_TEXTURE_PACKED_FLOAT),
 	EXT("GL_ARM_rgba8", EXTENSION_ARM_RGBA8),
+	EXT("GL_EXT_buffer_storage", EXTENSION_EXT_BUFFER_STORAGE),
 	EXT("GL_EXT_color_buffer_float", EXTENSION_EXT_COLOR_BUFFER_FLOAT),
 	EXT("GL_EXT_color_buffer_half_float", EXTENSION_EXT_COLOR_BUFFER_HALF_FLOAT),
 	EXT("GL_EXT_disjoint_timer_query", EXTENSION_EXT_DISJOINT_TIMER_QUERY),
@@ -343,6 +347,7 @@ static const struct gl_extension_table extension_table[] = {
 	EXT("GL_NV_pixel_buffer_object", EXTENSION_NV_PIXEL_BUFFER_OBJECT),
 	EXT("GL_OES_EGL_image", EXTENSION_OES_EGL_IMAGE),
 	EXT("GL_OES_EGL_image_external", EXTENSION_OES_EGL_IMAGE_EXTERNAL),
+	EXT("GL_OES_get_program_binary", EXTENSION_OES_GET_PROGRAM_BINARY),
 	EXT("GL_OES_mapbuffer", EXTENSION_OES_MAPBUFFER),
 	EXT("GL_OES_required_internalformat", EXTENSION_OES_REQUIRED_INTERNALFORMAT),
 	EXT("GL_OES_rgb8_rgba8", EXTENSION_OES_RGB8_RGBA8),
@@ -1315,15 +1320,18 @@ gl_renderer_do_capture_tasks(struct gl_renderer *gr,
 			continue;
 		}
 
+		gl_gpu_profile_begin_pass(gr, &go->gpu_profile, "capture",
+					  NULL);
+
 		if (gl_features_has(gr, FEATURE_ASYNC_READBACK)) {
 			gl_renderer_do_read_pixels_async(gr, go, output, ct, &rect);
-			continue;
-		}
-
-		if (gl_renderer_do_capture(gr, go, buffer, &rect))
+		} else if (gl_renderer_do_capture(gr, go, buffer, &rect)) {
 			weston_capture_task_retire_complete(ct);
-		else
+		} else {
 			weston_capture_task_retire_failed(ct, "GL: capture failed");
+		}
+
+		gl_gpu_profile_end_pass(gr, &go->gpu_profile);
 	}
 }
 
@@ -2069,23 +2077,13 @@ set_blend_state(struct gl_renderer *gr,
 }
 
 static void
-draw_mesh(struct gl_renderer *gr,
-	  struct weston_paint_node *pnode,
-	  struct gl_shader_config *sconf,
-	  const struct clipper_vertex *positions,
-	  const uint32_t *barycentrics,
-	  const uint16_t *indices,
-	  int nidx,
-	  bool opaque)
+set_alpha_swizzle(struct weston_paint_node *pnode,
+		  bool opaque)
 {
 	struct gl_surface_state *gs = get_surface_state(pnode->surface);
 	struct gl_buffer_state *gb = gs->buffer;
 	GLint swizzle_a;
 
-	assert(nidx > 0);
-
-	set_blend_state(gr, !opaque || pnode->view->alpha < 1.0);
-
 	/* Prevent translucent surfaces from punching holes through the
 	 * renderbuffer. */
 	if (!pnode->draw_solid && gb->shader_variant == SHADER_VARIANT_RGBA) {
@@ -2095,6 +2093,210 @@ draw_mesh(struct gl_renderer *gr,
 			gb->parameters[0].flags |= TEXTURE_SWIZZLES_DIRTY;
 		}
 	}
+}
+
+/* Vertex of a batched draw, see batch_mesh() */
+struct gl_batch_vertex {
+	float position[2]; /* clip space */
+	float texcoord[2];
+	float batch[2]; /* texture slot, view alpha */
+};
+
+static bool
+texture_parameters_equal(const struct gl_texture_parameters *a,
+			 const struct gl_texture_parameters *b)
+{
+	return a->target == b->target &&
+	       memcmp(&a->filters, &b->filters, sizeof a->filters) == 0 &&
+	       memcmp(&a->wrap_modes, &b->wrap_modes, sizeof a->wrap_modes) == 0 &&
+	       memcmp(&a->swizzles, &b->swizzles, sizeof a->swizzles) == 0;
+}
+
+/* Draw the meshes queued by batch_mesh() at once */
+static void
+batch_flush(struct gl_renderer *gr)
+{
+	struct gl_shader_config *sconf = &gr->batch.sconf;
+	const struct gl_batch_vertex *vertices = gr->batch.vertices.data;
+	GLsizei stride = sizeof *vertices;
+	int nidx = gr->batch.indices.size / sizeof(uint16_t);
+
+	if (nidx == 0)
+		return;
+
+	set_blend_state(gr, gr->batch.blend);
+
+	sconf->input_tex = gr->batch.tex;
+	sconf->input_param = gr->batch.param;
+	sconf->input_num = gr->batch.ntex;
+
+	if (gr->debug_mode)
+		set_debug_mode(gr, sconf, NULL, gr->batch.opaque);
+
+	/* The nodes in the batch are not tracked, so fall back to drawing
+	 * them one by one from now on to report the failure to their
+	 * clients. */
+	if (!gl_renderer_use_program(gr, sconf))
+		gr->batch.disabled = true;
+
+	glEnableVertexAttribArray(SHADER_ATTRIB_LOC_TEXCOORD);
+	glEnableVertexAttribArray(SHADER_ATTRIB_LOC_BATCH);
+	glVertexAttribPointer(SHADER_ATTRIB_LOC_POSITION, 2, GL_FLOAT, GL_FALSE,
+			      stride, vertices->position);
+	glVertexAttribPointer(SHADER_ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+			      stride, vertices->texcoord);
+	glVertexAttribPointer(SHADER_ATTRIB_LOC_BATCH, 2, GL_FLOAT, GL_FALSE,
+			      stride, vertices->batch);
+	glDrawElements(GL_TRIANGLE_STRIP, nidx, GL_UNSIGNED_SHORT,
+		       gr->batch.indices.data);
+	glDisableVertexAttribArray(SHADER_ATTRIB_LOC_BATCH);
+	glDisableVertexAttribArray(SHADER_ATTRIB_LOC_TEXCOORD);
+
+	gr->batch.vertices.size = 0;
+	gr->batch.indices.size = 0;
+	gr->batch.ntex = 0;
+}
+
+/* Queue a mesh for a batched draw instead of drawing it right away
+ *
+ * Consecutive RGBA paint nodes with the same shader requirements and blend
+ * state end up in a single draw call, only differing in their texture and
+ * transformation. Positions are transformed to clip space and texture
+ * coordinates are computed here rather than in the vertex shader, and each
+ * vertex carries the texture slot and view alpha of its node. The batch is
+ * flushed whenever a node can't join it, and before anything else is drawn.
+ *
+ * Returns false if the mesh must be drawn on its own.
+ */
+static bool
+batch_mesh(struct gl_renderer *gr,
+	   struct weston_paint_node *pnode,
+	   const struct gl_shader_config *sconf,
+	   const struct clipper_vertex *positions,
+	   int nvtx,
+	   const uint16_t *indices,
+	   int nidx,
+	   bool opaque)
+{
+	struct gl_surface_state *gs = get_surface_state(pnode->surface);
+	struct gl_buffer_state *gb = gs->buffer;
+	bool blend = !opaque || pnode->view->alpha < 1.0;
+	struct gl_shader_requirements req = sconf->req;
+	struct gl_texture_parameters *param = &gb->parameters[0];
+	struct gl_batch_vertex *vertices;
+	struct weston_coord pos, texcoord;
+	uint16_t *batch_indices, base;
+	int i, slot;
+
+	/* Texture swizzles are uniforms on OpenGL ES 2, and there are only
+	 * as many of them as images in a buffer. */
+	if (gr->batch.disabled ||
+	    gr->gl_version < gl_version(3, 0) ||
+	    gr->debug_mode == DEBUG_MODE_WIREFRAME ||
+	    req.variant != SHADER_VARIANT_RGBA ||
+	    req.color_pre_curve != SHADER_COLOR_CURVE_IDENTITY ||
+	    req.color_mapping != SHADER_COLOR_MAPPING_IDENTITY ||
+	    req.color_post_curve != SHADER_COLOR_CURVE_IDENTITY ||
+	    sconf->projection.type & WESTON_MATRIX_TRANSFORM_OTHER ||
+	    sconf->surface_to_buffer.type & WESTON_MATRIX_TRANSFORM_OTHER)
+		return false;
+
+	assert(sconf->input_num == 1);
+
+	req.texcoord_input = SHADER_TEXCOORD_INPUT_ATTRIB;
+	req.batched = true;
+	req.tint = false; /* Set by set_debug_mode() at flush. */
+
+	if (gr->batch.indices.size > 0 &&
+	    (memcmp(&req, &gr->batch.sconf.req, sizeof req) != 0 ||
+	     opaque != gr->batch.opaque || blend != gr->batch.blend))
+		batch_flush(gr);
+
+	/* The same texture may only show up with different parameters in
+	 * another batch. */
+	set_alpha_swizzle(pnode, opaque);
+	for (slot = 0; slot < gr->batch.ntex; slot++) {
+		if (gr->batch.tex[slot] != sconf->input_tex[0])
+			continue;
+		if (!texture_parameters_equal(&gr->batch.param[slot], param))
+			batch_flush(gr);
+		break;
+	}
+	if (slot == SHADER_BATCH_TEX_MAX ||
+	    gr->batch.vertices.size / sizeof *vertices + nvtx > UINT16_MAX)
+		batch_flush(gr);
+
+	if (gr->batch.indices.size == 0) {
+		gr->batch.sconf = *sconf;
+		gr->batch.sconf.req = req;
+		weston_matrix_init(&gr->batch.sconf.projection);
+		gr->batch.opaque = opaque;
+		gr->batch.blend = blend;
+		slot = 0;
+	}
+
+	/* The copy carries the pending parameter updates from now on, it is
+	 * flushed before anything else can bind the texture. */
+	if (slot == gr->batch.ntex) {
+		gr->batch.tex[slot] = sconf->input_tex[0];
+		gr->batch.param[slot] = *param;
+		gr->batch.ntex++;
+		param->flags = 0;
+	}
+
+	base = gr->batch.vertices.size / sizeof *vertices;
+	vertices = wl_array_add(&gr->batch.vertices, nvtx * sizeof *vertices);
+	batch_indices = wl_array_add(&gr->batch.indices,
+				     (nidx + 2) * sizeof *batch_indices);
+
+	for (i = 0; i < nvtx; i++) {
+		pos = weston_coord(positions[i].x, positions[i].y);
+		texcoord = weston_matrix_transform_coord(&sconf->surface_to_buffer,
+							 pos);
+		pos = weston_matrix_transform_coord(&sconf->projection, pos);
+		vertices[i] = (struct gl_batch_vertex) {
+			.position = { pos.x, pos.y },
+			.texcoord = { texcoord.x, texcoord.y },
+			.batch = { slot, pnode->view->alpha },
+		};
+	}
+
+	/* Chain to the previous mesh with degenerate triangles, the same way
+	 * store_indices() chains sub-meshes. */
+	if (base > 0) {
+		batch_indices[0] = batch_indices[-1];
+		batch_indices[1] = indices[0] + base;
+		batch_indices += 2;
+	} else {
+		gr->batch.indices.size -= 2 * sizeof *batch_indices;
+	}
+	for (i = 0; i < nidx; i++)
+		batch_indices[i] = indices[i] + base;
+
+	return true;
+}
+
+static void
+draw_mesh(struct gl_renderer *gr,
+	  struct weston_paint_node *pnode,
+	  struct gl_shader_config *sconf,
+	  const struct clipper_vertex *positions,
+	  int nvtx,
+	  const uint32_t *barycentrics,
+	  const uint16_t *indices,
+	  int nidx,
+	  bool opaque)
+{
+	assert(nidx > 0);
+
+	if (batch_mesh(gr, pnode, sconf, positions, nvtx, indices, nidx,
+		       opaque))
+		return;
+
+	batch_flush(gr);
+
+	set_blend_state(gr, !opaque || pnode->view->alpha < 1.0);
+	set_alpha_swizzle(pnode, opaque);
 
 	if (gr->debug_mode)
 		set_debug_mode(gr, sconf, barycentrics, opaque);
@@ -2177,7 +2379,7 @@ repaint_region(struct gl_renderer *gr,
 			/* Highly unlikely flush to prevent index wraparound.
 			 * Subtracting 2 removes the last chaining indices. */
 			if ((nvtx + nvtx_max) > UINT16_MAX) {
-				draw_mesh(gr, pnode, sconf, positions,
+				draw_mesh(gr, pnode, sconf, positions, nvtx,
 					  barycentrics, indices, nidx - 2,
 					  opaque);
 				nvtx = nidx = 0;
@@ -2186,8 +2388,8 @@ repaint_region(struct gl_renderer *gr,
 	}
 
 	if (nvtx)
-		draw_mesh(gr, pnode, sconf, positions, barycentrics, indices,
-			  nidx - 2, opaque);
+		draw_mesh(gr, pnode, sconf, positions, nvtx, barycentrics,
+			  indices, nidx - 2, opaque);
 
 	gr->position_stream.size = 0;
 	gr->indices.size = 0;
@@ -2252,6 +2454,7 @@ clear_region(struct gl_renderer *gr, struct weston_paint_node *pnode,
 	/* We must be either fully transparent - punching a hole for an
 	 * underlay - or fully opaque, to use clear rather than blending. */
 	assert(pnode->solid.a == 0.0f || pnode->solid.a == 1.0f);
+	batch_flush(gr);
 	set_blend_state(gr, false);
 
 	r = pnode->solid.r;
@@ -2363,6 +2566,7 @@ static void
 repaint_views(struct weston_output *output, pixman_region32_t *damage)
 {
 	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct gl_output_state *go = get_output_state(output);
 	struct weston_paint_node *pnode;
 
 	gr->nbatches = 0;
@@ -2372,11 +2576,25 @@ repaint_views(struct weston_output *output, pixman_region32_t *damage)
 
 	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
-		if (pnode->plane == &output->primary_plane ||
-		    pnode->need_hole)
+		if (pnode->plane != &output->primary_plane &&
+		    !pnode->need_hole)
+			continue;
+
+		if (!go->gpu_profile.current) {
 			draw_paint_node(pnode, damage);
+			continue;
+		}
+
+		/* Don't let batches span paint nodes while timing them. */
+		gl_gpu_profile_begin_pass(gr, &go->gpu_profile, "node",
+					  pnode->surface);
+		draw_paint_node(pnode, damage);
+		batch_flush(gr);
+		gl_gpu_profile_end_pass(gr, &go->gpu_profile);
 	}
 
+	batch_flush(gr);
+
 	glDisableVertexAttribArray(SHADER_ATTRIB_LOC_POSITION);
 }
 
@@ -2771,6 +2989,9 @@ gl_renderer_repaint_output(struct weston_output *output,
 	if (use_output(output) < 0)
 		return;
 
+	if (gr->program_cache.prewarm_pending)
+		gl_renderer_prewarm_programs(gr);
+
 	rb = gl_renderer_update_renderbuffers(output, output_damage,
 					      renderbuffer);
 
@@ -2786,6 +3007,7 @@ gl_renderer_repaint_output(struct weston_output *output,
 	}
 
 	timeline_begin_render_query(gr, go->render_query);
+	gl_gpu_profile_begin_frame(gr, &go->gpu_profile);
 
 	/* Calculate the global GL matrix */
 	go->output_matrix = output->matrix;
@@ -2855,13 +3077,21 @@ gl_renderer_repaint_output(struct weston_output *output,
 		glBindFramebuffer(GL_FRAMEBUFFER, rb->fb);
 		glViewport(go->area.x, area_y,
 			   go->area.width, go->area.height);
+		gl_gpu_profile_begin_pass(gr, &go->gpu_profile, "shadow blit",
+					  NULL);
 		blit_shadow_to_output(output, gr->debug_clear ?
 				      &output->region : &rb->damage);
+		gl_gpu_profile_end_pass(gr, &go->gpu_profile);
 	} else {
 		repaint_views(output, &rb->damage);
 	}
 
-	draw_output_borders(output, rb->border_status);
+	if (rb->border_status != BORDER_STATUS_CLEAN) {
+		gl_gpu_profile_begin_pass(gr, &go->gpu_profile, "borders",
+					  NULL);
+		draw_output_borders(output, rb->border_status);
+		gl_gpu_profile_end_pass(gr, &go->gpu_profile);
+	}
 
 	gl_renderer_do_capture_tasks(gr, output,
 				     WESTON_OUTPUT_CAPTURE_SOURCE_FRAMEBUFFER);
@@ -2870,6 +3100,7 @@ gl_renderer_repaint_output(struct weston_output *output,
 	wl_signal_emit(&output->frame_signal, output_damage);
 
 	timeline_end_render_query(gr);
+	gl_gpu_profile_end_frame(gr, &go->gpu_profile);
 
 	if (go->render_sync != EGL_NO_SYNC_KHR)
 		gr->destroy_sync(gr->egl_display, go->render_sync);
@@ -2987,6 +3218,115 @@ gl_renderer_read_pixels(struct weston_output *output,
 	return 0;
 }
 
+/* Upload boxes of a wl_shm buffer straight from client memory. The driver
+ * copies the pixels before returning. */
+static void
+upload_shm_sync(struct gl_renderer *gr, struct weston_buffer *buffer,
+		struct gl_buffer_state *gb, const uint8_t *data,
+		const pixman_box32_t *boxes, int n_boxes)
+{
+	int i, j;
+
+	for (i = 0; i < n_boxes; i++) {
+		const pixman_box32_t *r = &boxes[i];
+
+		for (j = 0; j < gb->num_textures; j++) {
+			int hsub = pixel_format_hsub(buffer->pixel_format, j);
+			int vsub = pixel_format_vsub(buffer->pixel_format, j);
+
+			glBindTexture(GL_TEXTURE_2D, gb->textures[j]);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT,
+				      gb->pitch / hsub);
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, r->x1 / hsub);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, r->y1 / vsub);
+			gl_texture_2d_store(gr, 0, r->x1 / hsub, r->y1 / vsub,
+					    (r->x2 - r->x1) / hsub,
+					    (r->y2 - r->y1) / vsub,
+					    gb->texture_format[j].external,
+					    gb->texture_format[j].type,
+					    data + gb->offset[j]);
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+}
+
+/* Upload boxes of a wl_shm buffer through the upload ring. Only the copy into
+ * the ring happens now, the GPU uploads the textures from there later on.
+ * Returns false if the ring has no room. */
+static bool
+upload_shm_async(struct gl_renderer *gr, struct weston_buffer *buffer,
+		 struct gl_buffer_state *gb, const uint8_t *data,
+		 const pixman_box32_t *boxes, int n_boxes)
+{
+	size_t size = 0, base, pos;
+	uint8_t *map;
+	int i, j, row;
+
+	/* Tightly packed rows, but for GL_UNPACK_ALIGNMENT */
+	for (i = 0; i < n_boxes; i++) {
+		for (j = 0; j < gb->num_textures; j++) {
+			int hsub = pixel_format_hsub(buffer->pixel_format, j);
+			int vsub = pixel_format_vsub(buffer->pixel_format, j);
+			size_t stride = ROUND_UP_N((boxes[i].x2 - boxes[i].x1) /
+						   hsub * gb->cpp[j], 4);
+
+			size += stride * ((boxes[i].y2 - boxes[i].y1) / vsub);
+		}
+	}
+
+	map = gl_upload_ring_begin(gr, size, &base);
+	if (!map)
+		return false;
+
+	pos = 0;
+	for (i = 0; i < n_boxes; i++) {
+		for (j = 0; j < gb->num_textures; j++) {
+			int hsub = pixel_format_hsub(buffer->pixel_format, j);
+			int vsub = pixel_format_vsub(buffer->pixel_format, j);
+			int width = (boxes[i].x2 - boxes[i].x1) / hsub;
+			int height = (boxes[i].y2 - boxes[i].y1) / vsub;
+			size_t src_stride = gb->pitch / hsub * gb->cpp[j];
+			size_t stride = ROUND_UP_N(width * gb->cpp[j], 4);
+			const uint8_t *src = data + gb->offset[j] +
+				boxes[i].y1 / vsub * src_stride +
+				boxes[i].x1 / hsub * gb->cpp[j];
+
+			for (row = 0; row < height; row++)
+				memcpy(map + pos + row * stride,
+				       src + row * src_stride,
+				       width * gb->cpp[j]);
+			pos += stride * height;
+		}
+	}
+
+	gl_upload_ring_unmap(gr);
+
+	pos = 0;
+	for (i = 0; i < n_boxes; i++) {
+		for (j = 0; j < gb->num_textures; j++) {
+			int hsub = pixel_format_hsub(buffer->pixel_format, j);
+			int vsub = pixel_format_vsub(buffer->pixel_format, j);
+			int width = (boxes[i].x2 - boxes[i].x1) / hsub;
+			int height = (boxes[i].y2 - boxes[i].y1) / vsub;
+
+			glBindTexture(GL_TEXTURE_2D, gb->textures[j]);
+			gl_texture_2d_store(gr, 0, boxes[i].x1 / hsub,
+					    boxes[i].y1 / vsub, width, height,
+					    gb->texture_format[j].external,
+					    gb->texture_format[j].type,
+					    (const void *) (uintptr_t) (base + pos));
+			pos += ROUND_UP_N(width * gb->cpp[j], 4) * height;
+		}
+	}
+
+	gl_upload_ring_end(gr);
+
+	return true;
+}
+
 static void
 gl_renderer_flush_damage(struct weston_paint_node *pnode)
 {
@@ -2997,9 +3337,9 @@ gl_renderer_flush_damage(struct weston_paint_node *pnode)
 	struct weston_buffer *buffer = surface->buffer_ref.buffer;
 	struct gl_surface_state *gs = get_surface_state(surface);
 	struct gl_buffer_state *gb = gs->buffer;
-	pixman_box32_t *rectangles;
+	pixman_box32_t full, *rectangles, *boxes;
 	uint8_t *data;
-	int i, j, n;
+	int i, n;
 
 	assert(buffer && gb);
 
@@ -3019,62 +3359,39 @@ gl_renderer_flush_damage(struct weston_paint_node *pnode)
 	    !gb->needs_full_upload)
 		goto done;
 
-	data = wl_shm_buffer_get_data(buffer->shm_buffer);
-
 	if (gb->needs_full_upload || quirks->force_full_upload) {
-		wl_shm_buffer_begin_access(buffer->shm_buffer);
-
-		for (j = 0; j < gb->num_textures; j++) {
-			int hsub = pixel_format_hsub(buffer->pixel_format, j);
-			int vsub = pixel_format_vsub(buffer->pixel_format, j);
-
-			glBindTexture(GL_TEXTURE_2D, gb->textures[j]);
-			glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT,
-				      gb->pitch / hsub);
-			gl_texture_2d_store(gr, 0, 0, 0, buffer->width / hsub,
-					    buffer->height / vsub,
-					    gb->texture_format[j].external,
-					    gb->texture_format[j].type,
-					    data + gb->offset[j]);
+		full = (pixman_box32_t) { 0, 0, buffer->width, buffer->height };
+		boxes = &full;
+		n = 1;
+	} else {
+		rectangles = pixman_region32_rectangles(&gb->texture_damage,
+							&n);
+		boxes = xcalloc(n, sizeof *boxes);
+		for (i = 0; i < n; i++) {
+			pixman_box32_t r;
+
+			r = weston_surface_to_buffer_rect(surface,
+							  rectangles[i]);
+			boxes[i].x1 = CLIP(r.x1, 0, buffer->width);
+			boxes[i].y1 = CLIP(r.y1, 0, buffer->height);
+			boxes[i].x2 = CLIP(r.x2, 0, buffer->width);
+			boxes[i].y2 = CLIP(r.y2, 0, buffer->height);
 		}
-		wl_shm_buffer_end_access(buffer->shm_buffer);
-		goto done;
 	}
 
-	rectangles = pixman_region32_rectangles(&gb->texture_damage, &n);
-	wl_shm_buffer_begin_access(buffer->shm_buffer);
-	for (i = 0; i < n; i++) {
-		pixman_box32_t r;
-
-		r = weston_surface_to_buffer_rect(surface, rectangles[i]);
-
-		for (j = 0; j < gb->num_textures; j++) {
-			int hsub = pixel_format_hsub(buffer->pixel_format, j);
-			int vsub = pixel_format_vsub(buffer->pixel_format, j);
-			int width = r.x2 - r.x1, height = r.y2 - r.y1;
+	data = wl_shm_buffer_get_data(buffer->shm_buffer);
 
-			width  = MIN(width,  buffer->width);
-			height = MIN(height, buffer->height);
-			glBindTexture(GL_TEXTURE_2D, gb->textures[j]);
-			glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT,
-				      gb->pitch / hsub);
-			glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, r.x1 / hsub);
-			glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, r.y1 / vsub);
-			gl_texture_2d_store(gr, 0, r.x1 / hsub, r.y1 / vsub,
-					    width / hsub,
-					    height / vsub,
-					    gb->texture_format[j].external,
-					    gb->texture_format[j].type,
-					    data + gb->offset[j]);
-		}
-	}
+	/* Either way, the pixels are copied out of the wl_shm buffer by the
+	 * time this returns, so it can be released right below. */
+	wl_shm_buffer_begin_access(buffer->shm_buffer);
+	if (!upload_shm_async(gr, buffer, gb, data, boxes, n))
+		upload_shm_sync(gr, buffer, gb, data, boxes, n);
 	wl_shm_buffer_end_access(buffer->shm_buffer);
 
-done:
-	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
-	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
-	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+	if (boxes != &full)
+		free(boxes);
 
+done:
 	pixman_region32_fini(&gb->texture_damage);
 	pixman_region32_init(&gb->texture_damage);
 	gb->needs_full_upload = false;
@@ -3130,6 +3447,7 @@ gl_renderer_attach_shm(struct weston_surface *es, struct weston_buffer *buffer)
 	struct gl_format_info texture_format[3];
 	int pitch, hsub, vsub;
 	int offset[3] = { 0, 0, 0 };
+	int cpp[3] = { 0, 0, 0 };
 	unsigned int num_planes;
 	unsigned int i, j;
 	const struct yuv_format_descriptor *yuv = NULL;
@@ -3209,6 +3527,7 @@ gl_renderer_attach_shm(struct weston_surface *es, struct weston_buffer *buffer)
 
 			assert(yuv->plane[out].plane_index < (int) shm_plane_count);
 			offset[out] = shm_offset[yuv->plane[out].plane_index];
+			cpp[out] = info->bpp / 8;
 		}
 	} else {
 		int bpp = buffer->pixel_format->bpp;
@@ -3220,6 +3539,7 @@ gl_renderer_attach_shm(struct weston_surface *es, struct weston_buffer *buffer)
 
 		assert(bpp > 0 && !(bpp & 7));
 		pitch = buffer->stride / (bpp / 8);
+		cpp[0] = bpp / 8;
 
 		texture_format[0] = buffer->pixel_format->gl;
 	}
@@ -3235,6 +3555,7 @@ gl_renderer_attach_shm(struct weston_surface *es, struct weston_buffer *buffer)
 	    buffer->pixel_format == old_buffer->pixel_format) {
 		gs->buffer->pitch = pitch;
 		memcpy(gs->buffer->offset, offset, sizeof(offset));
+		memcpy(gs->buffer->cpp, cpp, sizeof(cpp));
 		return;
 	}
 
@@ -3251,6 +3572,7 @@ gl_renderer_attach_shm(struct weston_surface *es, struct weston_buffer *buffer)
 	gb->pitch = pitch;
 	gb->shader_variant = shader_variant;
 	ARRAY_COPY(gb->offset, offset);
+	ARRAY_COPY(gb->cpp, cpp);
 	ARRAY_COPY(gb->texture_format, texture_format);
 	gb->needs_full_upload = true;
 	gb->num_textures = num_planes;
@@ -4490,6 +4812,7 @@ gl_renderer_output_create(struct weston_output *output,
 		gr->gen_queries(1, &go->render_query);
 
 	wl_list_init(&go->timeline_render_point_list);
+	gl_gpu_profile_init(&go->gpu_profile, output);
 
 	go->render_sync = EGL_NO_SYNC_KHR;
 
@@ -4677,6 +5000,8 @@ gl_renderer_output_destroy(struct weston_output *output)
 	if (gl_features_has(gr, FEATURE_GPU_TIMELINE))
 		gr->delete_queries(1, &go->render_query);
 
+	gl_gpu_profile_fini(gr, &go->gpu_profile);
+
 	wl_list_for_each_safe(trp, tmp, &go->timeline_render_point_list, link)
 		timeline_render_point_destroy(trp);
 
@@ -4771,6 +5096,9 @@ gl_renderer_destroy(struct weston_compositor *ec)
 	gl_renderer_shader_list_destroy(gr);
 	if (gr->fallback_shader)
 		gl_shader_destroy(gr, gr->fallback_shader);
+	gl_program_cache_fini(gr);
+	gl_upload_ring_fini(gr);
+	gl_gpu_profile_release_queries(gr);
 
 	if (gr->wireframe_tex)
 		gl_texture_fini(&gr->wireframe_tex);
@@ -4794,10 +5122,13 @@ gl_renderer_destroy(struct weston_compositor *ec)
 	wl_array_release(&gr->position_stream);
 	wl_array_release(&gr->barycentric_stream);
 	wl_array_release(&gr->indices);
+	wl_array_release(&gr->batch.vertices);
+	wl_array_release(&gr->batch.indices);
 
 	if (gr->debug_mode_binding)
 		weston_binding_destroy(gr->debug_mode_binding);
 
+	weston_log_scope_destroy(gr->gpu_profile_scope);
 	weston_log_scope_destroy(gr->shader_scope);
 	weston_log_scope_destroy(gr->renderer_scope);
 	free(gr);
@@ -4856,6 +5187,7 @@ gl_renderer_display_create(struct weston_compositor *ec,
 	gr->renderer_scope = weston_compositor_add_log_scope(ec, "gl-renderer",
 		"GL-renderer verbose messages\n", NULL, NULL, gr);
 	gr->shader_scope = gl_shader_scope_create(gr);
+	gr->gpu_profile_scope = gl_gpu_profile_scope_create(gr);
 
 	if (gl_renderer_setup_egl_client_extensions(gr) < 0)
 		goto fail;
@@ -5021,6 +5353,8 @@ fail_terminate:
 	weston_drm_format_array_fini(&gr->supported_dmabuf_formats);
 	eglTerminate(gr->egl_display);
 fail:
+	gl_program_cache_fini(gr);
+	weston_log_scope_destroy(gr->gpu_profile_scope);
 	weston_log_scope_destroy(gr->shader_scope);
 	weston_log_scope_destroy(gr->renderer_scope);
 	free(gr);
@@ -5074,6 +5408,7 @@ gl_renderer_setup(struct weston_compositor *ec)
 	EGLBoolean ret;
 	PFNGLGETQUERYIVEXTPROC get_query_iv;
 	int elapsed_bits;
+	int timestamp_bits = 0;
 
 	EGLint context_attribs[16] = {
 		EGL_CONTEXT_CLIENT_VERSION, 0,
@@ -5188,15 +5523,17 @@ gl_renderer_setup(struct weston_compositor *ec)
 		GET_PROC_ADDRESS(gr->delete_queries, "glDeleteQueriesEXT");
 		GET_PROC_ADDRESS(gr->begin_query, "glBeginQueryEXT");
 		GET_PROC_ADDRESS(gr->end_query, "glEndQueryEXT");
-#if !defined(NDEBUG)
 		GET_PROC_ADDRESS(gr->get_query_object_iv,
 				 "glGetQueryObjectivEXT");
-#endif
 		GET_PROC_ADDRESS(gr->get_query_object_ui64v,
 				 "glGetQueryObjectui64vEXT");
+		GET_PROC_ADDRESS(gr->query_counter, "glQueryCounterEXT");
+		GET_PROC_ADDRESS(gr->get_integer64v, "glGetInteger64vEXT");
 		GET_PROC_ADDRESS(get_query_iv, "glGetQueryivEXT");
 		get_query_iv(GL_TIME_ELAPSED_EXT, GL_QUERY_COUNTER_BITS_EXT,
 			     &elapsed_bits);
+		get_query_iv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT,
+			     &timestamp_bits);
 		if (elapsed_bits == 0)
 			gr->gl_extensions &=
 				~EXTENSION_EXT_DISJOINT_TIMER_QUERY;
@@ -5237,6 +5574,17 @@ gl_renderer_setup(struct weston_compositor *ec)
 		gr->features |= FEATURE_ASYNC_READBACK;
 	}
 
+	/* Async upload feature. Unsynchronized mapping of the PBO relies on
+	 * fences to not overwrite anything the GPU may still read. */
+	if (gr->gl_version >= gl_version(3, 0) &&
+	    egl_display_has(gr, EXTENSION_KHR_GET_ALL_PROC_ADDRESSES) &&
+	    egl_display_has(gr, EXTENSION_KHR_FENCE_SYNC)) {
+		if (gl_extensions_has(gr, EXTENSION_EXT_BUFFER_STORAGE))
+			GET_PROC_ADDRESS(gr->buffer_storage,
+					 "glBufferStorageEXT");
+		gr->features |= FEATURE_ASYNC_UPLOAD;
+	}
+
 	/* Texture 3D feature. */
 	if (gr->gl_version >= gl_version(3, 0) &&
 	    egl_display_has(gr, EXTENSION_KHR_GET_ALL_PROC_ADDRESSES)) {
@@ -5263,6 +5611,11 @@ gl_renderer_setup(struct weston_compositor *ec)
 	    gl_extensions_has(gr, EXTENSION_EXT_DISJOINT_TIMER_QUERY))
 		gr->features |= FEATURE_GPU_TIMELINE;
 
+	/* GPU pass timestamps feature. */
+	if (gl_extensions_has(gr, EXTENSION_EXT_DISJOINT_TIMER_QUERY) &&
+	    timestamp_bits > 0)
+		gr->features |= FEATURE_GPU_PASS_TIMESTAMPS;
+
 	/* Texture immutability feature. */
 	if (gr->gl_version >= gl_version(3, 0) &&
 	    egl_display_has(gr, EXTENSION_KHR_GET_ALL_PROC_ADDRESSES)) {
@@ -5278,6 +5631,27 @@ gl_renderer_setup(struct weston_compositor *ec)
 	    gl_extensions_has(gr, EXTENSION_EXT_TEXTURE_RG))
 		gr->features |= FEATURE_TEXTURE_RG;
 
+	/* Program binary feature. */
+	if (gr->gl_version >= gl_version(3, 0) &&
+	    egl_display_has(gr, EXTENSION_KHR_GET_ALL_PROC_ADDRESSES)) {
+		GET_PROC_ADDRESS(gr->get_program_binary, "glGetProgramBinary");
+		GET_PROC_ADDRESS(gr->program_binary, "glProgramBinary");
+		gr->features |= FEATURE_PROGRAM_BINARY;
+	} else if (gl_extensions_has(gr, EXTENSION_OES_GET_PROGRAM_BINARY)) {
+		GET_PROC_ADDRESS(gr->get_program_binary,
+				 "glGetProgramBinaryOES");
+		GET_PROC_ADDRESS(gr->program_binary, "glProgramBinaryOES");
+		gr->features |= FEATURE_PROGRAM_BINARY;
+	}
+	if (gl_features_has(gr, FEATURE_PROGRAM_BINARY)) {
+		GLint n_formats = 0;
+
+		/* Drivers may support the API without any binary format. */
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &n_formats);
+		if (n_formats <= 0)
+			gr->features &= ~FEATURE_PROGRAM_BINARY;
+	}
+
 	/* Sized BGRA renderbuffer feature. */
 	if (gl_has_sized_bgra8_renderbuffer(gr))
 		gr->features |= FEATURE_SIZED_BGRA8_RENDERBUFFER;
@@ -5288,6 +5662,8 @@ gl_renderer_setup(struct weston_compositor *ec)
 
 	glActiveTexture(GL_TEXTURE0);
 
+	gl_program_cache_init(gr);
+
 	gr->fallback_shader = gl_renderer_create_fallback_shader(gr);
 	if (!gr->fallback_shader) {
 		weston_log("Error: compiling fallback shader failed.\n");
@@ -5320,11 +5696,19 @@ gl_renderer_setup(struct weston_compositor *ec)
 			    yesno(gl_extensions_has(gr, EXTENSION_OES_EGL_IMAGE_EXTERNAL)));
 	weston_log_continue(STAMP_SPACE "GPU timeline: %s\n",
 			    yesno(gl_features_has(gr, FEATURE_GPU_TIMELINE)));
+	weston_log_continue(STAMP_SPACE "GPU pass timestamps: %s\n",
+			    yesno(gl_features_has(gr, FEATURE_GPU_PASS_TIMESTAMPS)));
 	weston_log_continue(STAMP_SPACE "Texture immutability: %s\n",
 			    yesno(gl_features_has(gr, FEATURE_TEXTURE_IMMUTABILITY)));
 	weston_log_continue(STAMP_SPACE "Required precision: %s\n",
 			    yesno(gr->gl_version >= gl_version(3, 0) ||
 				  gl_extensions_has(gr, EXTENSION_OES_REQUIRED_INTERNALFORMAT)));
+	weston_log_continue(STAMP_SPACE "wl_shm upload through PBO ring: %s\n",
+			    !gl_features_has(gr, FEATURE_ASYNC_UPLOAD) ? "no" :
+			    gr->buffer_storage ? "yes, persistently mapped" :
+			    "yes");
+	weston_log_continue(STAMP_SPACE "Program binary cache: %s\n",
+			    gr->program_cache.dir ? gr->program_cache.dir : "no");
 
 	return 0;
 }
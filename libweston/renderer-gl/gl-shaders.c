@@ -78,12 +78,13 @@ union gl_shader_color_mapping_uniforms {
 struct gl_shader {
 	struct wl_list link; /* gl_renderer::shader_list */
 	struct timespec last_used;
+	bool used; /* drawn with, not only prewarmed */
 	struct gl_shader_requirements key;
 	GLuint program;
-	GLuint vertex_shader, fragment_shader;
 	GLint proj_uniform;
 	GLint surface_to_buffer_uniform;
 	GLint tex_uniforms[3];
+	GLint tex_batch_uniforms[SHADER_BATCH_TEX_MAX];
 	GLint swizzle_idx[3];
 	GLint swizzle_mask[3];
 	GLint swizzle_sub[3];
@@ -240,7 +241,7 @@ create_shader_description_string(const struct gl_shader_requirements *req)
 	int size;
 	char *str;
 
-	size = asprintf(&str, "%s %s %s %s %s %s %cinput_is_premult %ctint",
+	size = asprintf(&str, "%s %s %s %s %s %s %cinput_is_premult %ctint %cbatched",
 			gl_shader_texcoord_input_to_string(req->texcoord_input),
 			gl_shader_texture_variant_to_string(req->variant),
 			gl_shader_color_effect_to_string(req->color_effect),
@@ -248,7 +249,8 @@ create_shader_description_string(const struct gl_shader_requirements *req)
 			gl_shader_color_mapping_to_string(req->color_mapping),
 			gl_shader_color_curve_to_string(req->color_post_curve),
 			req->input_is_premult ? '+' : '-',
-			req->tint ? '+' : '-');
+			req->tint ? '+' : '-',
+			req->batched ? '+' : '-');
 	if (size < 0)
 		return NULL;
 	return str;
@@ -262,9 +264,11 @@ create_vertex_shader_config_string(const struct gl_shader_requirements *req)
 
 	size = asprintf(&str,
 			"#define DEF_TEXCOORD_INPUT %s\n"
-			"#define DEF_WIREFRAME %s\n",
+			"#define DEF_WIREFRAME %s\n"
+			"#define DEF_BATCHED %s\n",
 			gl_shader_texcoord_input_to_string(req->texcoord_input),
-			req->wireframe ? "true" : "false");
+			req->wireframe ? "true" : "false",
+			req->batched ? "true" : "false");
 
 	if (size < 0)
 		return NULL;
@@ -279,18 +283,22 @@ create_fragment_shader_config_string(const struct gl_shader_requirements *req)
 
 	size = asprintf(&str,
 			"#define MAX_CURVE_PARAMS %zu\n"
+			"#define MAX_BATCH_TEXTURES %d\n"
 			"#define DEF_TINT %s\n"
 			"#define DEF_INPUT_IS_PREMULT %s\n"
 			"#define DEF_WIREFRAME %s\n"
+			"#define DEF_BATCHED %s\n"
 			"#define DEF_COLOR_PRE_CURVE %s\n"
 			"#define DEF_COLOR_MAPPING %s\n"
 			"#define DEF_COLOR_POST_CURVE %s\n"
 			"#define DEF_COLOR_EFFECT %s\n"
 			"#define DEF_VARIANT %s\n",
 			ARRAY_LENGTH(((union weston_color_curve_parametric_chan_data){}).data),
+			SHADER_BATCH_TEX_MAX,
 			req->tint ? "true" : "false",
 			req->input_is_premult ? "true" : "false",
 			req->wireframe ? "true" : "false",
+			req->batched ? "true" : "false",
 			gl_shader_color_curve_to_string(req->color_pre_curve),
 			gl_shader_color_mapping_to_string(req->color_mapping),
 			gl_shader_color_curve_to_string(req->color_post_curve),
@@ -344,67 +352,28 @@ get_curve_uniform_locations(struct gl_renderer *gr,
 	}
 }
 
-static struct gl_shader *
-gl_shader_create(struct gl_renderer *gr,
-		 const struct gl_shader_requirements *requirements)
+/* Compile, attach and link the shaders of a new program */
+static bool
+link_program(struct gl_shader *shader, const char **vertex_sources,
+	     const char **fragment_sources)
 {
-	bool verbose = weston_log_scope_is_enabled(gr->shader_scope);
-	struct gl_shader *shader = NULL;
-	char buffer[512];
+	const struct gl_shader_requirements *requirements = &shader->key;
+	GLuint vs, fs;
+	char msg[512];
 	GLint status;
-	const char *sources[3];
-	char *conf = NULL;
 
-	shader = zalloc(sizeof *shader);
-	if (!shader) {
-		weston_log("could not create shader\n");
-		goto error_vertex;
-	}
-
-	wl_list_init(&shader->link);
-	shader->key = *requirements;
-
-	if (verbose) {
-		char *desc;
+	vs = compile_shader(GL_VERTEX_SHADER, 2, vertex_sources);
+	if (vs == GL_NONE)
+		return false;
 
-		desc = create_shader_description_string(requirements);
-		weston_log_scope_printf(gr->shader_scope,
-					"Compiling shader program for: %s\n",
-					desc);
-		free(desc);
+	fs = compile_shader(GL_FRAGMENT_SHADER, 3, fragment_sources);
+	if (fs == GL_NONE) {
+		glDeleteShader(vs);
+		return false;
 	}
 
-	conf = create_vertex_shader_config_string(&shader->key);
-	if (!conf)
-		goto error_vertex;
-
-	sources[0] = conf;
-	sources[1] = vertex_shader;
-	shader->vertex_shader = compile_shader(GL_VERTEX_SHADER, 2, sources);
-	if (shader->vertex_shader == GL_NONE)
-		goto error_vertex;
-
-	free(conf);
-	conf = create_fragment_shader_config_string(&shader->key);
-	if (!conf)
-		goto error_fragment;
-
-	sprintf(buffer,
-		"#version 100\n"
-		"#define GLES_API_MAJOR_VERSION %d\n",
-		gr->gl_version >= gl_version(3, 0) ? 3 : 2);
-
-	sources[0] = buffer;
-	sources[1] = conf;
-	sources[2] = fragment_shader;
-	shader->fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
-						 3, sources);
-	if (shader->fragment_shader == GL_NONE)
-		goto error_fragment;
-
-	shader->program = glCreateProgram();
-	glAttachShader(shader->program, shader->vertex_shader);
-	glAttachShader(shader->program, shader->fragment_shader);
+	glAttachShader(shader->program, vs);
+	glAttachShader(shader->program, fs);
 
 	glBindAttribLocation(shader->program, SHADER_ATTRIB_LOC_POSITION,
 			     "position");
@@ -415,18 +384,96 @@ gl_shader_create(struct gl_renderer *gr,
 		glBindAttribLocation(shader->program,
 				     SHADER_ATTRIB_LOC_BARYCENTRIC,
 				     "barycentric");
+	if (requirements->batched)
+		glBindAttribLocation(shader->program,
+				     SHADER_ATTRIB_LOC_BATCH, "batch");
 
 	glLinkProgram(shader->program);
+
+	/* Attached shaders go away with the program. */
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
 	glGetProgramiv(shader->program, GL_LINK_STATUS, &status);
 	if (!status) {
-		glGetProgramInfoLog(shader->program, sizeof buffer, NULL,
-				    buffer);
-		weston_log("link info: %s\n", buffer);
-		goto error_link;
+		glGetProgramInfoLog(shader->program, sizeof msg, NULL, msg);
+		weston_log("link info: %s\n", msg);
+		return false;
+	}
+
+	return true;
+}
+
+static struct gl_shader *
+gl_shader_create(struct gl_renderer *gr,
+		 const struct gl_shader_requirements *requirements)
+{
+	bool verbose = weston_log_scope_is_enabled(gr->shader_scope);
+	struct gl_shader *shader = NULL;
+	char version[128];
+	const char *vertex_sources[2];
+	const char *fragment_sources[3];
+	char *vertex_conf = NULL;
+	char *fragment_conf = NULL;
+	uint64_t source_hash = GL_PROGRAM_CACHE_HASH_INIT;
+	char *desc = NULL;
+	char name[32];
+	unsigned i;
+
+	shader = zalloc(sizeof *shader);
+	if (!shader) {
+		weston_log("could not create shader\n");
+		goto error;
 	}
 
-	glDeleteShader(shader->vertex_shader);
-	glDeleteShader(shader->fragment_shader);
+	wl_list_init(&shader->link);
+	shader->key = *requirements;
+
+	vertex_conf = create_vertex_shader_config_string(&shader->key);
+	fragment_conf = create_fragment_shader_config_string(&shader->key);
+	if (!vertex_conf || !fragment_conf)
+		goto error;
+
+	snprintf(version, sizeof version,
+		 "#version 100\n"
+		 "#define GLES_API_MAJOR_VERSION %d\n",
+		 gr->gl_version >= gl_version(3, 0) ? 3 : 2);
+
+	vertex_sources[0] = vertex_conf;
+	vertex_sources[1] = vertex_shader;
+	fragment_sources[0] = version;
+	fragment_sources[1] = fragment_conf;
+	fragment_sources[2] = fragment_shader;
+
+	for (i = 0; i < ARRAY_LENGTH(vertex_sources); i++)
+		source_hash = gl_program_cache_hash(source_hash,
+						    vertex_sources[i]);
+	for (i = 0; i < ARRAY_LENGTH(fragment_sources); i++)
+		source_hash = gl_program_cache_hash(source_hash,
+						    fragment_sources[i]);
+
+	if (verbose)
+		desc = create_shader_description_string(requirements);
+
+	shader->program = gl_program_cache_load(gr, requirements, source_hash);
+	if (shader->program != GL_NONE) {
+		if (verbose)
+			weston_log_scope_printf(gr->shader_scope,
+						"Loaded cached shader program for: %s\n",
+						desc);
+	} else {
+		if (verbose)
+			weston_log_scope_printf(gr->shader_scope,
+						"Compiling shader program for: %s\n",
+						desc);
+
+		shader->program = glCreateProgram();
+		if (!link_program(shader, vertex_sources, fragment_sources))
+			goto error_link;
+
+		gl_program_cache_store(gr, requirements, source_hash,
+				       shader->program);
+	}
 
 	shader->proj_uniform = glGetUniformLocation(shader->program, "proj");
 	shader->surface_to_buffer_uniform =
@@ -437,6 +484,13 @@ gl_shader_create(struct gl_renderer *gr,
 	if (requirements->wireframe)
 		shader->tex_uniform_wireframe =
 			glGetUniformLocation(shader->program, "tex_wireframe");
+	if (requirements->batched) {
+		for (i = 0; i < SHADER_BATCH_TEX_MAX; i++) {
+			snprintf(name, sizeof name, "tex_batch[%u]", i);
+			shader->tex_batch_uniforms[i] =
+				glGetUniformLocation(shader->program, name);
+		}
+	}
 	if (gr->gl_version < gl_version(3, 0)) {
 		shader->swizzle_idx[0] = glGetUniformLocation(shader->program, "swizzle_idx[0]");
 		shader->swizzle_idx[1] = glGetUniformLocation(shader->program, "swizzle_idx[1]");
@@ -504,7 +558,9 @@ gl_shader_create(struct gl_renderer *gr,
 	shader->yuv_offsets_uniform = glGetUniformLocation(shader->program,
 							   "yuv_offsets");
 
-	free(conf);
+	free(desc);
+	free(fragment_conf);
+	free(vertex_conf);
 
 	wl_list_insert(&gr->shader_list, &shader->link);
 
@@ -512,13 +568,11 @@ gl_shader_create(struct gl_renderer *gr,
 
 error_link:
 	glDeleteProgram(shader->program);
-	glDeleteShader(shader->fragment_shader);
-
-error_fragment:
-	glDeleteShader(shader->vertex_shader);
 
-error_vertex:
-	free(conf);
+error:
+	free(desc);
+	free(fragment_conf);
+	free(vertex_conf);
 	free(shader);
 	return NULL;
 }
@@ -536,6 +590,9 @@ gl_shader_destroy(struct gl_renderer *gr, struct gl_shader *shader)
 		free(desc);
 	}
 
+	if (shader->used)
+		gl_program_cache_mark_used(gr, &shader->key);
+
 	glDeleteProgram(shader->program);
 	wl_list_remove(&shader->link);
 	free(shader);
@@ -632,6 +689,20 @@ gl_renderer_create_fallback_shader(struct gl_renderer *gr)
 	return shader;
 }
 
+static struct gl_shader *
+gl_renderer_find_program(struct gl_renderer *gr,
+			 const struct gl_shader_requirements *requirements)
+{
+	struct gl_shader *shader;
+
+	wl_list_for_each(shader, &gr->shader_list, link) {
+		if (gl_shader_requirements_cmp(requirements, &shader->key) == 0)
+			return shader;
+	}
+
+	return NULL;
+}
+
 static struct gl_shader *
 gl_renderer_get_program(struct gl_renderer *gr,
 			const struct gl_shader_requirements *requirements)
@@ -645,10 +716,9 @@ gl_renderer_get_program(struct gl_renderer *gr,
 	    gl_shader_requirements_cmp(&reqs, &gr->current_shader->key) == 0)
 		return gr->current_shader;
 
-	wl_list_for_each(shader, &gr->shader_list, link) {
-		if (gl_shader_requirements_cmp(&reqs, &shader->key) == 0)
-			return shader;
-	}
+	shader = gl_renderer_find_program(gr, &reqs);
+	if (shader)
+		return shader;
 
 	shader = gl_shader_create(gr, &reqs);
 	if (shader)
@@ -657,6 +727,41 @@ gl_renderer_get_program(struct gl_renderer *gr,
 	return NULL;
 }
 
+/** Create the programs the previous session used, ahead of their first use
+ *
+ * Called at the first repaint, so that they survive garbage collection for
+ * as long as freshly used programs do.
+ */
+void
+gl_renderer_prewarm_programs(struct gl_renderer *gr)
+{
+	struct gl_shader_requirements reqs;
+	struct gl_shader *shader;
+	unsigned count = 0;
+	uint32_t *key;
+
+	gr->program_cache.prewarm_pending = false;
+
+	wl_array_for_each(key, &gr->program_cache.prev_used) {
+		memcpy(&reqs, key, sizeof reqs);
+		if (reqs.pad_bits_ != 0)
+			continue;
+
+		if (gl_renderer_find_program(gr, &reqs))
+			continue;
+
+		shader = gl_shader_create(gr, &reqs);
+		if (!shader)
+			continue;
+
+		shader->last_used = gr->compositor->last_repaint_start;
+		count++;
+	}
+
+	weston_log_scope_printf(gr->shader_scope,
+				"Prewarmed %u shader programs.\n", count);
+}
+
 void
 gl_renderer_garbage_collect_programs(struct gl_renderer *gr)
 {
@@ -810,6 +915,7 @@ gl_shader_load_config(struct gl_renderer *gr,
 	int swizzle_idx[4];
 	float swizzle_mask[4];
 	float swizzle_sub[4];
+	GLint tex_uniform;
 	int i, j;
 
 	glUniformMatrix4fv(shader->proj_uniform,
@@ -826,14 +932,18 @@ gl_shader_load_config(struct gl_renderer *gr,
 
 	glUniform1f(shader->view_alpha_uniform, sconf->view_alpha);
 
-	assert(sconf->input_num <= SHADER_INPUT_TEX_MAX);
+	assert(sconf->input_num <= (sconf->req.batched ?
+				    SHADER_BATCH_TEX_MAX : SHADER_INPUT_TEX_MAX));
 	for (i = 0; i < sconf->input_num; i++) {
-		assert(shader->tex_uniforms[i] != -1);
+		tex_uniform = sconf->req.batched ? shader->tex_batch_uniforms[i] :
+						   shader->tex_uniforms[i];
+		assert(tex_uniform != -1);
 
 		/* If the OpenGL ES implementation lacks swizzles as texture
 		 * parameters (OpenGL ES 2), the fragment shader loads swizzling
-		 * info from uniforms. */
+		 * info from uniforms. Batched draws need texture swizzles. */
 		if (gr->gl_version < gl_version(3, 0)) {
+			assert(!sconf->req.batched);
 			swizzles = sconf->input_param[i].swizzles.array;
 			for (j = 0; j < 4; j++) {
 				swizzle_idx[j] = swizzles[j] - GL_RED;
@@ -855,7 +965,7 @@ gl_shader_load_config(struct gl_renderer *gr,
 			glUniform4fv(shader->swizzle_sub[i], 1, swizzle_sub);
 		}
 
-		glUniform1i(shader->tex_uniforms[i], TEX_UNIT_IMAGES + i);
+		glUniform1i(tex_uniform, TEX_UNIT_IMAGES + i);
 		glActiveTexture(GL_TEXTURE0 + TEX_UNIT_IMAGES + i);
 		glBindTexture(sconf->input_param[i].target,
 			      sconf->input_tex[i]);
@@ -919,6 +1029,7 @@ gl_renderer_use_program(struct gl_renderer *gr,
 		wl_list_insert(&gr->shader_list, &shader->link);
 	}
 	shader->last_used = gr->compositor->last_repaint_start;
+	shader->used = true;
 
 	if (gr->current_shader != shader) {
 		glUseProgram(shader->program);
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Streaming ring of pixel unpack buffer memory for wl_shm uploads
+ *
+ * glTexSubImage2D() straight from client memory makes the driver copy the
+ * pixels before returning, and wait for the GPU if the texture is still in
+ * use. Instead, the damage is copied into a range of a pixel unpack buffer
+ * (PBO) and the texture upload is queued from there, for the GPU to do
+ * whenever it gets to it. The wl_shm buffer is done with as soon as the copy
+ * into the PBO is.
+ *
+ * Ranges are handed out in order, wrapping around at the end of the PBO. An
+ * EGL fence is inserted after the uploads reading each range, and the range
+ * is only reused once its fence has signalled. When the ring is full, the
+ * caller falls back to uploading from client memory.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+
+#include "gl-renderer.h"
+#include "gl-renderer-internal.h"
+#include "shared/helpers.h"
+
+#define UPLOAD_RING_MIN_SIZE (8 * 1024 * 1024)
+#define UPLOAD_RING_MAX_SIZE (128 * 1024 * 1024)
+
+/* Generous for any texel size and for GL_UNPACK_ALIGNMENT */
+#define UPLOAD_RING_ALIGNMENT 64
+
+struct gl_upload_fence {
+	EGLSyncKHR sync;
+	size_t end;
+};
+
+/* Forget the ranges the GPU is done reading, oldest first. */
+static void
+upload_ring_retire(struct gl_renderer *gr)
+{
+	struct gl_upload_fence *fences = gr->upload_ring.fences.data;
+	size_t count = gr->upload_ring.fences.size / sizeof *fences;
+	size_t done = 0;
+	EGLint ret;
+
+	while (done < count) {
+		ret = gr->client_wait_sync(gr->egl_display, fences[done].sync,
+					   EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0);
+		if (ret != EGL_CONDITION_SATISFIED_KHR)
+			break;
+
+		gr->destroy_sync(gr->egl_display, fences[done].sync);
+		gr->upload_ring.tail = fences[done].end;
+		done++;
+	}
+
+	if (done == 0)
+		return;
+
+	memmove(fences, fences + done, (count - done) * sizeof *fences);
+	gr->upload_ring.fences.size -= done * sizeof *fences;
+
+	/* Start over from the beginning when idle, to keep ranges whole. */
+	if (done == count)
+		gr->upload_ring.head = gr->upload_ring.tail = 0;
+}
+
+static void
+upload_ring_destroy_pbo(struct gl_renderer *gr)
+{
+	if (gr->upload_ring.pbo == 0)
+		return;
+
+	if (gr->upload_ring.map) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gr->upload_ring.pbo);
+		gr->unmap_buffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	glDeleteBuffers(1, &gr->upload_ring.pbo);
+	gr->upload_ring.pbo = 0;
+	gr->upload_ring.map = NULL;
+	gr->upload_ring.size = 0;
+	gr->upload_ring.head = gr->upload_ring.tail = 0;
+}
+
+/* (Re)create the PBO to hold at least 'size' bytes. Leaves it bound. */
+static bool
+upload_ring_create_pbo(struct gl_renderer *gr, size_t size)
+{
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT |
+			   GL_MAP_COHERENT_BIT_EXT;
+	size_t new_size = UPLOAD_RING_MIN_SIZE;
+
+	while (new_size < size)
+		new_size *= 2;
+	if (new_size > UPLOAD_RING_MAX_SIZE)
+		return false;
+
+	upload_ring_destroy_pbo(gr);
+
+	glGenBuffers(1, &gr->upload_ring.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gr->upload_ring.pbo);
+
+	if (gr->buffer_storage) {
+		gr->buffer_storage(GL_PIXEL_UNPACK_BUFFER, new_size, NULL,
+				   flags);
+		gr->upload_ring.map =
+			gr->map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0,
+					     new_size, flags);
+		if (!gr->upload_ring.map) {
+			weston_log("Failed to map the upload ring "
+				   "persistently.\n");
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &gr->upload_ring.pbo);
+			gr->upload_ring.pbo = 0;
+			return false;
+		}
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, new_size, NULL,
+			     GL_STREAM_DRAW);
+	}
+
+	gr->upload_ring.size = new_size;
+
+	return true;
+}
+
+/* Find room for 'size' bytes in the ring. Binds the PBO on success. */
+static bool
+upload_ring_reserve(struct gl_renderer *gr, size_t size, size_t *offset)
+{
+	size_t head, tail;
+
+	upload_ring_retire(gr);
+
+	if (gr->upload_ring.fences.size == 0) {
+		gr->upload_ring.head = gr->upload_ring.tail = 0;
+
+		if (size > gr->upload_ring.size &&
+		    !upload_ring_create_pbo(gr, size))
+			return false;
+
+		*offset = 0;
+		goto reserved;
+	}
+
+	/* Bytes in flight are [tail, head), possibly wrapping around. Ranges
+	 * never end right at the tail, so head == tail only when idle. */
+	head = ROUND_UP_N(gr->upload_ring.head, UPLOAD_RING_ALIGNMENT);
+	tail = gr->upload_ring.tail;
+
+	if (gr->upload_ring.head > tail) {
+		if (head < gr->upload_ring.size &&
+		    gr->upload_ring.size - head >= size)
+			*offset = head;
+		else if (tail > size)
+			*offset = 0;
+		else
+			return false;
+	} else if (head < tail && tail - head > size) {
+		*offset = head;
+	} else {
+		return false;
+	}
+
+reserved:
+	gr->upload_ring.pending = *offset + size;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gr->upload_ring.pbo);
+
+	return true;
+}
+
+/** Get ring memory to copy pixels into
+ *
+ * \param gr The renderer.
+ * \param size Number of bytes needed.
+ * \param offset Set to the offset of the returned memory into the PBO.
+ * \return The memory to write, or NULL if the ring has no room.
+ *
+ * On success, the PBO is left bound to GL_PIXEL_UNPACK_BUFFER. Call
+ * gl_upload_ring_unmap() once done writing, then upload textures with the
+ * offsets into the PBO in place of pointers, then call gl_upload_ring_end().
+ */
+void *
+gl_upload_ring_begin(struct gl_renderer *gr, size_t size, size_t *offset)
+{
+	void *map;
+
+	if (!gl_features_has(gr, FEATURE_ASYNC_UPLOAD))
+		return NULL;
+
+	if (!upload_ring_reserve(gr, size, offset))
+		return NULL;
+
+	if (gr->upload_ring.map)
+		return gr->upload_ring.map + *offset;
+
+	/* The fences make sure the GPU no longer reads that range. */
+	map = gr->map_buffer_range(GL_PIXEL_UNPACK_BUFFER, *offset, size,
+				   GL_MAP_WRITE_BIT |
+				   GL_MAP_INVALIDATE_RANGE_BIT |
+				   GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!map)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return map;
+}
+
+/** Make the memory from gl_upload_ring_begin() available to GL */
+void
+gl_upload_ring_unmap(struct gl_renderer *gr)
+{
+	if (!gr->upload_ring.map)
+		gr->unmap_buffer(GL_PIXEL_UNPACK_BUFFER);
+}
+
+/** Guard the range from gl_upload_ring_begin() until uploads are done
+ *
+ * Unbinds the PBO.
+ */
+void
+gl_upload_ring_end(struct gl_renderer *gr)
+{
+	struct gl_upload_fence *fence;
+	EGLSyncKHR sync;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	sync = gr->create_sync(gr->egl_display, EGL_SYNC_FENCE_KHR, NULL);
+	fence = sync != EGL_NO_SYNC_KHR ?
+		wl_array_add(&gr->upload_ring.fences, sizeof *fence) : NULL;
+	if (!fence) {
+		if (sync != EGL_NO_SYNC_KHR)
+			gr->destroy_sync(gr->egl_display, sync);
+
+		/* Nothing to wait on later, so wait right away. */
+		glFinish();
+		upload_ring_retire(gr);
+		if (gr->upload_ring.fences.size == 0)
+			gr->upload_ring.head = gr->upload_ring.tail = 0;
+		return;
+	}
+
+	fence->sync = sync;
+	fence->end = gr->upload_ring.pending;
+	gr->upload_ring.head = gr->upload_ring.pending;
+}
+
+void
+gl_upload_ring_fini(struct gl_renderer *gr)
+{
+	struct gl_upload_fence *fence;
+
+	wl_array_for_each(fence, &gr->upload_ring.fences)
+		gr->destroy_sync(gr->egl_display, fence->sync);
+	wl_array_release(&gr->upload_ring.fences);
+
+	upload_ring_destroy_pbo(gr);
+}
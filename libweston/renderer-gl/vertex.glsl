@@ -47,13 +47,16 @@ uniform mat4 surface_to_buffer;
 attribute vec2 position;
 attribute vec2 texcoord;
 attribute vec4 barycentric;
+attribute vec2 batch;
 
 /* Match the varying precision to the fragment shader */
 varying FRAG_PRECISION vec2 v_texcoord;
 varying FRAG_PRECISION vec3 v_barycentric;
+varying FRAG_PRECISION vec2 v_batch;
 
 compile_const int c_texcoord_input = DEF_TEXCOORD_INPUT;
 compile_const bool c_wireframe = DEF_WIREFRAME;
+compile_const bool c_batched = DEF_BATCHED;
 
 void main()
 {
@@ -66,4 +69,8 @@ void main()
 
 	if (c_wireframe)
 		v_barycentric = barycentric.xyz;
+
+	/* Texture slot and view alpha of batched draws */
+	if (c_batched)
+		v_batch = batch;
 }
@@ -0,0 +1,535 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * On-disk VkPipelineCache of the Vulkan renderer
+ *
+ * The pipeline cache data of a device is kept in vk-<device hash>.bin in the
+ * compositor's renderer cache directory, the hash covering the vendor and
+ * device IDs, the driver version and the pipeline cache UUID. The file header
+ * repeats them along with a hash of the data, and the data must start with a
+ * VkPipelineCacheHeaderVersionOne matching the device: anything else is
+ * ignored and the cache starts out empty.
+ *
+ * Pipelines are tied to a render pass, which can't be saved. The pipelines
+ * drawn with in a session are listed in vk-<device hash>.used with their
+ * requirement bits and the attachment format and layout of their render
+ * pass, so that the next session can create them all as soon as it has a
+ * compatible render pass.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan-renderer.h"
+#include "vulkan-renderer-internal.h"
+#include "shared/file-util.h"
+#include "shared/string-helpers.h"
+#include "shared/xalloc.h"
+#include "libweston/weston-log.h"
+
+#define PIPELINE_CACHE_MAGIC 0x43505657 /* "WVPC" */
+/* Bump whenever the shaders or the pipeline state change in ways the driver
+ * can't see, or the meaning of the requirement bits changes. */
+#define PIPELINE_CACHE_VERSION 1
+
+/* Anything bigger is not pipeline cache data */
+#define PIPELINE_CACHE_MAX_FILE_SIZE (64 * 1024 * 1024)
+
+/* Caches of other devices and drivers are removed once unused for this long */
+#define PIPELINE_CACHE_STALE_SECONDS (30 * 24 * 60 * 60)
+
+#define HASH_INIT 0xcbf29ce484222325ull
+
+struct pipeline_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint32_t driver_version;
+	uint8_t uuid[VK_UUID_SIZE];
+	uint32_t data_length;
+	uint64_t data_hash;
+};
+
+struct pipeline_cache_renderpass {
+	VkRenderPass renderpass;
+	VkFormat format;
+	VkImageLayout layout;
+};
+
+struct pipeline_cache_entry {
+	uint32_t bits;
+	VkFormat format;
+	VkImageLayout layout;
+};
+
+/* FNV-1a */
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static uint32_t
+requirements_to_bits(const struct vulkan_pipeline_requirements *req)
+{
+	return req->texcoord_input |
+	       req->variant << 1 |
+	       req->input_is_premult << 5 |
+	       req->blend << 6 |
+	       req->green_tint << 7;
+}
+
+static void
+bits_to_requirements(struct vulkan_pipeline_requirements *req, uint32_t bits,
+		     VkRenderPass renderpass)
+{
+	/* Pipelines are looked up with memcmp(), padding included. */
+	memset(req, 0, sizeof *req);
+	req->texcoord_input = bits & 1;
+	req->variant = (bits >> 1) & 0xf;
+	req->input_is_premult = (bits >> 5) & 1;
+	req->blend = (bits >> 6) & 1;
+	req->green_tint = (bits >> 7) & 1;
+	req->renderpass = renderpass;
+}
+
+static char *
+cache_path(struct vulkan_renderer *vr, const char *suffix)
+{
+	char *path = NULL;
+
+	str_printf(&path, "%s/vk-%016" PRIx64 ".%s", vr->pipeline_cache.dir,
+		   vr->pipeline_cache.device_hash, suffix);
+
+	return path;
+}
+
+/* Concurrent readers see either the old file or the complete new one. */
+static void
+replace_file(struct vulkan_renderer *vr, const char *path,
+	     const void *head, size_t head_size,
+	     const void *body, size_t body_size)
+{
+	char *tmp_template = NULL;
+
+	str_printf(&tmp_template, "%s/vk-tmp-XXXXXX", vr->pipeline_cache.dir);
+	if (!tmp_template)
+		return;
+
+	file_replace(path, tmp_template, head, head_size, body, body_size);
+	free(tmp_template);
+}
+
+/* Other devices' and drivers' caches would otherwise pile up with every
+ * update. */
+static void
+prune_stale_files(struct vulkan_renderer *vr)
+{
+	char own_prefix[32];
+	struct dirent *de;
+	struct stat st;
+	time_t now = time(NULL);
+	DIR *dir;
+
+	snprintf(own_prefix, sizeof own_prefix, "vk-%016" PRIx64,
+		 vr->pipeline_cache.device_hash);
+
+	dir = opendir(vr->pipeline_cache.dir);
+	if (!dir)
+		return;
+
+	while ((de = readdir(dir))) {
+		if (strncmp(de->d_name, "vk-", 3) != 0 ||
+		    strncmp(de->d_name, own_prefix, strlen(own_prefix)) == 0)
+			continue;
+
+		if (fstatat(dirfd(dir), de->d_name, &st,
+			    AT_SYMLINK_NOFOLLOW) < 0 ||
+		    !S_ISREG(st.st_mode) ||
+		    now - st.st_mtime < PIPELINE_CACHE_STALE_SECONDS)
+			continue;
+
+		unlinkat(dirfd(dir), de->d_name, 0);
+	}
+
+	closedir(dir);
+}
+
+static void
+header_init(struct pipeline_cache_header *header,
+	    const VkPhysicalDeviceProperties *props)
+{
+	*header = (struct pipeline_cache_header) {
+		.magic = PIPELINE_CACHE_MAGIC,
+		.version = PIPELINE_CACHE_VERSION,
+		.vendor_id = props->vendorID,
+		.device_id = props->deviceID,
+		.driver_version = props->driverVersion,
+	};
+	memcpy(header->uuid, props->pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+/* Returns the cache data in the file if it fits the device, or NULL. */
+static const void *
+check_cache_data(const char *data, size_t size,
+		 const struct pipeline_cache_header *expected,
+		 size_t *data_size)
+{
+	struct pipeline_cache_header header;
+	VkPipelineCacheHeaderVersionOne vk_header;
+	const char *cache_data = data + sizeof header;
+
+	if (size < sizeof header + sizeof vk_header)
+		return NULL;
+
+	memcpy(&header, data, sizeof header);
+	if (header.magic != expected->magic ||
+	    header.version != expected->version ||
+	    header.vendor_id != expected->vendor_id ||
+	    header.device_id != expected->device_id ||
+	    header.driver_version != expected->driver_version ||
+	    memcmp(header.uuid, expected->uuid, VK_UUID_SIZE) != 0 ||
+	    header.data_length != size - sizeof header ||
+	    header.data_hash != hash_bytes(HASH_INIT, cache_data,
+					   header.data_length))
+		return NULL;
+
+	memcpy(&vk_header, cache_data, sizeof vk_header);
+	if (vk_header.headerSize < sizeof vk_header ||
+	    vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+	    vk_header.vendorID != expected->vendor_id ||
+	    vk_header.deviceID != expected->device_id ||
+	    memcmp(vk_header.pipelineCacheUUID, expected->uuid,
+		   VK_UUID_SIZE) != 0)
+		return NULL;
+
+	*data_size = header.data_length;
+
+	return cache_data;
+}
+
+static void
+read_used_list(struct vulkan_renderer *vr)
+{
+	char *path = cache_path(vr, "used");
+	struct pipeline_cache_entry *entry;
+	unsigned int bits, format, layout;
+	char *data, *p;
+	size_t size;
+	int n;
+
+	data = path ? file_read_all(path, PIPELINE_CACHE_MAX_FILE_SIZE, &size) : NULL;
+	free(path);
+	if (!data)
+		return;
+
+	for (p = data;
+	     sscanf(p, "%x %u %u\n%n", &bits, &format, &layout, &n) == 3;
+	     p += n) {
+		entry = wl_array_add(&vr->pipeline_cache.prev_used,
+				     sizeof *entry);
+		if (!entry)
+			break;
+		entry->bits = bits;
+		entry->format = format;
+		entry->layout = layout;
+	}
+
+	free(data);
+}
+
+static void
+write_used_list(struct vulkan_renderer *vr)
+{
+	char *path = cache_path(vr, "used");
+	struct pipeline_cache_entry *entry;
+	char *list = NULL;
+	size_t size = 0;
+	FILE *fp;
+
+	if (!path)
+		return;
+
+	fp = open_memstream(&list, &size);
+	if (fp) {
+		wl_array_for_each(entry, &vr->pipeline_cache.used)
+			fprintf(fp, "%02" PRIx32 " %u %u\n", entry->bits,
+				(unsigned) entry->format,
+				(unsigned) entry->layout);
+		if (fclose(fp) == 0)
+			replace_file(vr, path, list, size, NULL, 0);
+	}
+
+	free(list);
+	free(path);
+}
+
+static void
+write_cache_data(struct vulkan_renderer *vr)
+{
+	struct pipeline_cache_header header;
+	VkPhysicalDeviceProperties props;
+	size_t size = 0;
+	void *data;
+	char *path;
+	VkResult result;
+
+	result = vkGetPipelineCacheData(vr->dev, vr->pipeline_cache.cache,
+					&size, NULL);
+	if (result != VK_SUCCESS || size == 0 ||
+	    size > PIPELINE_CACHE_MAX_FILE_SIZE - sizeof header)
+		return;
+
+	data = xmalloc(size);
+	result = vkGetPipelineCacheData(vr->dev, vr->pipeline_cache.cache,
+					&size, data);
+	if (result != VK_SUCCESS)
+		goto out;
+
+	vkGetPhysicalDeviceProperties(vr->phys_dev, &props);
+	header_init(&header, &props);
+	header.data_length = size;
+	header.data_hash = hash_bytes(HASH_INIT, data, size);
+
+	path = cache_path(vr, "bin");
+	if (path)
+		replace_file(vr, path, &header, sizeof header, data, size);
+	free(path);
+
+out:
+	free(data);
+}
+
+/** Create the pipeline cache, filled from disk when possible
+ *
+ * Must be called once the device is created. The cache is only kept in
+ * memory if the compositor has no cache directory.
+ */
+void
+vulkan_pipeline_cache_init(struct vulkan_renderer *vr)
+{
+	const char *dir = vr->compositor->renderer_cache_dir;
+	struct pipeline_cache_header expected;
+	VkPhysicalDeviceProperties props;
+	const void *initial_data = NULL;
+	size_t initial_size = 0;
+	char *path, *data = NULL;
+	size_t size;
+	VkResult result;
+
+	wl_array_init(&vr->pipeline_cache.renderpasses);
+	wl_array_init(&vr->pipeline_cache.prev_used);
+	wl_array_init(&vr->pipeline_cache.used);
+
+	vkGetPhysicalDeviceProperties(vr->phys_dev, &props);
+	header_init(&expected, &props);
+
+	if (dir && file_make_directory(dir) < 0) {
+		weston_log("Failed to create renderer cache directory %s: %s\n",
+			   dir, strerror(errno));
+	} else if (dir) {
+		vr->pipeline_cache.dir = xstrdup(dir);
+		vr->pipeline_cache.device_hash =
+			hash_bytes(HASH_INIT, &expected, sizeof expected);
+		vr->pipeline_cache.prewarm =
+			vr->compositor->renderer_cache_prewarm;
+
+		path = cache_path(vr, "bin");
+		if (path)
+			data = file_read_all(path, PIPELINE_CACHE_MAX_FILE_SIZE, &size);
+		if (data)
+			initial_data = check_cache_data(data, size, &expected,
+							&initial_size);
+		free(path);
+
+		read_used_list(vr);
+		prune_stale_files(vr);
+	}
+
+	const VkPipelineCacheCreateInfo create_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = initial_data ? initial_size : 0,
+		.pInitialData = initial_data,
+	};
+	result = vkCreatePipelineCache(vr->dev, &create_info, NULL,
+				       &vr->pipeline_cache.cache);
+	if (result != VK_SUCCESS && initial_data) {
+		/* The driver may still refuse what it made itself. */
+		const VkPipelineCacheCreateInfo empty_info = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		};
+		initial_data = NULL;
+		result = vkCreatePipelineCache(vr->dev, &empty_info, NULL,
+					       &vr->pipeline_cache.cache);
+	}
+	check_vk_success(result, "vkCreatePipelineCache");
+
+	if (vr->pipeline_cache.dir)
+		weston_log("Vulkan pipeline cache: %zu bytes loaded from %s\n",
+			   initial_data ? initial_size : 0, dir);
+
+	free(data);
+}
+
+/** Save the pipeline cache and the pipelines used, then destroy the cache
+ *
+ * Must be called before the device is destroyed.
+ */
+void
+vulkan_pipeline_cache_fini(struct vulkan_renderer *vr)
+{
+	if (vr->pipeline_cache.dir && vr->pipeline_cache.dirty)
+		write_cache_data(vr);
+	if (vr->pipeline_cache.dir && vr->pipeline_cache.used.size > 0)
+		write_used_list(vr);
+
+	vkDestroyPipelineCache(vr->dev, vr->pipeline_cache.cache, NULL);
+	vr->pipeline_cache.cache = VK_NULL_HANDLE;
+
+	wl_array_release(&vr->pipeline_cache.renderpasses);
+	wl_array_release(&vr->pipeline_cache.prev_used);
+	wl_array_release(&vr->pipeline_cache.used);
+	free(vr->pipeline_cache.dir);
+	vr->pipeline_cache.dir = NULL;
+}
+
+/** Make a render pass known to the cache, creating the pipelines the
+ * previous session used with a compatible one if prewarming
+ *
+ * \param vr The renderer.
+ * \param renderpass The render pass.
+ * \param format The format of its only attachment.
+ * \param layout The layout of its only attachment.
+ */
+void
+vulkan_pipeline_cache_add_renderpass(struct vulkan_renderer *vr,
+				     VkRenderPass renderpass,
+				     VkFormat format, VkImageLayout layout)
+{
+	struct pipeline_cache_renderpass *rp;
+	struct pipeline_cache_entry *entry;
+	struct vulkan_pipeline_requirements req;
+
+	rp = wl_array_add(&vr->pipeline_cache.renderpasses, sizeof *rp);
+	if (rp) {
+		rp->renderpass = renderpass;
+		rp->format = format;
+		rp->layout = layout;
+	}
+
+	if (!vr->pipeline_cache.prewarm)
+		return;
+
+	wl_array_for_each(entry, &vr->pipeline_cache.prev_used) {
+		if (entry->format != format || entry->layout != layout)
+			continue;
+
+		bits_to_requirements(&req, entry->bits, renderpass);
+		vulkan_renderer_prewarm_pipeline(vr, &req);
+	}
+}
+
+void
+vulkan_pipeline_cache_remove_renderpass(struct vulkan_renderer *vr,
+					VkRenderPass renderpass)
+{
+	struct pipeline_cache_renderpass *rp, *last;
+
+	last = (struct pipeline_cache_renderpass *)
+		((char *) vr->pipeline_cache.renderpasses.data +
+		 vr->pipeline_cache.renderpasses.size) - 1;
+
+	wl_array_for_each(rp, &vr->pipeline_cache.renderpasses) {
+		if (rp->renderpass != renderpass)
+			continue;
+
+		*rp = *last;
+		vr->pipeline_cache.renderpasses.size -= sizeof *rp;
+		return;
+	}
+}
+
+/** Record the creation of a pipeline, so that the cache gets saved */
+void
+vulkan_pipeline_cache_mark_created(struct vulkan_renderer *vr)
+{
+	vr->pipeline_cache.dirty = true;
+}
+
+/** Record a pipeline drawn with, for prewarming the next session */
+void
+vulkan_pipeline_cache_mark_used(struct vulkan_renderer *vr,
+				const struct vulkan_pipeline_requirements *req)
+{
+	struct pipeline_cache_renderpass *rp;
+	struct pipeline_cache_entry *entry;
+	uint32_t bits = requirements_to_bits(req);
+
+	if (!vr->pipeline_cache.dir)
+		return;
+
+	wl_array_for_each(rp, &vr->pipeline_cache.renderpasses) {
+		if (rp->renderpass == req->renderpass)
+			break;
+	}
+	if ((char *) rp >= (char *) vr->pipeline_cache.renderpasses.data +
+			   vr->pipeline_cache.renderpasses.size)
+		return;
+
+	wl_array_for_each(entry, &vr->pipeline_cache.used) {
+		if (entry->bits == bits && entry->format == rp->format &&
+		    entry->layout == rp->layout)
+			return;
+	}
+
+	entry = wl_array_add(&vr->pipeline_cache.used, sizeof *entry);
+	if (entry) {
+		entry->bits = bits;
+		entry->format = rp->format;
+		entry->layout = rp->layout;
+	}
+}
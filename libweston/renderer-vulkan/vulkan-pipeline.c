@@ -258,10 +258,14 @@ static void create_graphics_pipeline(struct vulkan_renderer *vr,
 		.pDynamicStates = dynamic_states,
 	};
 
+	const VkDescriptorSetLayout set_layouts[] = {
+		pipeline->uniform_set_layout,
+		pipeline->texture_set_layout,
+	};
 	const VkPipelineLayoutCreateInfo pipeline_layout_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 1,
-		.pSetLayouts = &pipeline->descriptor_set_layout,
+		.setLayoutCount = ARRAY_LENGTH(set_layouts),
+		.pSetLayouts = set_layouts,
 	};
 
 	result = vkCreatePipelineLayout(vr->dev, &pipeline_layout_info, NULL, &pipeline->pipeline_layout);
@@ -284,7 +288,7 @@ static void create_graphics_pipeline(struct vulkan_renderer *vr,
 		.basePipelineHandle = VK_NULL_HANDLE,
 	};
 
-	result = vkCreateGraphicsPipelines(vr->dev, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &pipeline->pipeline);
+	result = vkCreateGraphicsPipelines(vr->dev, vr->pipeline_cache.cache, 1, &pipeline_info, NULL, &pipeline->pipeline);
 	check_vk_success(result, "vkCreateGraphicsPipelines");
 
 	vkDestroyShaderModule(vr->dev, fs_module, NULL);
@@ -292,43 +296,51 @@ static void create_graphics_pipeline(struct vulkan_renderer *vr,
 }
 
 static void
-create_descriptor_set_layout(struct vulkan_renderer *vr, struct vulkan_pipeline *pipeline)
+create_descriptor_set_layouts(struct vulkan_renderer *vr, struct vulkan_pipeline *pipeline)
 {
 	VkResult result;
 
 	const VkDescriptorSetLayoutBinding vs_ubo_layout_binding = {
 		.binding = 0,
 		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
 	};
 
 	const VkDescriptorSetLayoutBinding fs_ubo_layout_binding = {
 		.binding = 1,
 		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
 	};
 
 	const VkDescriptorSetLayoutBinding fs_sampler_layout_binding = {
-		.binding = 2,
+		.binding = 0,
 		.descriptorCount = 1,
 		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
 	};
 
-	const VkDescriptorSetLayoutBinding bindings[] = {
+	const VkDescriptorSetLayoutBinding uniform_bindings[] = {
 		vs_ubo_layout_binding,
 		fs_ubo_layout_binding,
-		fs_sampler_layout_binding,
 	};
-	const VkDescriptorSetLayoutCreateInfo layout_info = {
+	const VkDescriptorSetLayoutCreateInfo uniform_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = ARRAY_LENGTH(uniform_bindings),
+		.pBindings = uniform_bindings,
+	};
+
+	result = vkCreateDescriptorSetLayout(vr->dev, &uniform_layout_info, NULL, &pipeline->uniform_set_layout);
+	check_vk_success(result, "vkCreateDescriptorSetLayout");
+
+	const VkDescriptorSetLayoutCreateInfo texture_layout_info = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-		.bindingCount = ARRAY_LENGTH(bindings),
-		.pBindings = bindings,
+		.bindingCount = 1,
+		.pBindings = &fs_sampler_layout_binding,
 	};
 
-	result = vkCreateDescriptorSetLayout(vr->dev, &layout_info, NULL, &pipeline->descriptor_set_layout);
+	result = vkCreateDescriptorSetLayout(vr->dev, &texture_layout_info, NULL, &pipeline->texture_set_layout);
 	check_vk_success(result, "vkCreateDescriptorSetLayout");
 }
 
@@ -347,9 +359,10 @@ vulkan_pipeline_create(struct vulkan_renderer *vr,
 	wl_list_init(&pipeline->link);
 	pipeline->key = *reqs;
 
-	create_descriptor_set_layout(vr, pipeline);
+	create_descriptor_set_layouts(vr, pipeline);
 
 	create_graphics_pipeline(vr, reqs, pipeline);
+	vulkan_pipeline_cache_mark_created(vr);
 
 	wl_list_insert(&vr->pipeline_list, &pipeline->link);
 
@@ -361,7 +374,8 @@ vulkan_pipeline_destroy(struct vulkan_renderer *vr, struct vulkan_pipeline *pipe
 {
 	vkDestroyPipelineLayout(vr->dev, pipeline->pipeline_layout, NULL);
 	vkDestroyPipeline(vr->dev, pipeline->pipeline, NULL);
-	vkDestroyDescriptorSetLayout(vr->dev, pipeline->descriptor_set_layout, NULL);
+	vkDestroyDescriptorSetLayout(vr->dev, pipeline->texture_set_layout, NULL);
+	vkDestroyDescriptorSetLayout(vr->dev, pipeline->uniform_set_layout, NULL);
 	wl_list_remove(&pipeline->link);
 	free(pipeline);
 }
@@ -382,9 +396,9 @@ vulkan_pipeline_requirements_cmp(const struct vulkan_pipeline_requirements *a,
 	return memcmp(a, b, sizeof(*a));
 }
 
-struct vulkan_pipeline *
-vulkan_renderer_get_pipeline(struct vulkan_renderer *vr,
-			     const struct vulkan_pipeline_requirements *reqs)
+static struct vulkan_pipeline *
+find_or_create_pipeline(struct vulkan_renderer *vr,
+			const struct vulkan_pipeline_requirements *reqs)
 {
 	struct vulkan_pipeline *pipeline;
 
@@ -393,10 +407,34 @@ vulkan_renderer_get_pipeline(struct vulkan_renderer *vr,
 			return pipeline;
 	}
 
-	pipeline = vulkan_pipeline_create(vr, reqs);
-	if (pipeline)
-		return pipeline;
+	return vulkan_pipeline_create(vr, reqs);
+}
 
-	return NULL;
+/** Get the pipeline to draw with, recording it for the next session */
+struct vulkan_pipeline *
+vulkan_renderer_get_pipeline(struct vulkan_renderer *vr,
+			     const struct vulkan_pipeline_requirements *reqs)
+{
+	struct vulkan_pipeline *pipeline;
+
+	pipeline = find_or_create_pipeline(vr, reqs);
+	if (pipeline && !pipeline->used) {
+		pipeline->used = true;
+		vulkan_pipeline_cache_mark_used(vr, reqs);
+	}
+
+	return pipeline;
+}
+
+/** Create a pipeline ahead of its first use
+ *
+ * It only gets recorded for the next session once drawn with, so that
+ * pipelines no longer needed drop out of the prewarm list.
+ */
+void
+vulkan_renderer_prewarm_pipeline(struct vulkan_renderer *vr,
+				 const struct vulkan_pipeline_requirements *reqs)
+{
+	find_or_create_pipeline(vr, reqs);
 }
 
@@ -48,7 +48,8 @@
 #include <vulkan/vulkan_xcb.h>
 
 #define MAX_NUM_IMAGES 5
-#define MAX_CONCURRENT_FRAMES 2
+#define MAX_CONCURRENT_FRAMES 3
+#define MAX_PENDING_UPLOADS (MAX_CONCURRENT_FRAMES + 1)
 
 struct vulkan_extension_table {
 	const char *name;
@@ -85,6 +86,7 @@ enum vulkan_device_ext_flag {
 	EXTENSION_KHR_MAINTENANCE_1                      = 1ull << 13,
 	EXTENSION_KHR_SAMPLER_YCBCR_CONVERSION           = 1ull << 14,
 	EXTENSION_KHR_SWAPCHAIN                          = 1ull << 15,
+	EXTENSION_KHR_TIMELINE_SEMAPHORE                 = 1ull << 16,
 };
 
 enum vulkan_pipeline_texture_variant {
@@ -127,8 +129,12 @@ struct vulkan_pipeline {
 
 	struct wl_list link; /* vulkan_renderer::pipeline_list */
 	struct timespec last_used;
+	bool used; /* drawn with, not only prewarmed */
 
-	VkDescriptorSetLayout descriptor_set_layout;
+	/* Set 0 holds the uniforms, as dynamic uniform buffers. Set 1 holds
+	 * the texture. */
+	VkDescriptorSetLayout uniform_set_layout;
+	VkDescriptorSetLayout texture_set_layout;
 
 	VkPipeline pipeline;
 	VkPipelineLayout pipeline_layout;
@@ -138,13 +144,16 @@ struct vulkan_renderer_texture_image {
 	VkImage image;
 	VkDeviceMemory memory;
 	VkImageView image_view;
+};
 
-	VkBuffer staging_buffer;
-	VkDeviceMemory staging_memory;
-	void *staging_map;
+/* Texture uploads recorded for the next queue submission */
+struct vulkan_renderer_upload {
+	VkCommandBuffer cmd_buffer;
+	uint64_t point; /* of the last submission */
+	bool recording;
 
-	VkCommandBuffer upload_cmd;
-	VkFence upload_fence;
+	/* struct vulkan_renderer_frame_vbuf::link */
+	struct wl_list staging_list;
 };
 
 struct vulkan_renderer {
@@ -155,6 +164,7 @@ struct vulkan_renderer {
 	VkInstance inst;
 
 	VkPhysicalDevice phys_dev;
+	VkDeviceSize uniform_align; /* of dynamic uniform buffer offsets */
 	VkQueue queue;
 	uint32_t queue_family;
 
@@ -164,6 +174,19 @@ struct vulkan_renderer {
 
 	VkCommandPool cmd_pool;
 
+	struct {
+		VkSemaphore semaphore; /* VK_NULL_HANDLE if unsupported */
+		uint64_t submitted; /* point of the last submission */
+		uint64_t completed; /* last point known to be reached */
+
+		/* Fences standing for the points, if there is no semaphore */
+		struct wl_list pending; /* vulkan_timeline_fence::link */
+		struct wl_array free_fences; /* VkFence */
+	} timeline;
+
+	struct vulkan_renderer_upload uploads[MAX_PENDING_UPLOADS];
+	uint32_t upload_index;
+
 	int drm_fd; /* drm device fd */
 	struct weston_drm_format_array supported_formats;
 	struct wl_list dmabuf_images;
@@ -171,6 +194,36 @@ struct vulkan_renderer {
 
 	struct wl_signal destroy_signal;
 	struct wl_list pipeline_list;
+
+	/* vulkan_buffer_state::retired_link, waiting for the GPU to be done */
+	struct wl_list retired_buffer_states;
+	/* vulkan_capture_task::link */
+	struct wl_list pending_capture_list;
+
+	struct {
+		/* pools of the descriptor sets kept across frames */
+		struct wl_list pool_list; /* vulkan_renderer_frame_dspool::link */
+		uint32_t cached_count;
+
+		/* counted over the output repaint being recorded */
+		uint32_t frame_allocated;
+		uint32_t cached_allocated;
+		uint32_t reused;
+
+		struct weston_log_scope *scope;
+	} descriptors;
+
+	struct {
+		VkPipelineCache cache;
+		char *dir; /* NULL if only kept in memory */
+		uint64_t device_hash;
+		bool prewarm;
+		bool dirty; /* pipelines were created since loading */
+
+		struct wl_array renderpasses;
+		struct wl_array prev_used; /* by the previous session */
+		struct wl_array used;
+	} pipeline_cache;
 	struct dmabuf_allocator *allocator;
 
 	PFN_vkCreateWaylandSurfaceKHR create_wayland_surface;
@@ -182,6 +235,8 @@ struct vulkan_renderer {
 	PFN_vkGetMemoryFdPropertiesKHR get_memory_fd_properties;
 	PFN_vkGetSemaphoreFdKHR get_semaphore_fd;
 	PFN_vkImportSemaphoreFdKHR import_semaphore_fd;
+	PFN_vkGetSemaphoreCounterValueKHR get_semaphore_counter_value;
+	PFN_vkWaitSemaphoresKHR wait_semaphores;
 
 	/* Debug modes. */
 	struct weston_binding *debug_mode_binding;
@@ -246,6 +301,48 @@ struct vulkan_pipeline *
 vulkan_renderer_get_pipeline(struct vulkan_renderer *vr,
 			     const struct vulkan_pipeline_requirements *reqs);
 
+void
+vulkan_renderer_prewarm_pipeline(struct vulkan_renderer *vr,
+				 const struct vulkan_pipeline_requirements *reqs);
+
+void
+vulkan_pipeline_cache_init(struct vulkan_renderer *vr);
+
+void
+vulkan_pipeline_cache_fini(struct vulkan_renderer *vr);
+
+void
+vulkan_pipeline_cache_add_renderpass(struct vulkan_renderer *vr,
+				     VkRenderPass renderpass,
+				     VkFormat format, VkImageLayout layout);
+
+void
+vulkan_pipeline_cache_remove_renderpass(struct vulkan_renderer *vr,
+					VkRenderPass renderpass);
+
+void
+vulkan_pipeline_cache_mark_created(struct vulkan_renderer *vr);
+
+void
+vulkan_pipeline_cache_mark_used(struct vulkan_renderer *vr,
+				const struct vulkan_pipeline_requirements *req);
+
+void
+vulkan_timeline_init(struct vulkan_renderer *vr);
+
+void
+vulkan_timeline_fini(struct vulkan_renderer *vr);
+
+uint64_t
+vulkan_timeline_submit(struct vulkan_renderer *vr,
+		       const VkSubmitInfo *submit_info);
+
+bool
+vulkan_timeline_reached(struct vulkan_renderer *vr, uint64_t point);
+
+void
+vulkan_timeline_wait(struct vulkan_renderer *vr, uint64_t point);
+
 bool
 vulkan_renderer_query_dmabuf_format(struct vulkan_renderer *vr,
 				    const struct pixel_format_info *format);
@@ -57,6 +57,7 @@
 #include "shared/helpers.h"
 #include "shared/platform.h"
 #include "shared/string-helpers.h"
+#include "shared/timespec-util.h"
 #include "shared/weston-drm-fourcc.h"
 #include "shared/xalloc.h"
 #include "libweston/weston-log.h"
@@ -78,6 +79,20 @@ enum vulkan_border_status {
 	BORDER_ALL_DIRTY = 0xf,
 };
 
+/* The bindings of a texture descriptor set. All the pipelines have identically
+ * defined descriptor set layouts, so the layout is not part of it. */
+struct vulkan_descriptor_key {
+	VkImageView image_view;
+	VkSampler sampler;
+};
+
+/* A descriptor set kept across frames by the owner of its bindings */
+struct vulkan_cached_descriptor_set {
+	struct vulkan_descriptor_key key;
+	VkDescriptorPool pool; /* VK_NULL_HANDLE if unused */
+	VkDescriptorSet set;
+};
+
 struct vulkan_border_image {
 	int32_t width, height;
 	int32_t tex_width;
@@ -87,15 +102,7 @@ struct vulkan_border_image {
 	VkSampler sampler;
 
 	VkDescriptorSet descriptor_set;
-
-	VkBuffer vs_ubo_buffer;
-	VkDeviceMemory vs_ubo_memory;
-	void *vs_ubo_map;
-
-	/* these are not really used as of now */
-	VkBuffer fs_ubo_buffer;
-	VkDeviceMemory fs_ubo_memory;
-	void *fs_ubo_map;
+	struct vulkan_cached_descriptor_set cached_descriptor_set;
 };
 
 struct vulkan_renderbuffer {
@@ -156,12 +163,17 @@ struct vulkan_renderer_frame {
 	VkCommandBuffer cmd_buffer;
 
 	VkSemaphore image_acquired;
-	VkFence fence;
+	uint64_t point; /* of its last submission */
 
 	struct wl_list acquire_fence_list;
 
 	struct wl_list vbuf_list;
 	struct wl_list dspool_list;
+
+	/* Uniforms of the draws, see bind_draw_descriptor_sets() */
+	struct wl_list ubuf_list;
+	VkBuffer uniform_buffer; /* the one uniform_set refers to */
+	VkDescriptorSet uniform_set;
 };
 
 enum vulkan_output_type {
@@ -221,19 +233,17 @@ struct vulkan_buffer_state {
 
 	struct wl_listener destroy_listener;
 
+	/* Once destroyed, in vulkan_renderer::retired_buffer_states */
+	struct wl_list retired_link;
+	uint64_t retire_point;
+
 	struct vulkan_renderer_texture_image texture;
 	VkSampler sampler_linear;
 	VkSampler sampler_nearest;
 
 	VkDescriptorSet descriptor_set;
-
-	VkBuffer vs_ubo_buffer;
-	VkDeviceMemory vs_ubo_memory;
-	void *vs_ubo_map;
-
-	VkBuffer fs_ubo_buffer;
-	VkDeviceMemory fs_ubo_memory;
-	void *fs_ubo_map;
+	/* one for each sampler */
+	struct vulkan_cached_descriptor_set cached_descriptor_sets[2];
 };
 
 struct vulkan_surface_state {
@@ -399,8 +409,16 @@ static const struct vulkan_extension_table vulkan_device_ext_table[] = {
 		.flag = EXTENSION_KHR_SWAPCHAIN,
 		.instance_dep = EXTENSION_KHR_SURFACE,
 	},
+	{
+		.name = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+		.flag = EXTENSION_KHR_TIMELINE_SEMAPHORE,
+		.instance_dep = EXTENSION_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2,
+	},
 };
 
+static void
+vulkan_renderer_submit_uploads(struct vulkan_renderer *vr);
+
 static void
 transfer_image_queue_family(VkCommandBuffer cmd_buffer, VkImage image,
 			    uint32_t src_index, uint32_t dst_index)
@@ -475,37 +493,54 @@ destroy_image(VkDevice device, VkImage image, VkImageView image_view, VkDeviceMe
 static void
 destroy_texture_image(struct vulkan_renderer *vr, struct vulkan_renderer_texture_image *texture)
 {
-	vkDestroyFence(vr->dev, texture->upload_fence, NULL);
-	vkFreeCommandBuffers(vr->dev, vr->cmd_pool, 1, &texture->upload_cmd);
-
-	destroy_buffer(vr->dev, texture->staging_buffer, texture->staging_memory);
-
 	destroy_image(vr->dev, texture->image, texture->image_view, texture->memory);
 }
 
 static void
-destroy_buffer_state(struct vulkan_buffer_state *vb)
+free_buffer_state(struct vulkan_buffer_state *vb)
 {
 	struct vulkan_renderer *vr = vb->vr;
 
-	// TODO: how to refcount this buffer properly so that it is not
-	// destroyed in the middle of a frame?
-	VkResult result;
-	result = vkQueueWaitIdle(vr->queue);
-	check_vk_success(result, "vkQueueWaitIdle");
-
+	release_cached_descriptor_sets(vr, vb->cached_descriptor_sets,
+				       ARRAY_LENGTH(vb->cached_descriptor_sets));
 	destroy_sampler(vr->dev, vb->sampler_linear);
 	destroy_sampler(vr->dev, vb->sampler_nearest);
 	destroy_texture_image(vr, &vb->texture);
 
-	destroy_buffer(vr->dev, vb->fs_ubo_buffer, vb->fs_ubo_memory);
-	destroy_buffer(vr->dev, vb->vs_ubo_buffer, vb->vs_ubo_memory);
+	wl_list_remove(&vb->retired_link);
+	free(vb);
+}
+
+/* Frees the buffer states the GPU is done with */
+static void
+free_retired_buffer_states(struct vulkan_renderer *vr)
+{
+	struct vulkan_buffer_state *vb, *tmp;
+
+	wl_list_for_each_safe(vb, tmp, &vr->retired_buffer_states, retired_link) {
+		if (!vulkan_timeline_reached(vr, vb->retire_point))
+			break;
+		free_buffer_state(vb);
+	}
+}
+
+/*
+ * Buffer states may still be used by submitted frames and uploads. Their
+ * Vulkan resources are only freed once the GPU is past the last submission,
+ * so that destroying one never waits for the queue.
+ */
+static void
+destroy_buffer_state(struct vulkan_buffer_state *vb)
+{
+	struct vulkan_renderer *vr = vb->vr;
+
+	vulkan_renderer_submit_uploads(vr);
+	vb->retire_point = vr->timeline.submitted;
+	wl_list_insert(vr->retired_buffer_states.prev, &vb->retired_link);
 
 	pixman_region32_fini(&vb->texture_damage);
 
 	wl_list_remove(&vb->destroy_listener.link);
-
-	free(vb);
 }
 
 static void
@@ -685,15 +720,16 @@ vulkan_renderer_output_destroy(struct weston_output *output)
 
 	// this wait idle is only on output destroy
 	VkResult result;
+	vulkan_renderer_submit_uploads(vr);
 	result = vkQueueWaitIdle(vr->queue);
 	check_vk_success(result, "vkQueueWaitIdle");
 
+	vulkan_pipeline_cache_remove_renderpass(vr, vo->renderpass);
 	vkDestroyRenderPass(vr->dev, vo->renderpass, NULL);
 
 	for (unsigned int i = 0; i < vo->num_frames; ++i) {
 		struct vulkan_renderer_frame *fr = &vo->frames[i];
 
-		vkDestroyFence(vr->dev, fr->fence, NULL);
 		vkDestroySemaphore(vr->dev, fr->image_acquired, NULL);
 		vkFreeCommandBuffers(vr->dev, vr->cmd_pool, 1, &fr->cmd_buffer);
 
@@ -704,12 +740,8 @@ vulkan_renderer_output_destroy(struct weston_output *output)
 			free(acquire_fence);
 		}
 
-		struct vulkan_renderer_frame_vbuf *vbuf, *vtmp;
-		wl_list_for_each_safe(vbuf, vtmp, &fr->vbuf_list, link) {
-			destroy_buffer(vr->dev, vbuf->buffer, vbuf->memory);
-			wl_list_remove(&vbuf->link);
-			free(vbuf);
-		}
+		destroy_host_buffers(vr, &fr->vbuf_list);
+		destroy_host_buffers(vr, &fr->ubuf_list);
 
 		struct vulkan_renderer_frame_dspool *dspool, *dtmp;
 		wl_list_for_each_safe(dspool, dtmp, &fr->dspool_list, link) {
@@ -810,13 +842,14 @@ vulkan_renderer_dmabuf_alloc(struct weston_renderer *renderer,
 
 static void
 create_descriptor_pool(struct vulkan_renderer *vr, VkDescriptorPool *descriptor_pool,
-		       uint32_t base_count, uint32_t maxsets)
+		       uint32_t base_count, uint32_t maxsets,
+		       VkDescriptorPoolCreateFlags flags)
 {
 	VkResult result;
 
 	const VkDescriptorPoolSize pool_sizes[] = {
 		{
-			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = 2 * base_count,
 		},
 		{
@@ -827,6 +860,7 @@ create_descriptor_pool(struct vulkan_renderer *vr, VkDescriptorPool *descriptor_
 
 	const VkDescriptorPoolCreateInfo pool_info = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = flags,
 		.poolSizeCount = ARRAY_LENGTH(pool_sizes),
 		.pPoolSizes = pool_sizes,
 		.maxSets = maxsets,
@@ -877,7 +911,7 @@ get_descriptor_set(struct vulkan_renderer *vr,
 	struct vulkan_renderer_frame_dspool *new_dspool = xzalloc(sizeof(*new_dspool));
 	new_dspool->count = base_count;
 	new_dspool->maxsets = maxsets;
-	create_descriptor_pool(vr, &new_dspool->pool, base_count, maxsets);
+	create_descriptor_pool(vr, &new_dspool->pool, base_count, maxsets, 0);
 	wl_list_insert(&fr->dspool_list, &new_dspool->link);
 
 	bool success = try_allocate_descriptor_set(vr, new_dspool->pool, descriptor_set_layout,
@@ -886,69 +920,183 @@ get_descriptor_set(struct vulkan_renderer *vr,
 }
 
 static void
-create_descriptor_set(struct vulkan_renderer *vr,
-		      struct vulkan_renderer_frame *fr,
-		      VkDescriptorSetLayout *descriptor_set_layout,
-		      VkBuffer vs_ubo_buffer,
-		      VkBuffer fs_ubo_buffer,
-		      VkImageView image_view,
-		      VkSampler sampler,
-		      VkDescriptorSet *descriptor_set)
+write_descriptor_set(struct vulkan_renderer *vr,
+		     VkDescriptorSet descriptor_set,
+		     const struct vulkan_descriptor_key *key)
+{
+	const VkDescriptorImageInfo image_info = {
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.imageView = key->image_view,
+		.sampler = key->sampler,
+	};
+
+	const VkWriteDescriptorSet descriptor_write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.pImageInfo = &image_info,
+	};
+
+	vkUpdateDescriptorSets(vr->dev, 1, &descriptor_write, 0, NULL);
+}
+
+static void
+write_uniform_descriptor_set(struct vulkan_renderer *vr,
+			     VkDescriptorSet descriptor_set,
+			     VkBuffer buffer)
 {
 	const VkDescriptorBufferInfo vs_ubo_info = {
-		.buffer = vs_ubo_buffer,
+		.buffer = buffer,
 		.offset = 0,
 		.range = sizeof(struct vs_ubo),
 	};
 
 	const VkDescriptorBufferInfo fs_ubo_info = {
-		.buffer = fs_ubo_buffer,
+		.buffer = buffer,
 		.offset = 0,
 		.range = sizeof(struct fs_ubo),
 	};
 
-	const VkDescriptorImageInfo image_info = {
-		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		.imageView = image_view,
-		.sampler = sampler,
-	};
-
-	get_descriptor_set(vr, fr, descriptor_set_layout, descriptor_set);
-	assert(descriptor_set);
-
 	const VkWriteDescriptorSet descriptor_writes[] = {
 		{
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = *descriptor_set,
+			.dstSet = descriptor_set,
 			.dstBinding = 0,
 			.dstArrayElement = 0,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = 1,
 			.pBufferInfo = &vs_ubo_info,
 		},
 		{
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = *descriptor_set,
+			.dstSet = descriptor_set,
 			.dstBinding = 1,
 			.dstArrayElement = 0,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = 1,
 			.pBufferInfo = &fs_ubo_info,
 		},
-		{
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = *descriptor_set,
-			.dstBinding = 2,
-			.dstArrayElement = 0,
-			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.descriptorCount = 1,
-			.pImageInfo = &image_info,
-		},
 	};
 
 	vkUpdateDescriptorSets(vr->dev, ARRAY_LENGTH(descriptor_writes), descriptor_writes, 0, NULL);
 }
 
+static bool
+descriptor_key_equal(const struct vulkan_descriptor_key *a,
+		     const struct vulkan_descriptor_key *b)
+{
+	return a->image_view == b->image_view &&
+	       a->sampler == b->sampler;
+}
+
+static void
+allocate_cached_descriptor_set(struct vulkan_renderer *vr,
+			       VkDescriptorSetLayout *descriptor_set_layout,
+			       struct vulkan_cached_descriptor_set *cached)
+{
+	const uint32_t count = 256;
+
+	struct vulkan_renderer_frame_dspool *dspool;
+
+	wl_list_for_each(dspool, &vr->descriptors.pool_list, link) {
+		if (try_allocate_descriptor_set(vr, dspool->pool, descriptor_set_layout,
+						&cached->set)) {
+			cached->pool = dspool->pool;
+			return;
+		}
+	}
+
+	dspool = xzalloc(sizeof(*dspool));
+	dspool->count = count;
+	dspool->maxsets = count;
+	create_descriptor_pool(vr, &dspool->pool, count, count,
+			       VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+	wl_list_insert(&vr->descriptors.pool_list, &dspool->link);
+
+	bool success = try_allocate_descriptor_set(vr, dspool->pool, descriptor_set_layout,
+						   &cached->set);
+	assert(success);
+	cached->pool = dspool->pool;
+}
+
+/*
+ * Returns a descriptor set with the given bindings, for the frame being
+ * recorded.
+ *
+ * Sets are kept across frames in the cache slots of the object owning the
+ * bindings, so that drawing an unchanged object allocates and writes nothing.
+ * A cached set may be in use by frames in flight, so it is never rewritten:
+ * if all the slots already hold other bindings, a set is allocated from the
+ * pools of the frame instead.
+ */
+static VkDescriptorSet
+get_cached_descriptor_set(struct vulkan_renderer *vr,
+			  struct vulkan_renderer_frame *fr,
+			  VkDescriptorSetLayout *descriptor_set_layout,
+			  struct vulkan_cached_descriptor_set *cache,
+			  unsigned int cache_size,
+			  const struct vulkan_descriptor_key *key)
+{
+	struct vulkan_cached_descriptor_set *unused = NULL;
+	VkDescriptorSet descriptor_set;
+
+	for (unsigned int i = 0; i < cache_size; i++) {
+		if (cache[i].pool == VK_NULL_HANDLE) {
+			if (!unused)
+				unused = &cache[i];
+		} else if (descriptor_key_equal(&cache[i].key, key)) {
+			vr->descriptors.reused++;
+			return cache[i].set;
+		}
+	}
+
+	if (!unused) {
+		get_descriptor_set(vr, fr, descriptor_set_layout, &descriptor_set);
+		write_descriptor_set(vr, descriptor_set, key);
+		vr->descriptors.frame_allocated++;
+		return descriptor_set;
+	}
+
+	allocate_cached_descriptor_set(vr, descriptor_set_layout, unused);
+	unused->key = *key;
+	write_descriptor_set(vr, unused->set, key);
+	vr->descriptors.cached_allocated++;
+	vr->descriptors.cached_count++;
+
+	return unused->set;
+}
+
+/* Must only be called once no frame in flight uses the sets anymore */
+static void
+release_cached_descriptor_sets(struct vulkan_renderer *vr,
+			       struct vulkan_cached_descriptor_set *cache,
+			       unsigned int cache_size)
+{
+	for (unsigned int i = 0; i < cache_size; i++) {
+		if (cache[i].pool == VK_NULL_HANDLE)
+			continue;
+
+		vkFreeDescriptorSets(vr->dev, cache[i].pool, 1, &cache[i].set);
+		vr->descriptors.cached_count--;
+		memset(&cache[i], 0, sizeof(cache[i]));
+	}
+}
+
+static void
+destroy_cached_descriptor_pools(struct vulkan_renderer *vr)
+{
+	struct vulkan_renderer_frame_dspool *dspool, *tmp;
+
+	wl_list_for_each_safe(dspool, tmp, &vr->descriptors.pool_list, link) {
+		vkDestroyDescriptorPool(vr->dev, dspool->pool, NULL);
+		wl_list_remove(&dspool->link);
+		free(dspool);
+	}
+}
+
 static void
 reset_descriptor_pool(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr)
 {
@@ -978,7 +1126,7 @@ reset_descriptor_pool(struct vulkan_renderer *vr, struct vulkan_renderer_frame *
 	struct vulkan_renderer_frame_dspool *new_dspool = xzalloc(sizeof(*new_dspool));
 	new_dspool->count = total_count;
 	new_dspool->maxsets = total_maxsets;
-	create_descriptor_pool(vr, &new_dspool->pool, total_count, total_maxsets);
+	create_descriptor_pool(vr, &new_dspool->pool, total_count, total_maxsets, 0);
 	wl_list_insert(&fr->dspool_list, &new_dspool->link);
 }
 
@@ -1030,50 +1178,26 @@ create_buffer(struct vulkan_renderer *vr, VkDeviceSize size,
 	check_vk_success(result, "vkBindBufferMemory");
 }
 
-static void
-create_vs_ubo_buffer(struct vulkan_renderer *vr, VkBuffer *vs_ubo_buffer,
-		     VkDeviceMemory *vs_ubo_memory, void **vs_ubo_map)
+/* Not limited to powers of two, unlike ROUND_UP_N() */
+static uint64_t
+align_up(uint64_t value, uint64_t align)
 {
-	VkResult result;
-	VkDeviceSize buffer_size = sizeof(struct vs_ubo);
-
-	create_buffer(vr, buffer_size,
-		      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		      vs_ubo_buffer, vs_ubo_memory);
-
-	result = vkMapMemory(vr->dev, *vs_ubo_memory, 0, VK_WHOLE_SIZE, 0, vs_ubo_map);
-	check_vk_success(result, "vkMapMemory");
-}
-
-static void
-create_fs_ubo_buffer(struct vulkan_renderer *vr, VkBuffer *fs_ubo_buffer,
-		     VkDeviceMemory *fs_ubo_memory, void **fs_ubo_map)
-{
-	VkResult result;
-	VkDeviceSize buffer_size = sizeof(struct fs_ubo);
-
-	create_buffer(vr, buffer_size,
-		      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		      fs_ubo_buffer, fs_ubo_memory);
-
-	result = vkMapMemory(vr->dev, *fs_ubo_memory, 0, VK_WHOLE_SIZE, 0, fs_ubo_map);
-	check_vk_success(result, "vkMapMemory");
+	return (value + align - 1) / align * align;
 }
 
 /*
- * Allocates new vertex buffers on demand or reuse current buffers if there
- * is still space available
+ * Allocates new host visible buffers on demand or reuse current buffers if
+ * there is still space available
  */
 static struct vulkan_renderer_frame_vbuf *
-get_vertex_buffer(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr, uint64_t size)
+get_host_buffer(struct vulkan_renderer *vr, struct wl_list *list,
+		VkBufferUsageFlags usage, uint64_t size)
 {
 	const uint32_t base_size = 4096;
 	VkResult result;
 
-	if (!wl_list_empty(&fr->vbuf_list)) {
-		struct vulkan_renderer_frame_vbuf *first = wl_container_of(fr->vbuf_list.next, first, link);
+	if (!wl_list_empty(list)) {
+		struct vulkan_renderer_frame_vbuf *first = wl_container_of(list->next, first, link);
 		if (first->size >= first->offset + size)
 			return first;
 	}
@@ -1083,39 +1207,39 @@ get_vertex_buffer(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr,
 	VkDeviceSize buffer_size = MAX(base_size, round_up_pow2_32(size));
 	new_vbuf->size = buffer_size;
 
-	create_buffer(vr, new_vbuf->size,
-		      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	create_buffer(vr, new_vbuf->size, usage,
 		      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		      &new_vbuf->buffer, &new_vbuf->memory);
 
 	result = vkMapMemory(vr->dev, new_vbuf->memory, 0, VK_WHOLE_SIZE, 0, &new_vbuf->map);
 	check_vk_success(result, "vkMapMemory");
 
-	wl_list_insert(&fr->vbuf_list, &new_vbuf->link);
+	wl_list_insert(list, &new_vbuf->link);
 
 	return new_vbuf;
 }
 
 /*
- * Resets vertex buffer offset so it can be reused; or coalesces multiple
- * vertex buffers into a single larger new one if multiple were dynamically
- * allocated in the previous use of this frame
+ * Resets host buffer offset so it can be reused; or coalesces multiple
+ * host buffers into a single larger new one if multiple were dynamically
+ * allocated in the previous use of this list
  */
 static void
-reset_vertex_buffers(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr)
+reset_host_buffers(struct vulkan_renderer *vr, struct wl_list *list,
+		   VkBufferUsageFlags usage)
 {
-	if (wl_list_empty(&fr->vbuf_list))
+	if (wl_list_empty(list))
 		return;
 
-	if (wl_list_length(&fr->vbuf_list) == 1) {
-		struct vulkan_renderer_frame_vbuf *first = wl_container_of(fr->vbuf_list.next, first, link);
+	if (wl_list_length(list) == 1) {
+		struct vulkan_renderer_frame_vbuf *first = wl_container_of(list->next, first, link);
 		first->offset = 0;
 		return;
 	}
 
 	struct vulkan_renderer_frame_vbuf *vbuf, *tmp;
 	uint64_t total_size = 0;
-	wl_list_for_each_safe(vbuf, tmp, &fr->vbuf_list, link) {
+	wl_list_for_each_safe(vbuf, tmp, list, link) {
 		total_size += vbuf->size;
 		wl_list_remove(&vbuf->link);
 		destroy_buffer(vr->dev, vbuf->buffer, vbuf->memory);
@@ -1124,7 +1248,189 @@ reset_vertex_buffers(struct vulkan_renderer *vr, struct vulkan_renderer_frame *f
 
 	total_size = round_up_pow2_32(total_size);
 
-	get_vertex_buffer(vr, fr, total_size);
+	get_host_buffer(vr, list, usage, total_size);
+}
+
+static void
+destroy_host_buffers(struct vulkan_renderer *vr, struct wl_list *list)
+{
+	struct vulkan_renderer_frame_vbuf *vbuf, *vtmp;
+
+	wl_list_for_each_safe(vbuf, vtmp, list, link) {
+		destroy_buffer(vr->dev, vbuf->buffer, vbuf->memory);
+		wl_list_remove(&vbuf->link);
+		free(vbuf);
+	}
+}
+
+#define VERTEX_BUFFER_USAGE \
+	(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+
+static struct vulkan_renderer_frame_vbuf *
+get_vertex_buffer(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr, uint64_t size)
+{
+	return get_host_buffer(vr, &fr->vbuf_list, VERTEX_BUFFER_USAGE, size);
+}
+
+static void
+reset_vertex_buffers(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr)
+{
+	reset_host_buffers(vr, &fr->vbuf_list, VERTEX_BUFFER_USAGE);
+}
+
+#define UNIFORM_BUFFER_USAGE VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+
+static void
+reset_uniform_buffers(struct vulkan_renderer *vr, struct vulkan_renderer_frame *fr)
+{
+	reset_host_buffers(vr, &fr->ubuf_list, UNIFORM_BUFFER_USAGE);
+	fr->uniform_buffer = VK_NULL_HANDLE;
+}
+
+/*
+ * Copies the uniforms of a draw to the uniform buffers of the frame, and binds
+ * them along with the texture descriptor set.
+ *
+ * Each draw gets uniforms of its own: the buffer or border drawn from may be
+ * drawn again, by this frame or by another one, while the GPU has yet to
+ * read them. The frame reuses its uniform buffers only once its last
+ * submission is done, like its vertex buffers.
+ */
+static void
+bind_draw_descriptor_sets(struct vulkan_renderer *vr,
+			  struct vulkan_renderer_frame *fr,
+			  struct vulkan_pipeline *pipeline,
+			  const struct vs_ubo *vs_ubo,
+			  const struct fs_ubo *fs_ubo,
+			  VkDescriptorSet texture_set)
+{
+	const uint64_t vs_size = align_up(sizeof(*vs_ubo), vr->uniform_align);
+	const uint64_t fs_size = align_up(sizeof(*fs_ubo), vr->uniform_align);
+	struct vulkan_renderer_frame_vbuf *ubuf;
+	uint32_t offsets[2];
+
+	/* Offsets stay aligned, as the buffers start aligned */
+	ubuf = get_host_buffer(vr, &fr->ubuf_list, UNIFORM_BUFFER_USAGE,
+			       vs_size + fs_size);
+	if (ubuf->buffer != fr->uniform_buffer) {
+		get_descriptor_set(vr, fr, &pipeline->uniform_set_layout,
+				   &fr->uniform_set);
+		write_uniform_descriptor_set(vr, fr->uniform_set, ubuf->buffer);
+		fr->uniform_buffer = ubuf->buffer;
+	}
+
+	offsets[0] = ubuf->offset;
+	offsets[1] = ubuf->offset + vs_size;
+	memcpy(ubuf->map + offsets[0], vs_ubo, sizeof(*vs_ubo));
+	memcpy(ubuf->map + offsets[1], fs_ubo, sizeof(*fs_ubo));
+	ubuf->offset += vs_size + fs_size;
+
+	const VkDescriptorSet descriptor_sets[] = {
+		fr->uniform_set,
+		texture_set,
+	};
+	vkCmdBindDescriptorSets(fr->cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipeline->pipeline_layout, 0,
+				ARRAY_LENGTH(descriptor_sets), descriptor_sets,
+				ARRAY_LENGTH(offsets), offsets);
+}
+
+/*
+ * Returns the command buffer recording texture uploads for the next
+ * submission, starting it if needed. Uploads go through a ring of
+ * MAX_PENDING_UPLOADS command buffers, each with its own staging memory, so
+ * that the CPU only waits for the GPU if it gets that many upload
+ * submissions ahead.
+ */
+static struct vulkan_renderer_upload *
+vulkan_renderer_begin_upload(struct vulkan_renderer *vr)
+{
+	struct vulkan_renderer_upload *up = &vr->uploads[vr->upload_index];
+	VkResult result;
+
+	if (up->recording)
+		return up;
+
+	vulkan_timeline_wait(vr, up->point);
+
+	reset_host_buffers(vr, &up->staging_list,
+			   VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+	const VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+
+	result = vkBeginCommandBuffer(up->cmd_buffer, &begin_info);
+	check_vk_success(result, "vkBeginCommandBuffer");
+
+	up->recording = true;
+
+	return up;
+}
+
+/*
+ * Submits the uploads recorded so far. Anything submitted to the queue later
+ * is ordered after them by the barriers they end with, there is no need to
+ * wait for them.
+ */
+static void
+vulkan_renderer_submit_uploads(struct vulkan_renderer *vr)
+{
+	struct vulkan_renderer_upload *up = &vr->uploads[vr->upload_index];
+	VkResult result;
+
+	if (!up->recording)
+		return;
+
+	result = vkEndCommandBuffer(up->cmd_buffer);
+	check_vk_success(result, "vkEndCommandBuffer");
+
+	const VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &up->cmd_buffer,
+	};
+
+	up->point = vulkan_timeline_submit(vr, &submit_info);
+
+	up->recording = false;
+	vr->upload_index = (vr->upload_index + 1) % MAX_PENDING_UPLOADS;
+}
+
+static void
+create_uploads(struct vulkan_renderer *vr)
+{
+	VkResult result;
+
+	for (unsigned int i = 0; i < MAX_PENDING_UPLOADS; i++) {
+		struct vulkan_renderer_upload *up = &vr->uploads[i];
+
+		const VkCommandBufferAllocateInfo cmd_alloc_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = vr->cmd_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+		result = vkAllocateCommandBuffers(vr->dev, &cmd_alloc_info, &up->cmd_buffer);
+		check_vk_success(result, "vkAllocateCommandBuffers");
+
+		up->point = 0;
+		wl_list_init(&up->staging_list);
+	}
+}
+
+/* Must be called with the queue idle */
+static void
+destroy_uploads(struct vulkan_renderer *vr)
+{
+	for (unsigned int i = 0; i < MAX_PENDING_UPLOADS; i++) {
+		struct vulkan_renderer_upload *up = &vr->uploads[i];
+
+		assert(!up->recording);
+		vkFreeCommandBuffers(vr->dev, vr->cmd_pool, 1, &up->cmd_buffer);
+		destroy_host_buffers(vr, &up->staging_list);
+	}
 }
 
 static int
@@ -1302,9 +1608,9 @@ vulkan_renderer_cmd_begin(struct vulkan_renderer *vr,
 	check_vk_success(result, "vkBeginCommandBuffer");
 }
 
-static void
-vulkan_renderer_cmd_end_wait(struct vulkan_renderer *vr,
-			     VkCommandBuffer *cmd_buffer)
+static uint64_t
+vulkan_renderer_cmd_end(struct vulkan_renderer *vr,
+			VkCommandBuffer *cmd_buffer)
 {
 	VkResult result;
 
@@ -1317,36 +1623,38 @@ vulkan_renderer_cmd_end_wait(struct vulkan_renderer *vr,
 		.pCommandBuffers = cmd_buffer,
 	};
 
-	result = vkQueueSubmit(vr->queue, 1, &submit_info, VK_NULL_HANDLE);
-	check_vk_success(result, "vkQueueSubmit");
+	return vulkan_timeline_submit(vr, &submit_info);
+}
 
-	result = vkQueueWaitIdle(vr->queue);
-	check_vk_success(result, "vkQueueWaitIdle");
+static void
+vulkan_renderer_cmd_end_wait(struct vulkan_renderer *vr,
+			     VkCommandBuffer *cmd_buffer)
+{
+	uint64_t point;
+
+	point = vulkan_renderer_cmd_end(vr, cmd_buffer);
+	vulkan_timeline_wait(vr, point);
 
 	vkFreeCommandBuffers(vr->dev, vr->cmd_pool, 1, cmd_buffer);
 }
 
-static bool
-vulkan_renderer_do_read_pixels(struct vulkan_renderer *vr,
-			       VkImage color_attachment,
-			       struct vulkan_output_state *vo,
-			       const struct pixel_format_info *pixel_format,
-			       void *pixels, int stride,
-			       const struct weston_geometry *rect)
+/* Records the copy of a region of the color attachment into a new buffer */
+static void
+record_read_pixels(struct vulkan_renderer *vr,
+		   VkCommandBuffer cmd_buffer,
+		   VkImage color_attachment,
+		   struct vulkan_output_state *vo,
+		   const struct pixel_format_info *pixel_format,
+		   int stride,
+		   const struct weston_geometry *rect,
+		   VkBuffer *dst_buffer, VkDeviceMemory *dst_memory)
 {
-	VkBuffer dst_buffer;
-	VkDeviceMemory dst_memory;
 	VkDeviceSize buffer_size = stride * vo->fb_size.height;
-	VkResult result;
 
 	create_buffer(vr, buffer_size,
 		      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		      &dst_buffer, &dst_memory);
-
-	// TODO: async implementation of this
-	VkCommandBuffer cmd_buffer;
-	vulkan_renderer_cmd_begin(vr, &cmd_buffer);
+		      dst_buffer, dst_memory);
 
 	transition_image_layout(cmd_buffer, color_attachment,
 				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -1354,7 +1662,7 @@ vulkan_renderer_do_read_pixels(struct vulkan_renderer *vr,
 				0, VK_ACCESS_TRANSFER_WRITE_BIT);
 
 	copy_sub_image_to_buffer(cmd_buffer,
-				 dst_buffer, color_attachment,
+				 *dst_buffer, color_attachment,
 				 vo->fb_size.width, vo->fb_size.height,
 				 (stride / (pixel_format->bpp/8)),
 				 pixel_format->bpp,
@@ -1365,9 +1673,18 @@ vulkan_renderer_do_read_pixels(struct vulkan_renderer *vr,
 				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
 				0, VK_ACCESS_TRANSFER_WRITE_BIT);
+}
 
-	// TODO: async implementation of this, remove wait
-	vulkan_renderer_cmd_end_wait(vr, &cmd_buffer);
+/* Copies the region read back by record_read_pixels() once it's done */
+static void
+copy_read_pixels(struct vulkan_renderer *vr,
+		 VkDeviceMemory dst_memory,
+		 const struct weston_size *fb_size,
+		 const struct pixel_format_info *pixel_format,
+		 void *pixels, int stride,
+		 const struct weston_geometry *rect)
+{
+	VkResult result;
 
 	/* Map image memory so we can start copying from it */
 	void* buffer_map;
@@ -1379,12 +1696,12 @@ vulkan_renderer_do_read_pixels(struct vulkan_renderer *vr,
 	 * so use a pixman composition. */
 	pixman_image_t *image_src;
 	image_src = pixman_image_create_bits_no_clear(pixel_format->pixman_format,
-						      vo->fb_size.width, vo->fb_size.height,
+						      fb_size->width, fb_size->height,
 						      buffer_map, stride);
 
 	pixman_image_t *image_dst;
 	image_dst = pixman_image_create_bits_no_clear(pixel_format->pixman_format,
-						      vo->fb_size.width, vo->fb_size.height,
+						      fb_size->width, fb_size->height,
 						      pixels, stride);
 
 	pixman_image_composite32(PIXMAN_OP_SRC,
@@ -1398,34 +1715,249 @@ vulkan_renderer_do_read_pixels(struct vulkan_renderer *vr,
 
 	pixman_image_unref(image_src);
 	pixman_image_unref(image_dst);
+}
+
+static bool
+vulkan_renderer_do_read_pixels(struct vulkan_renderer *vr,
+			       VkImage color_attachment,
+			       struct vulkan_output_state *vo,
+			       const struct pixel_format_info *pixel_format,
+			       void *pixels, int stride,
+			       const struct weston_geometry *rect)
+{
+	VkBuffer dst_buffer;
+	VkDeviceMemory dst_memory;
+
+	VkCommandBuffer cmd_buffer;
+	vulkan_renderer_cmd_begin(vr, &cmd_buffer);
+
+	record_read_pixels(vr, cmd_buffer, color_attachment, vo, pixel_format,
+			   stride, rect, &dst_buffer, &dst_memory);
+
+	/* The caller wants the pixels now */
+	vulkan_renderer_cmd_end_wait(vr, &cmd_buffer);
+
+	copy_read_pixels(vr, dst_memory, &vo->fb_size, pixel_format,
+			 pixels, stride, rect);
 
 	destroy_buffer(vr->dev, dst_buffer, dst_memory);
 
 	return true;
 }
 
-static bool
-vulkan_renderer_do_capture(struct vulkan_renderer *vr,
-			   VkImage color_attachment,
-			   struct vulkan_output_state *vo,
-			   struct weston_buffer *into,
-			   const struct weston_geometry *rect)
+/* A capture read back, waiting for the GPU before being copied out */
+struct vulkan_capture_task {
+	struct weston_capture_task *task;
+	struct wl_listener destroy_listener;
+	struct wl_event_source *source;
+	struct vulkan_renderer *vr;
+	struct wl_list link; /* vulkan_renderer::pending_capture_list */
+
+	VkCommandBuffer cmd_buffer;
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	uint64_t point;
+	/* Signalled with the read back and exported, if supported */
+	VkSemaphore semaphore;
+	int fd;
+
+	struct weston_size fb_size;
+	struct weston_geometry rect;
+};
+
+static void
+destroy_capture_task(struct vulkan_capture_task *vk_task)
 {
-	struct wl_shm_buffer *shm = into->shm_buffer;
-	const struct pixel_format_info *pixel_format = into->pixel_format;
-	bool ret;
+	struct vulkan_renderer *vr = vk_task->vr;
 
-	assert(into->type == WESTON_BUFFER_SHM);
-	assert(shm);
+	/* Only waits if the task was cancelled before the read back was done */
+	vulkan_timeline_wait(vr, vk_task->point);
 
-	wl_shm_buffer_begin_access(shm);
+	vkFreeCommandBuffers(vr->dev, vr->cmd_pool, 1, &vk_task->cmd_buffer);
+	destroy_buffer(vr->dev, vk_task->buffer, vk_task->memory);
+	if (vk_task->semaphore != VK_NULL_HANDLE)
+		vkDestroySemaphore(vr->dev, vk_task->semaphore, NULL);
+
+	wl_event_source_remove(vk_task->source);
+	if (vk_task->fd >= 0)
+		close(vk_task->fd);
+	wl_list_remove(&vk_task->link);
+	wl_list_remove(&vk_task->destroy_listener.link);
+
+	free(vk_task);
+}
+
+static void
+capture_task_parent_destroy_handler(struct wl_listener *l, void *data)
+{
+	struct vulkan_capture_task *vk_task;
+
+	vk_task = container_of(l, struct vulkan_capture_task, destroy_listener);
+	destroy_capture_task(vk_task);
+}
 
-	ret = vulkan_renderer_do_read_pixels(vr, color_attachment, vo, pixel_format,
-					     wl_shm_buffer_get_data(shm), into->stride, rect);
+static void
+complete_capture_task(struct vulkan_capture_task *vk_task)
+{
+	struct weston_buffer *buffer =
+		weston_capture_task_get_buffer(vk_task->task);
+	struct wl_shm_buffer *shm = buffer->shm_buffer;
 
+	wl_list_remove(&vk_task->destroy_listener.link);
+	wl_list_init(&vk_task->destroy_listener.link);
+
+	wl_shm_buffer_begin_access(shm);
+	copy_read_pixels(vk_task->vr, vk_task->memory, &vk_task->fb_size,
+			 buffer->pixel_format, wl_shm_buffer_get_data(shm),
+			 buffer->stride, &vk_task->rect);
 	wl_shm_buffer_end_access(shm);
 
-	return ret;
+	weston_capture_task_retire_complete(vk_task->task);
+	destroy_capture_task(vk_task);
+}
+
+static int
+async_capture_handler(void *data)
+{
+	struct vulkan_capture_task *vk_task = data;
+
+	if (!vulkan_timeline_reached(vk_task->vr, vk_task->point)) {
+		wl_event_source_timer_update(vk_task->source, 1);
+		return 0;
+	}
+
+	complete_capture_task(vk_task);
+
+	return 0;
+}
+
+static int
+async_capture_handler_fd(int fd, uint32_t mask, void *data)
+{
+	struct vulkan_capture_task *vk_task = data;
+
+	assert(fd == vk_task->fd);
+
+	if (mask & WL_EVENT_READABLE) {
+		complete_capture_task(vk_task);
+		return 0;
+	}
+
+	wl_list_remove(&vk_task->destroy_listener.link);
+	wl_list_init(&vk_task->destroy_listener.link);
+
+	weston_capture_task_retire_failed(vk_task->task,
+					  "Vulkan: capture failed");
+	destroy_capture_task(vk_task);
+
+	return 0;
+}
+
+/* Submits the read back of a capture, signalling a semaphore exported as a
+ * sync fd. Returns the fd, or -1 if there is nothing to wait for.
+ */
+static int
+submit_capture_export_fd(struct vulkan_renderer *vr,
+			 struct vulkan_capture_task *vk_task)
+{
+	VkResult result;
+	int fd = -1;
+
+	VkExportSemaphoreCreateInfo export_info = {
+		.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+		.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+	};
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+	};
+	pnext(&semaphore_info, &export_info);
+
+	result = vkCreateSemaphore(vr->dev, &semaphore_info, NULL,
+				   &vk_task->semaphore);
+	check_vk_success(result, "vkCreateSemaphore capture");
+
+	result = vkEndCommandBuffer(vk_task->cmd_buffer);
+	check_vk_success(result, "vkEndCommandBuffer");
+
+	const VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &vk_task->cmd_buffer,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &vk_task->semaphore,
+	};
+	vk_task->point = vulkan_timeline_submit(vr, &submit_info);
+
+	const VkSemaphoreGetFdInfoKHR semaphore_fd_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+		.semaphore = vk_task->semaphore,
+		.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+	};
+	result = vr->get_semaphore_fd(vr->dev, &semaphore_fd_info, &fd);
+	check_vk_success(result, "vkGetSemaphoreFdKHR");
+
+	return fd;
+}
+
+/*
+ * Submits the read back of a capture without waiting for it. The pixels are
+ * copied into the capture buffer, and the task retired, once the GPU is done.
+ */
+static void
+vulkan_renderer_do_capture_async(struct vulkan_renderer *vr,
+				 VkImage color_attachment,
+				 struct weston_output *output,
+				 struct weston_capture_task *task,
+				 const struct weston_geometry *rect)
+{
+	struct vulkan_output_state *vo = get_output_state(output);
+	struct weston_buffer *buffer = weston_capture_task_get_buffer(task);
+	struct vulkan_capture_task *vk_task;
+	struct wl_event_loop *loop;
+	int refresh_msec = 16;
+
+	assert(buffer->type == WESTON_BUFFER_SHM);
+
+	vk_task = xzalloc(sizeof(*vk_task));
+	vk_task->task = task;
+	vk_task->vr = vr;
+	vk_task->fb_size = vo->fb_size;
+	vk_task->rect = *rect;
+	vk_task->fd = -1;
+
+	vulkan_renderer_cmd_begin(vr, &vk_task->cmd_buffer);
+	record_read_pixels(vr, vk_task->cmd_buffer, color_attachment, vo,
+			   buffer->pixel_format, buffer->stride, rect,
+			   &vk_task->buffer, &vk_task->memory);
+	if (vr->semaphore_import_export)
+		vk_task->fd = submit_capture_export_fd(vr, vk_task);
+	else
+		vk_task->point = vulkan_renderer_cmd_end(vr, &vk_task->cmd_buffer);
+
+	vk_task->destroy_listener.notify = capture_task_parent_destroy_handler;
+	weston_capture_task_add_destroy_listener(task, &vk_task->destroy_listener);
+
+	loop = wl_display_get_event_loop(vr->compositor->wl_display);
+
+	if (vk_task->fd >= 0) {
+		vk_task->source = wl_event_loop_add_fd(loop, vk_task->fd,
+						       WL_EVENT_READABLE,
+						       async_capture_handler_fd,
+						       vk_task);
+	} else {
+		/* Check back once the GPU is likely done with the frame, then
+		 * poll */
+		if (output->current_mode && output->current_mode->refresh > 0)
+			refresh_msec = millihz_to_nsec(output->current_mode->refresh) / 1000000;
+
+		vk_task->source = wl_event_loop_add_timer(loop,
+							  async_capture_handler,
+							  vk_task);
+		wl_event_source_timer_update(vk_task->source,
+					     MAX(refresh_msec, 1));
+	}
+
+	wl_list_insert(&vr->pending_capture_list, &vk_task->link);
 }
 
 static void
@@ -1476,10 +2008,8 @@ vulkan_renderer_do_capture_tasks(struct vulkan_renderer *vr,
 			continue;
 		}
 
-		if (vulkan_renderer_do_capture(vr, color_attachment, vo, buffer, &rect))
-			weston_capture_task_retire_complete(ct);
-		else
-			weston_capture_task_retire_failed(ct, "Vulkan: capture failed");
+		vulkan_renderer_do_capture_async(vr, color_attachment, output,
+						 ct, &rect);
 	}
 }
 
@@ -1641,6 +2171,8 @@ repaint_region(struct vulkan_renderer *vr,
 	struct vulkan_buffer_state *vb = vs->buffer;
 	struct vulkan_pipeline *pipeline;
 	VkCommandBuffer cmd_buffer = fr->cmd_buffer;
+	struct vs_ubo vs_ubo;
+	struct fs_ubo fs_ubo;
 	uint32_t nfans;
 
 	struct wl_array vertices;
@@ -1668,17 +2200,14 @@ repaint_region(struct vulkan_renderer *vr,
 
 	vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &vbuf->buffer, &vbuf->offset);
 
-	memcpy(vb->vs_ubo_map + offsetof(struct vs_ubo, proj),
-	       pconf->projection.M.colmaj, sizeof(pconf->projection.M.colmaj));
-	memcpy(vb->vs_ubo_map + offsetof(struct vs_ubo, surface_to_buffer),
-	       pconf->surface_to_buffer.M.colmaj, sizeof(pconf->surface_to_buffer.M.colmaj));
-	memcpy(vb->fs_ubo_map + offsetof(struct fs_ubo, unicolor),
-	       pconf->unicolor, sizeof(pconf->unicolor));
-	memcpy(vb->fs_ubo_map + offsetof(struct fs_ubo, view_alpha),
-	       &pconf->view_alpha, sizeof(pconf->view_alpha));
+	memcpy(vs_ubo.proj, pconf->projection.M.colmaj, sizeof(vs_ubo.proj));
+	memcpy(vs_ubo.surface_to_buffer, pconf->surface_to_buffer.M.colmaj,
+	       sizeof(vs_ubo.surface_to_buffer));
+	memcpy(fs_ubo.unicolor, pconf->unicolor, sizeof(fs_ubo.unicolor));
+	fs_ubo.view_alpha = pconf->view_alpha;
 
-	vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipeline->pipeline_layout, 0, 1, &vb->descriptor_set, 0, NULL);
+	bind_draw_descriptor_sets(vr, fr, pipeline, &vs_ubo, &fs_ubo,
+				  vb->descriptor_set);
 
 	for (uint32_t i = 0, first = 0; i < nfans; i++) {
 		const uint32_t *vtxcntp = vtxcnt.data;
@@ -1799,19 +2328,19 @@ draw_paint_node(struct weston_paint_node *pnode,
 	pipeline = vulkan_renderer_get_pipeline(vr, &pconf.req);
 	assert(pipeline);
 
-	VkSampler sampler;
-	VkImageView image_view;
+	struct vulkan_descriptor_key key = { 0 };
 	if (vb->texture.image_view) {
-		image_view = vb->texture.image_view;
-		sampler = pnode->needs_filtering ? vb->sampler_linear : vb->sampler_nearest;
+		key.image_view = vb->texture.image_view;
+		key.sampler = pnode->needs_filtering ? vb->sampler_linear : vb->sampler_nearest;
 	} else {
-		image_view = vr->dummy.image.image_view;
-		sampler = vr->dummy.sampler;
+		key.image_view = vr->dummy.image.image_view;
+		key.sampler = vr->dummy.sampler;
 	}
-	create_descriptor_set(vr, fr, &pipeline->descriptor_set_layout,
-			      vb->vs_ubo_buffer, vb->fs_ubo_buffer,
-			      image_view, sampler,
-			      &vb->descriptor_set);
+	vb->descriptor_set =
+		get_cached_descriptor_set(vr, fr, &pipeline->texture_set_layout,
+					  vb->cached_descriptor_sets,
+					  ARRAY_LENGTH(vb->cached_descriptor_sets),
+					  &key);
 
 	if (pnode->is_fully_opaque) {
 		pixman_region32_init_rect(&surface_opaque, 0, 0,
@@ -2072,6 +2601,9 @@ draw_output_border_texture(struct vulkan_renderer *vr,
 {
 	struct vulkan_border_image *border = &vo->borders[side];
 	struct vulkan_pipeline *pipeline;
+	/* the texcoord shader variant does not use surface_to_buffer */
+	struct vs_ubo vs_ubo = { 0 };
+	struct fs_ubo fs_ubo;
 
 	if (!border->data)
 		return;
@@ -2088,27 +2620,25 @@ draw_output_border_texture(struct vulkan_renderer *vr,
 	pipeline = vulkan_renderer_get_pipeline(vr, &pconf->req);
 	assert(pipeline);
 
-	create_descriptor_set(vr, fr, &pipeline->descriptor_set_layout,
-			      border->vs_ubo_buffer, border->fs_ubo_buffer,
-			      border->texture.image_view, border->sampler,
-			      &border->descriptor_set);
+	const struct vulkan_descriptor_key key = {
+		.image_view = border->texture.image_view,
+		.sampler = border->sampler,
+	};
+	border->descriptor_set =
+		get_cached_descriptor_set(vr, fr, &pipeline->texture_set_layout,
+					  &border->cached_descriptor_set, 1, &key);
 
 	vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
 	memcpy(vbuf->map + vbuf->offset, position, sizeof(position));
 
 	vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &vbuf->buffer, &vbuf->offset);
 
-	memcpy(border->vs_ubo_map + offsetof(struct vs_ubo, proj),
-	       pconf->projection.M.colmaj, sizeof(pconf->projection.M.colmaj));
-	memset(border->vs_ubo_map + offsetof(struct vs_ubo, surface_to_buffer),
-	       0, sizeof(pconf->surface_to_buffer.M.colmaj));
-	memcpy(border->fs_ubo_map + offsetof(struct fs_ubo, unicolor),
-	       pconf->unicolor, sizeof(pconf->unicolor));
-	memcpy(border->fs_ubo_map + offsetof(struct fs_ubo, view_alpha),
-	       &pconf->view_alpha, sizeof(pconf->view_alpha));
+	memcpy(vs_ubo.proj, pconf->projection.M.colmaj, sizeof(vs_ubo.proj));
+	memcpy(fs_ubo.unicolor, pconf->unicolor, sizeof(fs_ubo.unicolor));
+	fs_ubo.view_alpha = pconf->view_alpha;
 
-	vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipeline->pipeline_layout, 0, 1, &border->descriptor_set, 0, NULL);
+	bind_draw_descriptor_sets(vr, fr, pipeline, &vs_ubo, &fs_ubo,
+				  border->descriptor_set);
 
 	vkCmdDraw(cmd_buffer, 4, 1, 0, 0);
 
@@ -2419,8 +2949,10 @@ vulkan_renderer_repaint_output(struct weston_output *output,
 	struct vulkan_renderer_frame *fr = &vo->frames[vo->frame_index];
 
 	assert(vo->frame_index < vo->num_frames);
-	vkWaitForFences(vr->dev, 1, &vo->frames[vo->frame_index].fence, VK_TRUE, UINT64_MAX);
-	vkResetFences(vr->dev, 1, &vo->frames[vo->frame_index].fence);
+	/* Only waits if the GPU is num_frames repaints of this output behind */
+	vulkan_timeline_wait(vr, fr->point);
+
+	free_retired_buffer_states(vr);
 
 	struct vulkan_renderer_frame_acquire_fence *acquire_fence, *ftmp;
 	wl_list_for_each_safe(acquire_fence, ftmp, &fr->acquire_fence_list, link) {
@@ -2430,9 +2962,14 @@ vulkan_renderer_repaint_output(struct weston_output *output,
 	}
 
 	reset_vertex_buffers(vr, fr);
+	reset_uniform_buffers(vr, fr);
 
 	reset_descriptor_pool(vr, fr);
 
+	vr->descriptors.frame_allocated = 0;
+	vr->descriptors.cached_allocated = 0;
+	vr->descriptors.reused = 0;
+
 	/* Clear the used_in_output_repaint flag, so that we can properly track
 	 * which surfaces were used in this output repaint. */
 	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
@@ -2575,8 +3112,21 @@ vulkan_renderer_repaint_output(struct weston_output *output,
 		submit_info.pSignalSemaphores = &im->render_done;
 	}
 
-	result = vkQueueSubmit(vr->queue, 1, &submit_info, fr->fence);
-	check_vk_success(result, "vkQueueSubmit");
+	/* Texture uploads go first, this frame may sample from them. */
+	vulkan_renderer_submit_uploads(vr);
+
+	fr->point = vulkan_timeline_submit(vr, &submit_info);
+
+	if (weston_log_scope_is_enabled(vr->descriptors.scope))
+		weston_log_scope_printf(vr->descriptors.scope,
+					"output %s: %u descriptor sets allocated "
+					"for this frame, %u for the cache, "
+					"%u reused from it, %u cached in total\n",
+					output->name,
+					vr->descriptors.frame_allocated,
+					vr->descriptors.cached_allocated,
+					vr->descriptors.reused,
+					vr->descriptors.cached_count);
 
 	if (vo->output_type == VULKAN_OUTPUT_SWAPCHAIN) {
 		assert(vulkan_device_has(vr, EXTENSION_KHR_SWAPCHAIN));
@@ -2695,88 +3245,102 @@ create_texture_sampler(struct vulkan_renderer *vr, VkSampler *texture_sampler, V
 	check_vk_success(result, "vkCreateSampler");
 }
 
+/* Copies rows of pixels, in one go if they are contiguous in both places */
 static void
-copy_buffer_to_sub_image(VkCommandBuffer cmd_buffer,
-			 VkBuffer buffer, VkImage image,
-			 uint32_t buffer_width, uint32_t buffer_height,
-			 uint32_t pitch,
-			 uint32_t bpp,
-			 uint32_t xoff, uint32_t yoff,
-			 uint32_t xcopy, uint32_t ycopy)
+copy_rows(void *dst, const void *src, size_t src_stride, size_t row_size,
+	  uint32_t rows)
 {
-	const VkOffset3D image_offset = { xoff, yoff };
-	const VkExtent3D image_extent = { xcopy, ycopy, 1 };
+	char *d = dst;
+	const char *p = src;
 
-	const VkBufferImageCopy region = {
-		.bufferOffset = ((buffer_width * yoff) + xoff) * (bpp/8),
-		.bufferRowLength = pitch,
-		.bufferImageHeight = buffer_height,
-		.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-		.imageSubresource.mipLevel = 0,
-		.imageSubresource.baseArrayLayer = 0,
-		.imageSubresource.layerCount = 1,
-		.imageOffset = image_offset,
-		.imageExtent = image_extent,
-	};
+	if (src_stride == row_size) {
+		memcpy(d, p, row_size * rows);
+		return;
+	}
 
-	vkCmdCopyBufferToImage(cmd_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(d, p, row_size);
+		d += row_size;
+		p += src_stride;
+	}
 }
 
+/*
+ * Records the upload of the given boxes of pixels into a texture, in the
+ * command buffer of the pending uploads. Only the boxes are copied to staging
+ * memory, tightly packed, and they are all copied to the image at once.
+ */
 static void
 update_texture_image(struct vulkan_renderer *vr,
 		     struct vulkan_renderer_texture_image *texture,
 		     VkImageLayout expected_layout,
 		     const struct pixel_format_info *pixel_format,
-		     uint32_t buffer_width, uint32_t buffer_height,
 		     uint32_t pitch, const void * const pixels,
-		     uint32_t xoff, uint32_t yoff,
-		     uint32_t xcopy, uint32_t ycopy)
+		     const pixman_box32_t *boxes, int nboxes)
 {
-	VkDeviceSize image_size = pitch * buffer_height * (pixel_format->bpp/8);
-	VkResult result;
+	const uint32_t cpp = pixel_format->bpp / 8;
+	/* bufferOffset must be a multiple of both 4 and the texel size */
+	const uint64_t align = 4 * cpp;
+	struct vulkan_renderer_upload *up;
+	struct vulkan_renderer_frame_vbuf *staging;
+	VkBufferImageCopy *regions;
+	uint64_t size = 0, offset;
+	int i;
 
 	assert(pixels);
 
-	memcpy(texture->staging_map, pixels, (size_t)image_size);
-
-	vkWaitForFences(vr->dev, 1, &texture->upload_fence, VK_TRUE, UINT64_MAX);
-	vkResetFences(vr->dev, 1, &texture->upload_fence);
-
-	const VkCommandBufferBeginInfo begin_info = {
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-	};
+	if (nboxes == 0)
+		return;
 
-	VkCommandBuffer cmd_buffer = texture->upload_cmd;
+	for (i = 0; i < nboxes; i++)
+		size += align_up((uint64_t) (boxes[i].x2 - boxes[i].x1) *
+				 (boxes[i].y2 - boxes[i].y1) * cpp, align);
+
+	up = vulkan_renderer_begin_upload(vr);
+	staging = get_host_buffer(vr, &up->staging_list,
+				  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				  size + align);
+	offset = align_up(staging->offset, align);
+	regions = xcalloc(nboxes, sizeof *regions);
+
+	for (i = 0; i < nboxes; i++) {
+		uint32_t w = boxes[i].x2 - boxes[i].x1;
+		uint32_t h = boxes[i].y2 - boxes[i].y1;
+		const char *src = (const char *) pixels +
+			((size_t) boxes[i].y1 * pitch + boxes[i].x1) * cpp;
+
+		copy_rows((char *) staging->map + offset, src,
+			  (size_t) pitch * cpp, (size_t) w * cpp, h);
+
+		regions[i] = (VkBufferImageCopy) {
+			.bufferOffset = offset,
+			.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.imageSubresource.layerCount = 1,
+			.imageOffset = { boxes[i].x1, boxes[i].y1, 0 },
+			.imageExtent = { w, h, 1 },
+		};
 
-	result = vkBeginCommandBuffer(cmd_buffer, &begin_info);
-	check_vk_success(result, "vkBeginCommandBuffer");
+		offset += align_up((uint64_t) w * h * cpp, align);
+	}
+	staging->offset = offset;
 
-	transition_image_layout(cmd_buffer, texture->image,
+	/* Wait for the draws of earlier submissions to be done reading */
+	transition_image_layout(up->cmd_buffer, texture->image,
 				expected_layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, VK_ACCESS_TRANSFER_WRITE_BIT);
 
-	copy_buffer_to_sub_image(cmd_buffer, texture->staging_buffer, texture->image,
-				 buffer_width, buffer_height, pitch, pixel_format->bpp,
-				 xoff, yoff, xcopy, ycopy);
+	vkCmdCopyBufferToImage(up->cmd_buffer, staging->buffer, texture->image,
+			       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			       nboxes, regions);
 
-	transition_image_layout(cmd_buffer, texture->image,
+	/* Make the draws of later submissions wait for the copy */
+	transition_image_layout(up->cmd_buffer, texture->image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
 
-	result = vkEndCommandBuffer(cmd_buffer);
-	check_vk_success(result, "vkEndCommandBuffer");
-
-	const VkSubmitInfo submit_info = {
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &cmd_buffer,
-	};
-
-	result = vkQueueSubmit(vr->queue, 1, &submit_info, texture->upload_fence);
-	check_vk_success(result, "vkQueueSubmit");
+	free(regions);
 }
 
 static void
@@ -2787,44 +3351,18 @@ update_texture_image_all(struct vulkan_renderer *vr,
 			 uint32_t buffer_width, uint32_t buffer_height,
 			 uint32_t pitch, const void * const pixels)
 {
+	const pixman_box32_t box = { 0, 0, buffer_width, buffer_height };
+
 	update_texture_image(vr, texture, expected_layout, pixel_format,
-			     buffer_width, buffer_height, pitch, pixels,
-			     0, 0, buffer_width, buffer_height);
+			     pitch, pixels, &box, 1);
 }
 
 static void
 create_texture_image(struct vulkan_renderer *vr,
 		     struct vulkan_renderer_texture_image *texture,
 		     const struct pixel_format_info *pixel_format,
-		     uint32_t buffer_width, uint32_t buffer_height, uint32_t pitch)
+		     uint32_t buffer_width, uint32_t buffer_height)
 {
-	VkDeviceSize image_size = pitch * buffer_height * (pixel_format->bpp/8);
-	VkResult result;
-
-	const VkFenceCreateInfo fence_info = {
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT,
-	};
-	result = vkCreateFence(vr->dev, &fence_info, NULL, &texture->upload_fence);
-	check_vk_success(result, "vkCreateFence");
-
-	const VkCommandBufferAllocateInfo cmd_alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandPool = vr->cmd_pool,
-		.commandBufferCount = 1,
-	};
-	result = vkAllocateCommandBuffers(vr->dev, &cmd_alloc_info, &texture->upload_cmd);
-	check_vk_success(result, "vkAllocateCommandBuffers");
-
-	create_buffer(vr, image_size,
-		      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		      &texture->staging_buffer, &texture->staging_memory);
-
-	result = vkMapMemory(vr->dev, texture->staging_memory, 0, image_size, 0, &texture->staging_map);
-	check_vk_success(result, "vkMapMemory");
-
 	create_image(vr, buffer_width, buffer_height, pixel_format->vulkan_format, VK_IMAGE_TILING_OPTIMAL,
 		     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->image, &texture->memory);
@@ -2845,7 +3383,7 @@ vulkan_renderer_flush_damage(struct weston_paint_node *pnode)
 	struct weston_buffer *buffer = surface->buffer_ref.buffer;
 	struct vulkan_surface_state *vs = get_surface_state(surface);
 	struct vulkan_buffer_state *vb = vs->buffer;
-	pixman_box32_t *rectangles;
+	pixman_box32_t *rectangles, *boxes;
 	uint8_t *data;
 	int n;
 
@@ -2891,27 +3429,35 @@ vulkan_renderer_flush_damage(struct weston_paint_node *pnode)
 	}
 
 	rectangles = pixman_region32_rectangles(&vb->texture_damage, &n);
+	boxes = xcalloc(n, sizeof *boxes);
 	wl_shm_buffer_begin_access(buffer->shm_buffer);
-	for (int i = 0; i < n; i++) {
-		pixman_box32_t r;
-
-		r = weston_surface_to_buffer_rect(surface, rectangles[i]);
-
-		for (int j = 0; j < vb->num_textures; j++) {
-			int hsub = pixel_format_hsub(buffer->pixel_format, j);
-			int vsub = pixel_format_vsub(buffer->pixel_format, j);
-			uint32_t xoff = r.x1 / hsub;
-			uint32_t yoff = r.y1 / vsub;
-			uint32_t xcopy = (r.x2 - r.x1) / hsub;
-			uint32_t ycopy = (r.y2 - r.y1) / vsub;
-			void *pixels = data + vb->offset[j];
-
-			update_texture_image(vr, &vb->texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-					     buffer->pixel_format, buffer->width / hsub, buffer->height / vsub,
-					     vb->pitch, pixels, xoff, yoff, xcopy, ycopy);
+	for (int j = 0; j < vb->num_textures; j++) {
+		int hsub = pixel_format_hsub(buffer->pixel_format, j);
+		int vsub = pixel_format_vsub(buffer->pixel_format, j);
+		void *pixels = data + vb->offset[j];
+		int nboxes = 0;
+
+		for (int i = 0; i < n; i++) {
+			pixman_box32_t r;
+
+			r = weston_surface_to_buffer_rect(surface, rectangles[i]);
+			boxes[nboxes] = (pixman_box32_t) {
+				.x1 = MAX(r.x1, 0) / hsub,
+				.y1 = MAX(r.y1, 0) / vsub,
+				.x2 = MIN(r.x2, buffer->width) / hsub,
+				.y2 = MIN(r.y2, buffer->height) / vsub,
+			};
+			if (boxes[nboxes].x1 < boxes[nboxes].x2 &&
+			    boxes[nboxes].y1 < boxes[nboxes].y2)
+				nboxes++;
 		}
+
+		update_texture_image(vr, &vb->texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				     buffer->pixel_format, vb->pitch, pixels,
+				     boxes, nboxes);
 	}
 	wl_shm_buffer_end_access(buffer->shm_buffer);
+	free(boxes);
 
 done:
 	pixman_region32_fini(&vb->texture_damage);
@@ -3006,12 +3552,10 @@ vulkan_renderer_attach_shm(struct weston_surface *surface, struct weston_buffer
 		uint32_t buffer_width = buffer->width / hsub;
 		uint32_t buffer_height = buffer->height / vsub;
 
-		create_texture_image(vr, &vb->texture, buffer->pixel_format, buffer_width, buffer_height, pitch);
+		create_texture_image(vr, &vb->texture, buffer->pixel_format, buffer_width, buffer_height);
 		create_texture_sampler(vr, &vb->sampler_nearest, VK_FILTER_NEAREST);
 		create_texture_sampler(vr, &vb->sampler_linear, VK_FILTER_LINEAR);
 	}
-	create_vs_ubo_buffer(vr, &vb->vs_ubo_buffer, &vb->vs_ubo_memory, &vb->vs_ubo_map);
-	create_fs_ubo_buffer(vr, &vb->fs_ubo_buffer, &vb->fs_ubo_memory, &vb->fs_ubo_map);
 }
 
 static void
@@ -3019,7 +3563,7 @@ create_texture_image_dummy(struct vulkan_renderer *vr)
 {
 	const struct pixel_format_info *dummy_pixel_format = pixel_format_get_info(DRM_FORMAT_ARGB8888);
 	const uint32_t dummy_pixels[1] = { 0 };
-	create_texture_image(vr, &vr->dummy.image, dummy_pixel_format, 1, 1, 1);
+	create_texture_image(vr, &vr->dummy.image, dummy_pixel_format, 1, 1);
 	create_texture_sampler(vr, &vr->dummy.sampler, VK_FILTER_NEAREST);
 	update_texture_image_all(vr, &vr->dummy.image, VK_IMAGE_LAYOUT_UNDEFINED,
 				 dummy_pixel_format, 1, 1, 1, dummy_pixels);
@@ -3047,9 +3591,6 @@ ensure_renderer_vulkan_buffer_state(struct weston_surface *surface,
 
 	vs->buffer = vb;
 
-	create_vs_ubo_buffer(vr, &vb->vs_ubo_buffer, &vb->vs_ubo_memory, &vb->vs_ubo_map);
-	create_fs_ubo_buffer(vr, &vb->fs_ubo_buffer, &vb->fs_ubo_memory, &vb->fs_ubo_map);
-
 	return vb;
 }
 
@@ -3202,13 +3743,13 @@ vulkan_renderer_output_destroy_border(struct weston_output *output,
 	// Wait idle here is bad, but this is only resize/refocus
 	// and not on drm-backend
 	VkResult result;
+	vulkan_renderer_submit_uploads(vr);
 	result = vkQueueWaitIdle(vr->queue);
 	check_vk_success(result, "vkQueueWaitIdle");
 
 	struct vulkan_border_image *border = &vo->borders[side];
 
-	destroy_buffer(vr->dev, border->fs_ubo_buffer, border->fs_ubo_memory);
-	destroy_buffer(vr->dev, border->vs_ubo_buffer, border->vs_ubo_memory);
+	release_cached_descriptor_sets(vr, &border->cached_descriptor_set, 1);
 
 	destroy_sampler(vr->dev, border->sampler);
 	destroy_texture_image(vr, &border->texture);
@@ -3252,13 +3793,10 @@ vulkan_renderer_output_set_border(struct weston_output *output,
 	const struct pixel_format_info *pixel_format = pixel_format_get_info(drm_format);
 	uint32_t pitch = tex_width;
 
-	create_texture_image(vr, &border->texture, pixel_format, tex_width, height, pitch);
+	create_texture_image(vr, &border->texture, pixel_format, tex_width, height);
 	create_texture_sampler(vr, &border->sampler, VK_FILTER_NEAREST);
 	update_texture_image_all(vr, &border->texture, VK_IMAGE_LAYOUT_UNDEFINED,
 				 pixel_format, tex_width, height, pitch, data);
-
-	create_vs_ubo_buffer(vr, &border->vs_ubo_buffer, &border->vs_ubo_memory, &border->vs_ubo_map);
-	create_fs_ubo_buffer(vr, &border->fs_ubo_buffer, &border->fs_ubo_memory, &border->fs_ubo_map);
 }
 
 static bool
@@ -3575,15 +4113,11 @@ vulkan_renderer_create_output_frames(struct weston_output *output,
 		result = vkCreateSemaphore(vr->dev, &semaphore_info, NULL, &fr->image_acquired);
 		check_vk_success(result, "vkCreateSemaphore image_acquired");
 
-		const VkFenceCreateInfo fence_info = {
-			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-			.flags = VK_FENCE_CREATE_SIGNALED_BIT,
-		};
-		result = vkCreateFence(vr->dev, &fence_info, NULL, &fr->fence);
-		check_vk_success(result, "vkCreateFence");
-
+		fr->point = 0;
 		wl_list_init(&fr->dspool_list);
 		wl_list_init(&fr->vbuf_list);
+		wl_list_init(&fr->ubuf_list);
+		fr->uniform_buffer = VK_NULL_HANDLE;
 		wl_list_init(&fr->acquire_fence_list);
 	}
 
@@ -3626,6 +4160,9 @@ create_renderpass(struct weston_output *output, VkFormat format, VkImageLayout a
 	result = vkCreateRenderPass(vr->dev, &renderpass_create_info, NULL, &vo->renderpass);
 	check_vk_success(result, "vkCreateRenderPass");
 
+	vulkan_pipeline_cache_add_renderpass(vr, vo->renderpass, format,
+					     attachment_layout);
+
 	return 0;
 }
 
@@ -3711,18 +4248,34 @@ static void
 vulkan_renderer_destroy(struct weston_compositor *ec)
 {
 	struct vulkan_renderer *vr = get_renderer(ec);
+	struct vulkan_capture_task *vk_task, *tmp;
 
 	wl_signal_emit(&vr->destroy_signal, vr);
 
 	VkResult result;
+	vulkan_renderer_submit_uploads(vr);
 	result = vkDeviceWaitIdle(vr->dev);
 	check_vk_success(result, "vkDeviceWaitIdle");
 
+	free_retired_buffer_states(vr);
+	assert(wl_list_empty(&vr->retired_buffer_states));
+
+	wl_list_for_each_safe(vk_task, tmp, &vr->pending_capture_list, link)
+		destroy_capture_task(vk_task);
+
+	destroy_cached_descriptor_pools(vr);
+	weston_log_scope_destroy(vr->descriptors.scope);
+
 	vulkan_renderer_pipeline_list_destroy(vr);
+	vulkan_pipeline_cache_fini(vr);
 
 	destroy_sampler(vr->dev, vr->dummy.sampler);
 	destroy_texture_image(vr, &vr->dummy.image);
 
+	destroy_uploads(vr);
+
+	vulkan_timeline_fini(vr);
+
 	vkDestroyCommandPool(vr->dev, vr->cmd_pool, NULL);
 
 	vkDestroyDevice(vr->dev, NULL);
@@ -3813,6 +4366,10 @@ vulkan_renderer_choose_physical_device(struct vulkan_renderer *vr)
 
 	vr->phys_dev = physical_device;
 
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(physical_device, &props);
+	vr->uniform_align = props.limits.minUniformBufferOffsetAlignment;
+
 	free(phys_devs);
 
 	log_vulkan_phys_dev(physical_device);
@@ -3985,9 +4542,6 @@ vulkan_renderer_import_dmabuf(struct weston_compositor *ec,
 	assert(vb->num_textures == 0);
 	vb->num_textures = 1;
 
-	create_vs_ubo_buffer(vr, &vb->vs_ubo_buffer, &vb->vs_ubo_memory, &vb->vs_ubo_map);
-	create_fs_ubo_buffer(vr, &vb->fs_ubo_buffer, &vb->fs_ubo_memory, &vb->fs_ubo_map);
-
 	linux_dmabuf_buffer_set_user_data(dmabuf, vb,
 		vulkan_renderer_destroy_dmabuf);
 
@@ -4281,6 +4835,12 @@ vulkan_renderer_setup_device_extensions(struct vulkan_renderer *vr)
 		load_device_proc(vr, "vkGetSemaphoreFdKHR", &vr->get_semaphore_fd);
 		load_device_proc(vr, "vkImportSemaphoreFdKHR", &vr->import_semaphore_fd);
 	}
+
+	// VK_KHR_timeline_semaphore
+	if (vulkan_device_has(vr, EXTENSION_KHR_TIMELINE_SEMAPHORE)) {
+		load_device_proc(vr, "vkGetSemaphoreCounterValueKHR", &vr->get_semaphore_counter_value);
+		load_device_proc(vr, "vkWaitSemaphoresKHR", &vr->wait_semaphores);
+	}
 }
 
 static void
@@ -4300,6 +4860,21 @@ vulkan_renderer_create_device(struct vulkan_renderer *vr)
 			      avail_device_extns, num_avail_device_extns,
 			      &vr->device_extensions);
 
+	/* The extension is of no use without the feature */
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+	};
+	if (vulkan_instance_has(vr, EXTENSION_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2) &&
+	    vulkan_device_has(vr, EXTENSION_KHR_TIMELINE_SEMAPHORE)) {
+		VkPhysicalDeviceFeatures2 features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		};
+		pnext(&features, &timeline_features);
+		vkGetPhysicalDeviceFeatures2(vr->phys_dev, &features);
+	}
+	if (!timeline_features.timelineSemaphore)
+		vr->device_extensions &= ~((uint64_t) EXTENSION_KHR_TIMELINE_SEMAPHORE);
+
 	const char **device_extns = xmalloc(num_avail_device_extns * sizeof(*device_extns));
 
 	for (uint32_t i = 0; i < ARRAY_LENGTH(vulkan_device_ext_table); i++) {
@@ -4319,6 +4894,7 @@ vulkan_renderer_create_device(struct vulkan_renderer *vr)
 
 	const VkDeviceCreateInfo device_create_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = timeline_features.timelineSemaphore ? &timeline_features : NULL,
 		.queueCreateInfoCount = 1,
 		.pQueueCreateInfos = &device_queue_info,
 		.enabledExtensionCount = num_device_extns,
@@ -4346,6 +4922,8 @@ vulkan_renderer_create_device(struct vulkan_renderer *vr)
 		weston_log("DRM format modifiers not supported\n");
 	if (!exportable_semaphore)
 		weston_log("VkSemaphore is not exportable\n");
+	if (!vulkan_device_has(vr, EXTENSION_KHR_TIMELINE_SEMAPHORE))
+		weston_log("Timeline semaphores not supported, using fences\n");
 	if (!importable_semaphore)
 		weston_log("VkSemaphore is not importable\n");
 
@@ -4368,6 +4946,8 @@ vulkan_renderer_display_create(struct weston_compositor *ec,
 
 	vr->compositor = ec;
 	wl_list_init(&vr->pipeline_list);
+	wl_list_init(&vr->retired_buffer_states);
+	wl_list_init(&vr->pending_capture_list);
 	vr->base.repaint_output = vulkan_renderer_repaint_output;
 	vr->base.resize_output = vulkan_renderer_resize_output;
 	vr->base.create_renderbuffer = vulkan_renderer_create_renderbuffer;
@@ -4394,6 +4974,10 @@ vulkan_renderer_display_create(struct weston_compositor *ec,
 
 	vulkan_renderer_create_device(vr);
 
+	vulkan_timeline_init(vr);
+
+	vulkan_pipeline_cache_init(vr);
+
 	weston_log("Vulkan instance extensions:\n");
 	for (uint32_t i = 0; i < ARRAY_LENGTH(vulkan_inst_ext_table); i++) {
 		const struct vulkan_extension_table *ext = &vulkan_inst_ext_table[i];
@@ -4463,6 +5047,15 @@ vulkan_renderer_display_create(struct weston_compositor *ec,
 	result = vkCreateCommandPool(vr->dev, &cmd_pool_create_info, NULL, &vr->cmd_pool);
 	check_vk_success(result, "vkCreateCommandPool");
 
+	create_uploads(vr);
+
+	wl_list_init(&vr->descriptors.pool_list);
+	vr->descriptors.scope =
+		weston_compositor_add_log_scope(ec, "vulkan-descriptors",
+			"Descriptor sets allocated and reused by each Vulkan "
+			"output repaint.\n",
+			NULL, NULL, vr);
+
 	ec->read_format = pixel_format_get_info(DRM_FORMAT_ARGB8888);
 
 	create_texture_image_dummy(vr); /* Workaround for solids */
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Submission timeline of the Vulkan renderer
+ *
+ * Every submission to the renderer's queue signals the next point of a
+ * timeline semaphore. Whatever the GPU uses remembers the point of the last
+ * submission using it, and is reused or destroyed once the timeline has
+ * reached that point: the CPU only ever waits for the work it is about to
+ * touch the resources of, never for the whole queue.
+ *
+ * Without VK_KHR_timeline_semaphore, each submission signals a fence of its
+ * own instead, and a point is reached once the fences of the submissions up
+ * to it are signalled.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan-renderer.h"
+#include "vulkan-renderer-internal.h"
+#include "shared/xalloc.h"
+
+struct vulkan_timeline_fence {
+	VkFence fence;
+	uint64_t point;
+	struct wl_list link; /* vulkan_renderer::timeline.pending */
+};
+
+void
+vulkan_timeline_init(struct vulkan_renderer *vr)
+{
+	VkResult result;
+
+	vr->timeline.submitted = 0;
+	vr->timeline.completed = 0;
+	wl_list_init(&vr->timeline.pending);
+	wl_array_init(&vr->timeline.free_fences);
+
+	if (!vulkan_device_has(vr, EXTENSION_KHR_TIMELINE_SEMAPHORE))
+		return;
+
+	const VkSemaphoreTypeCreateInfoKHR type_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+		.initialValue = 0,
+	};
+	const VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info,
+	};
+	result = vkCreateSemaphore(vr->dev, &semaphore_info, NULL,
+				   &vr->timeline.semaphore);
+	check_vk_success(result, "vkCreateSemaphore timeline");
+}
+
+/* Must be called with the queue idle */
+void
+vulkan_timeline_fini(struct vulkan_renderer *vr)
+{
+	struct vulkan_timeline_fence *tf, *tmp;
+	VkFence *fence;
+
+	wl_list_for_each_safe(tf, tmp, &vr->timeline.pending, link) {
+		vkDestroyFence(vr->dev, tf->fence, NULL);
+		wl_list_remove(&tf->link);
+		free(tf);
+	}
+
+	wl_array_for_each(fence, &vr->timeline.free_fences)
+		vkDestroyFence(vr->dev, *fence, NULL);
+	wl_array_release(&vr->timeline.free_fences);
+
+	if (vr->timeline.semaphore != VK_NULL_HANDLE)
+		vkDestroySemaphore(vr->dev, vr->timeline.semaphore, NULL);
+}
+
+static VkFence
+get_fence(struct vulkan_renderer *vr)
+{
+	struct wl_array *free_fences = &vr->timeline.free_fences;
+	VkFence fence;
+	VkResult result;
+
+	if (free_fences->size > 0) {
+		free_fences->size -= sizeof(fence);
+		fence = *(VkFence *) ((char *) free_fences->data + free_fences->size);
+		vkResetFences(vr->dev, 1, &fence);
+		return fence;
+	}
+
+	const VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+	};
+	result = vkCreateFence(vr->dev, &fence_info, NULL, &fence);
+	check_vk_success(result, "vkCreateFence");
+
+	return fence;
+}
+
+/* The fence of a submission is signalled, and those of all the earlier ones */
+static void
+retire_fence(struct vulkan_renderer *vr, struct vulkan_timeline_fence *tf)
+{
+	VkFence *slot;
+
+	vr->timeline.completed = tf->point;
+
+	slot = wl_array_add(&vr->timeline.free_fences, sizeof(*slot));
+	if (slot)
+		*slot = tf->fence;
+	else
+		vkDestroyFence(vr->dev, tf->fence, NULL);
+
+	wl_list_remove(&tf->link);
+	free(tf);
+}
+
+/** Submit work to the renderer's queue
+ *
+ * \param submit_info The work, signalling any binary semaphores.
+ * \return The point the timeline reaches once the work is done.
+ */
+uint64_t
+vulkan_timeline_submit(struct vulkan_renderer *vr,
+		       const VkSubmitInfo *submit_info)
+{
+	const uint32_t signal_count = submit_info->signalSemaphoreCount;
+	const uint64_t point = vr->timeline.submitted + 1;
+	VkSemaphore signal_semaphores[signal_count + 1];
+	uint64_t signal_values[signal_count + 1];
+	VkSubmitInfo info = *submit_info;
+	VkFence fence = VK_NULL_HANDLE;
+	VkResult result;
+
+	VkTimelineSemaphoreSubmitInfoKHR timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+	};
+
+	if (vr->timeline.semaphore != VK_NULL_HANDLE) {
+		/* Values of binary semaphores are ignored */
+		for (uint32_t i = 0; i < signal_count; i++) {
+			signal_semaphores[i] = submit_info->pSignalSemaphores[i];
+			signal_values[i] = 0;
+		}
+		signal_semaphores[signal_count] = vr->timeline.semaphore;
+		signal_values[signal_count] = point;
+
+		timeline_info.signalSemaphoreValueCount = signal_count + 1;
+		timeline_info.pSignalSemaphoreValues = signal_values;
+		info.signalSemaphoreCount = signal_count + 1;
+		info.pSignalSemaphores = signal_semaphores;
+		pnext(&info, &timeline_info);
+	} else {
+		fence = get_fence(vr);
+	}
+
+	result = vkQueueSubmit(vr->queue, 1, &info, fence);
+	check_vk_success(result, "vkQueueSubmit");
+
+	if (fence != VK_NULL_HANDLE) {
+		struct vulkan_timeline_fence *tf = xzalloc(sizeof(*tf));
+
+		tf->fence = fence;
+		tf->point = point;
+		wl_list_insert(vr->timeline.pending.prev, &tf->link);
+	}
+
+	vr->timeline.submitted = point;
+
+	return point;
+}
+
+/** Whether the work submitted up to a point is done, without waiting */
+bool
+vulkan_timeline_reached(struct vulkan_renderer *vr, uint64_t point)
+{
+	struct vulkan_timeline_fence *tf, *tmp;
+	VkResult result;
+
+	if (point <= vr->timeline.completed)
+		return true;
+
+	if (vr->timeline.semaphore != VK_NULL_HANDLE) {
+		uint64_t value;
+
+		result = vr->get_semaphore_counter_value(vr->dev,
+							 vr->timeline.semaphore,
+							 &value);
+		check_vk_success(result, "vkGetSemaphoreCounterValueKHR");
+		vr->timeline.completed = MAX(vr->timeline.completed, value);
+	} else {
+		wl_list_for_each_safe(tf, tmp, &vr->timeline.pending, link) {
+			if (vkGetFenceStatus(vr->dev, tf->fence) != VK_SUCCESS)
+				break;
+			retire_fence(vr, tf);
+		}
+	}
+
+	return point <= vr->timeline.completed;
+}
+
+/** Wait for the work submitted up to a point to be done */
+void
+vulkan_timeline_wait(struct vulkan_renderer *vr, uint64_t point)
+{
+	struct vulkan_timeline_fence *tf, *tmp;
+	VkResult result;
+
+	assert(point <= vr->timeline.submitted);
+
+	if (vulkan_timeline_reached(vr, point))
+		return;
+
+	if (vr->timeline.semaphore != VK_NULL_HANDLE) {
+		const VkSemaphoreWaitInfoKHR wait_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+			.semaphoreCount = 1,
+			.pSemaphores = &vr->timeline.semaphore,
+			.pValues = &point,
+		};
+
+		result = vr->wait_semaphores(vr->dev, &wait_info, UINT64_MAX);
+		check_vk_success(result, "vkWaitSemaphoresKHR");
+		vr->timeline.completed = point;
+	} else {
+		wl_list_for_each_safe(tf, tmp, &vr->timeline.pending, link) {
+			if (tf->point > point)
+				break;
+
+			result = vkWaitForFences(vr->dev, 1, &tf->fence,
+						 VK_TRUE, UINT64_MAX);
+			check_vk_success(result, "vkWaitForFences");
+			retire_fence(vr, tf);
+		}
+	}
+}
@@ -1,10 +1,10 @@
 #version 450
 
-layout(binding = 1) uniform _ubo {
+layout(set = 0, binding = 1) uniform _ubo {
 	uniform vec4 unicolor;
 	uniform float view_alpha;
 } ubo;
-layout(binding = 2) uniform sampler2D tex;
+layout(set = 1, binding = 0) uniform sampler2D tex;
 
 layout(location = 1) in vec2 v_texcoord;
 
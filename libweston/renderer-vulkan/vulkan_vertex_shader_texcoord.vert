@@ -1,6 +1,6 @@
 #version 450
 
-layout(binding = 0) uniform _ubo {
+layout(set = 0, binding = 0) uniform _ubo {
 	uniform mat4 proj;
 	uniform mat4 surface_to_buffer;
 } ubo;
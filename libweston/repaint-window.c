@@ -0,0 +1,148 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Adaptive repaint window
+ *
+ * Rather than reserving the same fixed time before every presentation for
+ * the repaint, the window is chosen from how long repaints on the output
+ * have actually been taking: a high percentile of the recent repaint
+ * durations plus a safety margin. A light scene can then latch client
+ * content much closer to the deadline, while a heavy one starts early
+ * enough to make it.
+ *
+ * Every missed presentation adds to the margin, which then decays back
+ * while frames keep hitting their target.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "repaint-window.h"
+#include "shared/helpers.h"
+
+/* Percentile of the recent repaint durations the window must cover */
+#define REPAINT_WINDOW_PERCENTILE 98
+
+/* Time the backend needs after the repaint before the deadline */
+#define REPAINT_WINDOW_MARGIN_NSEC 1000000
+
+/* Don't trust the histogram before this many samples */
+#define REPAINT_WINDOW_MIN_SAMPLES 16
+
+/* The miss penalty is halved after this many frames without a miss */
+#define REPAINT_WINDOW_PENALTY_DECAY_FRAMES 60
+
+WESTON_EXPORT_FOR_TESTS void
+weston_repaint_window_init(struct weston_repaint_window *rw)
+{
+	memset(rw, 0, sizeof *rw);
+	rw->reported_nsec = -1;
+}
+
+WESTON_EXPORT_FOR_TESTS void
+weston_repaint_window_add_sample(struct weston_repaint_window *rw,
+				 int64_t duration_nsec)
+{
+	int64_t bucket;
+
+	bucket = duration_nsec / (WESTON_REPAINT_WINDOW_BUCKET_USEC * 1000);
+	bucket = CLIP(bucket, 0, WESTON_REPAINT_WINDOW_BUCKETS - 1);
+
+	/* Forget the oldest sample once the ring is full */
+	if (rw->n_samples == WESTON_REPAINT_WINDOW_SAMPLES)
+		rw->histogram[rw->samples[rw->next_sample]]--;
+	else
+		rw->n_samples++;
+
+	rw->samples[rw->next_sample] = bucket;
+	rw->histogram[bucket]++;
+	rw->next_sample = (rw->next_sample + 1) % WESTON_REPAINT_WINDOW_SAMPLES;
+
+	rw->frames++;
+	if (rw->penalty_nsec > 0 &&
+	    ++rw->frames_since_miss >= REPAINT_WINDOW_PENALTY_DECAY_FRAMES) {
+		rw->penalty_nsec /= 2;
+		if (rw->penalty_nsec < WESTON_REPAINT_WINDOW_BUCKET_USEC * 1000)
+			rw->penalty_nsec = 0;
+		rw->frames_since_miss = 0;
+	}
+}
+
+WESTON_EXPORT_FOR_TESTS void
+weston_repaint_window_add_miss(struct weston_repaint_window *rw,
+			       int64_t refresh_nsec)
+{
+	rw->misses++;
+	rw->frames_since_miss = 0;
+
+	rw->penalty_nsec += REPAINT_WINDOW_MARGIN_NSEC;
+	if (rw->penalty_nsec > refresh_nsec / 2)
+		rw->penalty_nsec = refresh_nsec / 2;
+}
+
+WESTON_EXPORT_FOR_TESTS bool
+weston_repaint_window_is_ready(const struct weston_repaint_window *rw)
+{
+	return rw->n_samples >= REPAINT_WINDOW_MIN_SAMPLES;
+}
+
+/** Repaint duration not exceeded by most recent repaints
+ *
+ * Rounded up to the histogram resolution.
+ */
+WESTON_EXPORT_FOR_TESTS int64_t
+weston_repaint_window_get_percentile_nsec(const struct weston_repaint_window *rw)
+{
+	unsigned int wanted;
+	unsigned int seen = 0;
+	unsigned int i;
+
+	if (rw->n_samples == 0)
+		return 0;
+
+	wanted = DIV_ROUND_UP(rw->n_samples * REPAINT_WINDOW_PERCENTILE, 100);
+
+	for (i = 0; i < WESTON_REPAINT_WINDOW_BUCKETS - 1; i++) {
+		seen += rw->histogram[i];
+		if (seen >= wanted)
+			break;
+	}
+
+	return (int64_t)(i + 1) * WESTON_REPAINT_WINDOW_BUCKET_USEC * 1000;
+}
+
+/** The time to reserve before the presentation for the repaint
+ *
+ * Only meaningful once weston_repaint_window_is_ready(). Not clamped to the
+ * refresh period of the output.
+ */
+WESTON_EXPORT_FOR_TESTS int64_t
+weston_repaint_window_get_nsec(const struct weston_repaint_window *rw)
+{
+	return weston_repaint_window_get_percentile_nsec(rw) +
+	       REPAINT_WINDOW_MARGIN_NSEC + rw->penalty_nsec;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of most recent repaints the window is chosen from */
+#define WESTON_REPAINT_WINDOW_SAMPLES 128
+
+/* Histogram resolution is 100 us; the last bucket collects everything
+ * longer than that range. */
+#define WESTON_REPAINT_WINDOW_BUCKET_USEC 100
+#define WESTON_REPAINT_WINDOW_BUCKETS 400
+
+/** Per-output record of how long repaints take
+ *
+ * Keeps a histogram of the durations of the most recent repaints, from the
+ * start of the repaint to the backend having committed the new frame, and
+ * counts the frames that missed their target presentation time.
+ */
+struct weston_repaint_window {
+	uint32_t samples[WESTON_REPAINT_WINDOW_SAMPLES]; /* bucket indices */
+	unsigned int n_samples;
+	unsigned int next_sample;
+	uint16_t histogram[WESTON_REPAINT_WINDOW_BUCKETS];
+
+	/* Extra margin after recent misses, decays while frames hit */
+	int64_t penalty_nsec;
+	unsigned int frames_since_miss;
+
+	uint64_t frames;
+	uint64_t misses;
+
+	/* Last window reported, to only log changes */
+	int64_t reported_nsec;
+};
+
+void
+weston_repaint_window_init(struct weston_repaint_window *rw);
+
+void
+weston_repaint_window_add_sample(struct weston_repaint_window *rw,
+				 int64_t duration_nsec);
+
+void
+weston_repaint_window_add_miss(struct weston_repaint_window *rw,
+			       int64_t refresh_nsec);
+
+bool
+weston_repaint_window_is_ready(const struct weston_repaint_window *rw);
+
+int64_t
+weston_repaint_window_get_percentile_nsec(const struct weston_repaint_window *rw);
+
+int64_t
+weston_repaint_window_get_nsec(const struct weston_repaint_window *rw);
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "slab-pool.h"
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+
+struct weston_slab {
+	struct wl_list link; /* weston_slab_pool::slab_list */
+	alignas(max_align_t) unsigned char objects[];
+};
+
+/* Freed objects are chained through their first bytes */
+struct weston_slab_free_object {
+	void *next;
+};
+
+static size_t
+slab_object_stride(size_t object_size)
+{
+	size_t align = alignof(max_align_t);
+
+	object_size = MAX(object_size, sizeof(struct weston_slab_free_object));
+
+	return (object_size + align - 1) / align * align;
+}
+
+/** Create a slab pool
+ *
+ * \param name Name of the pool in debug output, must outlive the pool.
+ * \param object_size Size of the objects handed out.
+ * \param objects_per_slab Number of objects allocated at once.
+ */
+WESTON_EXPORT_FOR_TESTS struct weston_slab_pool *
+weston_slab_pool_create(const char *name, size_t object_size,
+			unsigned int objects_per_slab)
+{
+	struct weston_slab_pool *pool;
+
+	assert(objects_per_slab > 0);
+
+	pool = xzalloc(sizeof *pool);
+	pool->name = name;
+	pool->object_size = object_size;
+	pool->objects_per_slab = objects_per_slab;
+	wl_list_init(&pool->slab_list);
+
+	return pool;
+}
+
+/** Destroy a slab pool and all its slabs
+ *
+ * If objects are still in use, they are reported, and the pool is leaked
+ * rather than freed under them.
+ */
+WESTON_EXPORT_FOR_TESTS void
+weston_slab_pool_destroy(struct weston_slab_pool *pool)
+{
+	struct weston_slab *slab, *tmp;
+
+	if (pool->n_in_use > 0) {
+		weston_log("%u %s were never freed.\n",
+			   pool->n_in_use, pool->name);
+		return;
+	}
+
+	wl_list_for_each_safe(slab, tmp, &pool->slab_list, link) {
+		wl_list_remove(&slab->link);
+		free(slab);
+	}
+
+	free(pool);
+}
+
+#if ENABLE_SLAB_POOLS
+static void
+slab_pool_grow(struct weston_slab_pool *pool)
+{
+	size_t stride = slab_object_stride(pool->object_size);
+	struct weston_slab *slab;
+	unsigned int i;
+
+	slab = xmalloc(sizeof *slab + stride * pool->objects_per_slab);
+	wl_list_insert(pool->slab_list.prev, &slab->link);
+	pool->n_slabs++;
+
+	/* Chain the new objects in address order */
+	for (i = pool->objects_per_slab; i-- > 0; ) {
+		struct weston_slab_free_object *object;
+
+		object = (void *)(slab->objects + i * stride);
+		object->next = pool->free_list;
+		pool->free_list = object;
+	}
+}
+
+#endif
+
+/** Allocate a zero-initialized object from the pool
+ *
+ * Aborts when out of memory, like xzalloc().
+ */
+WESTON_EXPORT_FOR_TESTS void *
+weston_slab_pool_alloc(struct weston_slab_pool *pool)
+{
+	struct weston_slab_free_object *object;
+
+#if ENABLE_SLAB_POOLS
+	if (!pool->free_list)
+		slab_pool_grow(pool);
+
+	object = pool->free_list;
+	pool->free_list = object->next;
+
+	memset(object, 0, pool->object_size);
+#else
+	object = xzalloc(pool->object_size);
+#endif
+
+	pool->n_allocs++;
+	pool->n_in_use++;
+	pool->n_peak = MAX(pool->n_peak, pool->n_in_use);
+
+	return object;
+}
+
+/** Return an object to the pool */
+WESTON_EXPORT_FOR_TESTS void
+weston_slab_pool_free(struct weston_slab_pool *pool, void *object)
+{
+	struct weston_slab_free_object *free_object = object;
+
+	if (!object)
+		return;
+
+	assert(pool->n_in_use > 0);
+	pool->n_in_use--;
+
+#if ENABLE_SLAB_POOLS
+	free_object->next = pool->free_list;
+	pool->free_list = free_object;
+#else
+	free(free_object);
+#endif
+}
+
+void
+weston_slab_pool_print(const struct weston_slab_pool *pool, FILE *fp)
+{
+	unsigned int capacity = pool->n_slabs * pool->objects_per_slab;
+
+	fprintf(fp, "%s: %u in use, %u peak, %u free in %u slabs "
+		"of %zu bytes, %" PRIu64 " allocations\n",
+		pool->name, pool->n_in_use, pool->n_peak,
+		capacity - pool->n_in_use, pool->n_slabs,
+		sizeof(struct weston_slab) +
+		slab_object_stride(pool->object_size) * pool->objects_per_slab,
+		pool->n_allocs);
+}
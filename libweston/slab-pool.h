@@ -0,0 +1,72 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <wayland-util.h>
+
+/** Pool of fixed-size objects carved out of larger slabs
+ *
+ * Freed objects are kept for reuse instead of being returned to the system
+ * allocator, and objects allocated close in time end up close in memory.
+ * Slabs are only released when the pool is destroyed.
+ *
+ * Built with -Dslab-pools=false, every object is allocated and freed on its
+ * own instead, so that ASan and valgrind catch use after free on them.
+ */
+struct weston_slab_pool {
+	const char *name;
+	size_t object_size;
+	unsigned int objects_per_slab;
+
+	struct wl_list slab_list; /* struct weston_slab::link */
+	void *free_list;
+
+	/* Accounting, for the debug scope */
+	unsigned int n_slabs;
+	unsigned int n_in_use;
+	unsigned int n_peak;
+	uint64_t n_allocs;
+};
+
+struct weston_slab_pool *
+weston_slab_pool_create(const char *name, size_t object_size,
+			unsigned int objects_per_slab);
+
+void
+weston_slab_pool_destroy(struct weston_slab_pool *pool);
+
+void *
+weston_slab_pool_alloc(struct weston_slab_pool *pool);
+
+void
+weston_slab_pool_free(struct weston_slab_pool *pool, void *object);
+
+void
+weston_slab_pool_print(const struct weston_slab_pool *pool, FILE *fp);
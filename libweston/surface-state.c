@@ -437,6 +437,13 @@ weston_surface_apply_state(struct weston_surface *surface,
 		apply_damage_buffer(&surface->damage, surface, state);
 		surface->frame_commit_counter++;
 
+		surface->perf.commits++;
+		if (surface->perf_update_pending)
+			surface->perf.dropped++;
+		surface->perf_update_pending = true;
+		weston_compositor_read_presentation_clock(surface->compositor,
+							  &surface->perf_update_time);
+
 		pixman_region32_intersect_rect(&surface->damage,
 					       &surface->damage,
 					       0, 0,
@@ -697,28 +704,26 @@ weston_surface_state_merge_from(struct weston_surface_state *dst,
 	src->status = WESTON_SURFACE_CLEAN;
 }
 
+/* All deferred content updates of a surface are on the same queue, since a
+ * new one is always queued behind the ones already pending. The surface keeps
+ * a reference to that queue for as long as it has any, so finding it does
+ * not need to look at any other surface's content updates.
+ */
 static struct weston_transaction_queue *
-weston_surface_find_parent_transaction_queue(struct weston_compositor *comp,
-					     struct weston_surface *surface)
+weston_surface_find_parent_transaction_queue(struct weston_surface *surface)
 {
-	struct weston_transaction_queue *tq;
-	struct weston_transaction *tr;
-	struct weston_content_update *cu;
-
-	wl_list_for_each(tq, &comp->transaction_queue_list, link) {
-		wl_list_for_each(tr, &tq->transaction_list, link)
-			wl_list_for_each(cu, &tr->content_update_list, link) {
-				if (cu->surface == surface)
-					return tq;
-			}
-	}
-
-	return NULL;
+	return surface->transaction_queue;
 }
 
 static void
 weston_content_update_fini(struct weston_content_update *cu)
 {
+	struct weston_surface *surface = cu->surface;
+
+	assert(surface->pending_content_update_count > 0);
+	if (--surface->pending_content_update_count == 0)
+		surface->transaction_queue = NULL;
+
 	wl_list_remove(&cu->link);
 	weston_surface_state_fini(&cu->state);
 	wl_list_remove(&cu->surface_destroy_listener.link);
@@ -756,14 +761,16 @@ weston_transaction_add_content_update(struct weston_transaction *tr,
 {
 	struct weston_content_update *cu;
 
+	assert(tr->queue);
+	assert(!surface->transaction_queue ||
+	       surface->transaction_queue == tr->queue);
+
 	cu = xzalloc(sizeof *cu);
 	cu->transaction = tr;
-	/* Since surfaces don't maintain a list of transactions they're on, we
-	 * can either have the surface destructor walk all transaction lists
-	 * to remove any content updates for a destroyed surface, or hook
-	 * the surface_destroy signal.
-	 *
-	 * The latter is a little easier, so set that up.
+	/* Surfaces only know which queue their content updates are on, not
+	 * the content updates themselves. Rather than have the surface
+	 * destructor walk that queue to remove any content updates for a
+	 * destroyed surface, hook the surface_destroy signal.
 	 */
 	cu->surface_destroy_listener.notify = content_update_surface_destroy;
 	wl_signal_add(&surface->destroy_signal,
@@ -775,6 +782,9 @@ weston_transaction_add_content_update(struct weston_transaction *tr,
 	weston_surface_state_merge_from(&cu->state, state, surface);
 
 	wl_list_insert(&tr->content_update_list, &cu->link);
+
+	surface->transaction_queue = tr->queue;
+	surface->pending_content_update_count++;
 }
 
 static void
@@ -793,10 +803,8 @@ weston_surface_create_transaction(struct weston_compositor *comp,
 	tr->flow_id = transaction_flow_id;
 	wl_list_init(&tr->content_update_list);
 
-	weston_transaction_add_content_update(tr, surface, state);
-
 	/* Figure out if we need to be blocked behind an existing transaction */
-	parent = weston_surface_find_parent_transaction_queue(comp, surface);
+	parent = weston_surface_find_parent_transaction_queue(surface);
 	if (!parent) {
 		/* We weren't blocked by any existing transactions, so set up
 		 * a new list so content updates for this surface can block
@@ -810,6 +818,8 @@ weston_surface_create_transaction(struct weston_compositor *comp,
 	tr->queue = parent;
 	wl_list_insert(parent->transaction_list.prev, &tr->link);
 
+	weston_transaction_add_content_update(tr, surface, state);
+
 	if (need_schedule)
 		weston_repaint_timer_arm(comp);
 }
@@ -854,7 +864,7 @@ weston_surface_commit(struct weston_surface *surface)
 	 * in a single transaction, so these effectively become per surface
 	 * update streams.
 	 */
-	tq = weston_surface_find_parent_transaction_queue(comp, surface);
+	tq = weston_surface_find_parent_transaction_queue(surface);
 	if (tq || !weston_surface_state_ready(surface, state)) {
 		weston_surface_create_transaction(comp, surface, state);
 		return;
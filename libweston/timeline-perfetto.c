@@ -47,6 +47,9 @@ weston_perfetto_ensure_output_ids(struct weston_output *output)
 	snprintf(track_name, sizeof(track_name), "%s GPU activity", output->name);
 	output->gpu_track_id = util_perfetto_new_track(track_name);
 
+	snprintf(track_name, sizeof(track_name), "%s GPU passes", output->name);
+	output->gpu_pass_track_id = util_perfetto_new_track(track_name);
+
 	snprintf(track_name, sizeof(track_name), "%s paint", output->name);
 	output->paint_track_id = util_perfetto_new_track(track_name);
 
@@ -105,6 +108,7 @@ weston_timeline_perfetto(struct weston_log_scope *timeline_scope,
 {
 	struct weston_output *output = NULL;
 	struct weston_surface *surface = NULL;
+	const char *label = NULL;
 	struct timespec ts;
 	uint64_t now_ns;
 	uint64_t vblank_ns = 0, gpu_ns = 0;
@@ -141,6 +145,9 @@ weston_timeline_perfetto(struct weston_log_scope *timeline_scope,
 		case TLT_GPU:
 			gpu_ns = timespec_to_nsec(obj);
 			break;
+		case TLT_LABEL:
+			label = obj;
+			break;
 		default:
 			assert(!"not reached");
 		}
@@ -151,6 +158,8 @@ weston_timeline_perfetto(struct weston_log_scope *timeline_scope,
 	case TLP_CORE_REPAINT_ENTER_LOOP:
 	case TLP_CORE_REPAINT_RESTART:
 	case TLP_CORE_REPAINT_EXIT_LOOP:
+	case TLP_CORE_REPAINT_WINDOW:
+	case TLP_CORE_REPAINT_MISSED:
 		break;
 	case TLP_CORE_FLUSH_DAMAGE:
 		WESTON_TRACE_TIMESTAMP_END("Damaged", surface->damage_track_id, CLOCK_MONOTONIC, now_ns);
@@ -181,6 +190,12 @@ weston_timeline_perfetto(struct weston_log_scope *timeline_scope,
 	case TLP_RENDERER_GPU_END:
 		WESTON_TRACE_TIMESTAMP_END("Active", output->gpu_track_id, CLOCK_MONOTONIC, gpu_ns);
 		break;
+	case TLP_RENDERER_GPU_PASS_BEGIN:
+		WESTON_TRACE_TIMESTAMP_BEGIN(label, output->gpu_pass_track_id, 0, CLOCK_MONOTONIC, gpu_ns);
+		break;
+	case TLP_RENDERER_GPU_PASS_END:
+		WESTON_TRACE_TIMESTAMP_END(label, output->gpu_pass_track_id, CLOCK_MONOTONIC, gpu_ns);
+		break;
 	default:
 		assert(!"not reached");
 	}
@@ -346,6 +346,27 @@ emit_gpu_timestamp(struct timeline_emit_context *ctx, void *obj)
 	return 1;
 }
 
+static int
+emit_label(struct timeline_emit_context *ctx, void *obj)
+{
+	const char *label = obj;
+	const char *c;
+
+	/* Labels can come from clients, e.g. window titles */
+	fprintf(ctx->cur, "\"label\":\"");
+	for (c = label; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fprintf(ctx->cur, "\\%c", *c);
+		else if ((unsigned char) *c < 0x20)
+			fprintf(ctx->cur, "\\u%04x", *c);
+		else
+			fputc(*c, ctx->cur);
+	}
+	fprintf(ctx->cur, "\"");
+
+	return 1;
+}
+
 static struct weston_timeline_subscription_object *
 weston_timeline_get_subscription_object(struct weston_log_subscription *sub,
 		void *object)
@@ -396,6 +417,7 @@ static const type_func type_dispatch[] = {
 	[TLT_SURFACE] = emit_weston_surface,
 	[TLT_VBLANK] = emit_vblank_timestamp,
 	[TLT_GPU] = emit_gpu_timestamp,
+	[TLT_LABEL] = emit_label,
 };
 
 static const char *
@@ -420,10 +442,18 @@ tlp_to_string(enum timeline_point_name tlp)
 		return "core_repaint_enter_loop";
 	case TLP_CORE_COMMIT_DAMAGE:
 		return "core_commit_damage";
+	case TLP_CORE_REPAINT_WINDOW:
+		return "core_repaint_window";
+	case TLP_CORE_REPAINT_MISSED:
+		return "core_repaint_missed";
 	case TLP_RENDERER_GPU_BEGIN:
 		return "renderer_gpu_begin";
 	case TLP_RENDERER_GPU_END:
 		return "renderer_gpu_end";
+	case TLP_RENDERER_GPU_PASS_BEGIN:
+		return "renderer_gpu_pass_begin";
+	case TLP_RENDERER_GPU_PASS_END:
+		return "renderer_gpu_pass_end";
 	}
 	assert(!"not reached");
 }
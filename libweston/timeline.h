@@ -43,6 +43,7 @@ enum timeline_type {
 	TLT_SURFACE,
 	TLT_VBLANK,
 	TLT_GPU,
+	TLT_LABEL,
 };
 
 enum timeline_point_name {
@@ -55,8 +56,12 @@ enum timeline_point_name {
 	TLP_CORE_REPAINT_REQ,
 	TLP_CORE_REPAINT_ENTER_LOOP,
 	TLP_CORE_COMMIT_DAMAGE,
+	TLP_CORE_REPAINT_WINDOW,
+	TLP_CORE_REPAINT_MISSED,
 	TLP_RENDERER_GPU_BEGIN,
-	TLP_RENDERER_GPU_END
+	TLP_RENDERER_GPU_END,
+	TLP_RENDERER_GPU_PASS_BEGIN,
+	TLP_RENDERER_GPU_PASS_END
 };
 
 /** Timeline subscription created for each subscription
@@ -96,6 +101,7 @@ struct weston_timeline_subscription_object {
 #define TLP_SURFACE(s) TLT_SURFACE, TYPEVERIFY(struct weston_surface *, (s))
 #define TLP_VBLANK(t) TLT_VBLANK, TYPEVERIFY(const struct timespec *, (t))
 #define TLP_GPU(t) TLT_GPU, TYPEVERIFY(const struct timespec *, (t))
+#define TLP_LABEL(l) TLT_LABEL, TYPEVERIFY(const char *, (l))
 
 /** This macro is used to add timeline points.
  *
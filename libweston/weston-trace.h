@@ -49,6 +49,8 @@
 			util_perfetto_trace_end();                            \
 	} while (0)
 
+#define _WESTON_TRACE_ENABLED() unlikely(util_perfetto_is_tracing_enabled())
+
 #define _WESTON_TRACE_SET_COUNTER(name, value)                                \
 	do {                                                                  \
 		if (unlikely(util_perfetto_is_tracing_enabled()))             \
@@ -126,6 +128,7 @@ _weston_trace_scope_end(int *scope)
 #define _WESTON_TRACE_SCOPE_FLOW(name, id)
 #define _WESTON_TRACE_FUNC()
 #define _WESTON_TRACE_FUNC_FLOW(id)
+#define _WESTON_TRACE_ENABLED() false
 #define _WESTON_TRACE_SET_COUNTER(name, value)
 #define _WESTON_TRACE_TIMESTAMP_BEGIN(name, track_id, flow_id, clock, timestamp)
 #define _WESTON_TRACE_TIMESTAMP_END(name, track_id, clock, timestamp)
@@ -136,6 +139,7 @@ _weston_trace_scope_end(int *scope)
 #define WESTON_TRACE_SCOPE_FLOW(name, id) _WESTON_TRACE_SCOPE_FLOW(name, id)
 #define WESTON_TRACE_FUNC() _WESTON_TRACE_SCOPE(__func__)
 #define WESTON_TRACE_FUNC_FLOW(id) _WESTON_TRACE_SCOPE_FLOW(__func__, id)
+#define WESTON_TRACE_ENABLED() _WESTON_TRACE_ENABLED()
 #define WESTON_TRACE_SET_COUNTER(name, value) _WESTON_TRACE_SET_COUNTER(name, value)
 #define WESTON_TRACE_TIMESTAMP_BEGIN(name, track_id, flow_id, clock, timestamp) \
 	_WESTON_TRACE_TIMESTAMP_BEGIN(name, track_id, flow_id, clock, timestamp)
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * A minimal fork-join thread pool
+ *
+ * weston_worker_pool_run() hands out job indices to the worker threads and
+ * to the calling thread alike, and only returns once every job has finished.
+ * Jobs must not touch anything the other jobs of the same run write to, and
+ * must not call into libwayland-server: all protocol-visible work stays on
+ * the main thread, before or after the run.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include "worker-pool.h"
+#include "shared/xalloc.h"
+
+struct weston_worker_pool {
+	pthread_t *threads;
+	unsigned int n_workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	/* Protected by mutex */
+	weston_worker_func_t func;
+	void *data;
+	unsigned int count;
+	unsigned int next;
+	unsigned int finished;
+	uint64_t run_serial;
+	bool quit;
+};
+
+/* Run jobs of the current run until none are left. Called with the mutex
+ * held, returns with the mutex held. */
+static void
+worker_pool_drain(struct weston_worker_pool *pool)
+{
+	while (pool->next < pool->count) {
+		weston_worker_func_t func = pool->func;
+		void *data = pool->data;
+		unsigned int index = pool->next++;
+
+		pthread_mutex_unlock(&pool->mutex);
+		func(data, index);
+		pthread_mutex_lock(&pool->mutex);
+
+		if (++pool->finished == pool->count)
+			pthread_cond_signal(&pool->done_cond);
+	}
+}
+
+static void *
+worker_thread_function(void *data)
+{
+	struct weston_worker_pool *pool = data;
+	uint64_t seen_serial = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (true) {
+		while (!pool->quit && pool->run_serial == seen_serial)
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+		if (pool->quit)
+			break;
+
+		seen_serial = pool->run_serial;
+		worker_pool_drain(pool);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+/** Create a worker pool
+ *
+ * \param n_threads The number of threads working on a run, including the
+ * thread calling weston_worker_pool_run(). Must be at least 1.
+ * \return The pool, or NULL if the threads could not be started.
+ */
+struct weston_worker_pool *
+weston_worker_pool_create(unsigned int n_threads)
+{
+	struct weston_worker_pool *pool;
+	unsigned int i;
+
+	assert(n_threads >= 1);
+
+	pool = xzalloc(sizeof *pool);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	if (n_threads > 1)
+		pool->threads = xcalloc(n_threads - 1, sizeof *pool->threads);
+
+	for (i = 0; i < n_threads - 1; i++) {
+		if (pthread_create(&pool->threads[i], NULL,
+				   worker_thread_function, pool) != 0) {
+			weston_log("Failed to start worker thread.\n");
+			weston_worker_pool_destroy(pool);
+			return NULL;
+		}
+		pool->n_workers++;
+	}
+
+	return pool;
+}
+
+void
+weston_worker_pool_destroy(struct weston_worker_pool *pool)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&pool->mutex);
+	assert(pool->next >= pool->count);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->n_workers; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+/** Number of threads working on a run, including the calling thread */
+unsigned int
+weston_worker_pool_get_size(const struct weston_worker_pool *pool)
+{
+	return pool->n_workers + 1;
+}
+
+/** Run jobs on the pool and wait for all of them to finish
+ *
+ * \param pool The pool.
+ * \param func The job function, called once for every index.
+ * \param data Passed to \c func.
+ * \param count Number of jobs.
+ *
+ * The calling thread works on the jobs too. Runs must not be nested.
+ */
+void
+weston_worker_pool_run(struct weston_worker_pool *pool,
+		       weston_worker_func_t func, void *data,
+		       unsigned int count)
+{
+	unsigned int i;
+
+	if (count == 0)
+		return;
+
+	if (count == 1 || pool->n_workers == 0) {
+		for (i = 0; i < count; i++)
+			func(data, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	assert(pool->next >= pool->count);
+
+	pool->func = func;
+	pool->data = data;
+	pool->count = count;
+	pool->next = 0;
+	pool->finished = 0;
+	pool->run_serial++;
+	pthread_cond_broadcast(&pool->work_cond);
+
+	worker_pool_drain(pool);
+
+	while (pool->finished < pool->count)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+	pool->func = NULL;
+	pool->data = NULL;
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -32,8 +32,11 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "file-util.h"
+#include "xalloc.h"
 
 static int
 current_time_str(char *str, size_t len, const char *fmt)
@@ -144,3 +147,148 @@ file_name_with_datadir(const char *filename)
 
 	return out;
 }
+
+/** Create a directory and its missing parents, like mkdir -p
+ *
+ * \param path The directory to create.
+ * \return 0 on success, -1 with errno set otherwise.
+ *
+ * Directories are created private to the user.
+ */
+int
+file_make_directory(const char *path)
+{
+	char *tmp = xstrdup(path);
+	char *p = tmp;
+	int ret = 0;
+	char c;
+
+	do {
+		p++;
+		if (*p != '/' && *p != '\0')
+			continue;
+
+		c = *p;
+		*p = '\0';
+		if (mkdir(tmp, 0700) < 0 && errno != EEXIST) {
+			ret = -1;
+			break;
+		}
+		*p = c;
+	} while (*p != '\0');
+
+	free(tmp);
+
+	return ret;
+}
+
+/** Read a whole regular file
+ *
+ * \param path The file to read.
+ * \param max_size Files bigger than this are not read.
+ * \param size_out The size of the file.
+ * \return The contents, followed by a NUL the size does not include, or NULL.
+ * The caller must free() it.
+ */
+void *
+file_read_all(const char *path, size_t max_size, size_t *size_out)
+{
+	struct stat st;
+	char *data = NULL;
+	size_t done = 0;
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    (size_t) st.st_size > max_size)
+		goto out;
+
+	data = xmalloc(st.st_size + 1);
+	while (done < (size_t) st.st_size) {
+		ret = read(fd, data + done, st.st_size - done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			free(data);
+			data = NULL;
+			goto out;
+		}
+		done += ret;
+	}
+	data[done] = '\0';
+	*size_out = done;
+
+out:
+	close(fd);
+	return data;
+}
+
+/** Write all of a buffer to a file descriptor, retrying short writes */
+bool
+file_write_all(int fd, const void *data, size_t size)
+{
+	const char *p = data;
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = write(fd, p, size);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return false;
+		p += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+/** Atomically replace the contents of a file
+ *
+ * \param path The file to replace.
+ * \param tmp_template The mkstemp() template of the temporary file written
+ * first, in the same directory as path.
+ * \param head The first part of the new contents.
+ * \param head_size The size of head.
+ * \param body The rest of the new contents, NULL if body_size is 0.
+ * \param body_size The size of body.
+ * \return True on success.
+ *
+ * Concurrent readers see either the old file or the complete new one.
+ */
+bool
+file_replace(const char *path, const char *tmp_template,
+	     const void *head, size_t head_size,
+	     const void *body, size_t body_size)
+{
+	char *tmp_path = xstrdup(tmp_template);
+	bool ok;
+	int fd;
+
+#ifdef HAVE_MKOSTEMP
+	fd = mkostemp(tmp_path, O_CLOEXEC);
+#else
+	fd = mkstemp(tmp_path);
+#endif
+	if (fd < 0) {
+		free(tmp_path);
+		return false;
+	}
+
+	ok = file_write_all(fd, head, head_size) &&
+	     file_write_all(fd, body, body_size);
+	if (close(fd) < 0)
+		ok = false;
+	if (ok && rename(tmp_path, path) < 0)
+		ok = false;
+	if (!ok)
+		unlink(tmp_path);
+
+	free(tmp_path);
+
+	return ok;
+}
@@ -30,6 +30,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdio.h>
 
 FILE *
@@ -39,6 +40,20 @@ file_create_dated(const char *path, const char *prefix, const char *suffix,
 char *
 file_name_with_datadir(const char *);
 
+int
+file_make_directory(const char *path);
+
+void *
+file_read_all(const char *path, size_t max_size, size_t *size_out);
+
+bool
+file_write_all(int fd, const void *data, size_t size);
+
+bool
+file_replace(const char *path, const char *tmp_template,
+	     const void *head, size_t head_size,
+	     const void *body, size_t body_size);
+
 #ifdef  __cplusplus
 }
 #endif
@@ -50,6 +50,11 @@ static const struct setup_args my_setup_args[] = {
 		.color_management = false,
 		.meta.name = "pixman"
 	},
+	{
+		.renderer = WESTON_RENDERER_PIXMAN,
+		.color_management = true,
+		.meta.name = "pixman sRGB EOTF"
+	},
 	{
 		.renderer = WESTON_RENDERER_GL,
 		.color_management = false,
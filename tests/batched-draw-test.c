@@ -0,0 +1,171 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+struct setup_args {
+	struct fixture_metadata meta;
+	enum weston_renderer_type renderer;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{
+		.renderer = WESTON_RENDERER_PIXMAN,
+		.meta.name = "pixman"
+	},
+	{
+		.renderer = WESTON_RENDERER_GL,
+		.meta.name = "GL"
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = arg->renderer;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+#define GRID_COLUMNS 6
+#define GRID_ROWS 4
+#define CELL_SIZE 40
+
+static struct surface *
+create_cell(struct client *client, int x, int y, int width, int height,
+	    const pixman_color_t *color, bool opaque)
+{
+	struct rectangle opaque_rect = {
+		.x = 0, .y = 0, .width = width, .height = height
+	};
+	struct surface *surface;
+
+	surface = create_test_surface(client);
+	surface->width = width;
+	surface->height = height;
+	surface->buffer = create_shm_buffer_solid(client, width, height, color);
+	if (opaque)
+		surface_set_opaque_rect(surface, &opaque_rect);
+
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, x, y);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(surface->wl_surface, 0, 0, width, height);
+	wl_surface_commit(surface->wl_surface);
+
+	return surface;
+}
+
+/*
+ * Many small surfaces in a row share their shader and blend state, so the GL
+ * renderer merges them into a few draws, more than one since they outnumber
+ * the textures a draw can sample from. The opaque top rows and translucent
+ * bottom rows go in different draws. Either way, the output must look like
+ * compositing the surfaces one by one.
+ */
+TEST(batched_draws_match_separate_compositing)
+{
+	struct surface *cells[GRID_COLUMNS * GRID_ROWS];
+	struct range fuzz = { -1, 1 };
+	struct surface *background;
+	struct client *client;
+	struct buffer *shot;
+	pixman_image_t *expected;
+	pixman_color_t gray;
+	int done, i, x, y;
+
+	color_rgb888(&gray, 64, 64, 64);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	expected = pixman_image_create_bits(PIXMAN_a8r8g8b8, 320, 240, NULL, 0);
+	test_assert_ptr_not_null(expected);
+	fill_image_with_color(expected, &gray);
+
+	background = create_cell(client, 0, 0, 320, 240, &gray, true);
+
+	for (i = 0; i < GRID_COLUMNS * GRID_ROWS; i++) {
+		bool opaque = i < GRID_COLUMNS * GRID_ROWS / 2;
+		uint32_t alpha = (opaque || i % 2) ? 0xffff : 0x8080;
+		pixman_color_t color = {
+			.red = (i * 0x2b1f) % 0x10000 * alpha / 0xffff,
+			.green = (i * 0x4f53 + 0x3000) % 0x10000 * alpha / 0xffff,
+			.blue = (i * 0x7a2d + 0x8000) % 0x10000 * alpha / 0xffff,
+			.alpha = alpha,
+		};
+		pixman_rectangle16_t rect;
+
+		x = 16 + (i % GRID_COLUMNS) * 50;
+		y = 16 + (i / GRID_COLUMNS) * 54;
+		cells[i] = create_cell(client, x, y, CELL_SIZE, CELL_SIZE,
+				       &color, opaque);
+
+		rect = (pixman_rectangle16_t) {
+			.x = x, .y = y, .width = CELL_SIZE, .height = CELL_SIZE
+		};
+		pixman_image_fill_rectangles(PIXMAN_OP_OVER, expected, &color,
+					     1, &rect);
+	}
+
+	/* wait for everything to show up */
+	frame_callback_set(cells[ARRAY_LENGTH(cells) - 1]->wl_surface, &done);
+	wl_surface_commit(cells[ARRAY_LENGTH(cells) - 1]->wl_surface);
+	frame_callback_wait(client, &done);
+
+	shot = capture_screenshot_of_output(client, NULL, NO_DECORATIONS);
+	test_assert_ptr_not_null(shot);
+
+	test_assert_true(check_images_match(expected, shot->image, NULL,
+					    &fuzz));
+
+	buffer_destroy(shot);
+	pixman_image_unref(expected);
+	for (i = 0; i < GRID_COLUMNS * GRID_ROWS; i++)
+		surface_destroy(cells[i]);
+	surface_destroy(background);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
@@ -49,6 +49,11 @@ static const struct setup_args my_setup_args[] = {
 		.buffer_type = CLIENT_BUFFER_TYPE_DMABUF,
 		.gl_force_import_yuv_fallback = true,
 	},
+	{
+		.meta.name = "pixman - shm",
+		.renderer = WESTON_RENDERER_PIXMAN,
+		.buffer_type = CLIENT_BUFFER_TYPE_SHM,
+	},
 };
 
 static enum test_result_code
@@ -264,3 +264,114 @@ TEST(commit_timing_delete_surface_with_timestamps)
 
 	return RESULT_OK;
 }
+
+/* Queue up a lot of content updates on a lot of surfaces, and make sure
+ * every surface keeps track of its own queue.
+ */
+TEST(commit_timing_many_queued_transactions)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	const unsigned int updates_per_surface = 16;
+	struct client *client;
+	struct surface *surfaces[32];
+	struct buffer *buffers[ARRAY_LENGTH(surfaces)];
+	struct wp_commit_timer_v1 *timers[ARRAY_LENGTH(surfaces)];
+	struct wp_presentation *pres;
+	struct timespec base, target;
+	pixman_color_t red;
+	unsigned int i, j;
+
+	color_rgb888(&red, 255, 0, 0);
+
+	client = create_client_and_test_surface(0, 0, 20, 20);
+	test_assert_ptr_not_null(client);
+
+	pres = client_get_presentation(client);
+	clock_gettime(client_get_presentation_clock(client), &base);
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		surfaces[i] = create_test_surface(client);
+		weston_test_move_surface(client->test->weston_test,
+					 surfaces[i]->wl_surface,
+					 40 + (i % 8) * 30, 20 + (i / 8) * 30);
+		buffers[i] = surface_commit_color(client,
+						  surfaces[i]->wl_surface,
+						  &red, 20, 20);
+		timers[i] = wp_commit_timing_manager_v1_get_timer(client->commit_timing_manager,
+								  surfaces[i]->wl_surface);
+
+		target = base;
+		for (j = 0; j < updates_per_surface; j++) {
+			timespec_add_nsec(&target, &target,
+					  (NSEC_PER_SEC * 60ULL));
+			wp_commit_timer_v1_set_timestamp(timers[i],
+							 (uint64_t)target.tv_sec >> 32,
+							 target.tv_sec,
+							 target.tv_nsec);
+			wl_surface_damage_buffer(surfaces[i]->wl_surface,
+						 0, 0, 20, 20);
+			wl_surface_commit(surfaces[i]->wl_surface);
+		}
+	}
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_damage_buffer(client->surface->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(client->surface->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_view *view, *other;
+		unsigned int queued = 0;
+
+		wl_list_for_each(view, &compositor->view_list, link) {
+			struct weston_surface *surface = view->surface;
+
+			if (!surface->transaction_queue) {
+				test_assert_uint_eq(surface->pending_content_update_count, 0);
+				continue;
+			}
+
+			test_assert_uint_eq(surface->pending_content_update_count,
+					    updates_per_surface);
+			queued++;
+
+			/* independent surfaces must not block each other */
+			wl_list_for_each(other, &compositor->view_list, link) {
+				if (other == view)
+					continue;
+				test_assert_ptr_ne(other->surface->transaction_queue,
+						   surface->transaction_queue);
+			}
+		}
+
+		test_assert_uint_eq(queued, ARRAY_LENGTH(surfaces));
+		test_assert_int_eq(wl_list_length(&compositor->transaction_queue_list),
+				   ARRAY_LENGTH(surfaces));
+
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* Destroying the surfaces throws all their content updates away */
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		wp_commit_timer_v1_destroy(timers[i]);
+		surface_destroy(surfaces[i]);
+	}
+
+	wl_surface_damage_buffer(client->surface->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(client->surface->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+
+		test_assert_true(wl_list_empty(&compositor->transaction_queue_list));
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++)
+		buffer_destroy(buffers[i]);
+	wp_presentation_destroy(pres);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
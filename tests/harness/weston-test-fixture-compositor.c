@@ -198,6 +198,7 @@ compositor_setup_defaults_(struct compositor_setup *setup,
 		.scale = 1,
 		.refresh = 0,
 		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+		.output_count = 1,
 		.config_file = NULL,
 		.extra_module = NULL,
 		.logging_scopes = NULL,
@@ -333,6 +334,12 @@ execute_compositor(const struct compositor_setup *setup,
 		prog_args_take(&args, tmp);
 	}
 
+	if (setup->output_count > 1 &&
+	    setup->backend == WESTON_BACKEND_HEADLESS) {
+		str_printf(&tmp, "--output-count=%d", setup->output_count);
+		prog_args_take(&args, tmp);
+	}
+
 	if (setup->config_file) {
 		str_printf(&tmp, "--config=%s", setup->config_file);
 		prog_args_take(&args, tmp);
@@ -89,6 +89,8 @@ struct compositor_setup {
 	int refresh;
 	/** Default output transform, one of WL_OUTPUT_TRANSFORM_*. */
 	enum wl_output_transform transform;
+	/** Number of outputs, side by side (headless backend). */
+	int output_count;
 	/** The absolute path to \c weston.ini to use,
 	 * or NULL for \c --no-config .
 	 * To properly fill this entry use weston_ini_setup() */
@@ -120,6 +122,7 @@ compositor_setup_defaults_(struct compositor_setup *setup,
  * - refresh: 0 (repaint only on demand)
  * - scale: 1
  * - transform: WL_OUTPUT_TRANSFORM_NORMAL
+ * - output_count: 1
  * - config_file: none
  * - extra_module: none
  * - logging_scopes: compositor defaults
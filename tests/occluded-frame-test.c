@@ -0,0 +1,213 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libweston-internal.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static struct surface *
+create_opaque_surface(struct client *client, int x, int y,
+		      int width, int height, pixman_color_t *color)
+{
+	struct rectangle opaque = {
+		.x = 0, .y = 0, .width = width, .height = height
+	};
+	struct surface *surface;
+
+	surface = create_test_surface(client);
+	surface->width = width;
+	surface->height = height;
+	surface->buffer = create_shm_buffer_solid(client, width, height, color);
+	surface_set_opaque_rect(surface, &opaque);
+
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, x, y);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(surface->wl_surface, 0, 0, width, height);
+	wl_surface_commit(surface->wl_surface);
+
+	return surface;
+}
+
+/* Repaint a few times through the surface on top */
+static void
+repaint_through(struct client *client, struct surface *surface, int frames)
+{
+	int done;
+
+	while (frames-- > 0) {
+		frame_callback_set(surface->wl_surface, &done);
+		wl_surface_damage_buffer(surface->wl_surface, 0, 0, 1, 1);
+		wl_surface_commit(surface->wl_surface);
+		frame_callback_wait(client, &done);
+	}
+}
+
+/* Long enough for no test runner to ever reach it on its own. The test
+ * does not depend on how long repaints take: occluded frame callbacks are
+ * made due by backdating them instead.
+ */
+#define THROTTLE_MSEC (60 * 1000)
+
+static struct weston_surface *
+get_weston_surface(struct surface *surface)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+
+	return get_resource_data_from_proxy(suite_data,
+					    (struct wl_proxy *) surface->wl_surface);
+}
+
+/* Pretend the last frame callbacks of the surface were sent a whole
+ * interval before the last repaint of the output
+ */
+static void
+backdate_frame_callbacks(struct weston_output *output,
+			 struct weston_surface *surface)
+{
+	uint32_t interval = output->compositor->occluded_frame_interval_msec;
+
+	timespec_add_msec(&surface->frame_callback_time, &output->frame_time,
+			  -(int64_t) interval);
+}
+
+static void
+set_occluded_frame_interval(struct client *client, struct surface *top,
+			    struct surface *hidden, uint32_t interval_msec)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_damage_buffer(top->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(top->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_head *head = breakpoint->resource;
+
+		compositor->occluded_frame_interval_msec = interval_msec;
+		backdate_frame_callbacks(head->output,
+					 get_weston_surface(hidden));
+	}
+}
+
+TEST(occluded_frame_callbacks)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *hidden, *top;
+	pixman_color_t red, blue;
+	int hidden_done;
+
+	color_rgb888(&red, 255, 0, 0);
+	color_rgb888(&blue, 0, 0, 255);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	hidden = create_opaque_surface(client, 50, 50, 50, 50, &red);
+	top = create_opaque_surface(client, 0, 0, 320, 240, &blue);
+	repaint_through(client, top, 1);
+
+	/* By default, hidden surfaces get no frame callbacks at all */
+	frame_callback_set(hidden->wl_surface, &hidden_done);
+	wl_surface_damage_buffer(hidden->wl_surface, 0, 0, 50, 50);
+	wl_surface_commit(hidden->wl_surface);
+	repaint_through(client, top, 5);
+	client_roundtrip(client);
+	test_assert_false(hidden_done);
+
+	/* Once throttling is on, the withheld callback comes when due */
+	set_occluded_frame_interval(client, top, hidden, THROTTLE_MSEC);
+	repaint_through(client, top, 1);
+	frame_callback_wait(client, &hidden_done);
+
+	/* The next one does not come before the interval */
+	frame_callback_set(hidden->wl_surface, &hidden_done);
+	wl_surface_damage_buffer(hidden->wl_surface, 0, 0, 50, 50);
+	wl_surface_commit(hidden->wl_surface);
+	repaint_through(client, top, 5);
+	client_roundtrip(client);
+	test_assert_false(hidden_done);
+
+	/* ...but comes once due, even if nothing else repaints in the
+	 * meantime: the last repaint must have armed the timer for it */
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_damage_buffer(top->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(top->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_head *head = breakpoint->resource;
+
+		test_assert_true(head->output->occluded_frame_callbacks_pending);
+		test_assert_true(compositor->occluded_frame_timer_armed);
+
+		backdate_frame_callbacks(head->output,
+					 get_weston_surface(hidden));
+		compositor->occluded_frame_deadline = head->output->frame_time;
+		wl_event_source_timer_update(compositor->occluded_frame_timer, 1);
+	}
+	frame_callback_wait(client, &hidden_done);
+
+	set_occluded_frame_interval(client, top, hidden, 0);
+
+	surface_destroy(top);
+	surface_destroy(hidden);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
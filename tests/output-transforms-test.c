@@ -57,12 +57,24 @@
 		.meta.name = "Vulkan " #s " " #t,			\
 	}
 
+/* Tiled compositing must not change a single pixel */
+#define PIXMAN_THREADED(s, t, n)					\
+	{								\
+		.renderer = WESTON_RENDERER_PIXMAN,			\
+		.scale = s,						\
+		.transform = WL_OUTPUT_TRANSFORM_ ## t,			\
+		.transform_name = #t,					\
+		.repaint_threads = n,					\
+		.meta.name = "pixman " #s " " #t " " #n " threads",	\
+	}
+
 struct setup_args {
 	struct fixture_metadata meta;
 	enum weston_renderer_type renderer;
 	int scale;
 	enum wl_output_transform transform;
 	const char *transform_name;
+	int repaint_threads;
 };
 
 static const struct setup_args my_setup_args[] = {
@@ -80,6 +92,10 @@ static const struct setup_args my_setup_args[] = {
 	RENDERERS(2, 180),
 	RENDERERS(2, FLIPPED),
 	RENDERERS(3, FLIPPED_270),
+	PIXMAN_THREADED(1, NORMAL, 4),
+	PIXMAN_THREADED(1, 90, 4),
+	PIXMAN_THREADED(2, FLIPPED, 3),
+	PIXMAN_THREADED(3, FLIPPED_270, 2),
 };
 
 static enum test_result_code
@@ -101,6 +117,12 @@ fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
 	setup.transform = arg->transform;
 	setup.shell = SHELL_TEST_DESKTOP;
 
+	if (arg->repaint_threads > 1) {
+		weston_ini_setup(&setup,
+				 cfgln("[core]"),
+				 cfgln("repaint-threads=%d", arg->repaint_threads));
+	}
+
 	return weston_test_harness_execute_as_client(harness, &setup);
 }
 DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
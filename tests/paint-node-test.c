@@ -364,3 +364,371 @@ TEST(test_surface_unmaps_on_null)
 
 	return RESULT_OK;
 }
+
+/* Check that the z-order list of the output lists exactly the views of the
+ * view list that are on the output, in the same order, and that their
+ * visible regions are what a walk from the top computes.
+ */
+static void
+assert_z_order_list_consistent(struct weston_compositor *compositor,
+			       struct weston_output *output)
+{
+	struct weston_paint_node *pnode = NULL;
+	struct weston_view *view;
+	pixman_region32_t opaque;
+	pixman_region32_t visible;
+
+	pixman_region32_init(&opaque);
+	pixman_region32_init(&visible);
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (!(view->output_mask & (1u << output->id)))
+			continue;
+
+		pnode = next_pnode_from_z(output, pnode);
+		test_assert_ptr_not_null(pnode);
+		test_assert_ptr_eq(pnode->view, view);
+
+		pixman_region32_intersect(&visible,
+					  &view->transform.boundingbox,
+					  &output->region);
+		pixman_region32_subtract(&visible, &visible, &opaque);
+		test_assert_true(pixman_region32_equal(&visible,
+						       &pnode->visible));
+
+		if (pnode->is_fully_opaque)
+			pixman_region32_union(&opaque, &opaque, &visible);
+		else if (view->alpha == 1.0)
+			pixman_region32_union(&opaque, &opaque,
+					      &view->transform.opaque);
+	}
+
+	test_assert_ptr_null(next_pnode_from_z(output, pnode));
+
+	pixman_region32_fini(&visible);
+	pixman_region32_fini(&opaque);
+}
+
+TEST(z_order_list_follows_restack)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *surfaces[3];
+	struct buffer *buffers[ARRAY_LENGTH(surfaces)];
+	pixman_color_t red;
+	unsigned int i;
+
+	color_rgb888(&red, 255, 0, 0);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		surfaces[i] = create_test_surface(client);
+		weston_test_move_surface(client->test->weston_test,
+					 surfaces[i]->wl_surface,
+					 20 + 40 * i, 20 + 30 * i);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces) - 1; i++)
+		buffers[i] = surface_commit_color(client,
+						  surfaces[i]->wl_surface,
+						  &red, 100, 100);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	buffers[i] = surface_commit_color(client, surfaces[i]->wl_surface,
+					  &red, 100, 100);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_output *output = next_output(compositor, NULL);
+		struct weston_view *view, *bottom = NULL;
+
+		assert_z_order_list_consistent(compositor, output);
+
+		/* raise the bottom-most of our surfaces to the top */
+		wl_list_for_each(view, &compositor->view_list, link) {
+			if (view->surface->resource &&
+			    wl_resource_get_client(view->surface->resource) ==
+			    suite_data->wl_client)
+				bottom = view;
+		}
+		test_assert_ptr_not_null(bottom);
+		weston_view_move_to_layer(bottom,
+					  &bottom->layer_link.layer->view_list);
+
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* trigger a repaint */
+	wl_surface_damage_buffer(surfaces[0]->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(surfaces[0]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_output *output = next_output(compositor, NULL);
+		struct weston_paint_node *top;
+
+		assert_z_order_list_consistent(compositor, output);
+
+		top = next_pnode_from_z(output, NULL);
+		test_assert_ptr_not_null(top);
+		test_assert_ptr_eq(wl_resource_get_client(top->surface->resource),
+				   suite_data->wl_client);
+		test_assert_enum(output->paint_node_changes,
+				 WESTON_PAINT_NODE_ALL_DIRTY);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		buffer_destroy(buffers[i]);
+		surface_destroy(surfaces[i]);
+	}
+	client_destroy(client);
+
+	return RESULT_OK;
+}
+
+static struct weston_view *
+find_client_view(struct weston_compositor *compositor,
+		 struct wet_testsuite_data *suite_data, bool topmost)
+{
+	struct weston_view *view, *found = NULL;
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (!view->surface->resource ||
+		    wl_resource_get_client(view->surface->resource) !=
+		    suite_data->wl_client)
+			continue;
+
+		found = view;
+		if (topmost)
+			break;
+	}
+
+	return found;
+}
+
+static struct weston_view *lowered_view;
+
+TEST(z_order_list_follows_lower)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *surfaces[3];
+	struct buffer *buffers[ARRAY_LENGTH(surfaces)];
+	pixman_color_t red;
+	unsigned int i;
+
+	color_rgb888(&red, 255, 0, 0);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		surfaces[i] = create_test_surface(client);
+		weston_test_move_surface(client->test->weston_test,
+					 surfaces[i]->wl_surface,
+					 20 + 40 * i, 20 + 30 * i);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces) - 1; i++)
+		buffers[i] = surface_commit_color(client,
+						  surfaces[i]->wl_surface,
+						  &red, 100, 100);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	buffers[i] = surface_commit_color(client, surfaces[i]->wl_surface,
+					  &red, 100, 100);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_view *bottom;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+
+		/* lower the top-most of our surfaces to the bottom */
+		bottom = find_client_view(compositor, suite_data, false);
+		lowered_view = find_client_view(compositor, suite_data, true);
+		test_assert_ptr_not_null(bottom);
+		test_assert_ptr_ne(lowered_view, bottom);
+		weston_view_move_to_layer(lowered_view, &bottom->layer_link);
+
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* trigger a repaint */
+	wl_surface_damage_buffer(surfaces[0]->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(surfaces[0]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_output *output = next_output(compositor, NULL);
+
+		/* the paint node of the lowered view went to the bottom */
+		assert_z_order_list_consistent(compositor, output);
+		test_assert_ptr_eq(find_client_view(compositor, suite_data,
+						    false),
+				   lowered_view);
+		test_assert_enum(output->paint_node_changes,
+				 WESTON_PAINT_NODE_ALL_DIRTY);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		buffer_destroy(buffers[i]);
+		surface_destroy(surfaces[i]);
+	}
+	client_destroy(client);
+
+	return RESULT_OK;
+}
+
+/* Every step below only recomputes part of the visible regions, check that
+ * they always match a full walk from the top.
+ */
+TEST(incremental_visibility_matches_full_walk)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *surfaces[4];
+	struct buffer *buffers[ARRAY_LENGTH(surfaces)];
+	struct rectangle opaque = { .x = 0, .y = 0, .width = 80, .height = 80 };
+	pixman_color_t red;
+	unsigned int i;
+
+	color_rgb888(&red, 255, 0, 0);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	/* overlapping surfaces, all but the last one partly opaque */
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		surfaces[i] = create_test_surface(client);
+		weston_test_move_surface(client->test->weston_test,
+					 surfaces[i]->wl_surface,
+					 20 + 40 * i, 20 + 30 * i);
+		if (i < ARRAY_LENGTH(surfaces) - 1)
+			surface_set_opaque_rect(surfaces[i], &opaque);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces) - 1; i++)
+		buffers[i] = surface_commit_color(client,
+						  surfaces[i]->wl_surface,
+						  &red, 100, 100);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	buffers[i] = surface_commit_color(client, surfaces[i]->wl_surface,
+					  &red, 100, 100);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* move a surface in the middle of the stack under the others */
+	weston_test_move_surface(client->test->weston_test,
+				 surfaces[1]->wl_surface, 70, 40);
+	wl_surface_attach(surfaces[1]->wl_surface, buffers[1]->proxy, 0, 0);
+	wl_surface_damage_buffer(surfaces[1]->wl_surface, 0, 0, 100, 100);
+	wl_surface_commit(surfaces[1]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_view *bottom;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+
+		/* raise the bottom-most of our surfaces to the top */
+		bottom = find_client_view(compositor, suite_data, false);
+		test_assert_ptr_not_null(bottom);
+		weston_view_move_to_layer(bottom,
+					  &bottom->layer_link.layer->view_list);
+
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* trigger a repaint */
+	wl_surface_damage_buffer(surfaces[3]->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(surfaces[3]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_view *bottom;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+
+		/* and lower the top-most one back to the bottom */
+		bottom = find_client_view(compositor, suite_data, false);
+		test_assert_ptr_not_null(bottom);
+		weston_view_move_to_layer(find_client_view(compositor,
+							   suite_data, true),
+					  &bottom->layer_link);
+
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	wl_surface_damage_buffer(surfaces[3]->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(surfaces[3]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* unmap an opaque surface, uncovering what is below */
+	wl_surface_attach(surfaces[2]->wl_surface, NULL, 0, 0);
+	wl_surface_commit(surfaces[2]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+		REARM_BREAKPOINT(breakpoint);
+	}
+
+	/* and map it again elsewhere */
+	weston_test_move_surface(client->test->weston_test,
+				 surfaces[2]->wl_surface, 0, 0);
+	wl_surface_attach(surfaces[2]->wl_surface, buffers[2]->proxy, 0, 0);
+	wl_surface_damage_buffer(surfaces[2]->wl_surface, 0, 0, 100, 100);
+	wl_surface_commit(surfaces[2]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+
+		assert_z_order_list_consistent(compositor,
+					       next_output(compositor, NULL));
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++) {
+		buffer_destroy(buffers[i]);
+		surface_destroy(surfaces[i]);
+	}
+	client_destroy(client);
+
+	return RESULT_OK;
+}
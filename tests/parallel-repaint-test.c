@@ -0,0 +1,172 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libweston-internal.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+#define OUTPUT_WIDTH 320
+#define OUTPUT_HEIGHT 240
+#define VIEW_SIZE 100
+
+/* From well inside the first output to well inside the second one */
+#define SLIDE_START (OUTPUT_WIDTH - 2 * VIEW_SIZE)
+#define SLIDE_STEP 4
+#define SLIDE_FRAMES 100
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = OUTPUT_WIDTH;
+	setup.height = OUTPUT_HEIGHT;
+	setup.output_count = 2;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("repaint-threads=2"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Moves a view from one output to the other, from the frame animations of
+ * the first output. Those run while the second output, prepared for repaint
+ * together with the first one, has not been repainted yet. */
+struct slide {
+	struct weston_animation animation;
+	struct weston_view *view;
+	int frames;
+};
+
+static struct slide slide;
+
+static void
+slide_frame(struct weston_animation *animation,
+	    struct weston_output *output, const struct timespec *time)
+{
+	struct slide *slide = container_of(animation, struct slide, animation);
+	struct weston_coord_global pos;
+
+	if (slide->frames == SLIDE_FRAMES)
+		return;
+
+	slide->frames++;
+	pos.c = weston_coord(SLIDE_START + slide->frames * SLIDE_STEP, 50);
+	weston_view_set_position(slide->view, pos);
+
+	/* Keep both outputs repainting together */
+	weston_compositor_schedule_repaint(output->compositor);
+}
+
+TEST(animate_across_outputs)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *surface;
+	pixman_color_t color;
+	bool done = false;
+	int frame;
+
+	color_rgb888(&color, 0, 128, 255);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	surface = create_test_surface(client);
+	surface->width = VIEW_SIZE;
+	surface->height = VIEW_SIZE;
+	surface->buffer = create_shm_buffer_solid(client, VIEW_SIZE,
+						  VIEW_SIZE, &color);
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, SLIDE_START, 50);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(surface->wl_surface, 0, 0,
+				 VIEW_SIZE, VIEW_SIZE);
+	wl_surface_commit(surface->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_output *first, *second;
+		struct weston_surface *ws;
+
+		test_assert_int_eq(wl_list_length(&compositor->output_list), 2);
+		first = container_of(compositor->output_list.next,
+				     struct weston_output, link);
+		second = container_of(first->link.next,
+				      struct weston_output, link);
+		test_assert_f64_eq(second->pos.c.x, first->pos.c.x + first->width);
+		test_assert_ptr_not_null(compositor->repaint_pool);
+
+		ws = get_resource_data_from_proxy(suite_data,
+						  (struct wl_proxy *) surface->wl_surface);
+		slide.view = container_of(ws->views.next, struct weston_view,
+					  surface_link);
+		slide.frames = 0;
+		slide.animation.frame = slide_frame;
+		wl_list_insert(&first->animation_list, &slide.animation.link);
+		weston_compositor_schedule_repaint(compositor);
+	}
+
+	/* Outputs are repainted until the view has crossed over */
+	for (frame = 0; !done; frame++) {
+		test_assert_int_lt(frame, 10 * SLIDE_FRAMES);
+
+		client_push_breakpoint(client, suite_data,
+				       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+				       (struct wl_proxy *) client->output->wl_output);
+		RUN_INSIDE_BREAKPOINT(client, suite_data) {
+			done = slide.frames == SLIDE_FRAMES;
+			if (done)
+				wl_list_remove(&slide.animation.link);
+			else
+				weston_compositor_schedule_repaint(breakpoint->compositor);
+		}
+	}
+
+	surface_destroy(surface);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libweston-internal.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static void
+commit_frame(struct surface *surface)
+{
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(surface->wl_surface, 0, 0,
+				 surface->width, surface->height);
+	wl_surface_commit(surface->wl_surface);
+}
+
+TEST(perf_counters_commits_painted_dropped)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *surface;
+	pixman_color_t color;
+	int done;
+
+	color_rgb888(&color, 0, 128, 255);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	surface = create_test_surface(client);
+	surface->width = 100;
+	surface->height = 100;
+	surface->buffer = create_shm_buffer_solid(client, 100, 100, &color);
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, 20, 20);
+
+	frame_callback_set(surface->wl_surface, &done);
+	commit_frame(surface);
+	frame_callback_wait(client, &done);
+
+	/* The first of two commits before a repaint never gets painted */
+	commit_frame(surface);
+	frame_callback_set(surface->wl_surface, &done);
+	commit_frame(surface);
+	frame_callback_wait(client, &done);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	commit_frame(surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_head *head = breakpoint->resource;
+		struct weston_output *output = head->output;
+		struct weston_view *view;
+		bool found = false;
+
+		test_assert_enum(breakpoint->template_->breakpoint,
+				 WESTON_TEST_BREAKPOINT_POST_REPAINT);
+
+		wl_list_for_each(view, &compositor->view_list, link) {
+			struct weston_perf_counters *perf = &view->surface->perf;
+
+			if (view->surface->width != 100)
+				continue;
+
+			/* The commit of this very repaint is only accounted
+			 * once the repaint is done. */
+			found = true;
+			test_assert_true(view->surface->perf_update_pending);
+			test_assert_u64_eq(perf->commits, 4);
+			test_assert_u64_eq(perf->painted, 2);
+			test_assert_u64_eq(perf->dropped, 1);
+			test_assert_u64_eq(perf->latency_count, perf->painted);
+			test_assert_u64_ge(perf->latency_total_nsec,
+					   perf->latency_max_nsec);
+		}
+		test_assert_true(found);
+
+		test_assert_u64_ge(output->perf.commits, 2);
+		test_assert_u64_ge(output->perf.painted, 2);
+		test_assert_u64_eq(output->perf.latency_count,
+				   output->perf.painted);
+	}
+
+	surface_destroy(surface);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
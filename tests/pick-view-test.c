@@ -0,0 +1,194 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libweston-internal.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* The linear walk weston_compositor_pick_view() used to do */
+static struct weston_view *
+reference_pick_view(struct weston_compositor *compositor,
+		    struct weston_coord_global pos)
+{
+	struct weston_view *view;
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		struct weston_coord_surface surf_pos;
+
+		weston_view_update_transform(view);
+
+		if (!pixman_region32_contains_point(&view->transform.boundingbox,
+						    pos.c.x, pos.c.y, NULL))
+			continue;
+
+		surf_pos = weston_coord_global_to_surface(view, pos);
+		if (!pixman_region32_contains_point(&view->surface->input,
+						    surf_pos.c.x, surf_pos.c.y,
+						    NULL))
+			continue;
+
+		if (view->geometry.scissor_enabled &&
+		    !pixman_region32_contains_point(&view->geometry.scissor,
+						    surf_pos.c.x, surf_pos.c.y,
+						    NULL))
+			continue;
+
+		return view;
+	}
+
+	return NULL;
+}
+
+static int
+compare_picks(struct weston_compositor *compositor)
+{
+	int checked = 0;
+	int x, y;
+
+	for (y = -16; y < 256; y += 3) {
+		for (x = -16; x < 336; x += 3) {
+			struct weston_coord_global pos;
+
+			pos.c = weston_coord(x + 0.5, y + 0.5);
+			test_assert_ptr_eq(weston_compositor_pick_view(compositor, pos),
+					   reference_pick_view(compositor, pos));
+			checked++;
+		}
+	}
+
+	return checked;
+}
+
+static struct surface *
+create_mapped_surface(struct client *client, int x, int y,
+		      int width, int height, pixman_color_t *color)
+{
+	struct surface *surface;
+
+	surface = create_test_surface(client);
+	surface->width = width;
+	surface->height = height;
+	surface->buffer = create_shm_buffer_solid(client, width, height, color);
+
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, x, y);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(surface->wl_surface, 0, 0, width, height);
+
+	return surface;
+}
+
+TEST(pick_view_matches_linear_walk)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	struct client *client;
+	struct surface *surfaces[6];
+	struct wl_region *region;
+	pixman_color_t color;
+	unsigned int i;
+
+	color_rgb888(&color, 0, 128, 255);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	surfaces[0] = create_mapped_surface(client, 0, 0, 320, 240, &color);
+	surfaces[1] = create_mapped_surface(client, 10, 10, 100, 80, &color);
+	surfaces[2] = create_mapped_surface(client, 60, 40, 200, 150, &color);
+	surfaces[3] = create_mapped_surface(client, 250, 200, 120, 90, &color);
+	surfaces[4] = create_mapped_surface(client, -30, 150, 64, 64, &color);
+	surfaces[5] = create_mapped_surface(client, 100, 100, 50, 50, &color);
+
+	/* input only on the left half of one surface */
+	region = wl_compositor_create_region(client->wl_compositor);
+	wl_region_add(region, 0, 0, 100, 150);
+	wl_surface_set_input_region(surfaces[2]->wl_surface, region);
+	wl_region_destroy(region);
+
+	/* no input at all on another one */
+	region = wl_compositor_create_region(client->wl_compositor);
+	wl_surface_set_input_region(surfaces[5]->wl_surface, region);
+	wl_region_destroy(region);
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces) - 1; i++)
+		wl_surface_commit(surfaces[i]->wl_surface);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_commit(surfaces[ARRAY_LENGTH(surfaces) - 1]->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_view *view;
+
+		test_assert_enum(breakpoint->template_->breakpoint,
+				 WESTON_TEST_BREAKPOINT_POST_REPAINT);
+
+		test_assert_int_gt(compare_picks(compositor), 0);
+
+		/* Move every view around without a repaint in between, so
+		 * the index has to catch up with stale transforms. */
+		wl_list_for_each(view, &compositor->view_list, link) {
+			view->geometry.pos_offset.x += 37;
+			view->geometry.pos_offset.y -= 11;
+			weston_view_geometry_dirty(view);
+		}
+
+		test_assert_int_gt(compare_picks(compositor), 0);
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(surfaces); i++)
+		surface_destroy(surfaces[i]);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
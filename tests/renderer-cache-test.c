@@ -0,0 +1,277 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shared/string-helpers.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+/*
+ * The fixtures run in order, each one on what the previous one left in the
+ * cache: the first one fills it, the second one must load everything back,
+ * the third one must reject the entries it damaged and store them again.
+ */
+enum cache_step {
+	CACHE_STEP_STORE,
+	CACHE_STEP_RELOAD,
+	CACHE_STEP_REJECT,
+};
+
+struct setup_args {
+	struct fixture_metadata meta;
+	enum cache_step step;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{ .step = CACHE_STEP_STORE, .meta.name = "store" },
+	{ .step = CACHE_STEP_RELOAD, .meta.name = "reload" },
+	{ .step = CACHE_STEP_REJECT, .meta.name = "reject" },
+};
+
+/* Entries touched here are recognizable by their modification time */
+#define OLD_MTIME 1000000000
+
+/* struct program_cache_header starts with the magic, then the version */
+#define ENTRY_VERSION_OFFSET 4
+
+static char *
+get_cache_dir(void)
+{
+	char *wd, *dir = NULL;
+
+	wd = realpath(".", NULL);
+	test_assert_ptr_not_null(wd);
+	str_printf(&dir, "%s/%s-cache", wd, THIS_TEST_NAME);
+	test_assert_ptr_not_null(dir);
+	free(wd);
+
+	return dir;
+}
+
+/* Call func on the files of the GL program cache ending in suffix, and
+ * return how many there are. */
+static unsigned int
+for_each_file(const char *dir, const char *suffix,
+	      void (*func)(const char *path, unsigned int index))
+{
+	struct dirent *de;
+	unsigned int count = 0;
+	char *path;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return 0;
+
+	while ((de = readdir(d))) {
+		size_t len = strlen(de->d_name);
+
+		if (strncmp(de->d_name, "gl-", 3) != 0 ||
+		    len < strlen(suffix) ||
+		    strcmp(de->d_name + len - strlen(suffix), suffix) != 0)
+			continue;
+
+		if (func) {
+			str_printf(&path, "%s/%s", dir, de->d_name);
+			test_assert_ptr_not_null(path);
+			func(path, count);
+			free(path);
+		}
+		count++;
+	}
+
+	closedir(d);
+
+	return count;
+}
+
+static void
+remove_file(const char *path, unsigned int index)
+{
+	test_assert_int_eq(unlink(path), 0);
+}
+
+static void
+set_old_mtime(const char *path, unsigned int index)
+{
+	const struct timespec times[2] = {
+		{ .tv_sec = OLD_MTIME },
+		{ .tv_sec = OLD_MTIME },
+	};
+
+	test_assert_int_eq(utimensat(AT_FDCWD, path, times, 0), 0);
+}
+
+/* Every other entry gets a version from the future, the others a flipped
+ * bit in their binary. */
+static void
+damage_entry(const char *path, unsigned int index)
+{
+	struct stat st;
+	uint32_t version = UINT32_MAX;
+	uint8_t byte;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	test_assert_int_ge(fd, 0);
+	test_assert_int_eq(fstat(fd, &st), 0);
+	test_assert_s64_gt(st.st_size,
+			   (int64_t) (ENTRY_VERSION_OFFSET + sizeof version));
+
+	if (index % 2 == 0) {
+		test_assert_s64_eq(pwrite(fd, &version, sizeof version,
+					  ENTRY_VERSION_OFFSET),
+				   (int64_t) sizeof version);
+	} else {
+		test_assert_s64_eq(pread(fd, &byte, 1, st.st_size - 1), 1);
+		byte ^= 0x01;
+		test_assert_s64_eq(pwrite(fd, &byte, 1, st.st_size - 1), 1);
+	}
+
+	close(fd);
+	set_old_mtime(path, index);
+}
+
+static void
+assert_loaded(const char *path, unsigned int index)
+{
+	struct stat st;
+
+	test_assert_int_eq(stat(path, &st), 0);
+	test_assert_s64_eq(st.st_mtime, OLD_MTIME);
+}
+
+static void
+assert_stored_again(const char *path, unsigned int index)
+{
+	struct stat st;
+
+	test_assert_int_eq(stat(path, &st), 0);
+	test_assert_s64_ne(st.st_mtime, OLD_MTIME);
+}
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+	enum test_result_code ret;
+	char *dir = get_cache_dir();
+
+	switch (arg->step) {
+	case CACHE_STEP_STORE:
+		for_each_file(dir, "", remove_file);
+		test_assert_true(mkdir(dir, 0700) == 0 || errno == EEXIST);
+		break;
+	case CACHE_STEP_RELOAD:
+		for_each_file(dir, ".bin", set_old_mtime);
+		break;
+	case CACHE_STEP_REJECT:
+		for_each_file(dir, ".bin", damage_entry);
+		break;
+	}
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_GL;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.test_quirks.renderer_cache_dir = dir;
+
+	ret = weston_test_harness_execute_as_client(harness, &setup);
+	free(dir);
+
+	return ret;
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+TEST(gl_program_cache_round_trip)
+{
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	char *dir = get_cache_dir();
+	struct client *client;
+	struct surface *surface;
+	pixman_color_t color;
+	int done;
+
+	color_rgb888(&color, 0, 128, 255);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	surface = create_test_surface(client);
+	surface->width = 100;
+	surface->height = 100;
+	surface->buffer = create_shm_buffer_solid(client, 100, 100, &color);
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, 20, 20);
+
+	frame_callback_set(surface->wl_surface, &done);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(surface->wl_surface, 0, 0, 100, 100);
+	wl_surface_commit(surface->wl_surface);
+	frame_callback_wait(client, &done);
+
+	/* Without program binaries from the driver there is no cache */
+	if (for_each_file(dir, ".bin", NULL) == 0) {
+		testlog("No program got cached, skipping.\n");
+		surface_destroy(surface);
+		client_destroy(client);
+		free(dir);
+		return RESULT_SKIP;
+	}
+
+	switch (args->step) {
+	case CACHE_STEP_STORE:
+		break;
+	case CACHE_STEP_RELOAD:
+		for_each_file(dir, ".bin", assert_loaded);
+		break;
+	case CACHE_STEP_REJECT:
+		for_each_file(dir, ".bin", assert_stored_again);
+		break;
+	}
+
+	surface_destroy(surface);
+	client_destroy(client);
+	free(dir);
+
+	return RESULT_OK;
+}
@@ -0,0 +1,402 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Repaint path microbenchmarks
+ *
+ * Every scenario builds a synthetic scene, then damages all of it and
+ * repaints for a fixed number of frames. The time the core spent in each
+ * repaint phase is taken from weston_output::repaint_profile and logged as
+ * one JSON object per scenario and renderer, on a line starting with
+ * "bench: ". Run with 'meson test --benchmark'.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libweston-internal.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+#include "shared/xalloc.h"
+
+#define BENCH_FRAMES 120
+#define BENCH_VIEW_SIZE 64
+#define BENCH_MAX_CHILDREN 3
+
+struct setup_args {
+	struct fixture_metadata meta;
+	enum weston_renderer_type renderer;
+	int repaint_threads;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{
+		.renderer = WESTON_RENDERER_NOOP,
+		.meta.name = "noop",
+	},
+	{
+		.renderer = WESTON_RENDERER_PIXMAN,
+		.meta.name = "pixman",
+	},
+	{
+		.renderer = WESTON_RENDERER_PIXMAN,
+		.repaint_threads = 4,
+		.meta.name = "pixman 4 threads",
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = arg->renderer;
+	setup.width = 1280;
+	setup.height = 720;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	if (arg->repaint_threads > 1) {
+		weston_ini_setup(&setup,
+				 cfgln("[core]"),
+				 cfgln("repaint-threads=%d", arg->repaint_threads));
+	}
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+struct scenario {
+	const char *name;
+	unsigned int views;
+	unsigned int children; /* subsurfaces per view */
+	bool blended;
+	bool scaled;
+	bool rotated;
+};
+
+static const struct scenario scenarios[] = {
+	{ .name = "opaque", .views = 64 },
+	{ .name = "opaque-many", .views = 512 },
+	{ .name = "blended", .views = 64, .blended = true },
+	{ .name = "subsurfaces", .views = 32, .children = 3 },
+	{ .name = "scaled", .views = 64, .scaled = true },
+	{ .name = "rotated", .views = 64, .rotated = true },
+	{
+		.name = "mixed", .views = 128, .children = 2,
+		.blended = true, .scaled = true, .rotated = true,
+	},
+};
+
+struct bench_rotation {
+	struct weston_transform transform;
+	struct weston_view *view;
+};
+
+struct bench_view {
+	struct surface *surface;
+	struct wp_viewport *viewport;
+	struct wl_surface *children[BENCH_MAX_CHILDREN];
+	struct wl_subsurface *subsurfaces[BENCH_MAX_CHILDREN];
+};
+
+static void
+bench_view_init(struct bench_view *bv, struct client *client,
+		struct wl_subcompositor *subco, const struct scenario *sc,
+		unsigned int index, struct buffer *buffer,
+		struct buffer *child_buffer)
+{
+	struct rectangle opaque = {
+		.x = 0, .y = 0,
+		.width = BENCH_VIEW_SIZE, .height = BENCH_VIEW_SIZE,
+	};
+	unsigned int i;
+
+	bv->surface = create_test_surface(client);
+	weston_test_move_surface(client->test->weston_test,
+				 bv->surface->wl_surface,
+				 (index * 37) % (1280 - 2 * BENCH_VIEW_SIZE),
+				 (index * 53) % (720 - 2 * BENCH_VIEW_SIZE));
+
+	if (!sc->blended)
+		surface_set_opaque_rect(bv->surface, &opaque);
+
+	if (sc->scaled) {
+		bv->viewport = wp_viewporter_get_viewport(client->viewporter,
+							  bv->surface->wl_surface);
+		wp_viewport_set_destination(bv->viewport,
+					    BENCH_VIEW_SIZE * 3 / 2,
+					    BENCH_VIEW_SIZE * 3 / 2);
+	}
+
+	for (i = 0; i < sc->children; i++) {
+		bv->children[i] = wl_compositor_create_surface(client->wl_compositor);
+		bv->subsurfaces[i] =
+			wl_subcompositor_get_subsurface(subco, bv->children[i],
+							bv->surface->wl_surface);
+		wl_subsurface_set_position(bv->subsurfaces[i],
+					   16 * (i + 1), 16 * (i + 1));
+		wl_surface_attach(bv->children[i], child_buffer->proxy, 0, 0);
+		wl_surface_damage_buffer(bv->children[i], 0, 0,
+					 BENCH_VIEW_SIZE / 2,
+					 BENCH_VIEW_SIZE / 2);
+		wl_surface_commit(bv->children[i]);
+	}
+
+	wl_surface_attach(bv->surface->wl_surface, buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(bv->surface->wl_surface, 0, 0,
+				 BENCH_VIEW_SIZE, BENCH_VIEW_SIZE);
+	wl_surface_commit(bv->surface->wl_surface);
+}
+
+static void
+bench_view_damage(struct bench_view *bv, const struct scenario *sc)
+{
+	unsigned int i;
+
+	/* Synchronized children are applied with their parent */
+	for (i = 0; i < sc->children; i++) {
+		wl_surface_damage_buffer(bv->children[i], 0, 0,
+					 BENCH_VIEW_SIZE / 2,
+					 BENCH_VIEW_SIZE / 2);
+		wl_surface_commit(bv->children[i]);
+	}
+
+	wl_surface_damage_buffer(bv->surface->wl_surface, 0, 0,
+				 BENCH_VIEW_SIZE, BENCH_VIEW_SIZE);
+	wl_surface_commit(bv->surface->wl_surface);
+}
+
+static void
+bench_view_fini(struct bench_view *bv, const struct scenario *sc)
+{
+	unsigned int i;
+
+	for (i = 0; i < sc->children; i++) {
+		wl_subsurface_destroy(bv->subsurfaces[i]);
+		wl_surface_destroy(bv->children[i]);
+	}
+
+	if (bv->viewport)
+		wp_viewport_destroy(bv->viewport);
+
+	surface_destroy(bv->surface);
+}
+
+/* Rotate every top-level view of our client by 30 degrees around its
+ * center. */
+static void
+rotate_client_views(struct weston_compositor *compositor,
+		    struct wl_client *wl_client,
+		    struct bench_rotation *rotations, unsigned int count)
+{
+	struct weston_view *view;
+	unsigned int n = 0;
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		struct weston_matrix *matrix;
+		float cx, cy;
+
+		if (view->geometry.parent || !view->surface->resource ||
+		    wl_resource_get_client(view->surface->resource) != wl_client)
+			continue;
+
+		test_assert_uint_lt(n, count);
+		rotations[n].view = view;
+		matrix = &rotations[n].transform.matrix;
+
+		cx = view->surface->width / 2.0f;
+		cy = view->surface->height / 2.0f;
+		weston_matrix_init(matrix);
+		weston_matrix_translate(matrix, -cx, -cy, 0);
+		weston_matrix_rotate_xy(matrix, cosf(M_PI / 6), sinf(M_PI / 6));
+		weston_matrix_translate(matrix, cx, cy, 0);
+
+		wl_list_insert(view->geometry.transformation_list.prev,
+			       &rotations[n].transform.link);
+		weston_view_geometry_dirty(view);
+		n++;
+	}
+}
+
+static void
+unrotate_client_views(struct bench_rotation *rotations, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count && rotations[i].view; i++) {
+		wl_list_remove(&rotations[i].transform.link);
+		weston_view_geometry_dirty(rotations[i].view);
+	}
+}
+
+static void
+report(const char *renderer, const struct scenario *sc,
+       const struct weston_repaint_profile *prof)
+{
+	char line[512];
+	size_t len;
+	unsigned int i;
+
+	len = snprintf(line, sizeof line,
+		       "{\"renderer\":\"%s\",\"scenario\":\"%s\","
+		       "\"views\":%u,\"subsurfaces\":%u,\"frames\":%" PRIu64,
+		       renderer, sc->name, sc->views, sc->views * sc->children,
+		       prof->frames);
+
+	for (i = 0; i < WESTON_REPAINT_PHASE_COUNT && len < sizeof line; i++)
+		len += snprintf(line + len, sizeof line - len,
+				",\"%s_ns\":%" PRIu64,
+				weston_repaint_phase_to_str(i),
+				prof->frames ? prof->total_nsec[i] / prof->frames : 0);
+
+	testlog("bench: %s}\n", line);
+}
+
+TEST_P(repaint_scene, scenarios)
+{
+	struct wet_testsuite_data *suite_data = TEST_GET_SUITE_DATA();
+	const struct scenario *sc = data;
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	struct weston_repaint_profile prof = { 0 };
+	struct bench_rotation *rotations = NULL;
+	struct wl_subcompositor *subco;
+	struct bench_view *views;
+	struct buffer *buffer, *child_buffer;
+	struct client *client;
+	struct surface *pacer;
+	pixman_color_t color, child_color;
+	unsigned int frame, i;
+	int done;
+
+	test_assert_uint_le(sc->children, BENCH_MAX_CHILDREN);
+
+	if (sc->blended) {
+		/* premultiplied */
+		color = (pixman_color_t) {
+			.red = 0, .green = 0x2000, .blue = 0x4000,
+			.alpha = 0x8080,
+		};
+	} else {
+		color_rgb888(&color, 0, 128, 255);
+	}
+	color_rgb888(&child_color, 255, 128, 0);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+	subco = client_get_subcompositor(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	buffer = create_shm_buffer_solid(client, BENCH_VIEW_SIZE,
+					 BENCH_VIEW_SIZE, &color);
+	child_buffer = create_shm_buffer_solid(client, BENCH_VIEW_SIZE / 2,
+					       BENCH_VIEW_SIZE / 2,
+					       &child_color);
+
+	views = xcalloc(sc->views, sizeof *views);
+	for (i = 0; i < sc->views; i++)
+		bench_view_init(&views[i], client, subco, sc, i,
+				buffer, child_buffer);
+
+	/* one more for the pacer surface */
+	if (sc->rotated)
+		rotations = xcalloc(sc->views + 1, sizeof *rotations);
+
+	/* Stacked on top of everything else, so its frame callbacks are
+	 * never withheld for being occluded. */
+	pacer = create_test_surface(client);
+	pacer->width = 1;
+	pacer->height = 1;
+	pacer->buffer = create_shm_buffer_solid(client, 1, 1, &child_color);
+	weston_test_move_surface(client->test->weston_test,
+				 pacer->wl_surface, 0, 0);
+	wl_surface_attach(pacer->wl_surface, pacer->buffer->proxy, 0, 0);
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_damage_buffer(pacer->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(pacer->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_compositor *compositor = breakpoint->compositor;
+		struct weston_head *head = breakpoint->resource;
+
+		if (sc->rotated)
+			rotate_client_views(compositor, suite_data->wl_client,
+					    rotations, sc->views + 1);
+
+		memset(head->output->repaint_profile, 0,
+		       sizeof *head->output->repaint_profile);
+	}
+
+	for (frame = 0; frame < BENCH_FRAMES; frame++) {
+		for (i = 0; i < sc->views; i++)
+			bench_view_damage(&views[i], sc);
+
+		frame_callback_set(pacer->wl_surface, &done);
+		wl_surface_damage_buffer(pacer->wl_surface, 0, 0, 1, 1);
+		wl_surface_commit(pacer->wl_surface);
+		frame_callback_wait(client, &done);
+	}
+
+	client_push_breakpoint(client, suite_data,
+			       WESTON_TEST_BREAKPOINT_POST_REPAINT,
+			       (struct wl_proxy *) client->output->wl_output);
+	wl_surface_damage_buffer(pacer->wl_surface, 0, 0, 1, 1);
+	wl_surface_commit(pacer->wl_surface);
+
+	RUN_INSIDE_BREAKPOINT(client, suite_data) {
+		struct weston_head *head = breakpoint->resource;
+
+		prof = *head->output->repaint_profile;
+
+		if (sc->rotated)
+			unrotate_client_views(rotations, sc->views + 1);
+	}
+
+	test_assert_u64_ge(prof.frames, BENCH_FRAMES);
+	report(args->meta.name, sc, &prof);
+
+	surface_destroy(pacer);
+	for (i = 0; i < sc->views; i++)
+		bench_view_fini(&views[i], sc);
+	free(views);
+	free(rotations);
+	buffer_destroy(child_buffer);
+	buffer_destroy(buffer);
+	wl_subcompositor_destroy(subco);
+	client_destroy(client);
+
+	return RESULT_OK;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "repaint-window.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-assert.h"
+
+#define MSEC 1000000
+
+TEST(repaint_window_needs_samples)
+{
+	struct weston_repaint_window rw;
+	unsigned int i;
+
+	weston_repaint_window_init(&rw);
+	test_assert_false(weston_repaint_window_is_ready(&rw));
+
+	for (i = 0; i < 15; i++)
+		weston_repaint_window_add_sample(&rw, 2 * MSEC);
+	test_assert_false(weston_repaint_window_is_ready(&rw));
+
+	weston_repaint_window_add_sample(&rw, 2 * MSEC);
+	test_assert_true(weston_repaint_window_is_ready(&rw));
+
+	return RESULT_OK;
+}
+
+/*
+ * The window covers the slow repaints once there are enough of them to
+ * matter, and forgets them once they have left the sample ring.
+ */
+TEST(repaint_window_follows_percentile)
+{
+	struct weston_repaint_window rw;
+	int64_t fast, slow;
+	unsigned int i;
+
+	weston_repaint_window_init(&rw);
+
+	for (i = 0; i < WESTON_REPAINT_WINDOW_SAMPLES; i++)
+		weston_repaint_window_add_sample(&rw, 1 * MSEC + 50000);
+
+	test_assert_s64_eq(weston_repaint_window_get_percentile_nsec(&rw),
+			   1 * MSEC + 100000);
+	fast = weston_repaint_window_get_nsec(&rw);
+	test_assert_s64_gt(fast, weston_repaint_window_get_percentile_nsec(&rw));
+
+	/* A single outlier is not enough to move a high percentile */
+	weston_repaint_window_add_sample(&rw, 9 * MSEC);
+	test_assert_s64_eq(weston_repaint_window_get_nsec(&rw), fast);
+
+	for (i = 0; i < 10; i++)
+		weston_repaint_window_add_sample(&rw, 9 * MSEC);
+	slow = weston_repaint_window_get_nsec(&rw);
+	test_assert_s64_ge(slow, 9 * MSEC);
+
+	/* Overflowing durations land in the last bucket */
+	weston_repaint_window_add_sample(&rw, 1000 * MSEC);
+	test_assert_s64_le(weston_repaint_window_get_percentile_nsec(&rw),
+			   WESTON_REPAINT_WINDOW_BUCKETS *
+			   WESTON_REPAINT_WINDOW_BUCKET_USEC * 1000);
+
+	for (i = 0; i < WESTON_REPAINT_WINDOW_SAMPLES; i++)
+		weston_repaint_window_add_sample(&rw, 1 * MSEC + 50000);
+	test_assert_s64_eq(weston_repaint_window_get_nsec(&rw), fast);
+
+	return RESULT_OK;
+}
+
+TEST(repaint_window_miss_penalty_decays)
+{
+	struct weston_repaint_window rw;
+	int64_t base, penalized;
+	unsigned int i;
+
+	weston_repaint_window_init(&rw);
+
+	for (i = 0; i < WESTON_REPAINT_WINDOW_SAMPLES; i++)
+		weston_repaint_window_add_sample(&rw, 3 * MSEC);
+	base = weston_repaint_window_get_nsec(&rw);
+
+	weston_repaint_window_add_miss(&rw, 16 * MSEC);
+	weston_repaint_window_add_miss(&rw, 16 * MSEC);
+	penalized = weston_repaint_window_get_nsec(&rw);
+	test_assert_s64_gt(penalized, base);
+	test_assert_u64_eq(rw.misses, 2);
+
+	/* The penalty never exceeds half a refresh period */
+	for (i = 0; i < 100; i++)
+		weston_repaint_window_add_miss(&rw, 16 * MSEC);
+	test_assert_s64_le(weston_repaint_window_get_nsec(&rw) - base,
+			   8 * MSEC);
+
+	/* ... and goes away while frames hit their target */
+	for (i = 0; i < 1000; i++)
+		weston_repaint_window_add_sample(&rw, 3 * MSEC);
+	test_assert_s64_eq(weston_repaint_window_get_nsec(&rw), base);
+
+	return RESULT_OK;
+}
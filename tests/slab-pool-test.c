@@ -0,0 +1,101 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "slab-pool.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-assert.h"
+
+struct test_object {
+	uint64_t a;
+	char b[13];
+};
+
+TEST(slab_pool_reuses_objects)
+{
+	struct weston_slab_pool *pool;
+	struct test_object *objects[10];
+	struct test_object *again;
+	unsigned int i;
+
+	pool = weston_slab_pool_create("test objects",
+				       sizeof(struct test_object), 4);
+
+	for (i = 0; i < ARRAY_LENGTH(objects); i++) {
+		objects[i] = weston_slab_pool_alloc(pool);
+		test_assert_u64_eq(objects[i]->a, 0);
+		test_assert_u64_eq((uintptr_t)objects[i] % alignof(max_align_t), 0);
+		objects[i]->a = i + 1;
+		objects[i]->b[12] = 'x';
+	}
+
+	test_assert_uint_eq(pool->n_in_use, ARRAY_LENGTH(objects));
+
+#if ENABLE_SLAB_POOLS
+	test_assert_uint_eq(pool->n_slabs, 3);
+
+	/* Objects of a slab are handed out next to each other */
+	test_assert_true((char *)objects[1] > (char *)objects[0]);
+	test_assert_true((char *)objects[1] - (char *)objects[0] <
+			 2 * (ptrdiff_t)sizeof(struct test_object));
+#endif
+
+	/* A freed object is replaced by a cleared one, the same one when
+	 * pooling */
+	weston_slab_pool_free(pool, objects[5]);
+	again = weston_slab_pool_alloc(pool);
+#if ENABLE_SLAB_POOLS
+	test_assert_ptr_eq(again, objects[5]);
+#endif
+	test_assert_u64_eq(again->a, 0);
+	test_assert_int_eq(again->b[12], 0);
+	objects[5] = again;
+
+	for (i = 0; i < ARRAY_LENGTH(objects); i++)
+		weston_slab_pool_free(pool, objects[i]);
+
+	test_assert_uint_eq(pool->n_in_use, 0);
+	test_assert_uint_eq(pool->n_peak, ARRAY_LENGTH(objects));
+	test_assert_u64_eq(pool->n_allocs, ARRAY_LENGTH(objects) + 1);
+
+	/* No new slab needed to allocate as many objects again */
+	for (i = 0; i < ARRAY_LENGTH(objects); i++)
+		objects[i] = weston_slab_pool_alloc(pool);
+#if ENABLE_SLAB_POOLS
+	test_assert_uint_eq(pool->n_slabs, 3);
+#endif
+
+	for (i = 0; i < ARRAY_LENGTH(objects); i++)
+		weston_slab_pool_free(pool, objects[i]);
+
+	weston_slab_pool_destroy(pool);
+
+	return RESULT_OK;
+}
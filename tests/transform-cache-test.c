@@ -0,0 +1,156 @@
+/*
+ * Copyright 2026 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-assert.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,test-harness-plugin";
+	setup.refresh = HIGHEST_OUTPUT_REFRESH;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Commit damage on the whole surface and wait for the repaint */
+static void
+commit_damaged(struct client *client, struct surface *surface)
+{
+	int done;
+
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0,
+			  surface->width, surface->height);
+	frame_callback_set(surface->wl_surface, &done);
+	wl_surface_commit(surface->wl_surface);
+	frame_callback_wait(client, &done);
+}
+
+static void
+fill_quadrants(struct buffer *buf)
+{
+	static const pixman_color_t colors[] = {
+		{ 0xffff, 0x0000, 0x0000, 0xffff },
+		{ 0x0000, 0xffff, 0x0000, 0xffff },
+		{ 0x0000, 0x0000, 0xffff, 0xffff },
+		{ 0x7fff, 0x7fff, 0x7fff, 0x7fff },
+	};
+	int width = pixman_image_get_width(buf->image);
+	int height = pixman_image_get_height(buf->image);
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(colors); i++) {
+		pixman_rectangle16_t rect = {
+			.x = (i % 2) * width / 2,
+			.y = (i / 2) * height / 2,
+			.width = width / 2,
+			.height = height / 2,
+		};
+
+		pixman_image_fill_rectangles(PIXMAN_OP_SRC, buf->image,
+					     &colors[i], 1, &rect);
+	}
+}
+
+/*
+ * A scaled view gets drawn from its cached output space image once it has
+ * not changed for a repaint. That must look exactly like drawing it
+ * directly, which happens again right after its content gets damaged.
+ */
+TEST(transform_cache_matches_direct_drawing)
+{
+	struct client *client;
+	struct surface *background;
+	struct wp_viewport *viewport;
+	struct buffer *cached, *direct;
+	pixman_color_t gray;
+	int i;
+
+	color_rgb888(&gray, 64, 64, 64);
+
+	client = create_client();
+	test_assert_ptr_not_null(client);
+
+	/* move the pointer away, its cursor must not get in the way */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	background = create_test_surface(client);
+	background->width = 320;
+	background->height = 240;
+	background->buffer = create_shm_buffer_solid(client, 320, 240, &gray);
+	weston_test_move_surface(client->test->weston_test,
+				 background->wl_surface, 0, 0);
+	commit_damaged(client, background);
+
+	/* upscaled by a non-integer factor, so it gets filtered */
+	client->surface = create_test_surface(client);
+	viewport = client_create_viewport(client);
+	client->surface->buffer = create_shm_buffer_a8r8g8b8(client, 40, 30);
+	fill_quadrants(client->surface->buffer);
+	wp_viewport_set_destination(viewport, 130, 95);
+	client->surface->width = 130;
+	client->surface->height = 95;
+	move_client_frame_sync(client, 37, 21);
+
+	/* repaint the scaled view through the background, unchanged */
+	for (i = 0; i < 3; i++)
+		commit_damaged(client, background);
+
+	cached = capture_screenshot_of_output(client, NULL, NO_DECORATIONS);
+	test_assert_ptr_not_null(cached);
+
+	/* same content, but damaged: drawn directly again */
+	commit_damaged(client, client->surface);
+
+	direct = capture_screenshot_of_output(client, NULL, NO_DECORATIONS);
+	test_assert_ptr_not_null(direct);
+
+	test_assert_true(check_images_match(cached->image, direct->image,
+					    NULL, NULL));
+
+	buffer_destroy(direct);
+	buffer_destroy(cached);
+	wp_viewport_destroy(viewport);
+	surface_destroy(background);
+	client_destroy(client);
+
+	return RESULT_OK;
+}